@@ -0,0 +1,85 @@
+// This example demonstrates lossless compression of the raw heart and skin conductance
+// signals before sending them over the serial port. Each compressed block is preceded
+// by a channel byte; decode on the computer with extras/host/RiceDecode.
+// The cost of compression (CPU cycles per sample) is printed on Serial1 when available.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <Heart.h>
+#include <SkinConductance.h>
+#include <RiceCodec.h>
+
+// Create instances for sensors.
+Heart heart(A1);
+SkinConductance sc(A6);
+
+// One encoder per channel.
+RiceEncoder heartEncoder;
+RiceEncoder scEncoder;
+
+const uint8_t HEART_CHANNEL = 0;
+const uint8_t SC_CHANNEL = 1;
+
+// Cycle count statistics.
+unsigned long nSamples = 0;
+unsigned long nCycles = 0;
+const long printInterval = 5000;       // millis
+unsigned long lastPrintMillis = 0;
+
+void send(uint8_t channel, RiceEncoder& encoder) {
+  Serial.write(channel);
+  Serial.write(encoder.data(), encoder.size());
+}
+
+void compress(uint8_t channel, RiceEncoder& encoder, uint16_t sample) {
+#ifdef ARM_DWT_CYCCNT
+  uint32_t start = ARM_DWT_CYCCNT;
+  bool blockReady = encoder.put(sample);
+  nCycles += ARM_DWT_CYCCNT - start;
+#else
+  bool blockReady = encoder.put(sample);
+#endif
+  nSamples++;
+  if (blockReady)
+    send(channel, encoder);
+}
+
+void setup() {
+  Serial.begin(115200);
+  Serial1.begin(9600);
+
+#ifdef ARM_DWT_CYCCNT
+  // Enable the cycle counter.
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+#endif
+
+  // Initialize sensors.
+  heart.reset();
+  sc.reset();
+}
+
+void loop() {
+  // Update sensors and compress every new sample.
+  if (heart.update())
+    compress(HEART_CHANNEL, heartEncoder, heart.getRaw());
+  if (sc.update())
+    compress(SC_CHANNEL, scEncoder, sc.getRaw());
+
+  unsigned long currentMillis = millis();
+  if (currentMillis - lastPrintMillis >= printInterval && nSamples > 0) {
+    lastPrintMillis = currentMillis;
+    Serial1.print("cycles/sample: ");
+    Serial1.println((float)nCycles / nSamples);
+  }
+}
@@ -0,0 +1,83 @@
+// This example prints the RAM footprint of the BioData classes on the board: size of one
+// instance, heap allocated by its constructor, and the budget
+// checked at compile time (see Footprint.h), then how many participants fit in RAM.
+// Building it also fails if a class or an example configuration is over its budget.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <BioData.h>
+#include <Footprint.h>
+
+// Storage for the measured objects (constructed in setup(), never destroyed).
+alignas(Heart) uint8_t heartStorage[sizeof(Heart)];
+alignas(SkinConductance) uint8_t scStorage[sizeof(SkinConductance)];
+alignas(Respiration) uint8_t respStorage[sizeof(Respiration)];
+
+extern "C" char* sbrk(int incr);
+
+// Bytes between the top of the heap and the stack.
+int freeRam() {
+  char top;
+  return &top - sbrk(0);
+}
+
+void printLine(const char* name, size_t size, size_t heap, size_t budget) {
+  Serial.print(name);
+  Serial.print("\t");
+  Serial.print(size);
+  Serial.print("\t");
+  Serial.print(heap);
+  Serial.print("\t");
+  Serial.println(budget);
+}
+
+void setup() {
+  Serial.begin(115200);
+  while (!Serial && millis() < 3000) ;
+
+  size_t heartHeap = footprintHeap<Heart>(heartStorage, A1);
+  size_t scHeap = footprintHeap<SkinConductance>(scStorage, A6);
+  size_t respHeap = footprintHeap<Respiration>(respStorage, A0);
+  size_t trioHeap = heartHeap + scHeap + respHeap;
+
+  Serial.println("class\tsizeof\theap\tbudget");
+  printLine("Heart", sizeof(Heart), heartHeap, FOOTPRINT_HEART_BUDGET);
+  printLine("SkinConductance", sizeof(SkinConductance), scHeap, FOOTPRINT_SKIN_CONDUCTANCE_BUDGET);
+  printLine("Respiration", sizeof(Respiration), respHeap, FOOTPRINT_RESPIRATION_BUDGET);
+  printLine("PulseRespiration", sizeof(PulseRespiration), 0, FOOTPRINT_PULSE_RESPIRATION_BUDGET);
+  printLine("PulseTransit", sizeof(PulseTransit), 0, FOOTPRINT_PULSE_TRANSIT_BUDGET);
+  printLine("PulseMorphology", sizeof(PulseMorphology), 0, FOOTPRINT_PULSE_MORPHOLOGY_BUDGET);
+  printLine("HrvComplexity", sizeof(HrvComplexity), 0, FOOTPRINT_HRV_COMPLEXITY_BUDGET);
+  printLine("OscEncoder", sizeof(OscEncoder), 0, FOOTPRINT_OSC_ENCODER_BUDGET);
+  printLine("SampleLogger", sizeof(SampleLogger), 0, FOOTPRINT_SAMPLE_LOGGER_BUDGET);
+  printLine("PyramidLogger", sizeof(PyramidLogger), 0, FOOTPRINT_PYRAMID_LOGGER_BUDGET);
+  printLine("Pyramid", sizeof(Pyramid), 0, FOOTPRINT_PYRAMID_BUDGET);
+  printLine("RiceEncoder", sizeof(RiceEncoder), 0, FOOTPRINT_RICE_ENCODER_BUDGET);
+
+  Serial.println();
+  Serial.println("configuration\tstatic\theap\tbudget");
+  printLine("participant", FOOTPRINT_TRIO, trioHeap, FOOTPRINT_RAM_BUDGET);
+  printLine("OscOutput", FOOTPRINT_OSC_OUTPUT, trioHeap, FOOTPRINT_RAM_BUDGET);
+  printLine("SampleLogger", FOOTPRINT_SAMPLE_LOGGER, trioHeap, FOOTPRINT_RAM_BUDGET);
+  printLine("Pyramid", FOOTPRINT_PYRAMID, trioHeap, FOOTPRINT_RAM_BUDGET);
+  printLine("Compression", FOOTPRINT_COMPRESSION, heartHeap + scHeap, FOOTPRINT_RAM_BUDGET);
+
+  Serial.println();
+  Serial.print("participants in budget: ");
+  Serial.println(FOOTPRINT_RAM_BUDGET / (FOOTPRINT_TRIO + trioHeap));
+  Serial.print("free RAM now: ");
+  Serial.println(freeRam());
+}
+
+void loop() {
+}
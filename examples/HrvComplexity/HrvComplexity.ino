@@ -0,0 +1,40 @@
+// This example measures the complexity of the heart rate (see HrvComplexity.h): the
+// sample entropy and DFA alpha1 of the last 256 beat intervals. Both are updated on
+// every beat; they print as nan until enough beats were seen (alpha1 needs about 50).
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <Heart.h>
+#include <HrvComplexity.h>
+
+// Create instances for sensor and complexity measures.
+Heart heart(A1);
+HrvComplexity complexity;
+
+void setup() {
+  Serial.begin(9600);
+
+  // Initialize sensor.
+  heart.reset();
+}
+
+void loop() {
+  // Update sensor, then the measures (they only work on beats).
+  if (heart.update() && complexity.process(heart)) {
+    Serial.print(heart.getBPM());
+    Serial.print("\t");
+    Serial.print(complexity.getSampleEntropy());
+    Serial.print("\t");
+    Serial.println(complexity.getDfaAlpha1());
+  }
+}
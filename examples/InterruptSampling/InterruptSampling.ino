@@ -0,0 +1,69 @@
+// This example samples the heart and skin conductance sensors in a timer interrupt
+// (Teensy IntervalTimer) so that sampling is not delayed by the main loop. The loop reads
+// the features with getFeatures(), which copies all of them from the same sample without
+// disabling interrupts (see Seqlock.h). Beats are counted, so none are missed between reads.
+// Respiration reads its sensor over I2C and stays in the loop.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <Heart.h>
+#include <SkinConductance.h>
+
+// Create instances for sensors.
+Heart heart(A1);
+SkinConductance sc(A6);
+
+// Heart is sampled at 200 Hz, skin conductance every 4th tick (50 Hz).
+IntervalTimer sampleTimer;
+volatile uint8_t tick = 0;
+
+const long printInterval = 100;       // millis
+unsigned long lastPrintMillis = 0;
+uint32_t lastBeats = 0;
+
+void sampleSensors() {
+  heart.sample();
+  if (++tick == 4) {
+    tick = 0;
+    sc.sample();
+  }
+}
+
+void setup() {
+  Serial.begin(115200);
+  sampleTimer.begin(sampleSensors, 5000);  // microseconds
+}
+
+void loop() {
+  if (millis() - lastPrintMillis >= printInterval) {
+    lastPrintMillis = millis();
+
+    Heart::Features h;
+    SkinConductance::Features s;
+    heart.getFeatures(h);
+    sc.getFeatures(s);
+
+    Serial.print(h.bpm);
+    Serial.print(" ");
+    Serial.print(h.bpmChange);
+    Serial.print(" ");
+    Serial.print(h.amplitudeChange);
+    Serial.print(" ");
+    Serial.print(h.beats - lastBeats);  // beats since last print
+    Serial.print(" ");
+    Serial.print(s.scr);
+    Serial.print(" ");
+    Serial.println(s.scl);
+    lastBeats = h.beats;
+  }
+}
@@ -0,0 +1,65 @@
+// This example demonstrates sending Heart, SkinConductance and Respiration data
+// as SLIP-encoded OSC bundles over the serial port.
+// In Max use [serial] -> [slipOSC], in Pd use [slipdec] -> [oscparse].
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <BioData.h>
+#include <OscEncoder.h>
+
+// Create instances for sensors.
+Heart heart(A1);
+SkinConductance sc(A6);
+Respiration resp(A0);
+
+// OSC bundle: addresses and type tags are laid out once in setup().
+OscEncoder osc;
+int heartMsg;
+int scMsg;
+int respMsg;
+
+//variable for attenuating data flow to serial port prevents crashes
+const long sendInterval = 20;       // millis
+unsigned long lastSendMillis = 0;
+
+void setup() {
+  Serial.begin(115200);
+
+  // Initialize sensors.
+  heart.reset();
+  sc.reset();
+  resp.reset();
+
+  heartMsg = osc.addHeart("/biodata/heart");
+  scMsg = osc.addSkinConductance("/biodata/sc");
+  respMsg = osc.addRespiration("/biodata/resp");
+}
+
+void loop() {
+  // Update sensors.
+  heart.update();
+  sc.update();
+  resp.update();
+
+  unsigned long currentMillis = millis();
+  if (currentMillis - lastSendMillis >= sendInterval) {
+    lastSendMillis = currentMillis;
+
+    // Only the arguments change from one bundle to the next.
+    osc.setTimeTagMicros(micros());
+    osc.setHeart(heartMsg, heart);
+    osc.setSkinConductance(scMsg, sc);
+    osc.setRespiration(respMsg, resp);
+    osc.write(Serial);
+  }
+}
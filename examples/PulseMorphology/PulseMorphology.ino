@@ -0,0 +1,46 @@
+// This example prints the shape of every pulse captured by the heart sensor (see
+// PulseMorphology.h): rise time, width and dicrotic notch, in milliseconds from the foot
+// of the pulse. Each beat is measured when the next one is detected. The correlation with
+// the average beat is low for motion artifacts.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <Heart.h>
+#include <PulseMorphology.h>
+
+// Create instances for sensor and measurements.
+Heart heart(A1);
+PulseMorphology morphology;
+
+void setup() {
+  Serial.begin(9600);
+
+  // Initialize sensor.
+  heart.reset();
+}
+
+void loop() {
+  // Update sensor, then the measurements (they only work on beats).
+  if (heart.update() && morphology.process(heart)) {
+    const PulseMorphology::Beat& beat = morphology.getBeat();
+    Serial.print(beat.riseTime);
+    Serial.print("\t");
+    Serial.print(beat.width);
+    Serial.print("\t");
+    Serial.print(beat.notchTime);      // 0 if no notch was found
+    Serial.print("\t");
+    Serial.print(beat.notchHeight);
+    Serial.print("\t");
+    Serial.println(beat.correlation);  // below 0.5: probably an artifact
+  }
+}
@@ -0,0 +1,41 @@
+// This example estimates the respiration rate from the heart sensor alone (see
+// PulseRespiration.h): breathing modulates the time between beats and the pulse amplitude.
+// The estimate needs about a minute of regular breathing to settle; isReliable() tells
+// when the two estimates agree.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <Heart.h>
+#include <PulseRespiration.h>
+
+// Create instances for sensor and estimator.
+Heart heart(A1);
+PulseRespiration pulseRespiration;
+
+void setup() {
+  Serial.begin(9600);
+
+  // Initialize sensor.
+  heart.reset();
+}
+
+void loop() {
+  // Update sensor, then the estimator (it only works on beats).
+  if (heart.update() && pulseRespiration.process(heart)) {
+    Serial.print(heart.getBPM());
+    Serial.print("\t");
+    Serial.print(pulseRespiration.getRpm());
+    Serial.print("\t");
+    Serial.println(pulseRespiration.isReliable());
+  }
+}
@@ -0,0 +1,55 @@
+// This example measures the pulse transit time between two heart sensors, one on the ear
+// (proximal, closer to the heart) and one on a finger (distal): how long the pulse wave
+// takes to travel between them (see PulseTransit.h). It also prints the longest time spent
+// in PulseTransit since the last beat, to check that the correlation done on each beat
+// fits between two samples on the board.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <Heart.h>
+#include <PulseTransit.h>
+
+// Create instances for sensors.
+Heart ear(A1);
+Heart finger(A2);
+PulseTransit pulseTransit;
+
+unsigned long longestMicros = 0;
+
+void setup() {
+  Serial.begin(9600);
+
+  // Initialize sensors.
+  ear.reset();
+  finger.reset();
+}
+
+void loop() {
+  // Update both sensors on the same tick, then the transit time.
+  if (ear.update()) {
+    finger.sample();
+
+    unsigned long start = micros();
+    bool updated = pulseTransit.process(ear, finger);
+    longestMicros = max(longestMicros, micros() - start);
+
+    if (updated) {
+      Serial.print(pulseTransit.getTransitTime());     // milliseconds, averaged over beats
+      Serial.print("\t");
+      Serial.print(pulseTransit.getCorrelation());     // low values: transit time unreliable
+      Serial.print("\t");
+      Serial.println(longestMicros);                   // cost of the correlation on the board
+      longestMicros = 0;
+    }
+  }
+}
@@ -0,0 +1,88 @@
+// This example demonstrates recording a min/max/mean pyramid of all three sensors to an SD card.
+// The pyramid summarizes the signals at every zoom level, so a plotting program can show a
+// whole night of recording instantly (see extras/host/PyramidStore.h). Only bins of 16 samples
+// and more are written, which takes 3 bytes per sample.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <SD.h>
+#include <BioData.h>
+#include <Pyramid.h>
+
+// Create instances for sensors.
+Heart heart(A1);
+SkinConductance sc(A6);
+Respiration resp(A0);
+
+// Pyramid channels.
+const uint8_t HEART_CHANNEL = 0;
+const uint8_t SC_CHANNEL = 1;
+const uint8_t RESP_CHANNEL = 2;
+
+// Finest level written: bins of 2^4 = 16 samples.
+const uint8_t MIN_LEVEL = 4;
+
+const int chipSelect = BUILTIN_SDCARD; // change to your SD card's CS pin if needed
+
+File file;
+FileStorage<File> storage(file);
+PyramidLogger logger(storage);
+Pyramid heartPyramid(logger, HEART_CHANNEL, MIN_LEVEL);
+Pyramid scPyramid(logger, SC_CHANNEL, MIN_LEVEL);
+Pyramid respPyramid(logger, RESP_CHANNEL, MIN_LEVEL);
+
+// Pin to end the recording (connect to ground).
+const int stopPin = 2;
+bool recording = true;
+
+void setup() {
+  Serial.begin(9600);
+  pinMode(stopPin, INPUT_PULLUP);
+
+  if (!SD.begin(chipSelect)) {
+    Serial.println("SD card initialization failed");
+    while (1);
+  }
+  file = SD.open("pyramid.bin", FILE_WRITE);
+
+  // Initialize sensors.
+  heart.reset();
+  sc.reset();
+  resp.reset();
+}
+
+void loop() {
+  if (!recording)
+    return;
+
+  // Update sensors and add every new sample to its pyramid.
+  if (heart.update())
+    heartPyramid.put(heart.getRaw());
+  if (sc.update())
+    scPyramid.put(sc.getRaw());
+  if (resp.update())
+    respPyramid.put(resp.getRaw());
+
+  // Write the last partial bins and close the file.
+  if (digitalRead(stopPin) == LOW) {
+    heartPyramid.flush();
+    scPyramid.flush();
+    respPyramid.flush();
+    logger.close();
+    file.close();
+    recording = false;
+    Serial.print("Recording closed, ");
+    Serial.print(logger.nWriteErrors());
+    Serial.println(" write errors");
+  }
+}
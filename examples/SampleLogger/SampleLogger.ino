@@ -0,0 +1,79 @@
+// This example demonstrates logging raw samples of all three sensors to an SD card.
+// Samples are appended to one memory block while the other one is written to the card,
+// so a slow SD write does not make you lose samples.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <SD.h>
+#include <BioData.h>
+#include <SampleLogger.h>
+
+// Create instances for sensors.
+Heart heart(A1);
+SkinConductance sc(A6);
+Respiration resp(A0);
+
+// Log channels.
+const uint8_t HEART_CHANNEL = 0;
+const uint8_t SC_CHANNEL = 1;
+const uint8_t RESP_CHANNEL = 2;
+
+const int chipSelect = BUILTIN_SDCARD; // change to your SD card's CS pin if needed
+
+File file;
+FileStorage<File> storage(file);
+SampleLogger logger(storage);
+
+//variable for reporting logger statistics
+const long printInterval = 5000;       // millis
+unsigned long lastPrintMillis = 0;
+
+void setup() {
+  Serial.begin(9600);
+
+  if (!SD.begin(chipSelect)) {
+    Serial.println("SD card initialization failed");
+    while (1);
+  }
+  file = SD.open("samples.bin", FILE_WRITE);
+
+  // Initialize sensors.
+  heart.reset();
+  sc.reset();
+  resp.reset();
+}
+
+void loop() {
+  // Update sensors and log every new sample.
+  if (heart.update())
+    logger.log(HEART_CHANNEL, heart.getRaw(), micros());
+  if (sc.update())
+    logger.log(SC_CHANNEL, sc.getRaw(), micros());
+  if (resp.update())
+    logger.log(RESP_CHANNEL, resp.getRaw(), micros());
+
+  // Write a full block if there is one.
+  logger.flush();
+
+  unsigned long currentMillis = millis();
+  if (currentMillis - lastPrintMillis >= printInterval) {
+    lastPrintMillis = currentMillis;
+    Serial.print(logger.nBlocksWritten());
+    Serial.print(" blocks, ");
+    Serial.print(logger.nOverruns());
+    Serial.print(" overruns, worst write ");
+    Serial.print(logger.maxWriteMicros());
+    Serial.println(" us");
+    file.flush();
+  }
+}
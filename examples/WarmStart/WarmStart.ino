@@ -0,0 +1,70 @@
+// This example demonstrates saving the state of the Heart and SkinConductance filters
+// to EEPROM, and restoring it at power-up so that amplitude and bpm baselines are
+// valid immediately instead of after a long calibration phase.
+// for more info see README at https://github.com/eringee/BioData/
+/******************************************************
+copyright Erin Gee 2017
+Authors Erin Gee // Martin Peach // Thomas Ouellet-Fredericks
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License version 3 as published by
+the Free Software Foundation.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    For more details: <http://www.gnu.org/licenses/>.
+******************************************************/
+#include <EEPROM.h>
+#include <Heart.h>
+#include <SkinConductance.h>
+
+// Create instances for sensors.
+Heart heart(A1);
+SkinConductance sc(A6);
+
+// EEPROM locations of the snapshots.
+const int heartAddress = 0;
+const int scAddress = 256;
+
+// Save the state every 10 minutes (EEPROM has limited write cycles).
+const unsigned long saveInterval = 600000UL;   // millis
+unsigned long lastSaveMillis = 0;
+
+uint8_t buffer[256];
+
+template <class T> void saveToEEPROM(const T& sensor, int address) {
+  size_t size = saveSnapshot(sensor, buffer, sizeof(buffer));
+  for (size_t i = 0; i < size; i++)
+    EEPROM.update(address + i, buffer[i]); // only writes bytes that changed
+}
+
+template <class T> bool loadFromEEPROM(T& sensor, int address) {
+  for (size_t i = 0; i < sizeof(buffer); i++)
+    buffer[i] = EEPROM.read(address + i);
+  return loadSnapshot(sensor, buffer, sizeof(buffer));
+}
+
+void setup() {
+  Serial.begin(9600);
+
+  // Initialize sensors, then restore previous baselines if there are any.
+  heart.reset();
+  sc.reset();
+  if (loadFromEEPROM(heart, heartAddress))
+    Serial.println("Heart state restored");
+  if (loadFromEEPROM(sc, scAddress))
+    Serial.println("Skin conductance state restored");
+}
+
+void loop() {
+  // Update sensors.
+  heart.update();
+  sc.update();
+
+  unsigned long currentMillis = millis();
+  if (currentMillis - lastSaveMillis >= saveInterval) {
+    lastSaveMillis = currentMillis;
+    saveToEEPROM(heart, heartAddress);
+    saveToEEPROM(sc, scAddress);
+  }
+}
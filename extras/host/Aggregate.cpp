@@ -0,0 +1,202 @@
+/*
+ * Aggregate.cpp
+ *
+ * Merges the OSC streams of several boards (Aggregator.h) and prints one
+ * time-aligned CSV line per output frame: time in seconds, then the values
+ * of every device (empty when missing or stale).
+ *
+ * Usage: Aggregate [-rate hz] [-latency ms] [-values n] [-record dir]
+ *                  [-synchrony seconds] source...
+ *
+ * Sources are serial ports, pseudo-TTYs, pipes or FIFOs carrying the SLIP
+ * output of examples/OscOutput, or capture files. With -record, the frames
+ * of every live source are saved to dir/device<i>.cap with their arrival
+ * times. Capture files (which cannot be mixed with live sources) are
+ * replayed as fast as possible. The estimated skew of every device is
+ * printed at the end.
+ *
+ * With -synchrony, three columns are added: mean pairwise BPM correlation,
+ * mean pairwise breath phase locking and group breathing coherence over the
+ * last #seconds# (Synchrony.h). They need the OscOutput layout.
+ *
+ * Defaults: 50 Hz, 100 ms latency, 14 values per device (the Heart,
+ * SkinConductance and Respiration messages of OscOutput).
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "Aggregator.h"
+#include "Synchrony.h"
+
+// Positions of BPM and isExhaling() in OscOutput frames.
+#define BPM_VALUE        1
+#define EXHALING_VALUE   9
+
+// Prints output frames, with the synchrony of the group if requested.
+class Output {
+  size_t _nValues;
+  GroupSynchrony* _synchrony;
+  std::vector<BreathPhase> _phases;
+  std::vector<float> _bpm;
+  std::vector<float> _phase;
+
+public:
+  Output(size_t nDevices, size_t nValues, size_t synchronyFrames) :
+    _nValues(nValues),
+    _synchrony(synchronyFrames ? new GroupSynchrony(nDevices, synchronyFrames) : NULL),
+    _phases(nDevices), _bpm(nDevices), _phase(nDevices)
+  {}
+
+  ~Output() { delete _synchrony; }
+
+  void header() const {
+    printf("time");
+    for (size_t d = 0; d < _bpm.size(); d++)
+      for (size_t v = 0; v < _nValues; v++)
+        printf(",%zu.%zu", d, v);
+    if (_synchrony)
+      printf(",bpmSync,breathSync,coherence");
+    printf("\n");
+  }
+
+  void frame(double seconds, const std::vector<float>& values) {
+    printf("%.3f", seconds);
+    for (size_t v = 0; v < values.size(); v++) {
+      if (isnan(values[v]))
+        printf(",");
+      else
+        printf(",%.6g", values[v]);
+    }
+    if (_synchrony) {
+      for (size_t d = 0; d < _bpm.size(); d++) {
+        const float* device = &values[d * _nValues];
+        _bpm[d] = device[BPM_VALUE];
+        _phase[d] = isnan(device[EXHALING_VALUE]) ? NAN : _phases[d].update(device[EXHALING_VALUE] != 0, seconds);
+      }
+      _synchrony->add(_bpm.data(), _phase.data());
+      printf(",%.4f,%.4f,%.4f", _synchrony->meanBpmCorrelation(), _synchrony->meanPhaseLocking(),
+             _synchrony->groupCoherence());
+    }
+    printf("\n");
+  }
+};
+
+int main(int argc, char** argv) {
+  double rate = 50;
+  int64_t latency = 100000;
+  size_t nValues = 14;
+  const char* recordDirectory = NULL;
+  double synchronySeconds = 0;
+  Aggregator aggregator;
+
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-rate") == 0 && i + 1 < argc)
+      rate = atof(argv[++i]);
+    else if (strcmp(argv[i], "-latency") == 0 && i + 1 < argc)
+      latency = (int64_t)(atof(argv[++i]) * 1000);
+    else if (strcmp(argv[i], "-values") == 0 && i + 1 < argc)
+      nValues = atoi(argv[++i]);
+    else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+      recordDirectory = argv[++i];
+    else if (strcmp(argv[i], "-synchrony") == 0 && i + 1 < argc)
+      synchronySeconds = atof(argv[++i]);
+    else
+      break;
+  }
+  if (i >= argc || rate <= 0 || nValues == 0 || (synchronySeconds > 0 && nValues <= EXHALING_VALUE)) {
+    fprintf(stderr, "usage: %s [-rate hz] [-latency ms] [-values n] [-record dir]\n"
+                    "          [-synchrony seconds] source...\n", argv[0]);
+    return 1;
+  }
+
+  size_t nCaptures = 0;
+  for (; i < argc; i++) {
+    if (aggregator.openDevice(argv[i]) < 0) {
+      perror(argv[i]);
+      return 1;
+    }
+    if (aggregator.device(aggregator.nDevices() - 1).capture)
+      nCaptures++;
+  }
+  bool live = (nCaptures == 0);
+  if (!live && nCaptures < aggregator.nDevices()) {
+    fprintf(stderr, "capture files and live sources cannot be mixed\n");
+    return 1;
+  }
+
+  std::vector<AggregatorCapture> records((recordDirectory && live) ? aggregator.nDevices() : 0);
+  for (size_t d = 0; d < records.size(); d++) {
+    std::string path = std::string(recordDirectory) + "/device" + std::to_string(d) + ".cap";
+    if (!records[d].open(path.c_str())) {
+      perror(path.c_str());
+      return 1;
+    }
+    aggregator.setRecord(d, &records[d]);
+  }
+
+  Output output(aggregator.nDevices(), nValues, (size_t)(synchronySeconds * rate));
+  output.header();
+
+  std::vector<float> values(aggregator.nDevices() * nValues);
+  int64_t period = (int64_t)(1e6 / rate);
+
+  if (!live) {
+    // Replay captures on their own time base.
+    int64_t start = aggregator.nextCaptureArrival();
+    for (int64_t t = start + latency; ; t += period) {
+      bool more = aggregator.replayUntil(t);
+      aggregator.frameAt(t - latency, nValues, values.data());
+      output.frame((double)(t - latency - start) / 1e6, values);
+      if (!more)
+        break;
+    }
+  } else {
+    int64_t start = aggregatorHostMicros();
+    int64_t next = start + latency;
+    int64_t end = INT64_MAX;  // once all sources are closed, until the last frames are out
+    while (next <= end) {
+      int64_t now = aggregatorHostMicros();
+      if (now < next) {
+        int timeout = (int)((next - now + 999) / 1000);
+        if (end != INT64_MAX)
+          usleep(timeout * 1000);
+        else if (!aggregator.poll(timeout))
+          end = aggregatorHostMicros() + latency;
+        continue;
+      }
+      aggregator.frameAt(next - latency, nValues, values.data());
+      output.frame((double)(next - latency - start) / 1e6, values);
+      fflush(stdout);
+      next += period;
+    }
+  }
+
+  for (size_t d = 0; d < aggregator.nDevices(); d++) {
+    const Aggregator::Device& device = aggregator.device(d);
+    fprintf(stderr, "%s: %zu frames, %u bad, skew %.1f ppm\n", device.name.c_str(), device.nFrames,
+            device.nBadFrames, device.clock.skewPpm());
+  }
+  return 0;
+}
@@ -0,0 +1,386 @@
+/*
+ * Aggregator.cpp (host)
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Aggregator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <termios.h>
+#include <unistd.h>
+#include <chrono>
+
+int64_t aggregatorHostMicros() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ClockModel::ClockModel() {
+  reset();
+}
+
+void ClockModel::reset() {
+  _nPoints = 0;
+  _next = 0;
+  _blockSize = 0;
+  _origin = 0;
+  _offset = 0;
+  _skew = 0;
+  _valid = false;
+}
+
+void ClockModel::observe(int64_t deviceMicros, int64_t hostMicros) {
+  double device = (double)deviceMicros;
+  double offset = (double)(hostMicros - deviceMicros);
+
+  if (!_valid) {
+    _origin = device;
+    _offset = offset;
+    _valid = true;
+  }
+
+  if (_blockSize == 0 || offset < _blockMin.offset) {
+    _blockMin.device = device;
+    _blockMin.offset = offset;
+  }
+  _blockSize++;
+
+  // Until the first block is complete, follow the smallest offset.
+  if (_nPoints == 0 && offset < _offset)
+    _offset = offset;
+
+  if (_blockSize >= CLOCK_MODEL_BLOCK) {
+    _points[_next] = _blockMin;
+    _next = (_next + 1) % CLOCK_MODEL_BLOCKS;
+    if (_nPoints < CLOCK_MODEL_BLOCKS)
+      _nPoints++;
+    _blockSize = 0;
+    fit();
+  }
+}
+
+void ClockModel::fit() {
+  if (_nPoints == 1) {
+    _origin = _points[0].device;
+    _offset = _points[0].offset;
+    _skew = 0;
+    return;
+  }
+
+  // Least squares line through the block minima, around their mean.
+  double meanX = 0, meanY = 0;
+  for (size_t i = 0; i < _nPoints; i++) {
+    meanX += _points[i].device;
+    meanY += _points[i].offset;
+  }
+  meanX /= _nPoints;
+  meanY /= _nPoints;
+  double sxy = 0, sxx = 0;
+  for (size_t i = 0; i < _nPoints; i++) {
+    double dx = _points[i].device - meanX;
+    sxy += dx * (_points[i].offset - meanY);
+    sxx += dx * dx;
+  }
+  _origin = meanX;
+  _offset = meanY;
+  _skew = (sxx > 0) ? sxy / sxx : 0;
+  _skew = constrain(_skew, -CLOCK_MODEL_MAX_SKEW, CLOCK_MODEL_MAX_SKEW);
+}
+
+static uint32_t bundleInt32(const uint8_t* p) {
+  return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// Size of the null-terminated, padded OSC string at #p#, or 0 if it overruns #end#.
+static size_t bundleStringSize(const uint8_t* p, const uint8_t* end) {
+  const uint8_t* q = p;
+  while (q < end && *q) q++;
+  if (q >= end) return 0;
+  size_t size = ((q - p) + 4) & ~3;
+  return (p + size <= end) ? size : 0;
+}
+
+bool aggregatorDecodeBundle(const uint8_t* data, size_t size, uint32_t& micros, AggregatorFrame& frame) {
+  if (size < 16 || memcmp(data, "#bundle", 8) != 0)
+    return false;
+
+  // Timetag written by OscEncoder::setTimeTagMicros().
+  uint32_t seconds = bundleInt32(data + 8);
+  uint32_t fraction = bundleInt32(data + 12);
+  micros = seconds * 1000000UL + (uint32_t)(((uint64_t)fraction * 1000000UL + 0x80000000UL) >> 32);
+
+  frame.nValues = 0;
+  const uint8_t* p = data + 16;
+  const uint8_t* end = data + size;
+  while (p + 4 <= end) {
+    uint32_t elementSize = bundleInt32(p);
+    p += 4;
+    if (elementSize > (size_t)(end - p))
+      return false;
+    const uint8_t* elementEnd = p + elementSize;
+
+    size_t addressSize = bundleStringSize(p, elementEnd);
+    if (addressSize == 0) return false;
+    const uint8_t* tags = p + addressSize;
+    size_t tagsSize = bundleStringSize(tags, elementEnd);
+    if (tagsSize == 0 || tags[0] != ',') return false;
+    const uint8_t* arg = tags + tagsSize;
+
+    for (const uint8_t* t = tags + 1; *t; t++, arg += 4) {
+      if (arg + 4 > elementEnd || (*t != 'f' && *t != 'i'))
+        return false;
+      uint32_t bits = bundleInt32(arg);
+      float value;
+      if (*t == 'f')
+        memcpy(&value, &bits, 4);
+      else
+        value = (float)(int32_t)bits;
+      if (frame.nValues < AGGREGATOR_MAX_VALUES)
+        frame.values[frame.nValues++] = value;
+    }
+    p = elementEnd;
+  }
+  return true;
+}
+
+bool AggregatorCapture::open(const char* path) {
+  close();
+  _file = fopen(path, "wb");
+  return _file != NULL;
+}
+
+bool AggregatorCapture::write(int64_t hostMicros, const uint8_t* bundle, size_t size) {
+  if (!_file) return false;
+  uint8_t header[10];
+  for (int i = 0; i < 8; i++)
+    header[i] = (uint8_t)((uint64_t)hostMicros >> (8 * i));
+  header[8] = (uint8_t)size;
+  header[9] = (uint8_t)(size >> 8);
+  return fwrite(header, 1, 10, _file) == 10 && fwrite(bundle, 1, size, _file) == size;
+}
+
+void AggregatorCapture::close() {
+  if (_file) fclose(_file);
+  _file = NULL;
+}
+
+Aggregator::Aggregator() :
+  _maxStaleMicros(500000),
+  _frameCallback(NULL),
+  _frameContext(NULL)
+{}
+
+Aggregator::~Aggregator() {
+  for (size_t i = 0; i < _devices.size(); i++) {
+    if (_devices[i]->fd >= 0) ::close(_devices[i]->fd);
+    if (_devices[i]->capture) fclose(_devices[i]->capture);
+    delete _devices[i];
+  }
+}
+
+size_t Aggregator::addDevice(const char* name) {
+  Device* device = new Device();
+  device->name = name;
+  device->index = _devices.size();
+  device->fd = -1;
+  device->capture = NULL;
+  device->record = NULL;
+  device->lastMicros = 0;
+  device->unwrapped = 0;
+  device->started = false;
+  device->nFrames = 0;
+  device->nValues = 0;
+  device->nextArrival = INT64_MAX;
+  device->ended = true;
+  device->nBadFrames = 0;
+  _devices.push_back(device);
+  return _devices.size() - 1;
+}
+
+int Aggregator::openDevice(const char* path) {
+  struct stat st;
+  if (stat(path, &st) != 0)
+    return -1;
+
+  if (S_ISREG(st.st_mode)) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return -1;
+    size_t i = addDevice(path);
+    _devices[i]->capture = file;
+    _devices[i]->ended = false;
+    readCapture(*_devices[i]);
+    return i;
+  }
+
+  // A FIFO without writer reads as closed: wait for the writer first.
+  int fd = open(path, S_ISFIFO(st.st_mode) ? O_RDONLY : O_RDONLY | O_NONBLOCK | O_NOCTTY);
+  if (fd < 0) return -1;
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  if (isatty(fd)) {
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+      cfmakeraw(&tio);
+      tcsetattr(fd, TCSANOW, &tio);
+    }
+  }
+  size_t i = addDevice(path);
+  _devices[i]->fd = fd;
+  return i;
+}
+
+void Aggregator::setRecord(size_t i, AggregatorCapture* capture) {
+  _devices[i]->record = capture;
+}
+
+void Aggregator::addFrame(Device& device, const uint8_t* bundle, size_t size, int64_t hostMicros) {
+  AggregatorFrame& frame = device.history[device.nFrames % AGGREGATOR_HISTORY];
+  uint32_t micros;
+  if (!aggregatorDecodeBundle(bundle, size, micros, frame)) {
+    device.nBadFrames++;
+    return;
+  }
+  if (device.record)
+    device.record->write(hostMicros, bundle, size);
+
+  // Device micros() wraps around every 2^32 us.
+  if (device.started)
+    device.unwrapped += (uint32_t)(micros - device.lastMicros);
+  else
+    device.unwrapped = micros;
+  device.started = true;
+  device.lastMicros = micros;
+
+  frame.deviceMicros = device.unwrapped;
+  device.clock.observe(frame.deviceMicros, hostMicros);
+  device.nValues = frame.nValues;
+  device.nFrames++;
+
+  if (_frameCallback)
+    _frameCallback(device.index, frame, hostMicros, _frameContext);
+}
+
+void Aggregator::ingest(size_t i, const uint8_t* bytes, size_t n, int64_t hostMicros) {
+  Device& device = *_devices[i];
+  for (size_t k = 0; k < n; k++) {
+    if (device.slip.decode(bytes[k]))
+      addFrame(device, device.slip.data(), device.slip.size(), hostMicros);
+  }
+}
+
+bool Aggregator::poll(int timeoutMillis) {
+  std::vector<struct pollfd> fds;
+  std::vector<size_t> indices;
+  for (size_t i = 0; i < _devices.size(); i++) {
+    if (_devices[i]->fd >= 0) {
+      struct pollfd p = { _devices[i]->fd, POLLIN, 0 };
+      fds.push_back(p);
+      indices.push_back(i);
+    }
+  }
+  if (fds.empty())
+    return false;
+
+  if (::poll(fds.data(), fds.size(), timeoutMillis) <= 0)
+    return true;
+
+  uint8_t buffer[4096];
+  for (size_t k = 0; k < fds.size(); k++) {
+    if (!(fds[k].revents & (POLLIN | POLLHUP | POLLERR)))
+      continue;
+    Device& device = *_devices[indices[k]];
+    ssize_t n = read(device.fd, buffer, sizeof(buffer));
+    if (n > 0) {
+      ingest(indices[k], buffer, n, aggregatorHostMicros());
+    } else if (n == 0 || (errno != EAGAIN && errno != EINTR)) {
+      ::close(device.fd);
+      device.fd = -2;
+    }
+  }
+  return true;
+}
+
+bool Aggregator::readCapture(Device& device) {
+  uint8_t header[10];
+  if (fread(header, 1, 10, device.capture) == 10) {
+    uint64_t arrival = 0;
+    for (int i = 0; i < 8; i++)
+      arrival |= (uint64_t)header[i] << (8 * i);
+    device.nextBundle.resize(header[8] | (header[9] << 8));
+    if (fread(device.nextBundle.data(), 1, device.nextBundle.size(), device.capture) == device.nextBundle.size()) {
+      device.nextArrival = (int64_t)arrival;
+      return true;
+    }
+  }
+  device.ended = true;
+  device.nextArrival = INT64_MAX;
+  return false;
+}
+
+bool Aggregator::replayUntil(int64_t hostMicros) {
+  bool more = false;
+  for (size_t i = 0; i < _devices.size(); i++) {
+    Device& device = *_devices[i];
+    while (!device.ended && device.nextArrival <= hostMicros) {
+      addFrame(device, device.nextBundle.data(), device.nextBundle.size(), device.nextArrival);
+      readCapture(device);
+    }
+    more = more || !device.ended;
+  }
+  return more;
+}
+
+int64_t Aggregator::nextCaptureArrival() const {
+  int64_t next = INT64_MAX;
+  for (size_t i = 0; i < _devices.size(); i++) {
+    if (_devices[i]->nextArrival < next)
+      next = _devices[i]->nextArrival;
+  }
+  return next;
+}
+
+void Aggregator::frameAt(int64_t hostMicros, size_t nValues, float* out) const {
+  for (size_t i = 0; i < _devices.size(); i++) {
+    const Device& device = *_devices[i];
+    float* values = out + i * nValues;
+
+    // Latest frame at or before #hostMicros#, from the newest.
+    const AggregatorFrame* frame = NULL;
+    int64_t time = 0;
+    size_t oldest = (device.nFrames > AGGREGATOR_HISTORY) ? device.nFrames - AGGREGATOR_HISTORY : 0;
+    for (size_t k = device.nFrames; k > oldest; k--) {
+      const AggregatorFrame& f = device.history[(k - 1) % AGGREGATOR_HISTORY];
+      time = device.clock.toHost(f.deviceMicros);
+      if (time <= hostMicros) {
+        frame = &f;
+        break;
+      }
+    }
+
+    if (frame && hostMicros - time <= _maxStaleMicros) {
+      for (size_t v = 0; v < nValues; v++)
+        values[v] = (v < frame->nValues) ? frame->values[v] : NAN;
+    } else {
+      for (size_t v = 0; v < nValues; v++)
+        values[v] = NAN;
+    }
+  }
+}
@@ -0,0 +1,236 @@
+/*
+ * Aggregator.h (host)
+ *
+ * Merges the OSC streams of several boards (see examples/OscOutput) into one
+ * stream of time-aligned multi-subject frames.
+ *
+ * Every board stamps its bundles with its own micros(), which starts at a
+ * different time on each board, drifts by up to a few hundred ppm and wraps
+ * every 71 minutes. Each device stream gets a ClockModel mapping device time
+ * to host time, fitted on (device time, arrival time) pairs: transport
+ * delays only ever make frames late, so the model follows the lower envelope
+ * of the observed offsets (minimum per block of frames, then a least-squares
+ * line over the last blocks) and estimates both offset and skew.
+ *
+ * Sources are pipes, FIFOs, serial ports and pseudo-TTYs (SLIP bytes, stamped
+ * on arrival with the host clock), or capture files recorded by
+ * AggregatorCapture (SLIP frames with their arrival times), which replay a
+ * session exactly.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_AGGREGATOR_H_
+#define BIODATA_HOST_AGGREGATOR_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "OscEncoder.h"
+
+// Values kept per device frame (all arguments of all messages of a bundle).
+#ifndef AGGREGATOR_MAX_VALUES
+#define AGGREGATOR_MAX_VALUES 32
+#endif
+
+// Device frames kept per device for alignment.
+#ifndef AGGREGATOR_HISTORY
+#define AGGREGATOR_HISTORY 256
+#endif
+
+// Frames per block of the clock model, and blocks used for the fit.
+#ifndef CLOCK_MODEL_BLOCK
+#define CLOCK_MODEL_BLOCK 50
+#endif
+#ifndef CLOCK_MODEL_BLOCKS
+#define CLOCK_MODEL_BLOCKS 120
+#endif
+
+// Largest plausible clock error (crystals are within a few hundred ppm):
+// bursts of frames read late, eg. from a full buffer, must not tilt the fit.
+#ifndef CLOCK_MODEL_MAX_SKEW
+#define CLOCK_MODEL_MAX_SKEW 1e-3
+#endif
+
+/**
+ * Maps the unwrapped device clock to the host clock: host = device + offset
+ * + skew * (device - origin), fitted on the minima of (arrival - device)
+ * of blocks of CLOCK_MODEL_BLOCK observations.
+ */
+class ClockModel {
+  struct Point {
+    double device;
+    double offset;
+  };
+  Point _points[CLOCK_MODEL_BLOCKS];
+  size_t _nPoints;
+  size_t _next;
+
+  Point _blockMin;
+  size_t _blockSize;
+
+  double _origin;
+  double _offset;
+  double _skew;
+  bool _valid;
+
+  void fit();
+
+public:
+  ClockModel();
+
+  void reset();
+
+  /// Adds a frame stamped #deviceMicros# (unwrapped) that arrived at #hostMicros#.
+  void observe(int64_t deviceMicros, int64_t hostMicros);
+
+  /// Host time of device time #deviceMicros#.
+  int64_t toHost(int64_t deviceMicros) const {
+    return (int64_t)(deviceMicros + _offset + _skew * (deviceMicros - _origin));
+  }
+
+  /// True once at least one observation was made.
+  bool valid() const { return _valid; }
+
+  /// Estimated device clock error (host ticks per device tick - 1), in ppm.
+  double skewPpm() const { return _skew * 1e6; }
+};
+
+/// One device frame, as decoded from an OSC bundle.
+struct AggregatorFrame {
+  int64_t deviceMicros;   // unwrapped timetag
+  uint8_t nValues;
+  float values[AGGREGATOR_MAX_VALUES];
+};
+
+/// Decodes the timetag (in micros, modulo 2^32) and arguments of an OSC bundle.
+bool aggregatorDecodeBundle(const uint8_t* data, size_t size, uint32_t& micros, AggregatorFrame& frame);
+
+/// Writes a capture file: per frame, uint64 arrival time (host micros,
+/// little-endian), uint16 size, then the bundle.
+class AggregatorCapture {
+  FILE* _file;
+
+public:
+  AggregatorCapture() : _file(NULL) {}
+  ~AggregatorCapture() { close(); }
+
+  bool open(const char* path);
+  bool write(int64_t hostMicros, const uint8_t* bundle, size_t size);
+  void close();
+};
+
+class Aggregator {
+public:
+  struct Device {
+    std::string name;
+    size_t index;
+    int fd;                 // -1 for devices fed with ingest()
+    FILE* capture;          // capture file source, or NULL
+    AggregatorCapture* record; // where to record frames, or NULL
+    SlipDecoder slip;
+    ClockModel clock;
+
+    uint32_t lastMicros;    // last timetag, to unwrap
+    int64_t unwrapped;
+    bool started;
+
+    // Frames, oldest first in a ring.
+    AggregatorFrame history[AGGREGATOR_HISTORY];
+    size_t nFrames;         // total received
+    uint8_t nValues;        // values per frame (of the last frame)
+
+    // Next capture record (capture sources only).
+    int64_t nextArrival;
+    std::vector<uint8_t> nextBundle;
+    bool ended;
+
+    uint32_t nBadFrames;
+  };
+
+  /// Called for every frame decoded, see setFrameCallback().
+  typedef void (*FrameCallback)(size_t device, const AggregatorFrame& frame, int64_t hostMicros, void* context);
+
+private:
+  std::vector<Device*> _devices;
+  int64_t _maxStaleMicros;
+  FrameCallback _frameCallback;
+  void* _frameContext;
+
+  void addFrame(Device& device, const uint8_t* bundle, size_t size, int64_t hostMicros);
+  bool readCapture(Device& device);
+
+public:
+  Aggregator();
+  ~Aggregator();
+
+  /// Values of devices without a frame in the last #micros# are NaN (default 500 ms).
+  void setMaxStale(int64_t micros) { _maxStaleMicros = micros; }
+
+  /// Adds a device fed with ingest(). Returns its index.
+  size_t addDevice(const char* name);
+
+  /**
+   * Adds a device read from #path#: a capture file, or a pipe, FIFO or
+   * TTY (put in raw mode). Returns its index, or -1 if it cannot be opened.
+   */
+  int openDevice(const char* path);
+
+  size_t nDevices() const { return _devices.size(); }
+  const Device& device(size_t i) const { return *_devices[i]; }
+
+  /// Records the frames of device #i# to #capture# (NULL to stop).
+  void setRecord(size_t i, AggregatorCapture* capture);
+
+  /// Calls #callback# with every frame decoded, and its arrival time.
+  void setFrameCallback(FrameCallback callback, void* context) {
+    _frameCallback = callback;
+    _frameContext = context;
+  }
+
+  /// Feeds SLIP bytes of device #i# that arrived at #hostMicros#.
+  void ingest(size_t i, const uint8_t* bytes, size_t n, int64_t hostMicros);
+
+  /**
+   * Reads what is available from pipes and TTYs, waiting up to
+   * #timeoutMillis#. Returns false when all of them are closed.
+   */
+  bool poll(int timeoutMillis);
+
+  /**
+   * Replays the records of capture files that arrived before #hostMicros#.
+   * Returns false when all captures have ended.
+   */
+  bool replayUntil(int64_t hostMicros);
+
+  /// Arrival time of the next capture record (INT64_MAX if none).
+  int64_t nextCaptureArrival() const;
+
+  /**
+   * Fills #out# with the values of every device at host time #hostMicros#
+   * (#nValues# per device, latest frame at or before that time, NaN if none
+   * or stale). Query times a little behind the latest arrivals, so that
+   * all devices have reported.
+   */
+  void frameAt(int64_t hostMicros, size_t nValues, float* out) const;
+};
+
+/// Host clock in microseconds (steady).
+int64_t aggregatorHostMicros();
+
+#endif
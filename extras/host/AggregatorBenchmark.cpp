@@ -0,0 +1,182 @@
+/*
+ * AggregatorBenchmark.cpp
+ *
+ * Simulates groups of boards sending OscOutput bundles at 50 Hz for 10
+ * minutes, each with its own start time (some close to the 32-bit micros()
+ * wrap), a clock error of up to +/-150 ppm and variable transport delays
+ * (1-4 ms, with 5% of frames delayed up to 60 ms), and merges them with
+ * Aggregator on one thread at 50 output frames per second.
+ *
+ * Reports, per group size: CPU time per simulated second and real-time
+ * factor, error of the aligned device clocks (against the simulated truth)
+ * after 10 s, error of the estimated skews, and the share of output frames
+ * holding the device frame they should. Aligned times include the minimum
+ * transport delay (1 ms here), common to all boards: frames sent less than
+ * that before an output frame only show up in the next one.
+ *
+ * Usage: AggregatorBenchmark [-write dir]
+ *
+ * With -write, the streams of the first group are also saved as capture
+ * files (dir/device<i>.cap) for Aggregate.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Aggregator.h"
+
+#define DURATION_MICROS  (600LL * 1000000)
+#define FRAME_MICROS     20000
+#define LATENCY_MICROS   100000
+#define WARMUP_MICROS    (10LL * 1000000)
+#define N_VALUES         14
+
+// Small deterministic generator.
+static uint32_t randomState = 12345;
+static double uniform() {
+  randomState = randomState * 1664525UL + 1013904223UL;
+  return (randomState >> 8) / 16777216.0;
+}
+
+struct SimulatedBoard {
+  uint64_t start;       // device micros at host time 0
+  double skew;          // device ticks per host tick - 1
+  int64_t phase;        // host time of the first frame
+  OscEncoder osc;
+  int heartMsg;
+  uint32_t nSent;
+  int64_t nextArrival;  // of frame #nSent#
+
+  // Host time at which the board sends frame #k#.
+  int64_t sendTime(uint32_t k) const { return phase + (int64_t)((double)k * FRAME_MICROS / (1 + skew)); }
+};
+
+static double percentile(std::vector<double>& values, double p) {
+  if (values.empty()) return 0;
+  size_t k = std::min(values.size() - 1, (size_t)(p * values.size()));
+  std::nth_element(values.begin(), values.begin() + k, values.end());
+  return values[k];
+}
+
+static int64_t delay() {
+  return 1000 + (int64_t)(3000 * uniform()) + ((uniform() < 0.05) ? (int64_t)(60000 * uniform()) : 0);
+}
+
+static bool run(size_t nBoards, const char* writeDirectory) {
+  std::vector<SimulatedBoard> boards(nBoards);
+  Aggregator aggregator;
+  std::vector<AggregatorCapture> captures(writeDirectory ? nBoards : 0);
+  for (size_t b = 0; b < nBoards; b++) {
+    SimulatedBoard& board = boards[b];
+    board.start = (b % 4 == 0) ? 4294967295ULL - (uint64_t)(300e6 * uniform()) : (uint64_t)(1e6 + 30e6 * uniform());
+    board.skew = (2 * uniform() - 1) * 150e-6;
+    board.phase = (int64_t)(FRAME_MICROS * uniform());
+    board.heartMsg = board.osc.addHeart();
+    board.osc.addSkinConductance();
+    board.osc.addRespiration();
+    board.nSent = 0;
+    board.nextArrival = board.sendTime(0) + delay();
+    aggregator.addDevice(("board" + std::to_string(b)).c_str());
+    if (writeDirectory) {
+      std::string path = std::string(writeDirectory) + "/device" + std::to_string(b) + ".cap";
+      captures[b].open(path.c_str());
+      aggregator.setRecord(b, &captures[b]);
+    }
+  }
+
+  uint8_t frame[2 * OSC_ENCODER_MAX_SIZE + 2];
+  std::vector<float> values(nBoards * N_VALUES);
+  std::vector<double> alignErrors;
+  size_t nMatched = 0, nChecked = 0;
+  double cpu = 0;
+
+  for (int64_t t = FRAME_MICROS; t <= DURATION_MICROS; t += FRAME_MICROS) {
+    for (size_t b = 0; b < nBoards; b++) {
+      SimulatedBoard& board = boards[b];
+      while (board.nextArrival <= t) {
+        // Frame number in the first value, device micros() in the timetag.
+        uint32_t k = board.nSent++;
+        uint64_t deviceMicros = board.start + (uint64_t)k * FRAME_MICROS;
+        board.osc.setTimeTagMicros((uint32_t)deviceMicros);
+        board.osc.setFloat(board.heartMsg, 0, (float)k);
+        size_t n = board.osc.encode(frame, sizeof(frame));
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        aggregator.ingest(b, frame, n, board.nextArrival);
+        cpu += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        // Frames can overtake each other in the simulation: keep them in order.
+        board.nextArrival = std::max(board.nextArrival, board.sendTime(board.nSent) + delay());
+      }
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int64_t query = t - LATENCY_MICROS;
+    aggregator.frameAt(query, N_VALUES, values.data());
+    cpu += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    if (query < WARMUP_MICROS)
+      continue;
+    for (size_t b = 0; b < nBoards; b++) {
+      const Aggregator::Device& device = aggregator.device(b);
+      const SimulatedBoard& board = boards[b];
+
+      // Device frame that was sent last at #query#.
+      uint32_t expected = (uint32_t)floor((query - board.phase) * (1 + board.skew) / FRAME_MICROS);
+      nChecked++;
+      if (values[b * N_VALUES] == (float)expected)
+        nMatched++;
+
+      // Aligned time of that frame against the truth, once per second.
+      if (t % 1000000 == 0) {
+        // The unwrapped device clock starts at the first timetag.
+        int64_t deviceMicros = device.history[(device.nFrames - 1) % AGGREGATOR_HISTORY].deviceMicros;
+        int64_t firstMicros = (int64_t)(board.start & 0xFFFFFFFFULL);
+        int64_t truth = board.sendTime((uint32_t)((deviceMicros - firstMicros) / FRAME_MICROS));
+        alignErrors.push_back(fabs((double)(device.clock.toHost(deviceMicros) - truth)));
+      }
+    }
+  }
+
+  std::vector<double> skewErrors;
+  for (size_t b = 0; b < nBoards; b++)
+    skewErrors.push_back(fabs(aggregator.device(b).clock.skewPpm() - (1 / (1 + boards[b].skew) - 1) * 1e6));
+
+  double seconds = DURATION_MICROS / 1e6;
+  printf("%8zu %10.1f %10.0fx %10.0f %10.0f %10.2f %10.2f %9.2f%%\n", nBoards, cpu / seconds * 1e6,
+         seconds / cpu, percentile(alignErrors, 0.5), percentile(alignErrors, 0.99),
+         percentile(skewErrors, 0.5), percentile(skewErrors, 1.0), 100.0 * nMatched / nChecked);
+  return true;
+}
+
+int main(int argc, char** argv) {
+  const char* writeDirectory = (argc > 2 && strcmp(argv[1], "-write") == 0) ? argv[2] : NULL;
+  printf("10 minutes of 50 Hz OSC per board, aligned at 50 Hz with %d ms latency\n", LATENCY_MICROS / 1000);
+  printf("%8s %10s %11s %10s %10s %10s %10s %10s\n", "boards", "us cpu/s", "real-time", "align p50",
+         "align p99", "skew p50", "skew max", "matched");
+  printf("%8s %10s %11s %10s %10s %10s %10s %10s\n", "", "", "", "(us)", "(us)", "(ppm)", "(ppm)", "");
+  size_t groups[] = { 4, 8, 16, 32, 64 };
+  for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++)
+    run(groups[g], g == 0 ? writeDirectory : NULL);
+  return 0;
+}
@@ -0,0 +1,196 @@
+/*
+ * ArchiveBenchmark.cpp
+ *
+ * Compares FeatureArchive with wide CSV for the features of a long replay
+ * (8 hours of synthetic 200 Hz PPG through Heart): file size, write time,
+ * and time to read a single column over the whole file or over one hour.
+ * Checks that the archive gives back exactly the values written.
+ *
+ * Usage: ArchiveBenchmark [directory]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "FeatureArchive.h"
+#include "Replay.h"
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static long fileSize(const char* path) {
+  struct stat st;
+  return (stat(path, &st) == 0) ? st.st_size : -1;
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+struct Sum {
+  double sum;
+  size_t n;
+};
+
+static void addValues(uint64_t, const float* values, size_t n, void* context) {
+  Sum* s = (Sum*)context;
+  for (size_t i = 0; i < n; i++)
+    s->sum += values[i];
+  s->n += n;
+}
+
+int main(int argc, char** argv) {
+  std::string directory = (argc > 1) ? argv[1] : "/tmp";
+  std::string archivePath = directory + "/features.bdfa";
+  std::string csvPath = directory + "/features.csv";
+  const unsigned long rate = 200;
+
+  // Features of 8 hours of PPG.
+  std::vector<uint16_t> samples;
+  double phase = 0;
+  for (size_t i = 0; i < 8UL * 3600 * rate; i++) {
+    double t = (double)i / rate;
+    phase = fmod(phase + (1.2 + 0.2 * sin(t / 600.0)) / rate, 1.0);
+    double pulse = exp(-pow((phase - 0.2) / 0.06, 2)) + 0.3 * exp(-pow((phase - 0.45) / 0.08, 2));
+    samples.push_back((uint16_t)(350 + (250 + 50 * sin(t / 900.0)) * pulse + noise(3)));
+  }
+  size_t n = samples.size();
+  std::vector<HeartFeatures> features(n);
+  replay<HeartChannel>(samples.data(), n, rate, features.data());
+
+  std::vector<std::string> columns;
+  columns.push_back("normalized");
+  columns.push_back("bpm");
+  columns.push_back("bpmChange");
+  columns.push_back("amplitudeChange");
+  columns.push_back("beat");
+
+  // CSV.
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  FILE* csv = fopen(csvPath.c_str(), "w");
+  if (!csv) {
+    perror(csvPath.c_str());
+    return 1;
+  }
+  fprintf(csv, "time,normalized,bpm,bpmChange,amplitudeChange,beat\n");
+  for (size_t i = 0; i < n; i++) {
+    const HeartFeatures& f = features[i];
+    fprintf(csv, "%.3f,%.9g,%.9g,%.9g,%.9g,%d\n", (double)i / rate, f.normalized, f.bpm, f.bpmChange,
+            f.amplitudeChange, f.beat ? 1 : 0);
+  }
+  fclose(csv);
+  double csvWrite = seconds(start);
+
+  // Archive.
+  start = std::chrono::steady_clock::now();
+  FeatureArchiveWriter writer;
+  if (!writer.open(archivePath.c_str(), columns, rate)) {
+    perror(archivePath.c_str());
+    return 1;
+  }
+  for (size_t i = 0; i < n; i++) {
+    const HeartFeatures& f = features[i];
+    float row[5] = { f.normalized, f.bpm, f.bpmChange, f.amplitudeChange, f.beat ? 1.0f : 0.0f };
+    writer.append(row);
+  }
+  if (!writer.close()) {
+    fprintf(stderr, "write error\n");
+    return 1;
+  }
+  double archiveWrite = seconds(start);
+
+  printf("%zu rows x %zu features\n", n, columns.size());
+  printf("%-10s %12s %10s %10s\n", "", "size", "write", "B/row");
+  printf("%-10s %12ld %9.3fs %10.2f\n", "CSV", fileSize(csvPath.c_str()), csvWrite,
+         (double)fileSize(csvPath.c_str()) / n);
+  printf("%-10s %12ld %9.3fs %10.2f\n", "archive", fileSize(archivePath.c_str()), archiveWrite,
+         (double)fileSize(archivePath.c_str()) / n);
+
+  // Mean BPM over the whole file.
+  start = std::chrono::steady_clock::now();
+  csv = fopen(csvPath.c_str(), "r");
+  char line[256];
+  double csvSum = 0;
+  size_t csvRows = 0;
+  if (fgets(line, sizeof(line), csv)) {
+    while (fgets(line, sizeof(line), csv)) {
+      char* p = strchr(line, ',');
+      p = strchr(p + 1, ',');
+      csvSum += strtof(p + 1, NULL);
+      csvRows++;
+    }
+  }
+  fclose(csv);
+  double csvScan = seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  FeatureArchiveReader reader;
+  if (!reader.open(archivePath.c_str())) {
+    fprintf(stderr, "cannot open archive\n");
+    return 1;
+  }
+  int bpm = reader.findColumn("bpm");
+  Sum all = { 0, 0 };
+  size_t nChunks = reader.scan(bpm, 0, reader.nRows(), -INFINITY, INFINITY, addValues, &all);
+  double archiveScan = seconds(start);
+
+  printf("mean bpm, all rows:   CSV %.3fs (%.4f)  archive %.4fs (%.4f, %zu chunks decoded)\n",
+         csvScan, csvSum / csvRows, archiveScan, all.sum / all.n, nChunks);
+
+  // Mean BPM during the fourth hour.
+  start = std::chrono::steady_clock::now();
+  Sum hour = { 0, 0 };
+  nChunks = reader.scan(bpm, reader.rowAt(3 * 3600), reader.rowAt(4 * 3600), -INFINITY, INFINITY, addValues, &hour);
+  double hourScan = seconds(start);
+  printf("mean bpm, 4th hour:   archive %.5fs (%.4f, %zu rows, %zu chunks decoded)\n",
+         hourScan, hour.sum / hour.n, hour.n, nChunks);
+
+  // Chunks where bpm exceeds 80.
+  Sum high = { 0, 0 };
+  start = std::chrono::steady_clock::now();
+  nChunks = reader.scan(bpm, 0, reader.nRows(), 80, INFINITY, addValues, &high);
+  printf("chunks with bpm > 80: archive %.5fs (%zu chunks decoded of %zu)\n",
+         seconds(start), nChunks, (size_t)((n + FEATURE_ARCHIVE_CHUNK_ROWS - 1) / FEATURE_ARCHIVE_CHUNK_ROWS));
+
+  // Round trip.
+  bool ok = (reader.nRows() == n);
+  std::vector<float> column(n);
+  for (size_t c = 0; c < columns.size() && ok; c++) {
+    ok = (reader.read(c, 0, n, column.data()) == n);
+    for (size_t i = 0; i < n && ok; i++) {
+      const HeartFeatures& f = features[i];
+      float expected[5] = { f.normalized, f.bpm, f.bpmChange, f.amplitudeChange, f.beat ? 1.0f : 0.0f };
+      ok = (memcmp(&column[i], &expected[c], 4) == 0);
+    }
+  }
+  printf("round trip: %s\n", ok ? "identical" : "MISMATCH");
+
+  remove(csvPath.c_str());
+  remove(archivePath.c_str());
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,93 @@
+/*
+ * ArchiveDump.cpp
+ *
+ * Prints selected columns of a FeatureArchive as CSV, optionally restricted
+ * to a time range. Only the chunks of the requested columns are decoded.
+ *
+ * Usage: ArchiveDump archive.bdfa [-from seconds] [-to seconds] [column...]
+ *
+ * Without columns, lists the columns of the archive.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "FeatureArchive.h"
+
+// Rows decoded at a time.
+#define DUMP_ROWS 65536
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s archive.bdfa [-from seconds] [-to seconds] [column...]\n", argv[0]);
+    return 1;
+  }
+
+  FeatureArchiveReader reader;
+  if (!reader.open(argv[1])) {
+    fprintf(stderr, "%s: not a feature archive\n", argv[1]);
+    return 1;
+  }
+
+  uint64_t firstRow = 0, endRow = reader.nRows();
+  std::vector<int> columns;
+  for (int i = 2; i < argc; i++) {
+    if (strcmp(argv[i], "-from") == 0 && i + 1 < argc) {
+      firstRow = reader.rowAt(atof(argv[++i]));
+    } else if (strcmp(argv[i], "-to") == 0 && i + 1 < argc) {
+      endRow = reader.rowAt(atof(argv[++i]));
+    } else {
+      int column = reader.findColumn(argv[i]);
+      if (column < 0) {
+        fprintf(stderr, "%s: no column %s\n", argv[1], argv[i]);
+        return 1;
+      }
+      columns.push_back(column);
+    }
+  }
+  if (endRow > reader.nRows())
+    endRow = reader.nRows();
+
+  if (columns.empty()) {
+    printf("%llu rows at %u Hz\n", (unsigned long long)reader.nRows(), reader.rate());
+    for (size_t c = 0; c < reader.nColumns(); c++)
+      printf("%s\n", reader.columnName(c).c_str());
+    return 0;
+  }
+
+  printf("time");
+  for (size_t c = 0; c < columns.size(); c++)
+    printf(",%s", reader.columnName(columns[c]).c_str());
+  printf("\n");
+
+  std::vector<std::vector<float> > values(columns.size(), std::vector<float>(DUMP_ROWS));
+  for (uint64_t row = firstRow; row < endRow; row += DUMP_ROWS) {
+    size_t n = (endRow - row < DUMP_ROWS) ? endRow - row : DUMP_ROWS;
+    for (size_t c = 0; c < columns.size(); c++)
+      n = reader.read(columns[c], row, n, values[c].data());
+    for (size_t i = 0; i < n; i++) {
+      printf("%.3f", (double)(row + i) / reader.rate());
+      for (size_t c = 0; c < columns.size(); c++)
+        printf(",%.9g", values[c][i]);
+      printf("\n");
+    }
+  }
+  return 0;
+}
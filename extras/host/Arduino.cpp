@@ -0,0 +1,67 @@
+/*
+ * Arduino.cpp (host)
+ *
+ * Simulated clock and analog inputs for the host stand-in of the Arduino core.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Arduino.h"
+#include "Wire.h"
+
+#define HOST_N_ANALOG_PINS 64
+
+// One clock per thread, so that concurrent replays do not disturb each other.
+static thread_local unsigned long hostMicros = 0;
+static int hostAnalog[HOST_N_ANALOG_PINS];
+
+TwoWire Wire;
+
+unsigned long millis() {
+  return hostMicros / 1000UL;
+}
+
+unsigned long micros() {
+  return hostMicros;
+}
+
+void delay(unsigned long ms) {
+  hostMicros += ms * 1000UL;
+}
+
+void delayMicroseconds(unsigned int us) {
+  hostMicros += us;
+}
+
+void yield() {
+}
+
+int analogRead(uint8_t pin) {
+  return (pin < HOST_N_ANALOG_PINS) ? hostAnalog[pin] : 0;
+}
+
+void hostSetMicros(unsigned long us) {
+  hostMicros = us;
+}
+
+void hostAdvanceMicros(unsigned long us) {
+  hostMicros += us;
+}
+
+void hostSetAnalog(uint8_t pin, int value) {
+  if (pin < HOST_N_ANALOG_PINS)
+    hostAnalog[pin] = value;
+}
@@ -0,0 +1,111 @@
+/*
+ * Arduino.h (host)
+ *
+ * Minimal stand-in for the Arduino core so that the BioData sources can be
+ * compiled and exercised on a desktop machine (benchmarks, replay of recorded
+ * sessions). Only what the library uses is provided. Time and analog inputs
+ * are simulated and driven explicitly through the host*() functions below.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_ARDUINO_H_
+#define BIODATA_HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <type_traits>
+
+#define BIODATA_HOST 1
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+// Same semantics as the Teensy core: integer map() rounds, floating point
+// map() keeps the fractional part.
+template <class T, class A, class B, class C, class D>
+long map(T x, A in_min, B in_max, C out_min, D out_max,
+         typename std::enable_if<std::is_integral<T>::value>::type* = 0) {
+  long in_range = in_max - in_min;
+  long out_range = out_max - out_min;
+  if (in_range == 0) return out_min + out_range / 2;
+  long num = (x - in_min) * out_range;
+  if (out_range >= 0) {
+    num += in_range / 2;
+  } else {
+    num -= in_range / 2;
+  }
+  long result = num / in_range + out_min;
+  if (out_range >= 0) {
+    if (in_range * num < 0) return result - 1;
+  } else {
+    if (in_range * num >= 0) return result + 1;
+  }
+  return result;
+}
+
+template <class T, class A, class B, class C, class D>
+T map(T x, A in_min, B in_max, C out_min, D out_max,
+      typename std::enable_if<std::is_floating_point<T>::value>::type* = 0) {
+  return (x - (T)in_min) * ((T)out_max - (T)out_min) / ((T)in_max - (T)in_min) + (T)out_min;
+}
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+int analogRead(uint8_t pin);
+
+/// Sets the simulated clock (in microseconds). Each thread has its own clock.
+void hostSetMicros(unsigned long us);
+
+/// Advances the simulated clock by a number of microseconds.
+void hostAdvanceMicros(unsigned long us);
+
+/// Sets the value returned by analogRead() for a given pin.
+void hostSetAnalog(uint8_t pin, int value);
+
+/// Byte sink, same role as Arduino's Print.
+class Print {
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t b) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size) {
+    size_t n = 0;
+    while (size--) {
+      if (write(*buffer++)) n++;
+      else break;
+    }
+    return n;
+  }
+};
+
+#endif
@@ -0,0 +1,153 @@
+/*
+ * BatchProcess.cpp
+ *
+ * Summarizes many recorded sessions (SampleLogger files, see Session.h for
+ * channels and rates) on a work-stealing thread pool, one session per task.
+ * Prints one CSV line per session, in the order given, and the throughput
+ * in sessions per second.
+ *
+ * Usage: BatchProcess [-j threads] session.bin...
+ *        BatchProcess -b [nSessions]
+ *
+ * With -b, summarizes synthetic sessions of various lengths with 1, 2, 4...
+ * threads up to the number of cores, to show scaling.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "Session.h"
+#include "WorkStealingPool.h"
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static int noise(uint32_t& state, int amplitude) {
+  state = state * 1664525UL + 1013904223UL;
+  return (int)((state >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// Synthetic session #index#, lasting from 5 to 60 minutes.
+static void makeSession(size_t index, Session& session) {
+  uint32_t state = 12345 + index;
+  double minutes = 5 + (index * 7919) % 56;
+  double bpm = 60 + (index % 30);
+  for (size_t i = 0; i < minutes * 60 * SESSION_HEART_RATE; i++) {
+    double phase = fmod(i * bpm / 60 / SESSION_HEART_RATE, 1.0);
+    double pulse = exp(-pow((phase - 0.2) / 0.06, 2)) + 0.3 * exp(-pow((phase - 0.45) / 0.08, 2));
+    session.heart.push_back((uint16_t)(350 + 300 * pulse + noise(state, 3)));
+  }
+  for (size_t i = 0; i < minutes * 60 * SESSION_SC_RATE; i++) {
+    double t = (double)i / SESSION_SC_RATE;
+    double scr = fmod(t, 40.0) > 5 ? 60 * exp(-(fmod(t, 40.0) - 5) / 6.0) : 0;
+    session.sc.push_back((uint16_t)(500 + 40 * sin(t / 300.0) + scr + noise(state, 1)));
+    session.respiration.push_back((uint16_t)(13000 + 250 * sin(2 * M_PI * t / 4.0) + noise(state, 4)));
+  }
+}
+
+static bool operator==(const SessionSummary& a, const SessionSummary& b) {
+  return a.duration == b.duration && a.nBeats == b.nBeats && a.meanBpm == b.meanBpm &&
+         a.meanSCL == b.meanSCL && a.meanSCR == b.meanSCR &&
+         a.nBreaths == b.nBreaths && a.meanRpm == b.meanRpm;
+}
+
+/// Summarizes #sessions# on #nThreads# threads. Returns elapsed seconds.
+static double run(const std::vector<Session>& sessions, std::vector<SessionSummary>& summaries,
+                  unsigned int nThreads, size_t* nSteals) {
+  summaries.resize(sessions.size());
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  WorkStealingPool pool(nThreads);
+  for (size_t i = 0; i < sessions.size(); i++)
+    pool.submit([&sessions, &summaries, i]() { summarizeSession(sessions[i], summaries[i]); });
+  pool.wait();
+  if (nSteals) *nSteals = pool.nSteals();
+  return seconds(start);
+}
+
+static int benchmark(size_t nSessions) {
+  std::vector<Session> sessions(nSessions);
+  double hours = 0;
+  for (size_t i = 0; i < nSessions; i++) {
+    makeSession(i, sessions[i]);
+    hours += sessions[i].heart.size() / (3600.0 * SESSION_HEART_RATE);
+  }
+  printf("%zu synthetic sessions, %.1f hours of data\n", nSessions, hours);
+
+  std::vector<SessionSummary> reference;
+  double single = run(sessions, reference, 1, NULL);
+  printf("%2u threads  %7.3f s  %8.1f sessions/s\n", 1, single, nSessions / single);
+
+  unsigned int maxThreads = std::thread::hardware_concurrency();
+  int status = 0;
+  for (unsigned int nThreads = 2; nThreads <= maxThreads; nThreads *= 2) {
+    std::vector<SessionSummary> summaries;
+    size_t nSteals;
+    double elapsed = run(sessions, summaries, nThreads, &nSteals);
+    bool same = (summaries == reference);
+    printf("%2u threads  %7.3f s  %8.1f sessions/s  speedup %.2fx  %zu steals  %s\n",
+           nThreads, elapsed, nSessions / elapsed, single / elapsed, nSteals,
+           same ? "same results" : "RESULTS DIFFER");
+    if (!same) status = 1;
+  }
+  return status;
+}
+
+int main(int argc, char** argv) {
+  unsigned int nThreads = std::thread::hardware_concurrency();
+  int first = 1;
+
+  if (argc > 1 && strcmp(argv[1], "-b") == 0)
+    return benchmark(argc > 2 ? atoi(argv[2]) : 64);
+
+  if (argc > 2 && strcmp(argv[1], "-j") == 0) {
+    nThreads = atoi(argv[2]);
+    first = 3;
+  }
+  if (first >= argc) {
+    fprintf(stderr, "usage: %s [-j threads] session.bin...\n"
+                    "       %s -b [nSessions]\n", argv[0], argv[0]);
+    return 1;
+  }
+
+  std::vector<Session> sessions(argc - first);
+  for (int i = first; i < argc; i++) {
+    if (!loadSession(argv[i], sessions[i - first])) {
+      perror(argv[i]);
+      return 1;
+    }
+  }
+
+  std::vector<SessionSummary> summaries;
+  double elapsed = run(sessions, summaries, nThreads, NULL);
+
+  printf("session,duration,beats,bpm,scl,scr,breaths,rpm\n");
+  for (size_t i = 0; i < summaries.size(); i++) {
+    const SessionSummary& s = summaries[i];
+    printf("%s,%.1f,%zu,%.2f,%.4f,%.4f,%zu,%.2f\n", argv[first + i], s.duration,
+           s.nBeats, s.meanBpm, s.meanSCL, s.meanSCR, s.nBreaths, s.meanRpm);
+  }
+  fprintf(stderr, "%zu sessions in %.3f s on %u threads (%.1f sessions/s)\n",
+          sessions.size(), elapsed, nThreads, sessions.size() / elapsed);
+  return 0;
+}
@@ -0,0 +1,410 @@
+/*
+ * BiodataCli.cpp (biodata-cli)
+ *
+ * Streams raw samples from stdin through the Heart, SkinConductance and
+ * Respiration pipelines and writes their features to stdout, for use in
+ * Unix pipelines.
+ *
+ * Usage: biodata-cli [-i records|u16|csv] [-o csv|json|bin] [-p heart,sc,resp]
+ *                    [-c channel] [-rate channel=hz] [-every n]
+ *
+ * Input formats:
+ *   records  SampleLogger records (8 bytes, see SampleLogger.h), default
+ *   u16      little-endian 16-bit samples of one channel (-c, default 0)
+ *   csv      "channel,value" lines (eg. the output of RiceDecode), or bare
+ *            values of channel -c
+ *
+ * Channels 0, 1 and 2 are heart, skin conductance and respiration, sampled at
+ * 200, 50 and 50 Hz unless set with -rate. Only the pipelines listed with -p
+ * run (default: all). -every n only writes the features of every n-th
+ * sample of each channel.
+ *
+ * Output formats (one row per sample):
+ *   csv   channel name, sample index, then the features:
+ *           heart: normalized, bpm, bpmChange, amplitudeChange, beat
+ *           sc:    scr, scl
+ *           resp:  rpm, rpmChange, amplitude, amplitudeChange, exhaling
+ *   json  one object per line with the same fields
+ *   bin   CliRecord (28 bytes): uint32 index, uint8 channel, uint8 number
+ *         of features, uint16 zero, then 5 floats (unused ones are 0)
+ *
+ * Input is read and output written in large blocks; within a block of
+ * input, rows are grouped by channel. Floats are written with 4 decimals in
+ * csv and json.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#include "Replay.h"
+#include "Session.h"
+
+// Samples read at a time, and output buffer size.
+#define CLI_BLOCK   65536
+#define CLI_OUTPUT  (4 << 20)
+
+#define CLI_CHANNELS 3
+#define CLI_MAX_FEATURES 5
+
+enum CliInput { INPUT_RECORDS, INPUT_U16, INPUT_CSV };
+enum CliOutput { OUTPUT_CSV, OUTPUT_JSON, OUTPUT_BINARY };
+
+struct CliRecord {
+  uint32_t index;
+  uint8_t channel;
+  uint8_t nFeatures;
+  uint16_t reserved;
+  float features[CLI_MAX_FEATURES];
+};
+
+static const char* channelNames[CLI_CHANNELS] = { "heart", "sc", "resp" };
+
+static const char* featureNames[CLI_CHANNELS][CLI_MAX_FEATURES] = {
+  { "normalized", "bpm", "bpmChange", "amplitudeChange", "beat" },
+  { "scr", "scl" },
+  { "rpm", "rpmChange", "amplitude", "amplitudeChange", "exhaling" }
+};
+
+static size_t toFloats(const HeartFeatures& f, float* out) {
+  out[0] = f.normalized;
+  out[1] = f.bpm;
+  out[2] = f.bpmChange;
+  out[3] = f.amplitudeChange;
+  out[4] = f.beat ? 1 : 0;
+  return 5;
+}
+
+static size_t toFloats(const SkinConductanceFeatures& f, float* out) {
+  out[0] = f.scr;
+  out[1] = f.scl;
+  return 2;
+}
+
+static size_t toFloats(const RespirationFeatures& f, float* out) {
+  out[0] = f.rpm;
+  out[1] = f.rpmChange;
+  out[2] = f.amplitude;
+  out[3] = f.amplitudeChange;
+  out[4] = f.exhaling ? 1 : 0;
+  return 5;
+}
+
+/// Buffered stdout with fast number formatting.
+class CliOutputBuffer {
+  char* _buffer;
+  size_t _size;
+
+public:
+  CliOutputBuffer() : _buffer(new char[CLI_OUTPUT]), _size(0) {}
+  ~CliOutputBuffer() { flush(); delete[] _buffer; }
+
+  /// Makes room for #n# more bytes.
+  void reserve(size_t n) {
+    if (_size + n > CLI_OUTPUT)
+      flush();
+  }
+
+  void flush() {
+    size_t written = 0;
+    while (written < _size) {
+      ssize_t n = write(STDOUT_FILENO, _buffer + written, _size - written);
+      if (n <= 0) exit(1);  // broken pipe: stop quietly
+      written += n;
+    }
+    _size = 0;
+  }
+
+  void put(char c) { _buffer[_size++] = c; }
+
+  void put(const char* s) {
+    while (*s) _buffer[_size++] = *s++;
+  }
+
+  void put(const void* data, size_t n) {
+    memcpy(_buffer + _size, data, n);
+    _size += n;
+  }
+
+  void putUnsigned(uint64_t v) {
+    char digits[20];
+    int n = 0;
+    do {
+      digits[n++] = '0' + v % 10;
+      v /= 10;
+    } while (v);
+    while (n) _buffer[_size++] = digits[--n];
+  }
+
+  // Fixed-point, 4 decimals, trailing zeros removed.
+  void putFloat(float value) {
+    if (isnan(value) || isinf(value)) {
+      put("null");
+      return;
+    }
+    double v = value;
+    if (v < 0) {
+      put('-');
+      v = -v;
+    }
+    if (v >= 1e15) {
+      _size += snprintf(_buffer + _size, 32, "%.6g", v);
+      return;
+    }
+    uint64_t scaled = (uint64_t)(v * 10000 + 0.5);
+    putUnsigned(scaled / 10000);
+    unsigned fraction = scaled % 10000;
+    if (fraction) {
+      put('.');
+      char digits[4];
+      for (int k = 3; k >= 0; k--) {
+        digits[k] = '0' + fraction % 10;
+        fraction /= 10;
+      }
+      int n = 4;
+      while (digits[n - 1] == '0') n--;
+      put(digits, n);
+    }
+  }
+};
+
+/// One pipeline: sensor, pending input samples and features.
+template <class Channel>
+struct CliPipeline {
+  typename Channel::Sensor* sensor;
+  uint8_t channel;
+  unsigned long rate;
+  size_t nProcessed;
+  std::vector<uint16_t> input;
+  std::vector<typename Channel::Features> features;
+
+  CliPipeline(uint8_t channel_, unsigned long rate_) : sensor(NULL), channel(channel_), rate(rate_), nProcessed(0) {
+    hostSetMicros(0);
+    sensor = Channel::create(rate);
+    input.reserve(CLI_BLOCK);
+    features.resize(CLI_BLOCK);
+  }
+
+  ~CliPipeline() { delete sensor; }
+
+  void run(CliOutputBuffer& out, CliOutput format, size_t every) {
+    size_t n = input.size();
+    processBlock<Channel>(*sensor, input.data(), n, nProcessed, rate, features.data());
+
+    for (size_t i = 0; i < n; i++) {
+      size_t index = nProcessed + i;
+      if (index % every != 0)
+        continue;
+      float values[CLI_MAX_FEATURES];
+      size_t nValues = toFloats(features[i], values);
+      out.reserve(64 + 40 * CLI_MAX_FEATURES);
+
+      if (format == OUTPUT_BINARY) {
+        CliRecord record;
+        memset(&record, 0, sizeof(record));
+        record.index = (uint32_t)index;
+        record.channel = channel;
+        record.nFeatures = nValues;
+        memcpy(record.features, values, nValues * sizeof(float));
+        out.put(&record, sizeof(record));
+      } else if (format == OUTPUT_CSV) {
+        out.put(channelNames[channel]);
+        out.put(',');
+        out.putUnsigned(index);
+        for (size_t v = 0; v < nValues; v++) {
+          out.put(',');
+          out.putFloat(values[v]);
+        }
+        out.put('\n');
+      } else {
+        out.put("{\"channel\":\"");
+        out.put(channelNames[channel]);
+        out.put("\",\"index\":");
+        out.putUnsigned(index);
+        for (size_t v = 0; v < nValues; v++) {
+          out.put(",\"");
+          out.put(featureNames[channel][v]);
+          out.put("\":");
+          out.putFloat(values[v]);
+        }
+        out.put("}\n");
+      }
+    }
+    nProcessed += n;
+    input.clear();
+  }
+};
+
+struct CliPipelines {
+  CliPipeline<HeartChannel>* heart;
+  CliPipeline<SkinConductanceChannel>* sc;
+  CliPipeline<RespirationChannel>* resp;
+
+  void add(uint8_t channel, uint16_t value) {
+    switch (channel) {
+      case SESSION_HEART_CHANNEL:       if (heart) heart->input.push_back(value); break;
+      case SESSION_SC_CHANNEL:          if (sc) sc->input.push_back(value); break;
+      case SESSION_RESPIRATION_CHANNEL: if (resp) resp->input.push_back(value); break;
+    }
+  }
+
+  void run(CliOutputBuffer& out, CliOutput format, size_t every) {
+    if (heart) heart->run(out, format, every);
+    if (sc) sc->run(out, format, every);
+    if (resp) resp->run(out, format, every);
+  }
+};
+
+// Reads up to #size# bytes (less only at the end of the input).
+static size_t readFully(uint8_t* buffer, size_t size) {
+  size_t total = 0;
+  while (total < size) {
+    ssize_t n = read(STDIN_FILENO, buffer + total, size - total);
+    if (n <= 0) break;
+    total += n;
+  }
+  return total;
+}
+
+static int usage(const char* name) {
+  fprintf(stderr, "usage: %s [-i records|u16|csv] [-o csv|json|bin] [-p heart,sc,resp]\n"
+                  "          [-c channel] [-rate channel=hz] [-every n]\n", name);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  CliInput input = INPUT_RECORDS;
+  CliOutput output = OUTPUT_CSV;
+  bool enabled[CLI_CHANNELS] = { true, true, true };
+  unsigned long rates[CLI_CHANNELS] = { SESSION_HEART_RATE, SESSION_SC_RATE, SESSION_RESPIRATION_RATE };
+  uint8_t defaultChannel = 0;
+  size_t every = 1;
+
+  for (int i = 1; i < argc; i++) {
+    if (i + 1 >= argc)
+      return usage(argv[0]);
+    const char* value = argv[i + 1];
+    if (strcmp(argv[i], "-i") == 0) {
+      if (strcmp(value, "records") == 0) input = INPUT_RECORDS;
+      else if (strcmp(value, "u16") == 0) input = INPUT_U16;
+      else if (strcmp(value, "csv") == 0) input = INPUT_CSV;
+      else return usage(argv[0]);
+    } else if (strcmp(argv[i], "-o") == 0) {
+      if (strcmp(value, "csv") == 0) output = OUTPUT_CSV;
+      else if (strcmp(value, "json") == 0) output = OUTPUT_JSON;
+      else if (strcmp(value, "bin") == 0) output = OUTPUT_BINARY;
+      else return usage(argv[0]);
+    } else if (strcmp(argv[i], "-p") == 0) {
+      for (int c = 0; c < CLI_CHANNELS; c++)
+        enabled[c] = false;
+      for (int c = 0; c < CLI_CHANNELS; c++) {
+        const char* found = strstr(value, channelNames[c]);
+        size_t length = strlen(channelNames[c]);
+        enabled[c] = found && (found[length] == ',' || found[length] == 0);
+      }
+    } else if (strcmp(argv[i], "-c") == 0) {
+      defaultChannel = atoi(value);
+      if (defaultChannel >= CLI_CHANNELS) return usage(argv[0]);
+    } else if (strcmp(argv[i], "-rate") == 0) {
+      int channel = atoi(value);
+      const char* equal = strchr(value, '=');
+      if (!equal || channel < 0 || channel >= CLI_CHANNELS || atol(equal + 1) <= 0) return usage(argv[0]);
+      rates[channel] = atol(equal + 1);
+    } else if (strcmp(argv[i], "-every") == 0) {
+      every = atol(value);
+      if (every == 0) return usage(argv[0]);
+    } else {
+      return usage(argv[0]);
+    }
+    i++;
+  }
+
+  CliPipelines pipelines;
+  pipelines.heart = enabled[SESSION_HEART_CHANNEL] ?
+    new CliPipeline<HeartChannel>(SESSION_HEART_CHANNEL, rates[SESSION_HEART_CHANNEL]) : NULL;
+  pipelines.sc = enabled[SESSION_SC_CHANNEL] ?
+    new CliPipeline<SkinConductanceChannel>(SESSION_SC_CHANNEL, rates[SESSION_SC_CHANNEL]) : NULL;
+  pipelines.resp = enabled[SESSION_RESPIRATION_CHANNEL] ?
+    new CliPipeline<RespirationChannel>(SESSION_RESPIRATION_CHANNEL, rates[SESSION_RESPIRATION_CHANNEL]) : NULL;
+
+  CliOutputBuffer out;
+
+  if (input == INPUT_CSV) {
+    // Lines are parsed by hand: strtol on each line is the bottleneck otherwise.
+    static char buffer[1 << 20];
+    size_t n, nSamples = 0;
+    long fields[2];
+    int nFields = 0;
+    long number = 0;
+    bool inNumber = false;
+    while ((n = fread(buffer, 1, sizeof(buffer), stdin)) > 0) {
+      for (size_t k = 0; k < n; k++) {
+        char c = buffer[k];
+        if (c >= '0' && c <= '9') {
+          number = number * 10 + (c - '0');
+          inNumber = true;
+        } else if (c == ',' || c == '\n') {
+          if (inNumber && nFields < 2)
+            fields[nFields++] = number;
+          number = 0;
+          inNumber = false;
+          if (c == '\n') {
+            if (nFields == 2) pipelines.add((uint8_t)fields[0], (uint16_t)fields[1]);
+            else if (nFields == 1) pipelines.add(defaultChannel, (uint16_t)fields[0]);
+            nFields = 0;
+            if (++nSamples % CLI_BLOCK == 0)
+              pipelines.run(out, output, every);
+          }
+        } else if (c != '\r' && c != ' ') {
+          // Header or malformed line: ignored.
+          nFields = 3;
+        }
+      }
+    }
+    if (inNumber && nFields < 2) {
+      fields[nFields++] = number;
+      if (nFields == 2) pipelines.add((uint8_t)fields[0], (uint16_t)fields[1]);
+      else if (nFields == 1) pipelines.add(defaultChannel, (uint16_t)fields[0]);
+    }
+  } else {
+    size_t recordSize = (input == INPUT_RECORDS) ? sizeof(SampleRecord) : 2;
+    std::vector<uint8_t> buffer(CLI_BLOCK * recordSize);
+    size_t n;
+    while ((n = readFully(buffer.data(), buffer.size()) / recordSize) > 0) {
+      if (input == INPUT_RECORDS) {
+        const SampleRecord* records = (const SampleRecord*)buffer.data();
+        for (size_t k = 0; k < n; k++)
+          pipelines.add(records[k].channel, records[k].value);
+      } else {
+        for (size_t k = 0; k < n; k++)
+          pipelines.add(defaultChannel, (uint16_t)(buffer[2 * k] | (buffer[2 * k + 1] << 8)));
+      }
+      pipelines.run(out, output, every);
+    }
+  }
+  pipelines.run(out, output, every);
+  out.flush();
+
+  delete pipelines.heart;
+  delete pipelines.sc;
+  delete pipelines.resp;
+  return 0;
+}
@@ -0,0 +1,337 @@
+/*
+ * BiodataPython.cpp (Python module "biodata")
+ *
+ * pybind11 bindings of the host build of the BioData filters and sensors,
+ * so that notebooks get exactly the numbers of the device code. Every class
+ * keeps the C++ method names and has a batch method taking a NumPy array:
+ *
+ *   Lop(alpha=0.01)         filter(x), process(x) -> float32 array,
+ *                           reset(), setSmoothing(a), setSmoothingBySamples(n)
+ *   MinMax()                filter(x), adapt(lop), process(x, adapt=0)
+ *                           -> float32 array (adapt(lop) before every sample
+ *                           if lop > 0, as in Heart), reset(), getMin(),
+ *                           getMax()
+ *   Hip(factor)             filter(x), process(x) -> float32 array
+ *   Threshold(lower, upper) detect(x), process(x) -> bool array, reset(),
+ *                           setBounds(lower, upper)
+ *
+ *   Heart(rate=200), SkinConductance(rate=50), Respiration(rate=50)
+ *     process(samples) -> dict of arrays, one entry per sample:
+ *       Heart:           normalized, bpm, bpmChange, amplitudeChange, beat
+ *       SkinConductance: scr, scl
+ *       Respiration:     rpm, rpmChange, amplitude, amplitudeChange, exhaling
+ *     and int64 arrays of event sample indices:
+ *       Heart:           beats
+ *       SkinConductance: scrs     (onsets, as in EventIndex.h)
+ *       Respiration:     exhales, inhales
+ *     reset(), nSamples, rate, and the setters of each sensor.
+ *
+ * Samples are converted to uint16 (raw ADC values), filter inputs to
+ * float32. Successive calls continue the same signal: sample indices and
+ * times (sample index / rate) run on from the previous call, as when a
+ * recording is replayed in pieces. Batch methods release the GIL while they
+ * loop in C++; an object must not be used from two threads at once.
+ *
+ * Build: see extras/host/README.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdexcept>
+#include <vector>
+
+#include <pybind11/pybind11.h>
+#include <pybind11/numpy.h>
+
+#include "Lop.h"
+#include "MinMax.h"
+#include "Hip.h"
+#include "Threshold.h"
+#include "Replay.h"
+#include "Session.h"
+#include "EventIndex.h"
+
+namespace py = pybind11;
+
+typedef py::array_t<float, py::array::c_style | py::array::forcecast> FloatArray;
+typedef py::array_t<uint16_t, py::array::c_style | py::array::forcecast> SampleArray;
+
+// Features computed at a time by sensors, before being split into columns.
+#define PYTHON_BLOCK 4096
+
+template <class Array>
+static size_t length(const Array& a) {
+  if (a.ndim() != 1)
+    throw std::invalid_argument("expected a one-dimensional array");
+  return (size_t)a.shape(0);
+}
+
+/// Applies #f# (float -> T) to every element of #input#, without the GIL.
+template <class T, class F>
+static py::array_t<T> mapArray(const FloatArray& input, F f) {
+  size_t n = length(input);
+  py::array_t<T> output(n);
+  const float* in = input.data();
+  T* out = output.mutable_data();
+  {
+    py::gil_scoped_release release;
+    for (size_t i = 0; i < n; i++)
+      out[i] = f(in[i]);
+  }
+  return output;
+}
+
+/**
+ * Columns of the features of each channel, and the events detected from
+ * them. store() writes the features of sample #i# of a call (sample #index#
+ * of the signal) and appends the index to the events it starts.
+ */
+struct HeartColumns {
+  typedef HeartChannel Channel;
+  static const size_t nFloats = 4;
+  static const size_t nFlags = 1;
+  static const size_t nEvents = 1;
+  static const char* const floatNames[nFloats];
+  static const char* const flagNames[nFlags];
+  static const char* const eventNames[nEvents];
+
+  void store(const HeartFeatures& f, float** floats, bool** flags, size_t i, int64_t index,
+             std::vector<int64_t>* events) {
+    floats[0][i] = f.normalized;
+    floats[1][i] = f.bpm;
+    floats[2][i] = f.bpmChange;
+    floats[3][i] = f.amplitudeChange;
+    flags[0][i] = f.beat;
+    if (f.beat)
+      events[0].push_back(index);
+  }
+};
+
+const char* const HeartColumns::floatNames[] = { "normalized", "bpm", "bpmChange", "amplitudeChange" };
+const char* const HeartColumns::flagNames[] = { "beat" };
+const char* const HeartColumns::eventNames[] = { "beats" };
+
+struct SkinConductanceColumns {
+  typedef SkinConductanceChannel Channel;
+  static const size_t nFloats = 2;
+  static const size_t nFlags = 0;
+  static const size_t nEvents = 1;
+  static const char* const floatNames[nFloats];
+  static const char* const* const flagNames;
+  static const char* const eventNames[nEvents];
+
+  bool response;  // between an SCR onset and its offset
+
+  SkinConductanceColumns() : response(false) {}
+
+  void store(const SkinConductanceFeatures& f, float** floats, bool**, size_t i, int64_t index,
+             std::vector<int64_t>* events) {
+    floats[0][i] = f.scr;
+    floats[1][i] = f.scl;
+    if (!response && f.scr > EVENT_SCR_ONSET) {
+      events[0].push_back(index);
+      response = true;
+    } else if (response && f.scr < EVENT_SCR_OFFSET) {
+      response = false;
+    }
+  }
+};
+
+const char* const SkinConductanceColumns::floatNames[] = { "scr", "scl" };
+const char* const* const SkinConductanceColumns::flagNames = NULL;
+const char* const SkinConductanceColumns::eventNames[] = { "scrs" };
+
+struct RespirationColumns {
+  typedef RespirationChannel Channel;
+  static const size_t nFloats = 4;
+  static const size_t nFlags = 1;
+  static const size_t nEvents = 2;
+  static const char* const floatNames[nFloats];
+  static const char* const flagNames[nFlags];
+  static const char* const eventNames[nEvents];
+
+  bool exhaling;
+
+  RespirationColumns() : exhaling(false) {}
+
+  void store(const RespirationFeatures& f, float** floats, bool** flags, size_t i, int64_t index,
+             std::vector<int64_t>* events) {
+    floats[0][i] = f.rpm;
+    floats[1][i] = f.rpmChange;
+    floats[2][i] = f.amplitude;
+    floats[3][i] = f.amplitudeChange;
+    flags[0][i] = f.exhaling;
+    if (f.exhaling != exhaling)
+      events[f.exhaling ? 0 : 1].push_back(index);
+    exhaling = f.exhaling;
+  }
+};
+
+const char* const RespirationColumns::floatNames[] = { "rpm", "rpmChange", "amplitude", "amplitudeChange" };
+const char* const RespirationColumns::flagNames[] = { "exhaling" };
+const char* const RespirationColumns::eventNames[] = { "exhales", "inhales" };
+
+/// A sensor driven sample by sample from NumPy arrays.
+template <class Columns>
+class PythonSensor {
+  typedef typename Columns::Channel Channel;
+  typedef typename Channel::Sensor Sensor;
+  typedef typename Channel::Features Features;
+
+  Sensor* _sensor;
+  unsigned long _rate;
+  int64_t _nSamples;
+  Columns _columns;
+
+  PythonSensor(const PythonSensor&);
+  PythonSensor& operator=(const PythonSensor&);
+
+public:
+  PythonSensor(unsigned long rate) : _rate(rate), _nSamples(0) {
+    if (rate == 0)
+      throw std::invalid_argument("rate must be positive");
+    hostSetMicros(0);
+    _sensor = Channel::create(rate);
+  }
+
+  ~PythonSensor() { delete _sensor; }
+
+  Sensor& sensor() { return *_sensor; }
+  unsigned long rate() const { return _rate; }
+  int64_t nSamples() const { return _nSamples; }
+
+  void reset() {
+    hostSetMicros(0);
+    _sensor->reset();
+    _nSamples = 0;
+    _columns = Columns();
+  }
+
+  py::dict process(const SampleArray& samples) {
+    size_t n = length(samples);
+    std::vector<py::array_t<float> > floatColumns;
+    std::vector<py::array_t<bool> > flagColumns;
+    std::vector<float*> floats;
+    std::vector<bool*> flags;
+    for (size_t c = 0; c < Columns::nFloats; c++) {
+      floatColumns.push_back(py::array_t<float>(n));
+      floats.push_back(floatColumns.back().mutable_data());
+    }
+    for (size_t c = 0; c < Columns::nFlags; c++) {
+      flagColumns.push_back(py::array_t<bool>(n));
+      flags.push_back(flagColumns.back().mutable_data());
+    }
+    std::vector<int64_t> events[Columns::nEvents];
+
+    const uint16_t* in = samples.data();
+    {
+      py::gil_scoped_release release;
+      std::vector<Features> block(PYTHON_BLOCK);
+      for (size_t first = 0; first < n; first += PYTHON_BLOCK) {
+        size_t count = (n - first < PYTHON_BLOCK) ? n - first : PYTHON_BLOCK;
+        processBlock<Channel>(*_sensor, in + first, count, (size_t)_nSamples, _rate, block.data());
+        for (size_t i = 0; i < count; i++)
+          _columns.store(block[i], floats.data(), flags.data(), first + i, _nSamples + i, events);
+        _nSamples += count;
+      }
+    }
+
+    py::dict result;
+    for (size_t c = 0; c < Columns::nFloats; c++)
+      result[Columns::floatNames[c]] = floatColumns[c];
+    for (size_t c = 0; c < Columns::nFlags; c++)
+      result[Columns::flagNames[c]] = flagColumns[c];
+    for (size_t e = 0; e < Columns::nEvents; e++)
+      result[Columns::eventNames[e]] = py::array_t<int64_t>(events[e].size(), events[e].data());
+    return result;
+  }
+};
+
+typedef PythonSensor<HeartColumns> PythonHeart;
+typedef PythonSensor<SkinConductanceColumns> PythonSkinConductance;
+typedef PythonSensor<RespirationColumns> PythonRespiration;
+
+/// Binds what all sensors have in common.
+template <class S>
+static py::class_<S> bindSensor(py::module& m, const char* name, unsigned long defaultRate) {
+  py::class_<S> c(m, name);
+  c.def(py::init<unsigned long>(), py::arg("rate") = defaultRate)
+   .def("process", &S::process, py::arg("samples"),
+        "Processes raw samples; returns a dict of feature and event index arrays.")
+   .def("reset", &S::reset)
+   .def_property_readonly("nSamples", &S::nSamples)
+   .def_property_readonly("rate", &S::rate);
+  return c;
+}
+
+PYBIND11_MODULE(biodata, m) {
+  m.doc() = "BioData filters and sensors (host build) with NumPy batch processing.";
+
+  py::class_<Lop>(m, "Lop")
+    .def(py::init<float>(), py::arg("alpha") = 0.01f)
+    .def("filter", &Lop::filter)
+    .def("process", [](Lop& lop, const FloatArray& x) {
+      return mapArray<float>(x, [&lop](float v) { return lop.filter(v); });
+    }, py::arg("x"))
+    .def("reset", &Lop::reset)
+    .def("setSmoothing", &Lop::setSmoothing)
+    .def("setSmoothingBySamples", &Lop::setSmoothingBySamples);
+
+  py::class_<MinMax>(m, "MinMax")
+    .def(py::init<>())
+    .def("filter", &MinMax::filter)
+    .def("adapt", &MinMax::adapt)
+    .def("process", [](MinMax& minMax, const FloatArray& x, float adapt) {
+      return mapArray<float>(x, [&minMax, adapt](float v) {
+        if (adapt > 0)
+          minMax.adapt(adapt);
+        return minMax.filter(v);
+      });
+    }, py::arg("x"), py::arg("adapt") = 0.0f)
+    .def("reset", &MinMax::reset)
+    .def("getMin", &MinMax::getMin)
+    .def("getMax", &MinMax::getMax);
+
+  py::class_<Hip>(m, "Hip")
+    .def(py::init<float>(), py::arg("factor"))
+    .def("filter", &Hip::filter)
+    .def("process", [](Hip& hip, const FloatArray& x) {
+      return mapArray<float>(x, [&hip](float v) { return hip.filter(v); });
+    }, py::arg("x"));
+
+  py::class_<Threshold>(m, "Threshold")
+    .def(py::init<float, float>(), py::arg("lower"), py::arg("upper"))
+    .def("detect", &Threshold::detect)
+    .def("process", [](Threshold& threshold, const FloatArray& x) {
+      return mapArray<bool>(x, [&threshold](float v) { return threshold.detect(v); });
+    }, py::arg("x"))
+    .def("reset", &Threshold::reset)
+    .def("setBounds", &Threshold::setBounds);
+
+  bindSensor<PythonHeart>(m, "Heart", SESSION_HEART_RATE)
+    .def("setAmplitudeSmoothing", [](PythonHeart& h, float s) { h.sensor().setAmplitudeSmoothing(s); })
+    .def("setBpmSmoothing", [](PythonHeart& h, float s) { h.sensor().setBpmSmoothing(s); })
+    .def("setAmplitudeMinMaxSmoothing", [](PythonHeart& h, float s) { h.sensor().setAmplitudeMinMaxSmoothing(s); })
+    .def("setBpmMinMaxSmoothing", [](PythonHeart& h, float s) { h.sensor().setBpmMinMaxSmoothing(s); })
+    .def("setMinMaxSmoothing", [](PythonHeart& h, float s) { h.sensor().setMinMaxSmoothing(s); })
+    .def("setThreshold", [](PythonHeart& h, float lower, float upper) { h.sensor().setThreshold(lower, upper); });
+
+  bindSensor<PythonSkinConductance>(m, "SkinConductance", SESSION_SC_RATE)
+    .def("setLopSmoothing", [](PythonSkinConductance& s, float v) { s.sensor().setLopSmoothing(v); })
+    .def("setLopassedSmoothing", [](PythonSkinConductance& s, float v) { s.sensor().setLopassedSmoothing(v); });
+
+  bindSensor<PythonRespiration>(m, "Respiration", SESSION_RESPIRATION_RATE);
+}
@@ -0,0 +1,150 @@
+/*
+ * CodecBenchmark.cpp
+ *
+ * Host benchmark for RiceEncoder/RiceDecoder. Compresses synthetic signals
+ * (200 Hz PPG, 50 Hz skin conductance, 50 Hz ADS1115 thermistor) and,
+ * optionally, a recording made with SampleLogger. Checks that decoding is
+ * lossless and reports compression ratio and encoding/decoding cost.
+ *
+ * Usage: CodecBenchmark [samples.bin]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAS_CYCLE_COUNTER 1
+#endif
+
+#include "RiceCodec.h"
+#include "SampleLogger.h"
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static uint64_t cycles() {
+#ifdef HAS_CYCLE_COUNTER
+  return __rdtsc();
+#else
+  return 0;
+#endif
+}
+
+static bool benchmark(const char* name, const std::vector<uint16_t>& samples) {
+  std::vector<uint8_t> stream;
+  stream.reserve(samples.size() * 2 + 1024);
+
+  RiceEncoder encoder;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  uint64_t c0 = cycles();
+  for (size_t i = 0; i < samples.size(); i++) {
+    if (encoder.put(samples[i]))
+      stream.insert(stream.end(), encoder.data(), encoder.data() + encoder.size());
+  }
+  if (encoder.flush())
+    stream.insert(stream.end(), encoder.data(), encoder.data() + encoder.size());
+  uint64_t encodeCycles = cycles() - c0;
+  double encodeSeconds = seconds(start);
+
+  std::vector<uint16_t> decoded;
+  decoded.reserve(samples.size());
+  uint16_t block[RICE_CODEC_BLOCK_SAMPLES];
+  size_t pos = 0;
+  start = std::chrono::steady_clock::now();
+  c0 = cycles();
+  while (pos < stream.size()) {
+    size_t consumed;
+    size_t n = RiceDecoder::decode(&stream[pos], stream.size() - pos, block, &consumed);
+    if (!n) break;
+    decoded.insert(decoded.end(), block, block + n);
+    pos += consumed;
+  }
+  uint64_t decodeCycles = cycles() - c0;
+  double decodeSeconds = seconds(start);
+
+  bool ok = (decoded == samples);
+  double n = samples.size();
+  printf("%-22s %9zu samples  ratio %5.2f (%5.2f bits/sample)  encode %6.1f ns %6.1f cycles  decode %6.1f ns %6.1f cycles  %s\n",
+         name, samples.size(), (2.0 * n) / stream.size(), 8.0 * stream.size() / n,
+         1e9 * encodeSeconds / n, encodeCycles / n, 1e9 * decodeSeconds / n, decodeCycles / n,
+         ok ? "lossless" : "MISMATCH");
+  return ok;
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+int main(int argc, char** argv) {
+  const size_t seconds = 3600;
+  bool ok = true;
+
+  // PPG: 72 BPM pulse with a dicrotic bump, 10-bit ADC at 200 Hz.
+  std::vector<uint16_t> ppg;
+  for (size_t i = 0; i < seconds * 200; i++) {
+    double phase = fmod(i / 200.0 * 1.2, 1.0);
+    double pulse = exp(-pow((phase - 0.2) / 0.06, 2)) + 0.3 * exp(-pow((phase - 0.45) / 0.08, 2));
+    ppg.push_back((uint16_t)(350 + 300 * pulse + noise(3)));
+  }
+  ok = benchmark("synthetic PPG", ppg) && ok;
+
+  // Skin conductance: slow drift with occasional responses, 10-bit ADC at 50 Hz.
+  std::vector<uint16_t> gsr;
+  for (size_t i = 0; i < seconds * 50; i++) {
+    double t = i / 50.0;
+    double scr = fmod(t, 40.0) > 5 ? 60 * exp(-(fmod(t, 40.0) - 5) / 6.0) : 0;
+    gsr.push_back((uint16_t)(500 + 40 * sin(t / 300.0) + scr + noise(1)));
+  }
+  ok = benchmark("synthetic GSR", gsr) && ok;
+
+  // Thermistor through ADS1115: 16-bit values, breathing at 15 RPM, 50 Hz.
+  std::vector<uint16_t> thermistor;
+  for (size_t i = 0; i < seconds * 50; i++) {
+    double t = i / 50.0;
+    thermistor.push_back((uint16_t)(13000 + 250 * sin(2 * M_PI * t / 4.0) + noise(4)));
+  }
+  ok = benchmark("synthetic thermistor", thermistor) && ok;
+
+  // Recorded data: a file written by SampleLogger, one stream per channel.
+  if (argc > 1) {
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+      perror(argv[1]);
+      return 1;
+    }
+    std::vector<uint16_t> channels[256];
+    SampleRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1)
+      channels[record.channel].push_back(record.value);
+    fclose(file);
+    for (int c = 0; c < 256; c++) {
+      if (channels[c].empty()) continue;
+      char name[32];
+      snprintf(name, sizeof(name), "recorded channel %d", c);
+      ok = benchmark(name, channels[c]) && ok;
+    }
+  }
+
+  return ok ? 0 : 1;
+}
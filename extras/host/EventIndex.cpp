@@ -0,0 +1,361 @@
+/*
+ * EventIndex.cpp (host)
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "EventIndex.h"
+
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+
+static const char* typeNames[EVENT_TYPES] = { "beat", "exhale", "inhale", "scr" };
+
+static const char* featureNames[EVENT_TYPES][EVENT_FEATURES] = {
+  { "bpm", "bpmChange", "amplitudeChange" },
+  { "rpm", "amplitude", "amplitudeChange" },
+  { "rpm", "amplitude", "amplitudeChange" },
+  { "peak", "scl", "riseTime" }
+};
+
+static const uint8_t typeChannels[EVENT_TYPES] = {
+  SESSION_HEART_CHANNEL, SESSION_RESPIRATION_CHANNEL, SESSION_RESPIRATION_CHANNEL, SESSION_SC_CHANNEL
+};
+
+const char* eventTypeName(int type) {
+  return (type >= 0 && type < EVENT_TYPES) ? typeNames[type] : "";
+}
+
+int findEventType(const char* name) {
+  for (int type = 0; type < EVENT_TYPES; type++)
+    if (strcmp(name, typeNames[type]) == 0)
+      return type;
+  return -1;
+}
+
+const char* eventFeatureName(int type, int feature) {
+  return (type >= 0 && type < EVENT_TYPES && feature >= 0 && feature < EVENT_FEATURES)
+    ? featureNames[type][feature] : "";
+}
+
+int findEventFeature(int type, const char* name) {
+  for (int feature = 0; feature < EVENT_FEATURES; feature++)
+    if (strcmp(name, eventFeatureName(type, feature)) == 0)
+      return feature;
+  return -1;
+}
+
+uint8_t eventChannel(int type) {
+  return typeChannels[type];
+}
+
+static void put16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back((uint8_t)v);
+  out.push_back((uint8_t)(v >> 8));
+}
+
+static void put32(std::vector<uint8_t>& out, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void put64(std::vector<uint8_t>& out, uint64_t v) {
+  for (int i = 0; i < 8; i++)
+    out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void putFloat(std::vector<uint8_t>& out, float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, 4);
+  put32(out, bits);
+}
+
+// Sequential reader over a loaded file, failing past its end.
+class EventIndexInput {
+  const std::vector<uint8_t>& _in;
+  size_t _pos;
+  bool _overrun;
+
+  const uint8_t* take(size_t n) {
+    if (_overrun || _pos + n > _in.size()) {
+      _overrun = true;
+      return NULL;
+    }
+    const uint8_t* p = &_in[_pos];
+    _pos += n;
+    return p;
+  }
+
+public:
+  EventIndexInput(const std::vector<uint8_t>& in) : _in(in), _pos(0), _overrun(false) {}
+
+  bool overrun() const { return _overrun; }
+
+  uint16_t get16() {
+    const uint8_t* p = take(2);
+    return p ? (uint16_t)(p[0] | (p[1] << 8)) : 0;
+  }
+
+  uint32_t get32() {
+    const uint8_t* p = take(4);
+    return p ? (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24) : 0;
+  }
+
+  uint64_t get64() {
+    uint64_t low = get32();
+    return low | ((uint64_t)get32() << 32);
+  }
+
+  float getFloat() {
+    uint32_t bits = get32();
+    float v;
+    memcpy(&v, &bits, 4);
+    return v;
+  }
+};
+
+EventIndex::EventIndex() {
+  clear();
+}
+
+void EventIndex::clear() {
+  _rates[SESSION_HEART_CHANNEL] = SESSION_HEART_RATE;
+  _rates[SESSION_SC_CHANNEL] = SESSION_SC_RATE;
+  _rates[SESSION_RESPIRATION_CHANNEL] = SESSION_RESPIRATION_RATE;
+  for (int c = 0; c < EVENT_CHANNELS; c++) {
+    _nSamples[c] = 0;
+    _seek[c].clear();
+  }
+  for (int type = 0; type < EVENT_TYPES; type++)
+    _events[type].clear();
+}
+
+bool EventIndex::build(const char* path) {
+  clear();
+
+  // Samples of each channel, and where every seek interval starts.
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  Session session;
+  std::vector<uint16_t>* samples[EVENT_CHANNELS];
+  samples[SESSION_HEART_CHANNEL] = &session.heart;
+  samples[SESSION_SC_CHANNEL] = &session.sc;
+  samples[SESSION_RESPIRATION_CHANNEL] = &session.respiration;
+  SampleRecord records[512];
+  uint64_t record = 0;
+  size_t n;
+  while ((n = fread(records, sizeof(SampleRecord), 512, file)) > 0) {
+    for (size_t i = 0; i < n; i++, record++) {
+      uint8_t c = records[i].channel;
+      if (c >= EVENT_CHANNELS)
+        continue;
+      if (samples[c]->size() % EVENT_INDEX_SEEK_INTERVAL == 0)
+        _seek[c].push_back(record);
+      samples[c]->push_back(records[i].value);
+    }
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  if (!ok) return false;
+  for (int c = 0; c < EVENT_CHANNELS; c++)
+    _nSamples[c] = samples[c]->size();
+
+  // Sensors start their chronometers at the beginning of the session.
+  hostSetMicros(0);
+  Heart heart(A1, SESSION_HEART_RATE);
+  for (size_t i = 0; i < session.heart.size(); i++) {
+    heart.process(session.heart[i], (unsigned long)((uint64_t)i * 1000 / SESSION_HEART_RATE));
+    if (heart.beatDetected()) {
+      Event e = { (uint32_t)i, { heart.getBPM(), heart.bpmChange(), heart.amplitudeChange() } };
+      _events[EVENT_BEAT].push_back(e);
+    }
+  }
+
+  SkinConductance sc(A6, SESSION_SC_RATE);
+  Event* response = NULL;
+  for (size_t i = 0; i < session.sc.size(); i++) {
+    sc.process(session.sc[i]);
+    float scr = sc.getSCR();
+    if (!response && scr > EVENT_SCR_ONSET) {
+      Event e = { (uint32_t)i, { scr, sc.getSCL(), 0 } };
+      _events[EVENT_SCR].push_back(e);
+      response = &_events[EVENT_SCR].back();
+    } else if (response) {
+      if (scr > response->features[0]) {
+        response->features[0] = scr;
+        response->features[2] = (float)(i - response->sample) / SESSION_SC_RATE;
+      }
+      if (scr < EVENT_SCR_OFFSET)
+        response = NULL;
+    }
+  }
+
+  if (!session.respiration.empty()) {
+    hostSetMicros(0);
+    Respiration* respiration = new Respiration(0, SESSION_RESPIRATION_RATE);
+    bool exhaling = respiration->isExhaling();
+    for (size_t i = 0; i < session.respiration.size(); i++) {
+      respiration->process(session.respiration[i], (unsigned long)((uint64_t)i * 1000 / SESSION_RESPIRATION_RATE));
+      if (respiration->isExhaling() != exhaling) {
+        exhaling = respiration->isExhaling();
+        Event e = { (uint32_t)i, { respiration->getRpm(), respiration->getTemperatureAmplitude(),
+                                   respiration->getAmplitudeChange() } };
+        _events[exhaling ? EVENT_EXHALE : EVENT_INHALE].push_back(e);
+      }
+    }
+    delete respiration;
+  }
+
+  return true;
+}
+
+bool EventIndex::save(const char* path) const {
+  std::vector<uint8_t> out;
+  out.insert(out.end(), "BDEV", "BDEV" + 4);
+  put16(out, EVENT_INDEX_VERSION);
+  put16(out, EVENT_TYPES);
+  put32(out, EVENT_INDEX_SEEK_INTERVAL);
+  for (int c = 0; c < EVENT_CHANNELS; c++) {
+    put32(out, _rates[c]);
+    put32(out, _nSamples[c]);
+  }
+  for (int c = 0; c < EVENT_CHANNELS; c++) {
+    put32(out, _seek[c].size());
+    for (size_t i = 0; i < _seek[c].size(); i++)
+      put64(out, _seek[c][i]);
+  }
+  for (int type = 0; type < EVENT_TYPES; type++) {
+    put32(out, _events[type].size());
+    for (size_t i = 0; i < _events[type].size(); i++) {
+      const Event& e = _events[type][i];
+      put32(out, e.sample);
+      for (int f = 0; f < EVENT_FEATURES; f++)
+        putFloat(out, e.features[f]);
+    }
+  }
+
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  bool ok = (fwrite(out.data(), 1, out.size(), file) == out.size());
+  return (fclose(file) == 0) && ok;
+}
+
+bool EventIndex::load(const char* path) {
+  clear();
+
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  std::vector<uint8_t> data;
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    data.insert(data.end(), buffer, buffer + n);
+  fclose(file);
+
+  if (data.size() < 4 || memcmp(data.data(), "BDEV", 4) != 0)
+    return false;
+  EventIndexInput in(data);
+  in.get32();
+  if (in.get16() != EVENT_INDEX_VERSION || in.get16() != EVENT_TYPES ||
+      in.get32() != EVENT_INDEX_SEEK_INTERVAL)
+    return false;
+  for (int c = 0; c < EVENT_CHANNELS; c++) {
+    _rates[c] = in.get32();
+    _nSamples[c] = in.get32();
+    if (_rates[c] == 0)
+      return false;
+  }
+  for (int c = 0; c < EVENT_CHANNELS && !in.overrun(); c++) {
+    _seek[c].resize(in.get32());
+    for (size_t i = 0; i < _seek[c].size() && !in.overrun(); i++)
+      _seek[c][i] = in.get64();
+  }
+  for (int type = 0; type < EVENT_TYPES && !in.overrun(); type++) {
+    _events[type].resize(in.get32());
+    for (size_t i = 0; i < _events[type].size() && !in.overrun(); i++) {
+      Event& e = _events[type][i];
+      e.sample = in.get32();
+      for (int f = 0; f < EVENT_FEATURES; f++)
+        e.features[f] = in.getFloat();
+    }
+  }
+  if (in.overrun()) {
+    clear();
+    return false;
+  }
+  return true;
+}
+
+static bool eventBefore(const Event& e, uint32_t sample) {
+  return e.sample < sample;
+}
+
+size_t EventIndex::lowerBound(int type, double seconds) const {
+  if (seconds <= 0)
+    return 0;
+  double sample = seconds * _rates[eventChannel(type)];
+  if (sample >= 4294967295.0)
+    return _events[type].size();
+  const std::vector<Event>& events = _events[type];
+  return std::lower_bound(events.begin(), events.end(), (uint32_t)ceil(sample), eventBefore) - events.begin();
+}
+
+void EventIndex::select(int type, double fromSeconds, double toSeconds, int feature, float minValue,
+                        float maxValue, std::vector<size_t>& out) const {
+  const std::vector<Event>& events = _events[type];
+  size_t end = lowerBound(type, toSeconds);
+  for (size_t i = lowerBound(type, fromSeconds); i < end; i++) {
+    if (feature < 0 || (events[i].features[feature] >= minValue && events[i].features[feature] <= maxValue))
+      out.push_back(i);
+  }
+}
+
+uint64_t EventIndex::seekRecord(uint8_t channel, uint32_t sample) const {
+  const std::vector<uint64_t>& seek = _seek[channel];
+  size_t k = sample / EVENT_INDEX_SEEK_INTERVAL;
+  if (seek.empty())
+    return 0;
+  return seek[std::min(k, seek.size() - 1)];
+}
+
+bool EventIndex::readSamples(FILE* session, uint8_t channel, uint32_t firstSample, uint32_t endSample,
+                             std::vector<uint16_t>& out) const {
+  if (channel >= EVENT_CHANNELS || _seek[channel].empty())
+    return true;
+  if (endSample > _nSamples[channel])
+    endSample = _nSamples[channel];
+  if (firstSample >= endSample)
+    return true;
+
+  size_t k = std::min((size_t)(firstSample / EVENT_INDEX_SEEK_INTERVAL), _seek[channel].size() - 1);
+  uint32_t sample = k * EVENT_INDEX_SEEK_INTERVAL;
+  if (fseeko(session, (off_t)(_seek[channel][k] * sizeof(SampleRecord)), SEEK_SET) != 0)
+    return false;
+
+  SampleRecord records[512];
+  size_t n;
+  while (sample < endSample && (n = fread(records, sizeof(SampleRecord), 512, session)) > 0) {
+    for (size_t i = 0; i < n && sample < endSample; i++) {
+      if (records[i].channel != channel)
+        continue;
+      if (sample >= firstSample)
+        out.push_back(records[i].value);
+      sample++;
+    }
+  }
+  return !ferror(session);
+}
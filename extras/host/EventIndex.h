@@ -0,0 +1,154 @@
+/*
+ * EventIndex.h (host)
+ *
+ * Sorted index of the events of a SampleLogger session (see Session.h):
+ * heart beats, exhale and inhale onsets, and skin conductance responses,
+ * each with its sample offset and a few features, so that event-centric
+ * queries ("30 s around every SCR above 0.5", "all breaths above 20 RPM")
+ * do not need the sensors to run again over whole recordings.
+ *
+ * The index also keeps a seek table into the session file: the position of
+ * every EVENT_INDEX_SEEK_INTERVAL-th sample of each channel, so that raw
+ * samples around an event are read without scanning the file.
+ *
+ * Features of each event type:
+ *   beat:    bpm, bpmChange, amplitudeChange
+ *   exhale:  rpm, amplitude, amplitudeChange  (when isExhaling() turns true)
+ *   inhale:  rpm, amplitude, amplitudeChange  (when isExhaling() turns false)
+ *   scr:     peak, scl, riseTime (seconds)    (when getSCR() rises above
+ *            EVENT_SCR_ONSET; peak is the highest getSCR() until it falls
+ *            back below EVENT_SCR_OFFSET)
+ *
+ * Layout (all values little-endian):
+ *   header:  "BDEV" uint16 version, uint16 nTypes, uint32 seekInterval,
+ *            per channel: uint32 rate, uint32 nSamples
+ *   seek:    per channel: uint32 nEntries, uint64 record number of sample
+ *            k * seekInterval for every k
+ *   events:  per type: uint32 nEvents, then uint32 sample and
+ *            EVENT_FEATURES floats per event, sorted by sample
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_EVENT_INDEX_H_
+#define BIODATA_HOST_EVENT_INDEX_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Session.h"
+
+#define EVENT_INDEX_VERSION 1
+
+#ifndef EVENT_INDEX_SEEK_INTERVAL
+#define EVENT_INDEX_SEEK_INTERVAL 1024
+#endif
+
+// SCR onset hysteresis (getSCR() rests at 0.2).
+#ifndef EVENT_SCR_ONSET
+#define EVENT_SCR_ONSET 0.3f
+#endif
+#ifndef EVENT_SCR_OFFSET
+#define EVENT_SCR_OFFSET 0.25f
+#endif
+
+#define EVENT_FEATURES 3
+#define EVENT_CHANNELS 3
+
+enum EventType {
+  EVENT_BEAT,
+  EVENT_EXHALE,
+  EVENT_INHALE,
+  EVENT_SCR,
+  EVENT_TYPES
+};
+
+struct Event {
+  uint32_t sample;                  // sample offset in the channel of the event
+  float features[EVENT_FEATURES];
+};
+
+/// Name of event #type# ("beat", "exhale", "inhale", "scr").
+const char* eventTypeName(int type);
+
+/// Returns the event type named #name#, or -1.
+int findEventType(const char* name);
+
+/// Name of feature #feature# of events of #type#.
+const char* eventFeatureName(int type, int feature);
+
+/// Returns the index of feature #name# of events of #type#, or -1.
+int findEventFeature(int type, const char* name);
+
+/// SampleLogger channel of events of #type#.
+uint8_t eventChannel(int type);
+
+class EventIndex {
+  uint32_t _rates[EVENT_CHANNELS];
+  uint32_t _nSamples[EVENT_CHANNELS];
+  std::vector<uint64_t> _seek[EVENT_CHANNELS];
+  std::vector<Event> _events[EVENT_TYPES];
+
+  void clear();
+
+public:
+  EventIndex();
+
+  /// Runs the sensors over session file #path# and indexes its events.
+  bool build(const char* path);
+
+  /// Writes the index to #path#. Returns false on error.
+  bool save(const char* path) const;
+
+  /// Reads an index written by save(). Returns false if invalid.
+  bool load(const char* path);
+
+  uint32_t rate(uint8_t channel) const { return _rates[channel]; }
+  uint32_t nSamples(uint8_t channel) const { return _nSamples[channel]; }
+
+  size_t nEvents(int type) const { return _events[type].size(); }
+  const Event& event(int type, size_t i) const { return _events[type][i]; }
+
+  /// Time of #event# of #type#, in seconds from the start of the session.
+  double time(int type, const Event& event) const {
+    return (double)event.sample / _rates[eventChannel(type)];
+  }
+
+  /// Index of the first event of #type# at or after #seconds# (binary search).
+  size_t lowerBound(int type, double seconds) const;
+
+  /**
+   * Appends to #out# the indices of the events of #type# in
+   * [fromSeconds, toSeconds) whose feature #feature# is in [minValue, maxValue]
+   * (any value if #feature# is -1).
+   */
+  void select(int type, double fromSeconds, double toSeconds, int feature, float minValue, float maxValue,
+              std::vector<size_t>& out) const;
+
+  /// Record number in the session file from which to read sample #sample# of #channel#.
+  uint64_t seekRecord(uint8_t channel, uint32_t sample) const;
+
+  /**
+   * Reads raw samples [firstSample, endSample) of #channel# from #session#
+   * (the file the index was built from) into #out#, starting from the
+   * nearest seek point. Returns false on read error.
+   */
+  bool readSamples(FILE* session, uint8_t channel, uint32_t firstSample, uint32_t endSample,
+                   std::vector<uint16_t>& out) const;
+};
+
+#endif
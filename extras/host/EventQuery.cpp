@@ -0,0 +1,160 @@
+/*
+ * EventQuery.cpp
+ *
+ * Builds the event index of a SampleLogger session (EventIndex.h), or
+ * queries it: lists the events of one type, optionally restricted to a time
+ * range and to a range of one of their features, with the raw samples
+ * around each of them.
+ *
+ * Usage: EventQuery -build session.bin [index.bdev]
+ *        EventQuery session.bin index.bdev type [-from seconds] [-to seconds]
+ *                   [-where feature min max] [-window seconds]
+ *
+ * Types are beat, exhale, inhale and scr. Events are printed as CSV
+ * (time, sample, features); with -window, the raw samples of the channel of
+ * the event from #seconds# before to #seconds# after it are printed instead
+ * (event, time, value).
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "EventIndex.h"
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static int usage(const char* name) {
+  fprintf(stderr, "usage: %s -build session.bin [index.bdev]\n"
+                  "       %s session.bin index.bdev type [-from seconds] [-to seconds]\n"
+                  "          [-where feature min max] [-window seconds]\n", name, name);
+  return 1;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3)
+    return usage(argv[0]);
+
+  EventIndex index;
+
+  if (strcmp(argv[1], "-build") == 0) {
+    std::string path = (argc > 3) ? argv[3] : std::string(argv[2]) + ".bdev";
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!index.build(argv[2])) {
+      perror(argv[2]);
+      return 1;
+    }
+    if (!index.save(path.c_str())) {
+      perror(path.c_str());
+      return 1;
+    }
+    fprintf(stderr, "%s: indexed in %.3f s:", path.c_str(), seconds(start));
+    for (int type = 0; type < EVENT_TYPES; type++)
+      fprintf(stderr, " %zu %s", index.nEvents(type), eventTypeName(type));
+    fprintf(stderr, "\n");
+    return 0;
+  }
+
+  if (argc < 4)
+    return usage(argv[0]);
+  if (!index.load(argv[2])) {
+    fprintf(stderr, "%s: not an event index\n", argv[2]);
+    return 1;
+  }
+  int type = findEventType(argv[3]);
+  if (type < 0) {
+    fprintf(stderr, "unknown event type %s\n", argv[3]);
+    return 1;
+  }
+
+  double from = 0, to = 1e12, window = -1;
+  int feature = -1;
+  float minValue = 0, maxValue = 0;
+  for (int i = 4; i < argc; i++) {
+    if (strcmp(argv[i], "-from") == 0 && i + 1 < argc) {
+      from = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-to") == 0 && i + 1 < argc) {
+      to = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-window") == 0 && i + 1 < argc) {
+      window = atof(argv[++i]);
+    } else if (strcmp(argv[i], "-where") == 0 && i + 3 < argc) {
+      feature = findEventFeature(type, argv[++i]);
+      if (feature < 0) {
+        fprintf(stderr, "%s events have no feature %s\n", eventTypeName(type), argv[i]);
+        return 1;
+      }
+      minValue = atof(argv[++i]);
+      maxValue = atof(argv[++i]);
+    } else {
+      return usage(argv[0]);
+    }
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  std::vector<size_t> selected;
+  index.select(type, from, to, feature, minValue, maxValue, selected);
+  double selectTime = seconds(start);
+
+  if (window < 0) {
+    printf("time,sample");
+    for (int f = 0; f < EVENT_FEATURES; f++)
+      printf(",%s", eventFeatureName(type, f));
+    printf("\n");
+    for (size_t i = 0; i < selected.size(); i++) {
+      const Event& e = index.event(type, selected[i]);
+      printf("%.3f,%u", index.time(type, e), e.sample);
+      for (int f = 0; f < EVENT_FEATURES; f++)
+        printf(",%.6g", e.features[f]);
+      printf("\n");
+    }
+    fprintf(stderr, "%zu events selected in %.1f us\n", selected.size(), selectTime * 1e6);
+    return 0;
+  }
+
+  // Raw samples around each event.
+  FILE* session = fopen(argv[1], "rb");
+  if (!session) {
+    perror(argv[1]);
+    return 1;
+  }
+  uint8_t channel = eventChannel(type);
+  uint32_t half = (uint32_t)(window * index.rate(channel));
+  std::vector<uint16_t> samples;
+  start = std::chrono::steady_clock::now();
+  printf("event,time,value\n");
+  for (size_t i = 0; i < selected.size(); i++) {
+    const Event& e = index.event(type, selected[i]);
+    uint32_t first = (e.sample > half) ? e.sample - half : 0;
+    samples.clear();
+    if (!index.readSamples(session, channel, first, e.sample + half + 1, samples)) {
+      perror(argv[1]);
+      return 1;
+    }
+    for (size_t j = 0; j < samples.size(); j++)
+      printf("%zu,%.3f,%u\n", selected[i], (double)(first + j) / index.rate(channel), samples[j]);
+  }
+  fclose(session);
+  fprintf(stderr, "%zu events selected in %.1f us, windows read in %.3f s\n", selected.size(),
+          selectTime * 1e6, seconds(start));
+  return 0;
+}
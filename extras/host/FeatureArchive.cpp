@@ -0,0 +1,461 @@
+/*
+ * FeatureArchive.cpp (host)
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "FeatureArchive.h"
+
+#include <fcntl.h>
+#include <math.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FEATURE_ARCHIVE_FOOTER_SIZE 16
+
+// Size of a chunk header: first row, number of rows and, per column,
+// min, max, offset and size.
+#define FEATURE_CHUNK_HEADER_SIZE(nColumns) (12 + 16 * (nColumns))
+
+static void put16(std::vector<uint8_t>& out, uint16_t v) {
+  out.push_back((uint8_t)v);
+  out.push_back((uint8_t)(v >> 8));
+}
+
+static void put32(std::vector<uint8_t>& out, uint32_t v) {
+  for (int i = 0; i < 4; i++)
+    out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void put64(std::vector<uint8_t>& out, uint64_t v) {
+  for (int i = 0; i < 8; i++)
+    out.push_back((uint8_t)(v >> (8 * i)));
+}
+
+static void putFloat(std::vector<uint8_t>& out, float v) {
+  uint32_t bits;
+  memcpy(&bits, &v, 4);
+  put32(out, bits);
+}
+
+static uint16_t get16(const uint8_t* p) {
+  return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t get64(const uint8_t* p) {
+  return (uint64_t)get32(p) | ((uint64_t)get32(p + 4) << 32);
+}
+
+static float getFloat(const uint8_t* p) {
+  uint32_t bits = get32(p);
+  float v;
+  memcpy(&v, &bits, 4);
+  return v;
+}
+
+/*
+ * Column codec. The first value is stored as is; every next value is XORed
+ * with the previous one:
+ *   '0'                               same value
+ *   '1' '0' <bits>                    significant bits fit in the previous window
+ *   '1' '1' <5: leading zeros> <5: length - 1> <bits>   new window
+ */
+class FeatureBitWriter {
+  std::vector<uint8_t>& _out;
+  uint64_t _acc;
+  uint8_t _nBits;
+
+public:
+  FeatureBitWriter(std::vector<uint8_t>& out) : _out(out), _acc(0), _nBits(0) {}
+
+  void write(uint32_t value, uint8_t n) {
+    if (n < 32) value &= (1UL << n) - 1;
+    _acc = (_acc << n) | value;
+    _nBits += n;
+    while (_nBits >= 8) {
+      _nBits -= 8;
+      _out.push_back((uint8_t)(_acc >> _nBits));
+    }
+  }
+
+  void flush() {
+    if (_nBits > 0)
+      _out.push_back((uint8_t)(_acc << (8 - _nBits)));
+    _nBits = 0;
+  }
+};
+
+class FeatureBitReader {
+  const uint8_t* _in;
+  size_t _size;
+  size_t _pos;
+  uint64_t _acc;
+  uint8_t _nBits;
+  bool _overrun;
+
+public:
+  FeatureBitReader(const uint8_t* in, size_t size) :
+    _in(in), _size(size), _pos(0), _acc(0), _nBits(0), _overrun(false) {}
+
+  uint32_t read(uint8_t n) {
+    while (_nBits < n) {
+      uint8_t byte = 0;
+      if (_pos < _size) byte = _in[_pos++];
+      else _overrun = true;
+      _acc = (_acc << 8) | byte;
+      _nBits += 8;
+    }
+    _nBits -= n;
+    uint64_t mask = (n < 32) ? ((1ULL << n) - 1) : 0xFFFFFFFFULL;
+    return (uint32_t)((_acc >> _nBits) & mask);
+  }
+
+  bool ok() const { return !_overrun; }
+};
+
+void featureEncode(const float* values, size_t n, std::vector<uint8_t>& out) {
+  if (n == 0) return;
+  FeatureBitWriter writer(out);
+  uint32_t previous;
+  memcpy(&previous, &values[0], 4);
+  writer.write(previous, 32);
+
+  int windowLeading = -1, windowTrailing = 0;
+  for (size_t i = 1; i < n; i++) {
+    uint32_t bits;
+    memcpy(&bits, &values[i], 4);
+    uint32_t x = bits ^ previous;
+    previous = bits;
+
+    if (x == 0) {
+      writer.write(0, 1);
+      continue;
+    }
+    int leading = __builtin_clz(x);
+    int trailing = __builtin_ctz(x);
+    if (windowLeading >= 0 && leading >= windowLeading && trailing >= windowTrailing) {
+      writer.write(2, 2); // '1' '0'
+      writer.write(x >> windowTrailing, 32 - windowLeading - windowTrailing);
+    } else {
+      int length = 32 - leading - trailing;
+      writer.write(3, 2); // '1' '1'
+      writer.write(leading, 5);
+      writer.write(length - 1, 5);
+      writer.write(x >> trailing, length);
+      windowLeading = leading;
+      windowTrailing = trailing;
+    }
+  }
+  writer.flush();
+}
+
+bool featureDecode(const uint8_t* in, size_t size, float* values, size_t n) {
+  if (n == 0) return true;
+  FeatureBitReader reader(in, size);
+  uint32_t previous = reader.read(32);
+  memcpy(&values[0], &previous, 4);
+
+  int windowLeading = 0, windowTrailing = 0;
+  for (size_t i = 1; i < n; i++) {
+    if (reader.read(1)) {
+      if (reader.read(1)) {
+        windowLeading = reader.read(5);
+        int length = reader.read(5) + 1;
+        windowTrailing = 32 - windowLeading - length;
+        if (windowTrailing < 0) return false;
+      }
+      int length = 32 - windowLeading - windowTrailing;
+      previous ^= reader.read(length) << windowTrailing;
+    }
+    memcpy(&values[i], &previous, 4);
+  }
+  return reader.ok();
+}
+
+FeatureArchiveWriter::FeatureArchiveWriter() :
+  _file(NULL), _offset(0), _rate(0), _nRows(0), _error(false) {}
+
+FeatureArchiveWriter::~FeatureArchiveWriter() {
+  if (_file)
+    close();
+}
+
+void FeatureArchiveWriter::writeBytes(const void* data, size_t size) {
+  if (size && fwrite(data, 1, size, _file) != size)
+    _error = true;
+  _offset += size;
+}
+
+bool FeatureArchiveWriter::open(const char* path, const std::vector<std::string>& columns, uint32_t rate) {
+  if (_file || columns.empty() || columns.size() > 0xFFFF)
+    return false;
+  _file = fopen(path, "wb");
+  if (!_file)
+    return false;
+
+  _offset = 0;
+  _rate = rate;
+  _columns = columns;
+  _buffers.assign(columns.size(), std::vector<float>());
+  for (size_t c = 0; c < _buffers.size(); c++)
+    _buffers[c].reserve(FEATURE_ARCHIVE_CHUNK_ROWS);
+  _chunkOffsets.clear();
+  _nRows = 0;
+  _error = false;
+
+  std::vector<uint8_t> header;
+  header.insert(header.end(), "BDFA", "BDFA" + 4);
+  put16(header, FEATURE_ARCHIVE_VERSION);
+  put16(header, columns.size());
+  put32(header, rate);
+  put32(header, FEATURE_ARCHIVE_CHUNK_ROWS);
+  for (size_t c = 0; c < columns.size(); c++) {
+    size_t length = columns[c].size() < 255 ? columns[c].size() : 255;
+    header.push_back((uint8_t)length);
+    header.insert(header.end(), columns[c].begin(), columns[c].begin() + length);
+  }
+  writeBytes(header.data(), header.size());
+  return !_error;
+}
+
+void FeatureArchiveWriter::append(const float* row) {
+  for (size_t c = 0; c < _buffers.size(); c++)
+    _buffers[c].push_back(row[c]);
+  _nRows++;
+  if (_buffers[0].size() == FEATURE_ARCHIVE_CHUNK_ROWS)
+    writeChunk();
+}
+
+void FeatureArchiveWriter::writeChunk() {
+  size_t n = _buffers[0].size();
+  if (n == 0) return;
+
+  std::vector<uint8_t> header;
+  std::vector<uint8_t> data;
+  put64(header, _nRows - n);
+  put32(header, n);
+  for (size_t c = 0; c < _buffers.size(); c++) {
+    const std::vector<float>& values = _buffers[c];
+    float min = NAN, max = NAN;
+    for (size_t i = 0; i < n; i++) {
+      float v = values[i];
+      if (v != v) continue; // NaN
+      if (!(v >= min)) min = v;
+      if (!(v <= max)) max = v;
+    }
+    size_t offset = data.size();
+    featureEncode(values.data(), n, data);
+    putFloat(header, min);
+    putFloat(header, max);
+    put32(header, offset);
+    put32(header, data.size() - offset);
+    _buffers[c].clear();
+  }
+
+  _chunkOffsets.push_back(_offset);
+  writeBytes(header.data(), header.size());
+  writeBytes(data.data(), data.size());
+}
+
+bool FeatureArchiveWriter::close() {
+  if (!_file)
+    return false;
+  writeChunk();
+
+  std::vector<uint8_t> index;
+  for (size_t i = 0; i < _chunkOffsets.size(); i++)
+    put64(index, _chunkOffsets[i]);
+  put64(index, _offset);
+  put32(index, _chunkOffsets.size());
+  index.insert(index.end(), "BDFI", "BDFI" + 4);
+  writeBytes(index.data(), index.size());
+
+  bool ok = !_error;
+  if (fclose(_file) != 0)
+    ok = false;
+  _file = NULL;
+  return ok;
+}
+
+FeatureArchiveReader::FeatureArchiveReader() :
+  _map(NULL), _mapSize(0), _fd(-1), _rate(0), _nRows(0) {}
+
+FeatureArchiveReader::~FeatureArchiveReader() {
+  close();
+}
+
+void FeatureArchiveReader::close() {
+  if (_map)
+    munmap((void*)_map, _mapSize);
+  if (_fd >= 0)
+    ::close(_fd);
+  _map = NULL;
+  _mapSize = 0;
+  _fd = -1;
+  _columns.clear();
+  _chunks.clear();
+  _nRows = 0;
+}
+
+bool FeatureArchiveReader::open(const char* path) {
+  close();
+  _fd = ::open(path, O_RDONLY);
+  if (_fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(_fd, &st) != 0 || st.st_size < 16 + FEATURE_ARCHIVE_FOOTER_SIZE) {
+    close();
+    return false;
+  }
+  _mapSize = st.st_size;
+  void* map = mmap(NULL, _mapSize, PROT_READ, MAP_PRIVATE, _fd, 0);
+  if (map == MAP_FAILED) {
+    _map = NULL;
+    close();
+    return false;
+  }
+  _map = (const uint8_t*)map;
+
+  // Header.
+  const uint8_t* p = _map;
+  const uint8_t* end = _map + _mapSize;
+  if (memcmp(p, "BDFA", 4) != 0 || get16(p + 4) != FEATURE_ARCHIVE_VERSION) {
+    close();
+    return false;
+  }
+  size_t nColumns = get16(p + 6);
+  _rate = get32(p + 8);
+  p += 16;
+  for (size_t c = 0; c < nColumns; c++) {
+    if (p >= end || p + 1 + *p > end) {
+      close();
+      return false;
+    }
+    _columns.push_back(std::string((const char*)p + 1, *p));
+    p += 1 + *p;
+  }
+
+  // Footer and index.
+  const uint8_t* footer = end - FEATURE_ARCHIVE_FOOTER_SIZE;
+  uint64_t indexOffset = get64(footer);
+  uint32_t nChunks = get32(footer + 8);
+  if (memcmp(footer + 12, "BDFI", 4) != 0 ||
+      indexOffset + 8ULL * nChunks + FEATURE_ARCHIVE_FOOTER_SIZE != _mapSize) {
+    close();
+    return false;
+  }
+
+  // Chunk headers.
+  for (uint32_t i = 0; i < nChunks; i++) {
+    uint64_t offset = get64(_map + indexOffset + 8 * i);
+    if (offset + FEATURE_CHUNK_HEADER_SIZE(nColumns) > indexOffset) {
+      close();
+      return false;
+    }
+    const uint8_t* h = _map + offset;
+    const uint8_t* data = h + FEATURE_CHUNK_HEADER_SIZE(nColumns);
+    Chunk chunk;
+    chunk.firstRow = get64(h);
+    chunk.nRows = get32(h + 8);
+    for (size_t c = 0; c < nColumns; c++) {
+      const uint8_t* ch = h + 12 + 16 * c;
+      ColumnChunk column;
+      column.min = getFloat(ch);
+      column.max = getFloat(ch + 4);
+      uint32_t columnOffset = get32(ch + 8);
+      column.size = get32(ch + 12);
+      column.data = data + columnOffset;
+      if (column.data + column.size > _map + indexOffset) {
+        close();
+        return false;
+      }
+      chunk.columns.push_back(column);
+    }
+    _nRows = chunk.firstRow + chunk.nRows;
+    _chunks.push_back(chunk);
+  }
+  return true;
+}
+
+int FeatureArchiveReader::findColumn(const char* name) const {
+  for (size_t c = 0; c < _columns.size(); c++)
+    if (_columns[c] == name)
+      return c;
+  return -1;
+}
+
+size_t FeatureArchiveReader::findChunk(uint64_t row) const {
+  size_t lo = 0, hi = _chunks.size();
+  while (lo < hi) {
+    size_t mid = (lo + hi) / 2;
+    if (_chunks[mid].firstRow + _chunks[mid].nRows <= row)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+size_t FeatureArchiveReader::read(size_t column, uint64_t firstRow, size_t n, float* out) const {
+  if (column >= _columns.size())
+    return 0;
+  std::vector<float> values;
+  size_t nRead = 0;
+  for (size_t i = findChunk(firstRow); i < _chunks.size() && nRead < n; i++) {
+    const Chunk& chunk = _chunks[i];
+    const ColumnChunk& c = chunk.columns[column];
+    values.resize(chunk.nRows);
+    if (!featureDecode(c.data, c.size, values.data(), chunk.nRows))
+      break;
+    uint64_t row = firstRow + nRead;
+    size_t from = row - chunk.firstRow;
+    size_t count = chunk.nRows - from;
+    if (count > n - nRead) count = n - nRead;
+    memcpy(out + nRead, values.data() + from, count * sizeof(float));
+    nRead += count;
+  }
+  return nRead;
+}
+
+size_t FeatureArchiveReader::scan(size_t column, uint64_t firstRow, uint64_t endRow, float minValue, float maxValue,
+                                  void (*callback)(uint64_t firstRow, const float* values, size_t n, void* context),
+                                  void* context) const {
+  if (column >= _columns.size())
+    return 0;
+  std::vector<float> values;
+  size_t nDecoded = 0;
+  for (size_t i = findChunk(firstRow); i < _chunks.size() && _chunks[i].firstRow < endRow; i++) {
+    const Chunk& chunk = _chunks[i];
+    const ColumnChunk& c = chunk.columns[column];
+    // Skip chunks out of range (chunks with only NaNs have NaN bounds and are decoded).
+    if (c.max < minValue || c.min > maxValue)
+      continue;
+    values.resize(chunk.nRows);
+    if (!featureDecode(c.data, c.size, values.data(), chunk.nRows))
+      break;
+    nDecoded++;
+    uint64_t from = (firstRow > chunk.firstRow) ? firstRow - chunk.firstRow : 0;
+    uint64_t to = (endRow < chunk.firstRow + chunk.nRows) ? endRow - chunk.firstRow : chunk.nRows;
+    callback(chunk.firstRow + from, values.data() + from, to - from, context);
+  }
+  return nDecoded;
+}
@@ -0,0 +1,151 @@
+/*
+ * FeatureArchive.h (host)
+ *
+ * Columnar, chunked binary storage for BioData features (eg. getBPM(),
+ * getSCL() of every sample of a replay), as a compact and fast to scan
+ * replacement for wide CSV files.
+ *
+ * Rows are split into chunks of FEATURE_ARCHIVE_CHUNK_ROWS. Within a chunk,
+ * every column is compressed separately (XOR of consecutive float values,
+ * bit-packed: repeated values take one bit) and described by its min and max,
+ * so that readers only decode the columns and chunks they need and can skip
+ * chunks whose values are out of a range of interest.
+ *
+ * Layout (all values little-endian):
+ *   header:  "BDFA" uint16 version, uint16 nColumns, uint32 rate (Hz),
+ *            uint32 chunkRows, then per column: uint8 length, name
+ *   chunks:  uint64 firstRow, uint32 nRows,
+ *            per column: float min, float max, uint32 offset, uint32 size
+ *            (offset relative to the end of the chunk header),
+ *            then column data
+ *   index:   uint64 offset of each chunk
+ *   footer:  uint64 index offset, uint32 nChunks, "BDFI"
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_FEATURE_ARCHIVE_H_
+#define BIODATA_HOST_FEATURE_ARCHIVE_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#define FEATURE_ARCHIVE_VERSION 1
+
+#ifndef FEATURE_ARCHIVE_CHUNK_ROWS
+#define FEATURE_ARCHIVE_CHUNK_ROWS 8192
+#endif
+
+/// Compresses #n# floats into #out# (appended). See FeatureArchive.h.
+void featureEncode(const float* values, size_t n, std::vector<uint8_t>& out);
+
+/// Decodes #n# floats from #in#. Returns false if #in# is truncated.
+bool featureDecode(const uint8_t* in, size_t size, float* values, size_t n);
+
+class FeatureArchiveWriter {
+  FILE* _file;
+  uint64_t _offset;
+  uint32_t _rate;
+  std::vector<std::string> _columns;
+  std::vector<std::vector<float> > _buffers; // one per column
+  std::vector<uint64_t> _chunkOffsets;
+  uint64_t _nRows;
+  bool _error;
+
+  void writeBytes(const void* data, size_t size);
+  void writeChunk();
+
+public:
+  FeatureArchiveWriter();
+  ~FeatureArchiveWriter();
+
+  /// Creates #path# with the given columns, sampled at #rate# Hz.
+  bool open(const char* path, const std::vector<std::string>& columns, uint32_t rate);
+
+  /// Appends one row (one value per column).
+  void append(const float* row);
+
+  /// Writes pending rows and the index, and closes the file.
+  /// Returns false if any write failed.
+  bool close();
+
+  uint64_t nRows() const { return _nRows; }
+};
+
+class FeatureArchiveReader {
+  struct ColumnChunk {
+    float min;
+    float max;
+    const uint8_t* data;
+    uint32_t size;
+  };
+  struct Chunk {
+    uint64_t firstRow;
+    uint32_t nRows;
+    std::vector<ColumnChunk> columns;
+  };
+
+  const uint8_t* _map;
+  size_t _mapSize;
+  int _fd;
+  uint32_t _rate;
+  std::vector<std::string> _columns;
+  std::vector<Chunk> _chunks;
+  uint64_t _nRows;
+
+  // Index of the first chunk that may contain #row#.
+  size_t findChunk(uint64_t row) const;
+
+public:
+  FeatureArchiveReader();
+  ~FeatureArchiveReader();
+
+  /// Memory-maps #path# and reads its index. Returns false if invalid.
+  bool open(const char* path);
+  void close();
+
+  uint32_t rate() const { return _rate; }
+  uint64_t nRows() const { return _nRows; }
+  size_t nColumns() const { return _columns.size(); }
+  const std::string& columnName(size_t column) const { return _columns[column]; }
+
+  /// Returns the index of column #name#, or -1.
+  int findColumn(const char* name) const;
+
+  /// Row of the sample at #seconds# from the start.
+  uint64_t rowAt(double seconds) const { return (uint64_t)(seconds * _rate + 0.5); }
+
+  /**
+   * Reads #n# values of #column# starting at #firstRow# into #out#, decoding
+   * only the chunks concerned. Returns the number of values read (less than
+   * #n# at the end of the archive).
+   */
+  size_t read(size_t column, uint64_t firstRow, size_t n, float* out) const;
+
+  /**
+   * Calls #callback(firstRow, values, n, context)# for the rows of #column#
+   * in [firstRow, endRow), one chunk at a time, skipping chunks where the
+   * column has no value in [minValue, maxValue]. Returns the number of
+   * chunks decoded.
+   */
+  size_t scan(size_t column, uint64_t firstRow, uint64_t endRow, float minValue, float maxValue,
+              void (*callback)(uint64_t firstRow, const float* values, size_t n, void* context),
+              void* context) const;
+};
+
+#endif
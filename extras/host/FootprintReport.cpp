@@ -0,0 +1,94 @@
+/*
+ * FootprintReport.cpp
+ *
+ * Prints the RAM footprint of the BioData classes and of the example
+ * configurations (Footprint.h): size of one instance, heap allocated by its
+ * constructor, and the device budget, then the number of participants
+ * (Heart, SkinConductance and Respiration) that fit in FOOTPRINT_RAM_BUDGET.
+ *
+ * Host sizes are larger than on the device (64-bit pointers and longs): run
+ * examples/Footprint on the board for the device figures. Build with
+ * -DFOOTPRINT_CHECK_HOST to also check the budgets at compile time.
+ *
+ * Usage: FootprintReport
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "BioData.h"
+#include "Footprint.h"
+#include "Average.h"
+#include "Lop.h"
+#include "MinMax.h"
+#include "PosixStorage.h"
+
+// Average window used for the heap figure.
+#define REPORT_AVERAGE_SIZE 100
+
+/// Constructs a T (left alive, see footprintHeap()) and prints its footprint.
+template <class T, class... Args>
+static size_t report(const char* name, size_t budget, Args&&... args) {
+  void* storage = malloc(sizeof(T));
+  size_t heap = footprintHeap<T>(storage, std::forward<Args>(args)...);
+  printf("%-22s %8zu %8zu", name, sizeof(T), heap);
+  if (budget)
+    printf(" %8zu", budget);
+  printf("\n");
+  return heap;
+}
+
+static void configuration(const char* name, size_t bytes, size_t heap) {
+  printf("%-22s %8zu %8zu %8lu  %s\n", name, bytes, heap, FOOTPRINT_RAM_BUDGET,
+         bytes + heap <= FOOTPRINT_RAM_BUDGET ? "ok" : "OVER");
+}
+
+int main() {
+  PosixStorage storage;
+  PyramidLogger pyramidLogger(storage);
+
+  // Budgets are for the device, where sizes are smaller.
+  printf("%-22s %8s %8s %8s\n", "class", "sizeof", "heap", "budget");
+  size_t heartHeap = report<Heart>("Heart", FOOTPRINT_HEART_BUDGET, A1);
+  size_t scHeap = report<SkinConductance>("SkinConductance", FOOTPRINT_SKIN_CONDUCTANCE_BUDGET, A6);
+  size_t respirationHeap = report<Respiration>("Respiration", FOOTPRINT_RESPIRATION_BUDGET, A0);
+  report<PulseRespiration>("PulseRespiration", FOOTPRINT_PULSE_RESPIRATION_BUDGET);
+  report<PulseTransit>("PulseTransit", FOOTPRINT_PULSE_TRANSIT_BUDGET);
+  report<PulseMorphology>("PulseMorphology", FOOTPRINT_PULSE_MORPHOLOGY_BUDGET);
+  report<HrvComplexity>("HrvComplexity", FOOTPRINT_HRV_COMPLEXITY_BUDGET);
+  report<OscEncoder>("OscEncoder", FOOTPRINT_OSC_ENCODER_BUDGET);
+  report<SampleLogger>("SampleLogger", FOOTPRINT_SAMPLE_LOGGER_BUDGET, storage);
+  report<PyramidLogger>("PyramidLogger", FOOTPRINT_PYRAMID_LOGGER_BUDGET, storage);
+  report<Pyramid>("Pyramid", FOOTPRINT_PYRAMID_BUDGET, pyramidLogger);
+  report<RiceEncoder>("RiceEncoder", FOOTPRINT_RICE_ENCODER_BUDGET);
+  report<Lop>("Lop", 0);
+  report<MinMax>("MinMax", 0);
+  report<Average<float> >("Average<float>(100)", 0, (uint32_t)REPORT_AVERAGE_SIZE);
+
+  size_t trioHeap = heartHeap + scHeap + respirationHeap;
+  printf("\n%-22s %8s %8s %8s\n", "configuration", "static", "heap", "budget");
+  configuration("participant (trio)", FOOTPRINT_TRIO, trioHeap);
+  configuration("OscOutput", FOOTPRINT_OSC_OUTPUT, trioHeap);
+  configuration("SampleLogger", FOOTPRINT_SAMPLE_LOGGER, trioHeap);
+  configuration("Pyramid", FOOTPRINT_PYRAMID, trioHeap);
+  configuration("Compression", FOOTPRINT_COMPRESSION, heartHeap + scHeap);
+
+  printf("\nparticipants in %lu bytes: %zu\n", FOOTPRINT_RAM_BUDGET,
+         (size_t)(FOOTPRINT_RAM_BUDGET / (FOOTPRINT_TRIO + trioHeap)));
+  return 0;
+}
@@ -0,0 +1,203 @@
+/*
+ * FrameRing.cpp (host)
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "FrameRing.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(FrameRingHeader) == 64, "FrameRingHeader must fill one cache line");
+
+FrameRingWriter::FrameRingWriter() :
+  _header(NULL), _slots(NULL), _mapSize(0), _written(0)
+{}
+
+FrameRingWriter::~FrameRingWriter() {
+  close();
+}
+
+bool FrameRingWriter::create(const char* name, uint32_t capacity) {
+  close();
+  uint32_t slots = 1;
+  while (slots < capacity)
+    slots <<= 1;
+
+  shm_unlink(name);
+  int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+  if (fd < 0)
+    return false;
+  size_t size = sizeof(FrameRingHeader) + (size_t)slots * sizeof(FrameRingSlot);
+  if (ftruncate(fd, size) != 0) {
+    ::close(fd);
+    shm_unlink(name);
+    return false;
+  }
+  void* map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    shm_unlink(name);
+    return false;
+  }
+
+  _name = name;
+  _mapSize = size;
+  _header = (FrameRingHeader*)map;
+  _slots = (FrameRingSlot*)(_header + 1);
+  _written = 0;
+
+  // The new object is zero-filled: slots are all "never written".
+  _header->version = FRAME_RING_VERSION;
+  _header->frameSize = sizeof(RingFrame);
+  _header->capacity = slots;
+  _header->written.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(_header->magic, "BDFR", 4);
+  return true;
+}
+
+void FrameRingWriter::close() {
+  if (_header) {
+    munmap(_header, _mapSize);
+    shm_unlink(_name.c_str());
+  }
+  _header = NULL;
+  _slots = NULL;
+}
+
+void FrameRingWriter::publish(const RingFrame& frame) {
+  if (!_header) return;
+  FrameRingSlot& slot = _slots[_written & (_header->capacity - 1)];
+  uint64_t sequence = 2 * (_written + 1);
+
+  slot.sequence.store(sequence - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&slot.frame, &frame, sizeof(RingFrame));
+  slot.sequence.store(sequence, std::memory_order_release);
+
+  _written++;
+  _header->written.store(_written, std::memory_order_release);
+}
+
+FrameRingReader::FrameRingReader() :
+  _header(NULL), _slots(NULL), _mapSize(0), _mask(0), _next(0), _nLost(0), _nOverruns(0)
+{}
+
+FrameRingReader::~FrameRingReader() {
+  close();
+}
+
+bool FrameRingReader::open(const char* name) {
+  close();
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(FrameRingHeader)) {
+    ::close(fd);
+    return false;
+  }
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return false;
+
+  const FrameRingHeader* header = (const FrameRingHeader*)map;
+  uint32_t capacity = header->capacity;
+  if (memcmp(header->magic, "BDFR", 4) != 0 || header->version != FRAME_RING_VERSION ||
+      header->frameSize != sizeof(RingFrame) || capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+      (size_t)st.st_size < sizeof(FrameRingHeader) + (size_t)capacity * sizeof(FrameRingSlot)) {
+    munmap(map, st.st_size);
+    return false;
+  }
+
+  _header = header;
+  _slots = (const FrameRingSlot*)(header + 1);
+  _mapSize = st.st_size;
+  _mask = capacity - 1;
+  _next = header->written.load(std::memory_order_acquire);
+  _nLost = 0;
+  _nOverruns = 0;
+  return true;
+}
+
+void FrameRingReader::close() {
+  if (_header)
+    munmap((void*)_header, _mapSize);
+  _header = NULL;
+  _slots = NULL;
+}
+
+uint64_t FrameRingReader::available() const {
+  return _header ? _header->written.load(std::memory_order_acquire) - _next : 0;
+}
+
+void FrameRingReader::skipLost() {
+  // Resume a quarter of a ring behind the writer, so that the frames read
+  // next are not about to be overwritten.
+  uint64_t written = _header->written.load(std::memory_order_acquire);
+  uint64_t resume = written - (_mask + 1) * 3 / 4;
+  if (written < (_mask + 1) * 3 / 4 || resume <= _next)
+    resume = _next + 1;
+  _nLost += resume - _next;
+  _nOverruns++;
+  _next = resume;
+}
+
+const RingFrame* FrameRingReader::peek() {
+  if (!_header)
+    return NULL;
+  for (;;) {
+    if (_next >= _header->written.load(std::memory_order_acquire))
+      return NULL;
+    const FrameRingSlot& slot = _slots[_next & _mask];
+    uint64_t sequence = slot.sequence.load(std::memory_order_acquire);
+    if (sequence == 2 * (_next + 1))
+      return &slot.frame;
+    if (sequence < 2 * (_next + 1))
+      return NULL;  // still being written
+    skipLost();
+  }
+}
+
+bool FrameRingReader::release() {
+  if (!_header)
+    return false;
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const FrameRingSlot& slot = _slots[_next & _mask];
+  if (slot.sequence.load(std::memory_order_relaxed) != 2 * (_next + 1)) {
+    skipLost();
+    return false;
+  }
+  _next++;
+  return true;
+}
+
+bool FrameRingReader::read(RingFrame& out) {
+  for (;;) {
+    const RingFrame* frame = peek();
+    if (!frame)
+      return false;
+    memcpy(&out, frame, sizeof(RingFrame));
+    if (release())
+      return true;
+  }
+}
@@ -0,0 +1,137 @@
+/*
+ * FrameRing.h (host)
+ *
+ * Shared-memory ring of fixed-layout BioData frames, written by one process
+ * (eg. RingPublish, which decodes the device streams once) and read by any
+ * number of consumer processes (visualizer, recorder, sonification...).
+ *
+ * The writer never waits for readers. Every slot carries a sequence number
+ * (seqlock): odd while the frame is being written, 2 * (n + 1) once frame
+ * #n# is complete. Readers map the ring read-only, keep their own position
+ * and read frames in place or by copy without locks or system calls; the
+ * sequence number tells them whether a frame is ready, and whether it was
+ * overwritten because they fell more than a ring behind (overrun), in which
+ * case they skip ahead and count the frames they lost.
+ *
+ * Layout: FrameRingHeader (one cache line), then #capacity# FrameRingSlots.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_FRAME_RING_H_
+#define BIODATA_HOST_FRAME_RING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+#define FRAME_RING_VERSION 1
+#define FRAME_RING_MAX_VALUES 32
+#define FRAME_RING_DEFAULT_NAME "/biodata"
+
+// Shared atomics must not rely on a lock inside the process.
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2, "FrameRing needs lock-free 64-bit atomics");
+
+/// One frame of one device (152 bytes).
+struct RingFrame {
+  int64_t hostMicros;      // arrival, or aligned time
+  int64_t deviceMicros;    // unwrapped device timetag
+  uint16_t device;
+  uint16_t nValues;
+  uint32_t reserved;
+  float values[FRAME_RING_MAX_VALUES];
+};
+
+struct FrameRingHeader {
+  char magic[4];           // "BDFR"
+  uint32_t version;
+  uint32_t frameSize;      // sizeof(RingFrame)
+  uint32_t capacity;       // number of slots, a power of two
+  std::atomic<uint64_t> written;  // number of frames published
+  uint8_t padding[40];
+};
+
+struct FrameRingSlot {
+  std::atomic<uint64_t> sequence;
+  RingFrame frame;
+};
+
+class FrameRingWriter {
+  std::string _name;
+  FrameRingHeader* _header;
+  FrameRingSlot* _slots;
+  size_t _mapSize;
+  uint64_t _written;
+
+public:
+  FrameRingWriter();
+  ~FrameRingWriter();
+
+  /// Creates (or replaces) shared memory object #name# with #capacity# slots (rounded up to a power of two).
+  bool create(const char* name, uint32_t capacity);
+
+  /// Unmaps and removes the ring; readers keep their mapping until they close it.
+  void close();
+
+  /// Publishes a frame.
+  void publish(const RingFrame& frame);
+
+  uint64_t nWritten() const { return _written; }
+};
+
+class FrameRingReader {
+  const FrameRingHeader* _header;
+  const FrameRingSlot* _slots;
+  size_t _mapSize;
+  uint32_t _mask;
+  uint64_t _next;
+  uint64_t _nLost;
+  uint64_t _nOverruns;
+
+  // Skips past the frames that were overwritten.
+  void skipLost();
+
+public:
+  FrameRingReader();
+  ~FrameRingReader();
+
+  /// Maps ring #name# read-only and starts at its newest frame. Returns false if invalid.
+  bool open(const char* name);
+  void close();
+
+  /// Copies the next frame into #out#. Returns false if none is available yet.
+  bool read(RingFrame& out);
+
+  /**
+   * Returns the next frame in place (NULL if none is available yet). It may
+   * be overwritten at any time: check release() before trusting what was
+   * read from it.
+   */
+  const RingFrame* peek();
+
+  /// Moves past the frame returned by peek(). Returns false if it was overwritten meanwhile.
+  bool release();
+
+  /// Number of frames published but not read yet.
+  uint64_t available() const;
+
+  /// Frames lost by falling behind, and the number of times it happened.
+  uint64_t nLost() const { return _nLost; }
+  uint64_t nOverruns() const { return _nOverruns; }
+};
+
+#endif
@@ -0,0 +1,209 @@
+/*
+ * HrvComplexityEval.cpp
+ *
+ * Checks HrvComplexity (streaming sample entropy and DFA alpha1) against
+ * the same measures recomputed over the whole window, on synthetic interval
+ * series of known structure: uncorrelated, 1/f, random walk and periodic
+ * (breathing) with noise. Every few beats, the streaming values must match
+ * the recomputed ones (the sample entropy exactly, with the same tolerance).
+ * A copy restored from a snapshot halfway must then give identical values.
+ * Prints the values, the largest differences and the cost per beat of
+ * both.
+ *
+ * Usage: HrvComplexityEval [beats]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+#include "HrvComplexity.h"
+#include "Snapshot.h"
+
+// Streaming values are compared with recomputed ones every this many beats.
+#define CHECK_EVERY 25
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Deterministic Gaussian noise.
+static uint32_t noiseState = 12345;
+static double uniform() {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return ((noiseState >> 8) + 0.5) / 16777216.0;
+}
+static double gaussian() {
+  return sqrt(-2 * log(uniform())) * cos(2 * M_PI * uniform());
+}
+
+/// Interval series around 850 ms.
+static void makeSeries(int kind, size_t n, std::vector<float>& series) {
+  // 1/f noise: sum of random walks relaxing at octave-spaced rates.
+  double octaves[12] = { 0 };
+  double walk = 0;
+  for (size_t i = 0; i < n; i++) {
+    double x = 0;
+    switch (kind) {
+      case 0:  // uncorrelated
+        x = 40 * gaussian();
+        break;
+      case 1:  // 1/f
+        for (int k = 0; k < 12; k++) {
+          double a = 1.0 / (1 << k);
+          octaves[k] += a * (gaussian() - octaves[k]);
+          x += 25 * octaves[k] / sqrt(a);
+        }
+        x /= 4;
+        break;
+      case 2:  // random walk, pulled back slowly
+        walk += 8 * gaussian() - 0.002 * walk;
+        x = walk;
+        break;
+      default:  // breathing every 4.3 beats, with noise
+        x = 50 * sin(2 * M_PI * i / 4.3) + 10 * gaussian();
+        break;
+    }
+    series.push_back((float)constrain(850 + x, 300, 1900));
+  }
+}
+
+/// Sample entropy of #x# (m = HRV_COMPLEXITY_M) with tolerance #r#, recomputed.
+static double sampleEntropy(const std::vector<int>& x, int r) {
+  const int m = HRV_COMPLEXITY_M;
+  long a = 0, b = 0;
+  int nTemplates = (int)x.size() - m;
+  for (int i = 0; i < nTemplates; i++)
+    for (int j = i + 1; j < nTemplates; j++) {
+      int k = 0;
+      while (k < m && abs(x[i + k] - x[j + k]) <= r) k++;
+      if (k < m) continue;
+      b++;
+      if (abs(x[i + m] - x[j + m]) <= r) a++;
+    }
+  return (a > 0 && b > 0) ? -log((double)a / b) : NAN;
+}
+
+/// DFA alpha1 of #x# (beat #first# is the first one), boxes aligned on the beat count.
+static double dfaAlpha1(const std::vector<int>& x, size_t first) {
+  double sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+  for (int n = HRV_DFA_MIN_BOX; n <= HRV_DFA_MAX_BOX; n++) {
+    double residuals = 0;
+    int nBoxes = 0;
+    for (size_t start = (first + n - 1) / n * n; start + n <= first + x.size(); start += n) {
+      // Linear fit of the profile over the box.
+      std::vector<double> y(n);
+      double c = 0;
+      for (int k = 0; k < n; k++) y[k] = (c += x[start - first + k]);
+      double mk = (n - 1) / 2.0, my = 0, skk = 0, sky = 0, syy = 0;
+      for (int k = 0; k < n; k++) my += y[k] / n;
+      for (int k = 0; k < n; k++) {
+        skk += (k - mk) * (k - mk);
+        sky += (k - mk) * (y[k] - my);
+        syy += (y[k] - my) * (y[k] - my);
+      }
+      residuals += syy - sky * sky / skk;
+      nBoxes++;
+    }
+    if (nBoxes < 2) return NAN;
+    double lx = log((double)n), ly = 0.5 * log(residuals / (nBoxes * n));
+    sumX += lx; sumY += ly; sumXX += lx * lx; sumXY += lx * ly;
+  }
+  double k = HRV_DFA_N_BOXES;
+  return (k * sumXY - sumX * sumY) / (k * sumXX - sumX * sumX);
+}
+
+int main(int argc, char** argv) {
+  size_t nBeats = (argc > 1) ? atoi(argv[1]) : 5000;
+  if (nBeats < 2 * HRV_COMPLEXITY_WINDOW) {
+    fprintf(stderr, "usage: %s [beats, at least %d]\n", argv[0], 2 * HRV_COMPLEXITY_WINDOW);
+    return 1;
+  }
+
+  const char* names[] = { "uncorrelated", "1/f", "random walk", "breathing" };
+  bool ok = true;
+  printf("HrvComplexity over %d beats (%d bytes), %zu beats per series\n", HRV_COMPLEXITY_WINDOW,
+         (int)sizeof(HrvComplexity), nBeats);
+  printf("series          SampEn  alpha1  tolerance  SampEn diff  alpha1 diff  streaming ns/beat  recomputed ns/beat\n");
+  for (int kind = 0; kind < 4; kind++) {
+    std::vector<float> series;
+    noiseState = 12345 + kind;
+    makeSeries(kind, nBeats, series);
+
+    HrvComplexity complexity;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < series.size(); i++)
+      complexity.addInterval(series[i]);
+    double streamingSeconds = seconds(start);
+
+    // Restored from a snapshot halfway, the rest must be identical.
+    HrvComplexity first, restored;
+    for (size_t i = 0; i < series.size() / 2; i++)
+      first.addInterval(series[i]);
+    std::vector<uint8_t> snapshot(snapshotSize(first));
+    bool identical = saveSnapshot(first, snapshot.data(), snapshot.size()) &&
+                     loadSnapshot(restored, snapshot.data(), snapshot.size());
+    for (size_t i = series.size() / 2; i < series.size(); i++) {
+      first.addInterval(series[i]);
+      restored.addInterval(series[i]);
+      identical &= (first.getSampleEntropy() == restored.getSampleEntropy() ||
+                    (isnan(first.getSampleEntropy()) && isnan(restored.getSampleEntropy()))) &&
+                   first.getDfaAlpha1() == restored.getDfaAlpha1();
+    }
+
+    // Again, checking against recomputed values.
+    complexity.reset();
+    double maxEntropyDiff = 0, maxAlphaDiff = 0, recomputedSeconds = 0, sumEntropy = 0, sumAlpha = 0;
+    size_t nChecks = 0;
+    for (size_t i = 0; i < series.size(); i++) {
+      complexity.addInterval(series[i]);
+      if (i + 1 < HRV_COMPLEXITY_WINDOW || (i + 1) % CHECK_EVERY != 0)
+        continue;
+      // Same units and rounding as HrvComplexity.
+      std::vector<int> window;
+      for (size_t k = i + 1 - HRV_COMPLEXITY_WINDOW; k <= i; k++)
+        window.push_back((int)(series[k] * HRV_COMPLEXITY_SCALE + 0.5f));
+      int tolerance = (int)(complexity.getTolerance() * HRV_COMPLEXITY_SCALE + 0.5f);
+      start = std::chrono::steady_clock::now();
+      double entropy = sampleEntropy(window, tolerance);
+      double alpha = dfaAlpha1(window, i + 1 - HRV_COMPLEXITY_WINDOW);
+      recomputedSeconds += seconds(start);
+
+      double entropyDiff = fabs(entropy - complexity.getSampleEntropy());
+      double alphaDiff = fabs(alpha - complexity.getDfaAlpha1());
+      if (isnan(entropy) != isnan(complexity.getSampleEntropy())) entropyDiff = INFINITY;
+      if (isnan(entropyDiff)) entropyDiff = 0;
+      if (entropyDiff > maxEntropyDiff) maxEntropyDiff = entropyDiff;
+      if (alphaDiff > maxAlphaDiff || isnan(alphaDiff)) maxAlphaDiff = isnan(alphaDiff) ? INFINITY : alphaDiff;
+      sumEntropy += complexity.getSampleEntropy();
+      sumAlpha += complexity.getDfaAlpha1();
+      nChecks++;
+    }
+    ok &= maxEntropyDiff < 1e-5 && maxAlphaDiff < 1e-3 && identical;
+
+    printf("%-14s  %6.2f  %6.2f  %9.2f  %11.2g  %11.2g  %17.0f  %18.0f%s\n", names[kind], sumEntropy / nChecks,
+           sumAlpha / nChecks, complexity.getTolerance(), maxEntropyDiff, maxAlphaDiff,
+           streamingSeconds * 1e9 / series.size(), recomputedSeconds * 1e9 / nChecks,
+           identical ? "" : "  (snapshot differs)");
+  }
+
+  printf("%s\n", ok ? "PASSED" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,318 @@
+/*
+ * LatencyHarness.cpp
+ *
+ * Measures the delay from a physiological event to its detection:
+ *  - beats: pulse foot (start of the systolic upstroke) to beatDetected();
+ *  - breaths: start of exhale (temperature minimum) to isExhaling().
+ * Sensors are driven with synthetic signals whose event times are known,
+ * for several sample rates and detection settings, and the latency
+ * distribution of each configuration is printed together with its CPU cost,
+ * so that CPU can be traded for latency.
+ *
+ * Also measures the group delay of each filtering stage: low-pass stages
+ * (Lop) lag a ramp by a constant number of samples, min/max normalizers
+ * (MinMax::adapt) take a number of samples to settle after an amplitude step.
+ *
+ * Usage: LatencyHarness
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Lop.h"
+#include "MinMax.h"
+#include "Sweep.h"
+#include "Replay.h"
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+/// Detection latencies (ms) of one configuration.
+struct Latencies {
+  std::vector<float> values;
+  size_t nMissed;
+  size_t nFalse;
+
+  Latencies() : nMissed(0), nFalse(0) {}
+
+  float percentile(float p) {
+    if (values.empty()) return NAN;
+    std::sort(values.begin(), values.end());
+    size_t i = (size_t)(p * (values.size() - 1) + 0.5f);
+    return values[i];
+  }
+};
+
+// Events and detections during the first seconds (normalizers calibrating)
+// are ignored.
+#define WARMUP_MILLIS 10000UL
+
+/**
+ * Matches each event with the first detection in [event, event + window).
+ * Detections matching no event count as false.
+ */
+static void matchEvents(const std::vector<unsigned long>& events, const std::vector<unsigned long>& detections,
+                        unsigned long window, Latencies& latencies) {
+  size_t d = 0;
+  while (d < detections.size() && detections[d] < WARMUP_MILLIS)
+    d++;
+  for (size_t e = 0; e < events.size(); e++) {
+    if (events[e] < WARMUP_MILLIS)
+      continue;
+    while (d < detections.size() && detections[d] < events[e]) {
+      latencies.nFalse++;
+      d++;
+    }
+    if (d < detections.size() && detections[d] < events[e] + window) {
+      latencies.values.push_back(detections[d] - events[e]);
+      d++;
+    } else {
+      latencies.nMissed++;
+    }
+  }
+  latencies.nFalse += detections.size() - d;
+}
+
+static void printLatencies(Latencies& l, double minutes) {
+  printf("%7.0f %7.0f %7.0f %7.0f %7.0f  %5.1f%%  %6.1f",
+         l.percentile(0), l.percentile(0.5), l.percentile(0.9), l.percentile(0.99), l.percentile(1),
+         100.0 * l.nMissed / (l.nMissed + l.values.size()), l.nFalse / minutes);
+}
+
+// PPG: each beat starts (foot) with a raised-cosine upstroke reaching the
+// systolic peak 120 ms later, followed by an exponential decay. Heart rate
+// and amplitude drift slowly.
+static void makePpg(unsigned long rate, double duration, std::vector<uint16_t>& samples,
+                    std::vector<unsigned long>& feet) {
+  double phase = 0;
+  double beatStart = 0;
+  feet.push_back(0);
+  for (size_t i = 0; i < duration * rate; i++) {
+    double t = (double)i / rate;
+    double bpm = 70 + 15 * sin(t / 45.0);
+    if (i) phase += bpm / 60 / rate;
+    if (phase >= 1) {
+      phase -= 1;
+      beatStart = t - phase * 60 / bpm;
+      feet.push_back((unsigned long)(beatStart * 1000 + 0.5));
+    }
+    double dt = t - beatStart;
+    double pulse = (dt < 0.12) ? 0.5 - 0.5 * cos(M_PI * dt / 0.12) : exp(-(dt - 0.12) / 0.25);
+    double amplitude = 250 + 80 * sin(t / 70.0);
+    samples.push_back((uint16_t)constrain(400 + amplitude * pulse + noise(6), 0, 1023));
+  }
+}
+
+// Thermistor: exhales start at the temperature minimum.
+static void makeBreathing(unsigned long rate, double duration, std::vector<uint16_t>& samples,
+                          std::vector<unsigned long>& exhales) {
+  double phase = 0.5;
+  for (size_t i = 0; i < duration * rate; i++) {
+    double t = (double)i / rate;
+    double previous = phase;
+    phase += (0.25 + 0.05 * sin(t / 90.0)) / rate;
+    if (phase >= 1) phase -= 1;
+    if (previous < 0.5 && phase >= 0.5)
+      exhales.push_back((unsigned long)(t * 1000 + 0.5));
+    samples.push_back((uint16_t)(13000 - 250 * cos(2 * M_PI * phase) + noise(6)));
+  }
+}
+
+static void heartLatency() {
+  const double duration = 600; // seconds
+  const unsigned long rates[] = { 100, 200, 400 };
+
+  printf("Heart: pulse foot to beatDetected() (ms), 10 minutes per rate\n");
+  printf("rate  upper lower smooth  CPU/s    min  median     p90     p99     max  missed  false/min\n");
+  for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+    unsigned long rate = rates[r];
+    std::vector<uint16_t> samples;
+    std::vector<unsigned long> feet;
+    noiseState = 12345;
+    makePpg(rate, duration, samples, feet);
+
+    std::vector<HeartConfig> configs;
+    for (float upper = 0.3f; upper < 0.75f; upper += 0.1f)
+      for (float smoothing = 0.05f; smoothing < 0.5f; smoothing *= 2) {
+        HeartConfig c;
+        c.thresholdUpper = upper;
+        c.thresholdLower = upper - 0.15f;
+        c.minMaxSmoothing = smoothing;
+        configs.push_back(c);
+      }
+
+    hostSetMicros(0);
+    HeartSweep sweep(configs);
+    std::vector<std::vector<unsigned long> > detections(configs.size());
+    for (size_t i = 0; i < samples.size(); i++) {
+      unsigned long ms = replayMillis(i, rate);
+      sweep.process(samples[i], ms);
+      for (size_t k = 0; k < configs.size(); k++)
+        if (sweep.beatDetected(k))
+          detections[k].push_back(ms);
+    }
+
+    // CPU cost of one Heart at this rate, per second of signal.
+    hostSetMicros(0);
+    Heart heart(A1, rate);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples.size(); i++)
+      heart.process(samples[i], replayMillis(i, rate));
+    double cpu = seconds(start) / duration;
+
+    for (size_t k = 0; k < configs.size(); k++) {
+      Latencies latencies;
+      matchEvents(feet, detections[k], 500, latencies);
+      printf("%4lu  %5.2f %5.2f %6.2f %5.1fus ", rate, configs[k].thresholdUpper, configs[k].thresholdLower,
+             configs[k].minMaxSmoothing, cpu * 1e6);
+      printLatencies(latencies, (duration - WARMUP_MILLIS / 1000) / 60);
+      printf("\n");
+    }
+  }
+  printf("\n");
+}
+
+static void respirationLatency() {
+  const double duration = 1200; // seconds
+  const unsigned long rates[] = { 25, 50, 100 };
+
+  printf("Respiration: start of exhale to isExhaling() (ms), 20 minutes per rate\n");
+  printf("rate  thresh reload smoother  CPU/s    min  median     p90     p99     max  missed  false/min\n");
+  for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+    unsigned long rate = rates[r];
+    std::vector<uint16_t> samples;
+    std::vector<unsigned long> exhales;
+    noiseState = 12345;
+    makeBreathing(rate, duration, samples, exhales);
+
+    std::vector<RespirationConfig> configs;
+    for (float threshold = 0.3f; threshold < 0.75f; threshold += 0.2f)
+      for (float smoother = 0.05f; smoother < 0.5f; smoother *= 3) {
+        RespirationConfig c;
+        c.peakThreshold = c.troughThreshold = threshold;
+        c.peakReloadThreshold = threshold - 0.1f;
+        c.troughReloadThreshold = threshold + 0.1f;
+        c.smootherFactor = smoother;
+        configs.push_back(c);
+      }
+
+    hostSetMicros(0);
+    RespirationSweep sweep(configs);
+    std::vector<std::vector<unsigned long> > detections(configs.size());
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples.size(); i++) {
+      unsigned long ms = replayMillis(i, rate);
+      sweep.process(samples[i], ms);
+      for (size_t k = 0; k < configs.size(); k++)
+        if (sweep.breathDetected(k))
+          detections[k].push_back(ms);
+    }
+    double cpu = seconds(start) / duration / configs.size();
+
+    for (size_t k = 0; k < configs.size(); k++) {
+      Latencies latencies;
+      matchEvents(exhales, detections[k], 3000, latencies);
+      printf("%4lu  %6.2f %6.2f %8.2f %5.1fus ", rate, configs[k].peakThreshold,
+             configs[k].peakThreshold - configs[k].peakReloadThreshold, configs[k].smootherFactor, cpu * 1e6);
+      printLatencies(latencies, (duration - WARMUP_MILLIS / 1000) / 60);
+      printf("\n");
+    }
+  }
+  printf("\n");
+}
+
+/// Lag (in samples) of a low-pass filter behind a unit ramp, once settled.
+static float lopLag(float smoothing) {
+  Lop lop(smoothing);
+  size_t n = (size_t)(2 / smoothing) + (size_t)(30 / smoothing);
+  float output = 0;
+  for (size_t i = 0; i < n; i++)
+    output = lop.filter((float)i);
+  return (n - 1) - output;
+}
+
+/// Samples for a min/max normalizer to recover from a 4x amplitude drop:
+/// number of samples until a full-swing input reaches 90% of the range again.
+static size_t minMaxSettling(float smoothing, size_t period) {
+  MinMax minMax;
+  for (size_t i = 0; i < 20 * period; i++) {
+    minMax.filter((i % period) < period / 2 ? 1.0f : -1.0f);
+    minMax.adapt(smoothing);
+  }
+  for (size_t i = 0; i < 1000000; i++) {
+    float input = (i % period) < period / 2 ? 0.25f : -0.25f;
+    minMax.filter(input);
+    minMax.adapt(smoothing);
+    if (minMax.getMax() - minMax.getMin() < 0.5f / 0.9f)
+      return i;
+  }
+  return 1000000;
+}
+
+static void stageDelays() {
+  printf("Group delay per stage (measured; Lop: ramp lag, MinMax: settling after a 4x amplitude drop)\n");
+  printf("stage                               setting      samples  at rate      delay\n");
+
+  struct { const char* name; float smoothing; unsigned long rate; } lops[] = {
+    { "Heart amplitude Lop",            0.001f, 200 },
+    { "Heart bpm Lop",                  0.001f, 200 },
+    { "SkinConductance SCL Lop",        0.01f,   50 },
+    { "SkinConductance baseline Lop",   0.005f,  50 },
+  };
+  for (size_t i = 0; i < sizeof(lops) / sizeof(lops[0]); i++) {
+    float lag = lopLag(lops[i].smoothing);
+    printf("%-34s %8.3f %12.1f  %4lu Hz  %7.3f s\n", lops[i].name, lops[i].smoothing, lag,
+           lops[i].rate, lag / lops[i].rate);
+  }
+
+  // Pulse period at 72 BPM, 200 Hz.
+  struct { const char* name; float smoothing; } minMaxes[] = {
+    { "Heart signal MinMax",            0.1f },
+    { "Heart signal MinMax",            0.2f },
+    { "Heart signal MinMax",            0.05f },
+  };
+  for (size_t i = 0; i < sizeof(minMaxes) / sizeof(minMaxes[0]); i++) {
+    size_t settling = minMaxSettling(minMaxes[i].smoothing, 167);
+    printf("%-34s %8.3f %12zu  %4d Hz  %7.3f s\n", minMaxes[i].name, minMaxes[i].smoothing, settling,
+           200, settling / 200.0);
+  }
+
+  // Respiration's smoothers are parameterized in seconds.
+  RespirationConfig defaults;
+  printf("%-34s %7.2fs %12s  %4d Hz  %7.3f s (nominal)\n", "Respiration Smoother", defaults.smootherFactor,
+         "-", 50, defaults.smootherFactor);
+}
+
+int main() {
+  stageDelays();
+  printf("\n");
+  heartLatency();
+  respirationLatency();
+  return 0;
+}
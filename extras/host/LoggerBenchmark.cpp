@@ -0,0 +1,76 @@
+/*
+ * LoggerBenchmark.cpp
+ *
+ * Host benchmark for SampleLogger with the POSIX file backend. Logs raw
+ * samples of the three sensors (200 Hz heart, 50 Hz skin conductance and
+ * respiration), calling flush() after each sample as loop() would, and
+ * reports write throughput and the worst-case time spent in flush().
+ *
+ * Usage: LoggerBenchmark [file] [nSamples] [sync]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <chrono>
+
+#include "SampleLogger.h"
+#include "PosixStorage.h"
+
+int main(int argc, char** argv) {
+  const char* path = (argc > 1) ? argv[1] : "samples.bin";
+  unsigned long nSamples = (argc > 2) ? strtoul(argv[2], NULL, 10) : 10000000UL;
+  bool sync = (argc > 3) && atoi(argv[3]);
+
+  PosixStorage storage(sync);
+  if (!storage.open(path)) {
+    perror(path);
+    return 1;
+  }
+  SampleLogger logger(storage);
+
+  double maxFlushSeconds = 0;
+  double totalFlushSeconds = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (unsigned long i = 0; i < nSamples; i++) {
+    // Every 5 ms: one heart sample; every 20 ms: skin conductance and respiration.
+    uint32_t t = (i / 6) * 5000;
+    uint8_t k = i % 6;
+    uint8_t channel = (k < 4) ? 0 : (k == 4 ? 1 : 2);
+    logger.log(channel, (uint16_t)(i & 0x3FF), t);
+
+    std::chrono::steady_clock::time_point flushStart = std::chrono::steady_clock::now();
+    if (logger.flush()) {
+      if (sync) storage.flush();
+      double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - flushStart).count();
+      totalFlushSeconds += s;
+      if (s > maxFlushSeconds) maxFlushSeconds = s;
+    }
+  }
+  logger.close();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  double bytes = (double)nSamples * sizeof(SampleRecord);
+  printf("samples:         %lu (%.1f MB)\n", nSamples, bytes / 1e6);
+  printf("blocks written:  %lu of %u bytes\n", (unsigned long)logger.nBlocksWritten(), (unsigned)SAMPLE_LOGGER_BLOCK_SIZE);
+  printf("overruns:        %lu\n", (unsigned long)logger.nOverruns());
+  printf("write errors:    %lu\n", (unsigned long)logger.nWriteErrors());
+  printf("throughput:      %.1f MB/s (%.1f Msamples/s)\n", bytes / seconds / 1e6, nSamples / seconds / 1e6);
+  printf("flush:           %.2f us mean, %.2f us worst case\n",
+         1e6 * totalFlushSeconds / (logger.nBlocksWritten() ? logger.nBlocksWritten() : 1), 1e6 * maxFlushSeconds);
+  return logger.nWriteErrors() ? 1 : 0;
+}
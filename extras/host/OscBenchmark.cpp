@@ -0,0 +1,102 @@
+/*
+ * OscBenchmark.cpp
+ *
+ * Host benchmark for OscEncoder: fills a bundle with Heart, SkinConductance
+ * and Respiration features every frame, SLIP-encodes it, decodes it back
+ * with SlipDecoder and checks that the round trip is lossless. Reports
+ * frames per second and encoded throughput.
+ *
+ * Usage: OscBenchmark [nFrames]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <chrono>
+
+#include "Heart.h"
+#include "SkinConductance.h"
+#include "Respiration.h"
+#include "OscEncoder.h"
+
+// Reads back a big-endian float argument.
+static float readFloat(const uint8_t* p) {
+  uint32_t bits = ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+  float f;
+  memcpy(&f, &bits, 4);
+  return f;
+}
+
+int main(int argc, char** argv) {
+  unsigned long nFrames = (argc > 1) ? strtoul(argv[1], NULL, 10) : 1000000UL;
+
+  Heart heart(A1);
+  SkinConductance sc(A6);
+  Respiration resp(A0);
+
+  OscEncoder osc;
+  int heartMsg = osc.addHeart();
+  int scMsg = osc.addSkinConductance();
+  int respMsg = osc.addRespiration();
+  if (heartMsg < 0 || scMsg < 0 || respMsg < 0) {
+    fprintf(stderr, "Bundle template does not fit in OSC_ENCODER_MAX_SIZE\n");
+    return 1;
+  }
+
+  uint8_t frame[2 * OSC_ENCODER_MAX_SIZE + 2];
+  SlipDecoder slip;
+  unsigned long nErrors = 0;
+  unsigned long long nBytes = 0;
+  double encodeSeconds = 0;
+
+  for (unsigned long i = 0; i < nFrames; i++) {
+    // Synthetic 72 BPM pulse and slow skin conductance drift.
+    hostAdvanceMicros(5000);
+    hostSetAnalog(A1, 512 + (int)(300 * sin(i * 0.0377)));
+    hostSetAnalog(A6, 400 + (int)(50 * sin(i * 0.001)));
+    heart.sample();
+    sc.sample();
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    osc.setTimeTagMicros(micros());
+    osc.setHeart(heartMsg, heart);
+    osc.setSkinConductance(scMsg, sc);
+    osc.setRespiration(respMsg, resp);
+    size_t n = osc.encode(frame, sizeof(frame));
+    encodeSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    nBytes += n;
+
+    // Round trip.
+    bool complete = false;
+    for (size_t k = 0; k < n; k++)
+      complete = slip.decode(frame[k]) || complete;
+    if (!complete || slip.size() != osc.size() || memcmp(slip.data(), osc.data(), osc.size()) != 0) {
+      nErrors++;
+    } else {
+      // Heart BPM is the second argument of the first message.
+      float bpm = readFloat(slip.data() + 16 + 4 + 16 + 8 + 4);
+      if (bpm != heart.getBPM())
+        nErrors++;
+    }
+  }
+
+  printf("frames:          %lu\n", nFrames);
+  printf("bundle size:     %u bytes (%.1f bytes SLIP-framed)\n", (unsigned)osc.size(), (double)nBytes / nFrames);
+  printf("round-trip errs: %lu\n", nErrors);
+  printf("encode:          %.1f ns/frame, %.1f Mframes/s, %.1f MB/s\n",
+         1e9 * encodeSeconds / nFrames, nFrames / encodeSeconds / 1e6, nBytes / encodeSeconds / 1e6);
+  return nErrors ? 1 : 0;
+}
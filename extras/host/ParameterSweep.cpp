@@ -0,0 +1,242 @@
+/*
+ * ParameterSweep.cpp
+ *
+ * Scores a grid of Heart configurations (threshold bounds and signal min/max
+ * smoothing) against annotated beats in a single pass over a recording (see
+ * Sweep.h), and prints the best ones. Also checks a few lanes against Heart.
+ *
+ * Usage: ParameterSweep [samples.bin beats.txt [channel]]
+ *        ParameterSweep -r [samples.bin breaths.txt [channel]]
+ *
+ * samples.bin is a SampleLogger recording (channel 0 by default, 200 Hz for
+ * heart, 50 Hz for respiration); annotation files hold one event time in
+ * milliseconds per line. Without files, uses a synthetic recording.
+ * With -r, sweeps Respiration's breath detection parameters instead.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "Sweep.h"
+#include "Replay.h"
+
+// Tolerance when matching detections with annotations.
+#define BEAT_TOLERANCE     150   // ms
+#define BREATH_TOLERANCE  1000   // ms
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static bool loadAnnotations(const char* path, std::vector<unsigned long>& times) {
+  FILE* file = fopen(path, "r");
+  if (!file) return false;
+  unsigned long t;
+  while (fscanf(file, "%lu", &t) == 1)
+    times.push_back(t);
+  fclose(file);
+  std::sort(times.begin(), times.end());
+  return true;
+}
+
+// One hour of PPG with varying heart rate, baseline wander, noise and
+// motion artifacts. Beats are annotated at the systolic peak.
+static void makeHeartRecording(unsigned long rate, std::vector<uint16_t>& samples,
+                               std::vector<unsigned long>& beats) {
+  double phase = 0;
+  for (size_t i = 0; i < 3600 * rate; i++) {
+    double t = (double)i / rate;
+    double previous = phase;
+    phase += (1.2 + 0.3 * sin(t / 120.0)) / rate;
+    if (previous < 0.2 && phase >= 0.2)
+      beats.push_back((unsigned long)(t * 1000));
+    if (phase >= 1) phase -= 1;
+    double pulse = exp(-pow((phase - 0.2) / 0.06, 2)) + 0.45 * exp(-pow((phase - 0.45) / 0.08, 2));
+    double wander = 80 * sin(2 * M_PI * t / 4.0) + 60 * sin(t / 30.0);
+    double artifact = (fmod(t, 97.0) < 1.5) ? 250 * sin(2 * M_PI * t * 3) : 0;
+    samples.push_back((uint16_t)constrain(400 + 200 * pulse + wander + artifact + noise(20), 0, 1023));
+  }
+}
+
+// One hour of thermistor signal, breathing at 10 to 20 RPM. Breaths are
+// annotated at the start of exhales (temperature rising).
+static void makeRespirationRecording(unsigned long rate, std::vector<uint16_t>& samples,
+                                     std::vector<unsigned long>& breaths) {
+  double phase = 0;
+  for (size_t i = 0; i < 3600 * rate; i++) {
+    double t = (double)i / rate;
+    double previous = phase;
+    phase += (0.25 + 0.08 * sin(t / 200.0)) / rate;
+    if (previous < 0.5 && phase >= 0.5)
+      breaths.push_back((unsigned long)(t * 1000));
+    if (phase >= 1) phase -= 1;
+    samples.push_back((uint16_t)(13000 - 250 * cos(2 * M_PI * phase) + 100 * sin(t / 60.0) + noise(8)));
+  }
+}
+
+static int sweepHeart(const std::vector<uint16_t>& samples, const std::vector<unsigned long>& beats,
+                      unsigned long rate) {
+  std::vector<HeartConfig> configs(1); // defaults first
+  for (float lower = 0.05f; lower < 0.5f; lower += 0.05f)
+    for (float upper = lower + 0.1f; upper < 0.95f; upper += 0.1f)
+      for (float smoothing = 0.025f; smoothing < 1; smoothing *= 2) {
+        HeartConfig c;
+        c.thresholdLower = lower;
+        c.thresholdUpper = upper;
+        c.minMaxSmoothing = smoothing;
+        configs.push_back(c);
+      }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  hostSetMicros(0);
+  HeartSweep sweep(configs);
+  std::vector<EventScore> scores(configs.size(), EventScore(beats, BEAT_TOLERANCE));
+  for (size_t i = 0; i < samples.size(); i++) {
+    unsigned long ms = replayMillis(i, rate);
+    sweep.process(samples[i], ms);
+    for (size_t k = 0; k < sweep.size(); k++)
+      if (sweep.beatDetected(k))
+        scores[k].add(ms);
+  }
+  double elapsed = seconds(start);
+  printf("%zu configurations x %zu samples in %.2f s (%.0f configurations/minute, %.1f ns per sample per configuration)\n",
+         configs.size(), samples.size(), elapsed, configs.size() * 60 / elapsed,
+         1e9 * elapsed / (samples.size() * configs.size()));
+
+  // Best configurations by F1 score.
+  std::vector<size_t> order(configs.size());
+  for (size_t k = 0; k < order.size(); k++) order[k] = k;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return scores[a].f1() > scores[b].f1(); });
+  printf("%zu annotated beats\n  lower upper smoothing     F1  sensitivity precision\n", beats.size());
+  for (size_t r = 0; r < 10 && r < order.size(); r++) {
+    const HeartConfig& c = configs[order[r]];
+    const EventScore& s = scores[order[r]];
+    printf("  %5.2f %5.2f %9.3f  %.4f  %.4f      %.4f\n", c.thresholdLower, c.thresholdUpper,
+           c.minMaxSmoothing, s.f1(), s.sensitivity(), s.precision());
+  }
+  printf("  %5.2f %5.2f %9.3f  %.4f  %.4f      %.4f  (defaults)\n", configs[0].thresholdLower, configs[0].thresholdUpper,
+         configs[0].minMaxSmoothing, scores[0].f1(), scores[0].sensitivity(), scores[0].precision());
+
+  // Check some lanes against Heart.
+  size_t checked[3] = { 0, configs.size() / 2, order[0] };
+  int status = 0;
+  for (int j = 0; j < 3; j++) {
+    size_t k = checked[j];
+    hostSetMicros(0);
+    Heart heart(A1, rate);
+    applyHeartConfig(heart, configs[k]);
+    hostSetMicros(0);
+    heart.reset();
+    hostSetMicros(0);
+    HeartSweep lane(std::vector<HeartConfig>(1, configs[k]));
+    size_t nDifferences = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+      unsigned long ms = replayMillis(i, rate);
+      heart.process(samples[i], ms);
+      lane.process(samples[i], ms);
+      if (heart.beatDetected() != lane.beatDetected(0) || heart.getBPM() != lane.getBPM(0) ||
+          heart.getNormalized() != lane.getNormalized(0) || heart.amplitudeChange() != lane.amplitudeChange(0) ||
+          heart.bpmChange() != lane.bpmChange(0))
+        nDifferences++;
+    }
+    printf("lane %zu vs Heart: %s\n", k, nDifferences ? "DIFFERENT" : "identical");
+    if (nDifferences) status = 1;
+  }
+  return status;
+}
+
+static int sweepRespiration(const std::vector<uint16_t>& samples, const std::vector<unsigned long>& breaths,
+                            unsigned long rate) {
+  std::vector<RespirationConfig> configs(1); // defaults first
+  for (float threshold = 0.3f; threshold < 0.75f; threshold += 0.1f)
+    for (float reload = 0.1f; reload < 0.45f; reload += 0.1f)
+      for (float window = 5; window <= 40; window *= 2) {
+        RespirationConfig c;
+        c.peakThreshold = c.troughThreshold = threshold;
+        c.peakReloadThreshold = threshold - reload;
+        c.troughReloadThreshold = threshold + reload;
+        c.normalizerTimeWindow = c.scalerTimeWindow = window;
+        configs.push_back(c);
+      }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  hostSetMicros(0);
+  RespirationSweep sweep(configs);
+  std::vector<EventScore> scores(configs.size(), EventScore(breaths, BREATH_TOLERANCE));
+  for (size_t i = 0; i < samples.size(); i++) {
+    unsigned long ms = replayMillis(i, rate);
+    sweep.process(samples[i], ms);
+    for (size_t k = 0; k < sweep.size(); k++)
+      if (sweep.breathDetected(k))
+        scores[k].add(ms);
+  }
+  double elapsed = seconds(start);
+  printf("%zu configurations x %zu samples in %.2f s (%.0f configurations/minute)\n",
+         configs.size(), samples.size(), elapsed, configs.size() * 60 / elapsed);
+
+  std::vector<size_t> order(configs.size());
+  for (size_t k = 0; k < order.size(); k++) order[k] = k;
+  std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return scores[a].f1() > scores[b].f1(); });
+  printf("%zu annotated breaths\n  threshold reload window     F1  sensitivity precision\n", breaths.size());
+  for (size_t r = 0; r < 10 && r < order.size(); r++) {
+    const RespirationConfig& c = configs[order[r]];
+    const EventScore& s = scores[order[r]];
+    printf("  %9.2f %6.2f %6.0f  %.4f  %.4f      %.4f\n", c.peakThreshold,
+           c.peakThreshold - c.peakReloadThreshold, c.normalizerTimeWindow,
+           s.f1(), s.sensitivity(), s.precision());
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  bool respiration = (argc > 1 && strcmp(argv[1], "-r") == 0);
+  int first = respiration ? 2 : 1;
+  unsigned long rate = respiration ? 50 : 200;
+
+  std::vector<uint16_t> samples;
+  std::vector<unsigned long> events;
+  if (argc > first + 1) {
+    uint8_t channel = (argc > first + 2) ? atoi(argv[first + 2]) : 0;
+    if (!loadRecording(argv[first], channel, samples)) {
+      perror(argv[first]);
+      return 1;
+    }
+    if (!loadAnnotations(argv[first + 1], events)) {
+      perror(argv[first + 1]);
+      return 1;
+    }
+  } else if (respiration) {
+    makeRespirationRecording(rate, samples, events);
+  } else {
+    makeHeartRecording(rate, samples, events);
+  }
+
+  return respiration ? sweepRespiration(samples, events, rate) : sweepHeart(samples, events, rate);
+}
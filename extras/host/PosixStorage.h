@@ -0,0 +1,74 @@
+/*
+ * PosixStorage.h (host)
+ *
+ * LogStorage backend writing to a regular file through POSIX calls, to use
+ * SampleLogger (and benchmark it) on a desktop machine.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_POSIX_STORAGE_H_
+#define BIODATA_HOST_POSIX_STORAGE_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include "SampleLogger.h"
+
+class PosixStorage : public LogStorage {
+  int _fd;
+  bool _sync;
+
+public:
+  /// If #sync# is true, flush() waits until data has reached the disk (fsync).
+  PosixStorage(bool sync=false) : _fd(-1), _sync(sync) {}
+  ~PosixStorage() { close(); }
+
+  /// Creates (or truncates) the file. Returns false on error.
+  bool open(const char* path) {
+    close();
+    _fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    return (_fd >= 0);
+  }
+
+  void close() {
+    if (_fd >= 0) {
+      ::close(_fd);
+      _fd = -1;
+    }
+  }
+
+  size_t write(const uint8_t* data, size_t size) {
+    size_t n = 0;
+    while (_fd >= 0 && n < size) {
+      ssize_t w = ::write(_fd, data + n, size - n);
+      if (w < 0) {
+        if (errno == EINTR) continue;
+        break;
+      }
+      n += w;
+    }
+    return n;
+  }
+
+  bool flush() {
+    if (_fd < 0) return false;
+    return _sync ? (::fsync(_fd) == 0) : true;
+  }
+};
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * PulseMorphologyEval.cpp
+ *
+ * Evaluates PulseMorphology (shape of every beat) on synthetic PPG whose
+ * pulses have a known shape: an upstroke, a decay and a dicrotic wave, all
+ * drifting over time, with noise and some beats replaced by motion
+ * artifacts. Each beat is also measured noise free at 10 kHz for
+ * reference. Prints the error of every measurement, how well the template
+ * correlation tells artifacts apart, the cost per sample and per beat, and
+ * checks that the replay engine (Replay.h) gives the same measurements
+ * sequentially and on several threads from checkpoints.
+ *
+ * Usage: PulseMorphologyEval [minutes]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+#include "Replay.h"
+
+#define RATE 200
+
+// Beats during the first seconds (normalization settling) are not scored.
+#define WARMUP_SECONDS 30
+
+// One beat in this many is a motion artifact.
+#define ARTIFACT_EVERY 20
+
+// Rate of the noise-free reference.
+#define REFERENCE_RATE 10000
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+/// Shape of one pulse (times in seconds from its foot).
+struct Shape {
+  double rise;      // foot to peak
+  double decay;     // time constant after the peak
+  double notch;     // start of the dicrotic wave
+  double dicrotic;  // height of the dicrotic wave (fraction of the amplitude)
+  double period;    // to the next foot
+  bool artifact;
+};
+
+static double pulse(const Shape& s, double dt) {
+  if (dt < 0 || dt >= s.period) return 0;
+  if (s.artifact)  // a sharp spike and a slow swing
+    return 1.4 * exp(-pow((dt - 0.05) / 0.02, 2)) - 0.5 * sin(M_PI * dt / s.period);
+  double p = (dt < s.rise) ? 0.5 - 0.5 * cos(M_PI * dt / s.rise) : exp(-(dt - s.rise) / s.decay);
+  double d = dt - s.notch;
+  if (d > 0 && d < 0.2)
+    p += s.dicrotic * (0.5 - 0.5 * cos(2 * M_PI * d / 0.2));
+  // Back to the baseline at the next foot.
+  double tail = s.period - dt;
+  if (tail < 0.1)
+    p *= tail / 0.1;
+  return p;
+}
+
+/// Reference measurements of #s#, noise free and sampled at REFERENCE_RATE.
+static PulseMorphology::Beat reference(const Shape& s) {
+  std::vector<double> x;
+  for (double dt = 0; dt < s.period; dt += 1.0 / REFERENCE_RATE)
+    x.push_back(pulse(s, dt));
+  size_t peak = 0;
+  for (size_t i = 0; i < x.size() / 2; i++)
+    if (x[i] > x[peak]) peak = i;
+  double amplitude = x[peak] - x[0];
+
+  PulseMorphology::Beat b;
+  memset(&b, 0, sizeof(b));
+  b.amplitude = amplitude;
+  b.riseTime = 1000.0 * peak / REFERENCE_RATE;
+  size_t up = peak, down = peak;
+  while (up > 0 && x[up - 1] >= amplitude / 2) up--;
+  while (down + 1 < x.size() && x[down + 1] >= amplitude / 2) down++;
+  b.width = 1000.0 * (down - up) / REFERENCE_RATE;
+  size_t lowest = peak;
+  for (size_t i = peak + 1; i < x.size() * 3 / 4; i++) {
+    if (x[i] < x[lowest]) lowest = i;
+    else if (x[i] - x[lowest] >= 0.02 * amplitude) {
+      b.notchTime = 1000.0 * lowest / REFERENCE_RATE;
+      b.notchHeight = x[lowest] / amplitude;
+      break;
+    }
+  }
+  return b;
+}
+
+/**
+ * PPG at RATE Hz. Fills the shapes of the beats and the sample at which each
+ * one starts.
+ */
+static void makePpg(double duration, std::vector<uint16_t>& samples, std::vector<Shape>& shapes,
+                    std::vector<size_t>& starts) {
+  for (double t = 0.5; t < duration;) {
+    Shape s;
+    s.rise = 0.12 + 0.04 * sin(t / 70.0);
+    s.decay = 0.3 + 0.1 * sin(t / 50.0);
+    s.notch = 0.3 + 0.05 * sin(t / 90.0);
+    s.dicrotic = 0.22 + 0.08 * sin(t / 40.0);
+    s.period = 60 / (70 + 12 * sin(t / 30.0));
+    s.artifact = (shapes.size() % ARTIFACT_EVERY == ARTIFACT_EVERY - 1);
+    shapes.push_back(s);
+    starts.push_back((size_t)(t * RATE));
+    t += s.period;
+  }
+
+  size_t b = 0;
+  for (size_t i = 0; i < duration * RATE; i++) {
+    double t = (double)i / RATE;
+    while (b + 1 < starts.size() && starts[b + 1] <= i) b++;
+    double x = 400 + 250 * pulse(shapes[b], t - (double)starts[b] / RATE) + noise(3);
+    samples.push_back((uint16_t)constrain(x, 0, 1023));
+  }
+}
+
+/// Mean absolute error of a measurement.
+struct Error {
+  double sum;
+  size_t n;
+
+  Error() : sum(0), n(0) {}
+  void add(double e) { sum += fabs(e); n++; }
+  double mean() const { return n ? sum / n : NAN; }
+};
+
+int main(int argc, char** argv) {
+  double duration = 60 * ((argc > 1) ? atof(argv[1]) : 10);
+  if (duration <= WARMUP_SECONDS) {
+    fprintf(stderr, "usage: %s [minutes]\n", argv[0]);
+    return 1;
+  }
+
+  std::vector<uint16_t> samples;
+  std::vector<Shape> shapes;
+  std::vector<size_t> starts;
+  makePpg(duration, samples, shapes, starts);
+
+  // Heart alone.
+  hostSetMicros(0);
+  Heart heartAlone(A1, RATE);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < samples.size(); i++)
+    heartAlone.process(samples[i], replayMillis(i, RATE));
+  double heartSeconds = seconds(start);
+
+  // Heart and PulseMorphology.
+  hostSetMicros(0);
+  Heart heart(A1, RATE);
+  PulseMorphology morphology(RATE);
+  std::vector<size_t> measuredAt;
+  std::vector<PulseMorphology::Beat> beats;
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < samples.size(); i++) {
+    heart.process(samples[i], replayMillis(i, RATE));
+    if (morphology.process(heart)) {
+      measuredAt.push_back(i);
+      beats.push_back(morphology.getBeat());
+    }
+  }
+  double bothSeconds = seconds(start);
+
+  // Cost of the measurements alone, timed one by one.
+  hostSetMicros(0);
+  Heart timedHeart(A1, RATE);
+  PulseMorphology timed(RATE);
+  double beatSeconds = 0;
+  size_t nTimed = 0;
+  for (size_t i = 0; i < samples.size(); i++) {
+    timedHeart.process(samples[i], replayMillis(i, RATE));
+    std::chrono::steady_clock::time_point beatStart = std::chrono::steady_clock::now();
+    if (timed.process(timedHeart)) {
+      beatSeconds += seconds(beatStart);
+      nTimed++;
+    }
+  }
+
+  // Score every measured beat against the one it was taken from: the beat
+  // starting just before the detection preceding the measurement.
+  Error interval, rise, width, notch, notchHeight;
+  size_t nScored = 0, nNotches = 0, nArtifacts = 0, nArtifactsFlagged = 0, nClean = 0, nCleanFlagged = 0;
+  for (size_t k = 0; k < beats.size(); k++) {
+    size_t detection = measuredAt[k] - (size_t)(beats[k].interval * RATE / 1000 + 0.5);
+    size_t b = 0;
+    while (b + 1 < starts.size() && starts[b + 1] <= detection) b++;
+    if (detection < WARMUP_SECONDS * RATE)
+      continue;
+    const Shape& s = shapes[b];
+    bool flagged = beats[k].correlation < 0.5f;
+    if (s.artifact) {
+      nArtifacts++;
+      nArtifactsFlagged += flagged;
+      continue;
+    }
+    nClean++;
+    nCleanFlagged += flagged;
+    PulseMorphology::Beat r = reference(s);
+    nScored++;
+    interval.add(beats[k].interval - 1000.0 * s.period);
+    rise.add(beats[k].riseTime - r.riseTime);
+    width.add(beats[k].width - r.width);
+    if (r.notchTime > 0 && beats[k].notchTime > 0) {
+      nNotches++;
+      notch.add(beats[k].notchTime - r.notchTime);
+      notchHeight.add(beats[k].notchHeight - r.notchHeight);
+    }
+  }
+
+  // Replay engine: sequential with checkpoints, then in parallel from them.
+  std::vector<MorphologyFeatures> sequential(samples.size()), parallel(samples.size());
+  ReplayCheckpoints checkpoints;
+  checkpoints.interval = 60 * RATE;
+  replay<MorphologyChannel>(samples.data(), samples.size(), RATE, sequential.data(), &checkpoints);
+  bool restored = replayParallel<MorphologyChannel>(samples.data(), samples.size(), RATE, parallel.data(), 4,
+                                                    &checkpoints, 0);
+  size_t nDifferent = 0;
+  for (size_t i = 0; i < samples.size(); i++)
+    if (memcmp(&sequential[i].beat, &parallel[i].beat, sizeof(PulseMorphology::Beat)) != 0 ||
+        sequential[i].measured != parallel[i].measured)
+      nDifferent++;
+
+  printf("PulseMorphology on %.0f minutes of synthetic PPG (%d Hz), %zu beats measured\n", duration / 60, RATE,
+         beats.size());
+  printf("mean absolute error  interval %.1f ms  rise time %.1f ms  width %.1f ms\n", interval.mean(), rise.mean(),
+         width.mean());
+  printf("dicrotic notch       found in %.0f%% of the beats  time %.1f ms  height %.3f\n",
+         nScored ? 100.0 * nNotches / nScored : 0, notch.mean(), notchHeight.mean());
+  printf("template             %.0f%% of artifacts below 0.5 correlation, %.1f%% of clean beats\n",
+         nArtifacts ? 100.0 * nArtifactsFlagged / nArtifacts : 0, nClean ? 100.0 * nCleanFlagged / nClean : 0);
+  printf("cost                 Heart %.1f ns/sample  added %.1f ns/sample  %.0f ns/beat  (%d bytes)\n",
+         heartSeconds * 1e9 / samples.size(), (bothSeconds - heartSeconds) * 1e9 / samples.size(),
+         nTimed ? beatSeconds * 1e9 / nTimed : 0, (int)sizeof(PulseMorphology));
+  printf("replay               %zu checkpoints, %zu samples differ in parallel%s\n", checkpoints.snapshots.size(),
+         nDifferent, restored ? "" : " (checkpoint not restored)");
+
+  bool ok = restored && nDifferent == 0;
+  printf("%s\n", ok ? "PASSED" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/*
+ * PulseRespirationEval.cpp
+ *
+ * Evaluates PulseRespiration (respiration rate from the pulse) on synthetic
+ * PPG whose breathing is known: respiration rates from 6 to 28 rpm, with
+ * the heart rate (respiratory sinus arrhythmia), the pulse amplitude and the
+ * baseline modulated by the breath, alone or together. Prints, per case,
+ * the error of the estimated rate once settled, how often the two
+ * estimates agree, and the cost of PulseRespiration compared with Heart's.
+ *
+ * Usage: PulseRespirationEval [minutes]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "PulseRespiration.h"
+#include "Replay.h"
+
+#define RATE 200
+
+// Estimates during the first seconds (trends settling) are not scored.
+#define WARMUP_SECONDS 60
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+/// Breathing modulation of the synthetic PPG.
+struct Modulation {
+  const char* name;
+  float rsa;        // heart rate swing (bpm)
+  float amplitude;  // pulse amplitude swing (fraction)
+  float baseline;   // baseline swing (ADC units)
+};
+
+/**
+ * PPG at RATE Hz breathing at #rpm# (drifting by 10%) with #m#. Fills the
+ * true respiration rate at every sample.
+ */
+static void makePpg(double duration, float rpm, const Modulation& m, std::vector<uint16_t>& samples,
+                    std::vector<float>& trueRpm) {
+  double beatPhase = 0, breathPhase = 0, beatStart = 0;
+  for (size_t i = 0; i < duration * RATE; i++) {
+    double t = (double)i / RATE;
+    double breathRpm = rpm * (1 + 0.1 * sin(t / 50.0));
+    breathPhase += breathRpm / 60 / RATE;
+    double breath = sin(2 * M_PI * breathPhase);
+
+    double bpm = 68 + 6 * sin(t / 80.0) + m.rsa * breath;
+    if (i) beatPhase += bpm / 60 / RATE;
+    if (beatPhase >= 1) {
+      beatPhase -= 1;
+      beatStart = t - beatPhase * 60 / bpm;
+    }
+    double dt = t - beatStart;
+    double pulse = (dt < 0.12) ? 0.5 - 0.5 * cos(M_PI * dt / 0.12) : exp(-(dt - 0.12) / 0.25);
+    double amplitude = 250 * (1 + m.amplitude * sin(2 * M_PI * breathPhase - 0.5));
+    samples.push_back((uint16_t)constrain(400 + m.baseline * breath + amplitude * pulse + noise(6), 0, 1023));
+    trueRpm.push_back((float)breathRpm);
+  }
+}
+
+int main(int argc, char** argv) {
+  double duration = 60 * ((argc > 1) ? atof(argv[1]) : 10);
+  if (duration <= WARMUP_SECONDS) {
+    fprintf(stderr, "usage: %s [minutes]\n", argv[0]);
+    return 1;
+  }
+
+  const Modulation modulations[] = {
+    { "RSA",                 4, 0,    0 },
+    { "amplitude",           0, 0.15, 0 },
+    { "RSA+amplitude",       4, 0.15, 0 },
+    { "all, weak",           2, 0.08, 15 },
+    { "none",                0, 0,    0 },
+  };
+  const float rates[] = { 6, 10, 15, 20, 28 };
+
+  printf("PulseRespiration on %.0f minutes of synthetic PPG per case (%d Hz)\n", duration / 60, RATE);
+  printf("modulation       rpm  estimated  mean error  p90 error  reliable  Heart ns/sample  added ns/sample\n");
+  for (size_t m = 0; m < sizeof(modulations) / sizeof(modulations[0]); m++) {
+    for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+      std::vector<uint16_t> samples;
+      std::vector<float> trueRpm;
+      noiseState = 12345;
+      makePpg(duration, rates[r], modulations[m], samples, trueRpm);
+
+      // Heart alone.
+      hostSetMicros(0);
+      Heart reference(A1, RATE);
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < samples.size(); i++)
+        reference.process(samples[i], replayMillis(i, RATE));
+      double heartSeconds = seconds(start);
+
+      // Heart and PulseRespiration, scored at every beat.
+      hostSetMicros(0);
+      Heart heart(A1, RATE);
+      PulseRespiration respiration;
+      std::vector<float> errors;
+      size_t nBeats = 0, nEstimated = 0, nReliable = 0;
+      start = std::chrono::steady_clock::now();
+      for (size_t i = 0; i < samples.size(); i++) {
+        heart.process(samples[i], replayMillis(i, RATE));
+        if (respiration.process(heart) && i >= WARMUP_SECONDS * RATE) {
+          nBeats++;
+          if (respiration.getRpm() > 0) {
+            nEstimated++;
+            errors.push_back(fabs(respiration.getRpm() - trueRpm[i]));
+          }
+          if (respiration.isReliable())
+            nReliable++;
+        }
+      }
+      double bothSeconds = seconds(start);
+
+      std::sort(errors.begin(), errors.end());
+      double sum = 0;
+      for (size_t k = 0; k < errors.size(); k++)
+        sum += errors[k];
+      float mean = errors.empty() ? NAN : sum / errors.size();
+      float p90 = errors.empty() ? NAN : errors[(size_t)(0.9 * (errors.size() - 1))];
+      printf("%-15s %4.0f  %8.0f%%  %10.2f  %9.2f  %7.0f%%  %15.1f  %15.1f\n", modulations[m].name, rates[r],
+             nBeats ? 100.0 * nEstimated / nBeats : 0, mean, p90, nBeats ? 100.0 * nReliable / nBeats : 0,
+             heartSeconds * 1e9 / samples.size(), (bothSeconds - heartSeconds) * 1e9 / samples.size());
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,221 @@
+/*
+ * PulseTransitBenchmark.cpp
+ *
+ * Evaluates PulseTransit (pulse transit time between two Heart sensors) on
+ * synthetic PPG from two sites whose delay is known: a proximal pulse, and
+ * a distal one with a slower decay, its own noise and baseline, arriving 35
+ * to 85 ms later with some jitter from beat to beat. Both upstrokes have the
+ * same shape: a slower distal upstroke would add half the difference of
+ * their durations to the measured transit time. Prints, per sample
+ * rate, the error of the averaged and per-beat transit times, and the cost:
+ * per sample, per beat (the correlation), and that of recomputing the same
+ * correlation over a sliding window on every sample instead.
+ *
+ * Usage: PulseTransitBenchmark [minutes]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+#include "PulseTransit.h"
+#include "Replay.h"
+
+// Estimates during the first seconds (normalization settling) are not scored.
+#define WARMUP_SECONDS 30
+
+// Window of the per-sample sliding correlation used for comparison.
+#define NAIVE_WINDOW_SECONDS 2
+#define NAIVE_SECONDS 10
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// Pulse shape #dt# seconds after its onset: upstroke, then decay over #decay# seconds.
+static double pulse(double dt, double decay) {
+  if (dt < 0) return 0;
+  return (dt < 0.12) ? 0.5 - 0.5 * cos(M_PI * dt / 0.12) : exp(-(dt - 0.12) / decay);
+}
+
+// Transit time (ms) at time #t#, without the jitter.
+static double trueTransit(double t) {
+  return 60 + 25 * sin(t / 40.0);
+}
+
+/**
+ * PPG of both sites at #rate# Hz. Fills the transit time of the last distal
+ * beat at every sample.
+ */
+static void makePpg(double duration, unsigned long rate, std::vector<uint16_t>& proximal,
+                    std::vector<uint16_t>& distal, std::vector<float>& transit) {
+  // Beat onsets of both sites.
+  std::vector<double> onsets, arrivals;
+  for (double t = 0.5; t < duration; t += 60 / (68 + 8 * sin(t / 30.0))) {
+    onsets.push_back(t);
+    arrivals.push_back(t + (trueTransit(t) + noise(3)) / 1000);
+  }
+
+  size_t p = 0, d = 0;
+  for (size_t i = 0; i < duration * rate; i++) {
+    double t = (double)i / rate;
+    while (p + 1 < onsets.size() && onsets[p + 1] <= t) p++;
+    while (d + 1 < arrivals.size() && arrivals[d + 1] <= t) d++;
+    double a = 420 + 240 * pulse(t - onsets[p], 0.25) + noise(4);
+    double b = 380 + 20 * sin(t / 3.0) + 180 * pulse(t - arrivals[d], 0.35) + noise(6);
+    proximal.push_back((uint16_t)constrain(a, 0, 1023));
+    distal.push_back((uint16_t)constrain(b, 0, 1023));
+    transit.push_back((float)((arrivals[d] - onsets[d]) * 1000));
+  }
+}
+
+static void summarize(std::vector<float>& errors, float& mean, float& p90) {
+  std::sort(errors.begin(), errors.end());
+  double sum = 0;
+  for (size_t k = 0; k < errors.size(); k++)
+    sum += errors[k];
+  mean = errors.empty() ? NAN : sum / errors.size();
+  p90 = errors.empty() ? NAN : errors[(size_t)(0.9 * (errors.size() - 1))];
+}
+
+/**
+ * Peak of the correlation of both slope signals over the last #window#
+ * samples, for all lags: what PulseTransit would cost if recomputed on
+ * every sample. Returns the lag of the peak.
+ */
+static int naiveCorrelation(const std::vector<float>& x, const std::vector<float>& y, size_t i, size_t window,
+                            int maxLag) {
+  int best = 0;
+  double bestValue = -INFINITY;
+  for (int k = -maxLag; k <= maxLag; k++) {
+    double sumX = 0, sumY = 0, sumXX = 0, sumYY = 0, sumXY = 0;
+    for (size_t j = i + 1 - window; j <= i; j++) {
+      double a = x[j], b = y[j - k];
+      sumX += a; sumY += b; sumXX += a * a; sumYY += b * b; sumXY += a * b;
+    }
+    double n = window;
+    double r = (n * sumXY - sumX * sumY) / sqrt((n * sumXX - sumX * sumX) * (n * sumYY - sumY * sumY) + 1e-12);
+    if (r > bestValue) { bestValue = r; best = k; }
+  }
+  return best;
+}
+
+int main(int argc, char** argv) {
+  double duration = 60 * ((argc > 1) ? atof(argv[1]) : 10);
+  if (duration <= WARMUP_SECONDS + NAIVE_SECONDS) {
+    fprintf(stderr, "usage: %s [minutes]\n", argv[0]);
+    return 1;
+  }
+
+  const unsigned long rates[] = { 100, 200 };
+
+  printf("PulseTransit on %.0f minutes of synthetic two-site PPG (transit 35 to 85 ms)\n", duration / 60);
+  printf("rate  lags  averaged error (mean/p90 ms)  per-beat error  correlation  "
+         "2 Hearts ns/sample  added ns/sample  ns/beat  naive ns/sample\n");
+  for (size_t r = 0; r < sizeof(rates) / sizeof(rates[0]); r++) {
+    unsigned long rate = rates[r];
+    std::vector<uint16_t> proximal, distal;
+    std::vector<float> transit;
+    noiseState = 12345;
+    makePpg(duration, rate, proximal, distal, transit);
+
+    // Both Hearts alone.
+    hostSetMicros(0);
+    Heart referenceProximal(A1, rate), referenceDistal(A2, rate);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < proximal.size(); i++) {
+      referenceProximal.process(proximal[i], replayMillis(i, rate));
+      referenceDistal.process(distal[i], replayMillis(i, rate));
+    }
+    double heartSeconds = seconds(start);
+
+    // Both Hearts and PulseTransit, scored when the transit time is updated.
+    hostSetMicros(0);
+    Heart heartProximal(A1, rate), heartDistal(A2, rate);
+    PulseTransit pulseTransit(rate);
+    std::vector<float> averagedErrors, beatErrors;
+    std::vector<float> proximalSlopes, distalSlopes;
+    double sumCorrelation = 0;
+    size_t nBeats = 0;
+    float previousProximal = 0, previousDistal = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < proximal.size(); i++) {
+      heartProximal.process(proximal[i], replayMillis(i, rate));
+      heartDistal.process(distal[i], replayMillis(i, rate));
+      if (pulseTransit.process(heartProximal, heartDistal)) {
+        nBeats++;
+        if (i >= WARMUP_SECONDS * rate) {
+          averagedErrors.push_back(fabs(pulseTransit.getTransitTime() - trueTransit((double)i / rate)));
+          beatErrors.push_back(fabs(pulseTransit.getBeatTransitTime() - transit[i]));
+          sumCorrelation += pulseTransit.getCorrelation();
+        }
+      }
+      // Kept for the per-sample comparison below.
+      if (i < NAIVE_SECONDS * rate) {
+        proximalSlopes.push_back(heartProximal.getNormalized() - previousProximal);
+        distalSlopes.push_back(heartDistal.getNormalized() - previousDistal);
+        previousProximal = heartProximal.getNormalized();
+        previousDistal = heartDistal.getNormalized();
+      }
+    }
+    double bothSeconds = seconds(start);
+
+    // Cost of the updates on beats alone, timed one by one.
+    hostSetMicros(0);
+    Heart timedProximal(A1, rate), timedDistal(A2, rate);
+    PulseTransit timed(rate);
+    double beatSeconds = 0;
+    for (size_t i = 0; i < proximal.size(); i++) {
+      timedProximal.process(proximal[i], replayMillis(i, rate));
+      timedDistal.process(distal[i], replayMillis(i, rate));
+      std::chrono::steady_clock::time_point beatStart = std::chrono::steady_clock::now();
+      if (timed.process(timedProximal, timedDistal))
+        beatSeconds += seconds(beatStart);
+    }
+
+    // Same correlation recomputed over a sliding window on every sample.
+    int maxLag = std::min((int)(0.24 * rate + 0.5), PULSE_TRANSIT_MAX_LAG);
+    size_t window = NAIVE_WINDOW_SECONDS * rate;
+    int sink = 0;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = window + maxLag; i + maxLag < proximalSlopes.size(); i++)
+      sink += naiveCorrelation(distalSlopes, proximalSlopes, i, window, maxLag);
+    double naiveSeconds = seconds(start) / (proximalSlopes.size() - window - 2 * maxLag);
+
+    float averagedMean, averagedP90, beatMean, beatP90;
+    summarize(averagedErrors, averagedMean, averagedP90);
+    summarize(beatErrors, beatMean, beatP90);
+    printf("%4lu  %4d  %14.1f / %5.1f  %7.1f / %5.1f  %11.2f  %18.1f  %15.1f  %7.0f  %15.0f\n", rate,
+           2 * maxLag + 1, averagedMean, averagedP90, beatMean, beatP90,
+           averagedErrors.empty() ? 0 : sumCorrelation / averagedErrors.size(), heartSeconds * 1e9 / proximal.size(),
+           (bothSeconds - heartSeconds) * 1e9 / proximal.size(), nBeats ? beatSeconds * 1e9 / nBeats : 0,
+           naiveSeconds * 1e9 + (sink & 0));
+  }
+  printf("per beat: %d multiply-adds per lag (PULSE_TRANSIT_SEGMENT), in 32-bit integers\n", PULSE_TRANSIT_SEGMENT);
+  return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * PyramidBenchmark.cpp
+ *
+ * Builds the min/max/mean pyramid (Pyramid.h) of 8 hours of synthetic
+ * 200 Hz PPG and measures the cost of building it per sample, then compares
+ * plotting queries (1000 pixels, from the whole session down to a few
+ * seconds) on the pyramid against a scan of the raw samples, checking that
+ * min, max and mean agree. Also reports the output size of PyramidLogger for
+ * a few minimum levels.
+ *
+ * Usage: PyramidBenchmark
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "Pyramid.h"
+#include "PyramidStore.h"
+
+#define PIXELS 1000
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+// Counts what PyramidLogger would write.
+class CountingStorage : public LogStorage {
+public:
+  size_t nBytes;
+  CountingStorage() : nBytes(0) {}
+  size_t write(const uint8_t*, size_t size) { nBytes += size; return size; }
+  bool flush() { return true; }
+};
+
+// Bins of the raw samples, with the same pixel edges as PyramidStore::query().
+static void scan(const std::vector<float>& samples, uint64_t firstSample, uint64_t endSample, size_t pixels,
+                 uint8_t level, PyramidBin* out) {
+  double samplesPerPixel = (double)(endSample - firstSample) / pixels;
+  for (size_t p = 0; p < pixels; p++) {
+    uint64_t start = firstSample + (uint64_t)(p * samplesPerPixel);
+    uint64_t end = firstSample + (uint64_t)((p + 1) * samplesPerPixel);
+    uint64_t first = (start >> level) << level;
+    uint64_t last = (end > start) ? (((end - 1) >> level) + 1) << level : first + (1ULL << level);
+    if (last > samples.size())
+      last = samples.size();
+    double sum = 0;
+    out[p].min = out[p].max = samples[first];
+    for (uint64_t i = first; i < last; i++) {
+      if (samples[i] < out[p].min) out[p].min = samples[i];
+      if (samples[i] > out[p].max) out[p].max = samples[i];
+      sum += samples[i];
+    }
+    out[p].mean = sum / (last - first);
+  }
+}
+
+int main() {
+  const unsigned long rate = 200;
+
+  std::vector<float> samples;
+  double phase = 0;
+  for (size_t i = 0; i < 8UL * 3600 * rate; i++) {
+    double t = (double)i / rate;
+    phase = fmod(phase + (1.2 + 0.2 * sin(t / 600.0)) / rate, 1.0);
+    double pulse = exp(-pow((phase - 0.2) / 0.06, 2)) + 0.3 * exp(-pow((phase - 0.45) / 0.08, 2));
+    samples.push_back((float)(int)(350 + (250 + 50 * sin(t / 900.0)) * pulse + noise(3)));
+  }
+  size_t n = samples.size();
+
+  // Build.
+  PyramidStore store;
+  Pyramid pyramid(store);
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; i++)
+    pyramid.put(samples[i]);
+  pyramid.flush();
+  double build = seconds(start);
+  printf("%zu samples: pyramid built in %.3fs (%.1f ns/sample)\n", n, build, build * 1e9 / n);
+
+  // Output of the logger.
+  for (uint8_t minLevel = 1; minLevel <= 6; minLevel++) {
+    CountingStorage storage;
+    PyramidLogger logger(storage);
+    Pyramid logged(logger, 0, minLevel);
+    for (size_t i = 0; i < n; i++)
+      logged.put(samples[i]);
+    logged.flush();
+    logger.close();
+    printf("PyramidLogger, min level %u: %.2f bytes/sample\n", minLevel, (double)storage.nBytes / n);
+  }
+
+  // Queries.
+  double spans[] = { 8 * 3600, 3600, 600, 60, 10 };
+  std::vector<PyramidBin> fromPyramid(PIXELS), fromSamples(PIXELS);
+  bool ok = (store.nSamples(0) == n);
+  printf("%-10s %6s %14s %14s %10s\n", "span", "level", "pyramid", "scan", "max error");
+  for (size_t s = 0; s < sizeof(spans) / sizeof(spans[0]); s++) {
+    uint64_t span = (uint64_t)(spans[s] * rate);
+    uint64_t firstSample = (n - span) / 3;
+    uint64_t endSample = firstSample + span;
+
+    const int repeats = 100;
+    uint8_t level = 0;
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < repeats; r++)
+      level = store.query(0, firstSample, endSample, PIXELS, fromPyramid.data());
+    double pyramidTime = seconds(start) / repeats;
+
+    start = std::chrono::steady_clock::now();
+    scan(samples, firstSample, endSample, PIXELS, level, fromSamples.data());
+    double scanTime = seconds(start);
+
+    double maxError = 0;
+    for (size_t p = 0; p < PIXELS; p++) {
+      ok = ok && fromPyramid[p].min == fromSamples[p].min && fromPyramid[p].max == fromSamples[p].max;
+      double error = fabs(fromPyramid[p].mean - fromSamples[p].mean);
+      if (error > maxError)
+        maxError = error;
+    }
+    ok = ok && maxError < 1e-2;
+    printf("%8.0fs %6u %12.1fus %12.1fus %10.2g\n", spans[s], level, pyramidTime * 1e6, scanTime * 1e6, maxError);
+  }
+  printf("min/max: %s\n", ok ? "identical" : "MISMATCH");
+  return ok ? 0 : 1;
+}
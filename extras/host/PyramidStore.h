@@ -0,0 +1,144 @@
+/*
+ * PyramidStore.h (host)
+ *
+ * Keeps the bins of one or more Pyramids (see src/Pyramid.h) in memory, as
+ * they are produced by a replay or as read back from a PyramidLogger file,
+ * and answers plotting queries: min, max and mean of each pixel column of a
+ * time range. A query reads at most a few bins per pixel, from the coarsest
+ * level finer than one pixel, so its cost depends on the number of pixels
+ * and not on the length of the range.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_PYRAMID_STORE_H_
+#define BIODATA_HOST_PYRAMID_STORE_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <vector>
+
+#include "Pyramid.h"
+
+class PyramidStore : public PyramidSink {
+  struct StoredBin {
+    PyramidBin bin;
+    uint32_t nSamples;
+  };
+  // Bins of each channel and level, indexed by bin index.
+  std::vector<std::vector<std::vector<StoredBin> > > _levels;
+
+  std::vector<StoredBin>& level(uint8_t channel, uint8_t level) {
+    if (channel >= _levels.size())
+      _levels.resize(channel + 1, std::vector<std::vector<StoredBin> >(PYRAMID_MAX_LEVEL + 1));
+    return _levels[channel][level];
+  }
+
+public:
+  void write(uint8_t channel, uint8_t lvl, uint32_t index, const PyramidBin& bin, uint32_t nSamples) {
+    if (lvl > PYRAMID_MAX_LEVEL)
+      return;
+    std::vector<StoredBin>& bins = level(channel, lvl);
+    if (index >= bins.size())
+      bins.resize(index + 1);
+    bins[index].bin = bin;
+    bins[index].nSamples = nSamples;
+  }
+
+  /// Reads a file written by PyramidLogger. Returns false if it cannot be read.
+  bool load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (!file)
+      return false;
+    PyramidRecord record;
+    while (fread(&record, sizeof(record), 1, file) == 1) {
+      PyramidBin bin = { record.min, record.max, record.mean };
+      write(record.channel, record.level, record.index, bin, record.nSamples);
+    }
+    fclose(file);
+    return true;
+  }
+
+  /// Number of bins of #lvl# stored for #channel#.
+  size_t nBins(uint8_t channel, uint8_t lvl) const {
+    return (channel < _levels.size() && lvl <= PYRAMID_MAX_LEVEL) ? _levels[channel][lvl].size() : 0;
+  }
+
+  /// Number of samples covered by the bins of #channel#.
+  uint64_t nSamples(uint8_t channel) const {
+    for (int k = 1; k <= PYRAMID_MAX_LEVEL; k++) {
+      size_t n = nBins(channel, k);
+      if (n > 0)
+        return ((uint64_t)(n - 1) << k) + _levels[channel][k][n - 1].nSamples;
+    }
+    return 0;
+  }
+
+  /**
+   * Fills #out# with one bin per pixel for samples [firstSample, endSample)
+   * of #channel# split into #pixels# columns. Returns the level used (0 if
+   * nothing is stored). Pixel edges are rounded to bins of that level, so
+   * min and max are exact when pixels cover a multiple of 2^level samples;
+   * when zoomed in below the finest level stored, neighbouring pixels share
+   * bins.
+   */
+  uint8_t query(uint8_t channel, uint64_t firstSample, uint64_t endSample, size_t pixels, PyramidBin* out) const {
+    if (pixels == 0 || endSample <= firstSample)
+      return 0;
+    double samplesPerPixel = (double)(endSample - firstSample) / pixels;
+
+    // Coarsest level with bins no larger than a pixel, or else the finest one.
+    uint8_t lvl = 0;
+    for (int k = PYRAMID_MAX_LEVEL; k >= 1; k--) {
+      if (nBins(channel, k) == 0)
+        continue;
+      if (lvl == 0 || (double)(1UL << k) <= samplesPerPixel)
+        lvl = k;
+      if ((double)(1UL << k) <= samplesPerPixel)
+        break;
+    }
+    if (lvl == 0)
+      return 0;
+
+    const std::vector<StoredBin>& bins = _levels[channel][lvl];
+    for (size_t p = 0; p < pixels; p++) {
+      uint64_t start = firstSample + (uint64_t)(p * samplesPerPixel);
+      uint64_t end = firstSample + (uint64_t)((p + 1) * samplesPerPixel);
+      uint64_t first = start >> lvl;
+      uint64_t last = (end > start) ? (end - 1) >> lvl : first;
+      if (last >= bins.size())
+        last = bins.size() - 1;
+
+      PyramidBin& bin = out[p];
+      double sum = 0;
+      uint64_t n = 0;
+      for (uint64_t i = first; i <= last && i < bins.size(); i++) {
+        const StoredBin& b = bins[i];
+        if (n == 0 || b.bin.min < bin.min) bin.min = b.bin.min;
+        if (n == 0 || b.bin.max > bin.max) bin.max = b.bin.max;
+        sum += (double)b.bin.mean * b.nSamples;
+        n += b.nSamples;
+      }
+      if (n == 0)
+        bin.min = bin.max = bin.mean = NAN;
+      else
+        bin.mean = sum / n;
+    }
+    return lvl;
+  }
+};
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * Replay.h (host)
+ *
+ * Replays recorded raw samples through BioData sensors. A recording can be
+ * processed sequentially, or split into chunks processed on several threads.
+ *
+ * Each sample depends on all the previous ones, so a chunk has to start from
+ * the state the sensor would have had at that point:
+ *  - with checkpoints (snapshots saved during a previous sequential pass,
+ *    see Snapshot.h), every chunk starts from the exact state and the output
+ *    is identical to sequential processing;
+ *  - otherwise, every chunk starts from a fresh sensor warmed up on the
+ *    #overlap# samples preceding the chunk. Fast stages (signal min/max,
+ *    threshold) converge within a few seconds but slow stages (Heart's
+ *    amplitude and bpm baselines, adapting at 0.001^2 per sample) do not:
+ *    amplitudeChange() and bpmChange() only match approximately.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_REPLAY_H_
+#define BIODATA_HOST_REPLAY_H_
+
+#include <stdio.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+
+#include "Heart.h"
+#include "SkinConductance.h"
+#include "Respiration.h"
+#include "PulseMorphology.h"
+#include "SampleLogger.h"
+#include "Snapshot.h"
+
+/// Time (in milliseconds) of sample #i# of a recording sampled at #rate# Hz.
+inline unsigned long replayMillis(size_t i, unsigned long rate) {
+  return (unsigned long)((uint64_t)i * 1000 / rate);
+}
+
+/**
+ * Channels tell the replay engine how to drive a sensor and which features
+ * to collect after every sample.
+ */
+struct HeartFeatures {
+  float normalized;
+  float bpm;
+  float bpmChange;
+  float amplitudeChange;
+  float interval;
+  float amplitude;
+  bool beat;
+};
+
+struct HeartChannel {
+  typedef Heart Sensor;
+  typedef HeartFeatures Features;
+
+  static Sensor* create(unsigned long rate) { return new Heart(A1, rate); }
+
+  static void process(Sensor& heart, uint16_t raw, size_t i, unsigned long rate) {
+    heart.process(raw, replayMillis(i, rate));
+  }
+
+  static Features features(const Sensor& heart) {
+    Features f;
+    f.normalized = heart.getNormalized();
+    f.bpm = heart.getBPM();
+    f.bpmChange = heart.bpmChange();
+    f.amplitudeChange = heart.amplitudeChange();
+    f.interval = heart.getInterval();
+    f.amplitude = heart.getAmplitude();
+    f.beat = heart.beatDetected();
+    return f;
+  }
+};
+
+struct SkinConductanceFeatures {
+  float scr;
+  float scl;
+};
+
+struct SkinConductanceChannel {
+  typedef SkinConductance Sensor;
+  typedef SkinConductanceFeatures Features;
+
+  static Sensor* create(unsigned long rate) { return new SkinConductance(A6, rate); }
+
+  static void process(Sensor& sc, uint16_t raw, size_t, unsigned long) {
+    sc.process(raw);
+  }
+
+  static Features features(const Sensor& sc) {
+    Features f;
+    f.scr = sc.getSCR();
+    f.scl = sc.getSCL();
+    return f;
+  }
+};
+
+struct RespirationFeatures {
+  float rpm;
+  float rpmChange;
+  float amplitude;
+  float amplitudeChange;
+  bool exhaling;
+  float temperature;
+  float normalized;
+  float scaled;
+  float normalizedAmplitude;
+  float amplitudeDelta;
+  float amplitudeVariability;
+  float interval;
+  float normalizedRpm;
+  float rpmDelta;
+  float rpmVariability;
+};
+
+struct RespirationChannel {
+  typedef Respiration Sensor;
+  typedef RespirationFeatures Features;
+
+  static Sensor* create(unsigned long rate) { return new Respiration(0, rate); }
+
+  static void process(Sensor& resp, uint16_t raw, size_t i, unsigned long rate) {
+    resp.process(raw, replayMillis(i, rate));
+  }
+
+  static Features features(const Sensor& resp) {
+    Features f;
+    f.rpm = resp.getRpm();
+    f.rpmChange = resp.getRpmChange();
+    f.amplitude = resp.getTemperatureAmplitude();
+    f.amplitudeChange = resp.getAmplitudeChange();
+    f.exhaling = resp.isExhaling();
+    f.temperature = resp.getTemperature();
+    f.normalized = resp.getNormalized();
+    f.scaled = resp.getScaled();
+    f.normalizedAmplitude = resp.getNormalizedAmplitude();
+    f.amplitudeDelta = resp.getTemperatureAmplitudeDelta();
+    f.amplitudeVariability = resp.getAmplitudeVariability();
+    f.interval = resp.getInterval();
+    f.normalizedRpm = resp.getNormalizedRpm();
+    f.rpmDelta = resp.getRpmDelta();
+    f.rpmVariability = resp.getRpmVariability();
+    return f;
+  }
+};
+
+/// Heart and the shape of its beats, replayed and saved together.
+struct HeartMorphology {
+  Heart heart;
+  PulseMorphology morphology;
+
+  HeartMorphology(unsigned long rate) : heart(A1, rate), morphology(rate) {}
+
+  void save(SnapshotWriter& out) const {
+    heart.save(out);
+    morphology.save(out);
+  }
+
+  void load(SnapshotReader& in) {
+    heart.load(in);
+    morphology.load(in);
+  }
+};
+
+/// Measurements of the last beat; #measured# on the samples where it was measured.
+struct MorphologyFeatures {
+  PulseMorphology::Beat beat;
+  bool measured;
+};
+
+struct MorphologyChannel {
+  typedef HeartMorphology Sensor;
+  typedef MorphologyFeatures Features;
+
+  static Sensor* create(unsigned long rate) { return new HeartMorphology(rate); }
+
+  static void process(Sensor& s, uint16_t raw, size_t i, unsigned long rate) {
+    s.heart.process(raw, replayMillis(i, rate));
+    s.morphology.process(s.heart);
+  }
+
+  static Features features(const Sensor& s) {
+    Features f;
+    f.beat = s.morphology.getBeat();
+    f.measured = s.morphology.beatMeasured();
+    return f;
+  }
+};
+
+/// Sensor states saved every #interval# samples during a sequential replay.
+struct ReplayCheckpoints {
+  size_t interval;
+  // snapshots[k]: state after processing (k+1) * interval samples.
+  std::vector<std::vector<uint8_t> > snapshots;
+
+  ReplayCheckpoints() : interval(0) {}
+};
+
+/**
+ * Batch path: processes #n# consecutive samples (numbered from #firstIndex#)
+ * with #sensor#, writing features of every sample to #out#.
+ */
+template <class Channel>
+void processBlock(typename Channel::Sensor& sensor, const uint16_t* samples, size_t n, size_t firstIndex,
+                  unsigned long rate, typename Channel::Features* out) {
+  for (size_t i = 0; i < n; i++) {
+    Channel::process(sensor, samples[i], firstIndex + i, rate);
+    out[i] = Channel::features(sensor);
+  }
+}
+
+/**
+ * Processes #n# samples sequentially, writing features of every sample to
+ * #out#. If #checkpoints# is not NULL and its interval is set, also saves the
+ * sensor state every checkpoints->interval samples.
+ */
+template <class Channel>
+void replay(const uint16_t* samples, size_t n, unsigned long rate,
+            typename Channel::Features* out, ReplayCheckpoints* checkpoints=NULL) {
+  hostSetMicros(0); // sensors start their chronometers at the beginning of the recording
+  typename Channel::Sensor* sensor = Channel::create(rate);
+  std::vector<uint8_t> buffer;
+  if (checkpoints) {
+    checkpoints->snapshots.clear();
+    buffer.resize(snapshotSize(*sensor));
+  }
+
+  size_t interval = (checkpoints && checkpoints->interval) ? checkpoints->interval : 0;
+  for (size_t i = 0; i < n; i += (interval ? interval : n)) {
+    size_t end = (interval && i + interval < n) ? i + interval : n;
+    processBlock<Channel>(*sensor, samples + i, end - i, i, rate, out + i);
+
+    if (interval && end % interval == 0) {
+      saveSnapshot(*sensor, buffer.data(), buffer.size());
+      checkpoints->snapshots.push_back(buffer);
+    }
+  }
+  delete sensor;
+}
+
+/**
+ * Processes #n# samples on #nThreads# threads, writing features of every
+ * sample to #out#. Uses #checkpoints# if not NULL; otherwise warms up every
+ * chunk on the #overlap# preceding samples. Returns false if a checkpoint
+ * could not be restored.
+ */
+template <class Channel>
+bool replayParallel(const uint16_t* samples, size_t n, unsigned long rate,
+                    typename Channel::Features* out, unsigned int nThreads,
+                    const ReplayCheckpoints* checkpoints, size_t overlap) {
+  if (nThreads < 1) nThreads = 1;
+  if (n == 0) return true;
+
+  // Chunks start on checkpoint boundaries when there are checkpoints.
+  size_t chunkSize = (n + nThreads - 1) / nThreads;
+  if (checkpoints && checkpoints->interval)
+    chunkSize = ((chunkSize + checkpoints->interval - 1) / checkpoints->interval) * checkpoints->interval;
+  size_t nChunks = (n + chunkSize - 1) / chunkSize;
+
+  // Sensors are created up front, on the calling thread's clock.
+  std::vector<typename Channel::Sensor*> sensors(nChunks);
+  for (size_t c = 0; c < nChunks; c++) {
+    hostSetMicros(0);
+    sensors[c] = Channel::create(rate);
+  }
+
+  std::atomic<size_t> nextChunk(0);
+  std::atomic<bool> ok(true);
+
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < nThreads; t++) {
+    threads.push_back(std::thread([&]() {
+      size_t c;
+      while ((c = nextChunk++) < nChunks) {
+        typename Channel::Sensor& sensor = *sensors[c];
+        size_t start = c * chunkSize;
+        size_t end = (start + chunkSize < n) ? start + chunkSize : n;
+
+        if (start > 0) {
+          if (checkpoints && checkpoints->interval) {
+            size_t k = start / checkpoints->interval - 1;
+            if (k >= checkpoints->snapshots.size() ||
+                !loadSnapshot(sensor, checkpoints->snapshots[k].data(), checkpoints->snapshots[k].size()))
+              ok = false;
+          } else {
+            size_t warmup = (start > overlap) ? start - overlap : 0;
+            for (size_t i = warmup; i < start; i++)
+              Channel::process(sensor, samples[i], i, rate);
+          }
+        }
+
+        processBlock<Channel>(sensor, samples + start, end - start, start, rate, out + start);
+      }
+    }));
+  }
+  for (size_t t = 0; t < threads.size(); t++)
+    threads[t].join();
+
+  for (size_t c = 0; c < nChunks; c++)
+    delete sensors[c];
+  return ok;
+}
+
+/**
+ * Reads the samples of one channel from a file written by SampleLogger.
+ * Returns false if the file cannot be read.
+ */
+inline bool loadRecording(const char* path, uint8_t channel, std::vector<uint16_t>& samples) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  SampleRecord records[512];
+  size_t n;
+  while ((n = fread(records, sizeof(SampleRecord), 512, file)) > 0) {
+    for (size_t i = 0; i < n; i++)
+      if (records[i].channel == channel)
+        samples.push_back(records[i].value);
+  }
+  fclose(file);
+  return true;
+}
+
+#endif
@@ -0,0 +1,155 @@
+/*
+ * ReplayBenchmark.cpp
+ *
+ * Host benchmark for Replay.h. Processes a long heart recording (8 hours of
+ * synthetic 200 Hz PPG, or channel 0 of a SampleLogger recording) through
+ * Heart sequentially, then in parallel from checkpoints and from overlapping
+ * warm-ups, and compares the outputs of every sample.
+ *
+ * Usage: ReplayBenchmark [samples.bin [channel]]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "Replay.h"
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic noise generator.
+static uint32_t noiseState = 12345;
+static int noise(int amplitude) {
+  noiseState = noiseState * 1664525UL + 1013904223UL;
+  return (int)((noiseState >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+static float maxError(float a, float b, float error) {
+  float e = fabs(a - b);
+  return (e > error) ? e : error;
+}
+
+/**
+ * Compares #out# to #reference# and prints the maximum error of every
+ * feature. Beats count as matched if they are within #beatTolerance#
+ * samples. Returns true if outputs are identical.
+ */
+static bool compare(const char* name, const std::vector<HeartFeatures>& reference,
+                    const std::vector<HeartFeatures>& out, size_t beatTolerance, double elapsed) {
+  float normalized = 0, bpm = 0, bpmChange = 0, amplitudeChange = 0;
+  size_t nBeats = 0, nMatched = 0, nExtra = 0;
+  bool identical = true;
+
+  for (size_t i = 0; i < reference.size(); i++) {
+    const HeartFeatures& r = reference[i];
+    const HeartFeatures& o = out[i];
+    normalized = maxError(r.normalized, o.normalized, normalized);
+    bpm = maxError(r.bpm, o.bpm, bpm);
+    bpmChange = maxError(r.bpmChange, o.bpmChange, bpmChange);
+    amplitudeChange = maxError(r.amplitudeChange, o.amplitudeChange, amplitudeChange);
+    if (r.normalized != o.normalized || r.bpm != o.bpm || r.bpmChange != o.bpmChange ||
+        r.amplitudeChange != o.amplitudeChange || r.beat != o.beat)
+      identical = false;
+
+    size_t from = (i > beatTolerance) ? i - beatTolerance : 0;
+    size_t to = (i + beatTolerance < reference.size()) ? i + beatTolerance : reference.size() - 1;
+    if (r.beat) {
+      nBeats++;
+      for (size_t j = from; j <= to; j++)
+        if (out[j].beat) { nMatched++; break; }
+    }
+    if (o.beat) {
+      bool found = false;
+      for (size_t j = from; j <= to && !found; j++)
+        found = reference[j].beat;
+      if (!found) nExtra++;
+    }
+  }
+
+  printf("%-28s %7.3f s  max error: normalized %.2e bpm %.2e bpmChange %.2e amplitudeChange %.2e"
+         "  beats %zu/%zu matched, %zu extra  %s\n",
+         name, elapsed, normalized, bpm, bpmChange, amplitudeChange,
+         nMatched, nBeats, nExtra, identical ? "identical" : "approximate");
+  return identical;
+}
+
+int main(int argc, char** argv) {
+  const unsigned long rate = 200;
+  std::vector<uint16_t> samples;
+
+  if (argc > 1) {
+    uint8_t channel = (argc > 2) ? atoi(argv[2]) : 0;
+    if (!loadRecording(argv[1], channel, samples)) {
+      perror(argv[1]);
+      return 1;
+    }
+  } else {
+    // 8 hours of PPG, heart rate slowly varying between 60 and 84 BPM.
+    double phase = 0;
+    for (size_t i = 0; i < 8UL * 3600 * rate; i++) {
+      double t = (double)i / rate;
+      phase = fmod(phase + (1.2 + 0.2 * sin(t / 600.0)) / rate, 1.0);
+      double pulse = exp(-pow((phase - 0.2) / 0.06, 2)) + 0.3 * exp(-pow((phase - 0.45) / 0.08, 2));
+      samples.push_back((uint16_t)(350 + (250 + 50 * sin(t / 900.0)) * pulse + noise(3)));
+    }
+  }
+  size_t n = samples.size();
+  printf("%zu samples (%.1f hours at %lu Hz)\n", n, n / (3600.0 * rate), rate);
+
+  // Sequential reference, saving checkpoints every minute.
+  std::vector<HeartFeatures> reference(n);
+  ReplayCheckpoints checkpoints;
+  checkpoints.interval = 60 * rate;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  replay<HeartChannel>(samples.data(), n, rate, reference.data(), &checkpoints);
+  double sequential = seconds(start);
+  printf("%-28s %7.3f s  (%zu checkpoints)\n", "sequential", sequential, checkpoints.snapshots.size());
+
+  unsigned int maxThreads = std::thread::hardware_concurrency();
+  if (maxThreads < 1) maxThreads = 1;
+
+  bool ok = true;
+  std::vector<HeartFeatures> out(n);
+  for (unsigned int nThreads = 1; nThreads <= maxThreads; nThreads *= 2) {
+    char name[64];
+
+    start = std::chrono::steady_clock::now();
+    if (!replayParallel<HeartChannel>(samples.data(), n, rate, out.data(), nThreads, &checkpoints, 0)) {
+      printf("failed to restore checkpoints\n");
+      return 1;
+    }
+    double elapsed = seconds(start);
+    snprintf(name, sizeof(name), "checkpoints, %u threads", nThreads);
+    ok = compare(name, reference, out, 0, elapsed) && ok;
+    printf("%-28s speedup %.2fx\n", "", sequential / elapsed);
+
+    // Overlap of 5 minutes: beat detection converges, slow baselines do not.
+    start = std::chrono::steady_clock::now();
+    replayParallel<HeartChannel>(samples.data(), n, rate, out.data(), nThreads, NULL, 300 * rate);
+    elapsed = seconds(start);
+    snprintf(name, sizeof(name), "overlap 5 min, %u threads", nThreads);
+    compare(name, reference, out, 2, elapsed);
+  }
+
+  // Outputs from checkpoints must be identical; overlap is approximate by design.
+  return ok ? 0 : 1;
+}
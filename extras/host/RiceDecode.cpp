@@ -0,0 +1,62 @@
+/*
+ * RiceDecode.cpp
+ *
+ * Host decoder for compressed sample streams as sent by the Compression
+ * example: a sequence of RiceEncoder blocks, each preceded by one channel
+ * byte. Reads the stream from a file (or stdin) and prints one
+ * "channel,value" line per sample.
+ *
+ * Usage: RiceDecode [stream.bin]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <vector>
+
+#include "RiceCodec.h"
+
+int main(int argc, char** argv) {
+  FILE* file = (argc > 1) ? fopen(argv[1], "rb") : stdin;
+  if (!file) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  std::vector<uint8_t> stream;
+  uint8_t buffer[65536];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0)
+    stream.insert(stream.end(), buffer, buffer + n);
+  if (file != stdin)
+    fclose(file);
+
+  uint16_t samples[RICE_CODEC_BLOCK_SAMPLES];
+  size_t pos = 0;
+  while (pos + 1 < stream.size()) {
+    uint8_t channel = stream[pos++];
+    size_t consumed;
+    size_t nSamples = RiceDecoder::decode(&stream[pos], stream.size() - pos, samples, &consumed);
+    if (!nSamples) {
+      fprintf(stderr, "Malformed block at byte %zu\n", pos - 1);
+      return 1;
+    }
+    for (size_t i = 0; i < nSamples; i++)
+      printf("%u,%u\n", channel, samples[i]);
+    pos += consumed;
+  }
+  return 0;
+}
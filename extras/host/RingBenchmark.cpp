@@ -0,0 +1,162 @@
+/*
+ * RingBenchmark.cpp
+ *
+ * Publishes frames to a FrameRing as fast as possible while consumer
+ * processes read them: fast readers (in place, with peek() and release())
+ * that check every frame, and one slow reader that falls behind on purpose
+ * to show overrun detection. Reports the cost of publishing and reading a
+ * frame, and what every reader got and lost.
+ *
+ * Usage: RingBenchmark [frames] [readers]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <vector>
+
+#include "FrameRing.h"
+
+#define RING_NAME     "/biodata-benchmark"
+#define RING_CAPACITY 4096
+#define END_DEVICE    0xFFFF
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Reads and checks frames until the end marker, and prints what was read and lost.
+static int reader(int id, bool slow, int ready) {
+  FrameRingReader ring;
+  if (!ring.open(RING_NAME))
+    return 1;
+  char c = 'r';
+  if (write(ready, &c, 1) != 1)
+    return 1;
+  close(ready);
+
+  unsigned long long nRead = 0, nBad = 0;
+  uint64_t expected = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  double busy = 0;
+  for (;;) {
+    std::chrono::steady_clock::time_point t = std::chrono::steady_clock::now();
+    const RingFrame* frame = ring.peek();
+    if (!frame) {
+      sched_yield();
+      continue;
+    }
+    // Frame number in the timetag, and a checksum of the values.
+    uint16_t device = frame->device;
+    int64_t number = frame->deviceMicros;
+    bool ok = (frame->values[0] == (float)(number & 0xFFFF) && frame->values[31] == (float)device);
+    if (!ring.release())
+      continue;  // overwritten while reading: skipped by the reader
+    busy += seconds(t);
+    if (device == END_DEVICE)
+      break;
+    if (!ok || (uint64_t)number < expected)
+      nBad++;
+    expected = number + 1;
+    nRead++;
+
+    if (slow && nRead % 1000 == 0)
+      usleep(2000);
+  }
+  printf("reader %d%s: %llu frames read, %llu lost in %llu overruns, %llu bad, %.1f ns/frame read, %.3f s\n",
+         id, slow ? " (slow)" : "", nRead, (unsigned long long)ring.nLost(),
+         (unsigned long long)ring.nOverruns(), nBad, busy * 1e9 / (nRead ? nRead : 1), seconds(start));
+  fflush(stdout);
+  return nBad ? 1 : 0;
+}
+
+int main(int argc, char** argv) {
+  unsigned long nFrames = (argc > 1) ? strtoul(argv[1], NULL, 10) : 2000000UL;
+  int nReaders = (argc > 2) ? atoi(argv[2]) : 3;
+
+  FrameRingWriter ring;
+  if (!ring.create(RING_NAME, RING_CAPACITY)) {
+    perror(RING_NAME);
+    return 1;
+  }
+
+  // Readers open the ring before the first frame is published.
+  int ready[2];
+  if (pipe(ready) != 0)
+    return 1;
+  std::vector<pid_t> children;
+  for (int r = 0; r <= nReaders; r++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(ready[0]);
+      _exit(reader(r, r == nReaders, ready[1]));
+    }
+    children.push_back(pid);
+  }
+  close(ready[1]);
+  char c;
+  for (int r = 0; r <= nReaders; r++) {
+    if (read(ready[0], &c, 1) != 1) {
+      fprintf(stderr, "reader failed to start\n");
+      return 1;
+    }
+  }
+
+  RingFrame frame;
+  memset(&frame, 0, sizeof(frame));
+  frame.nValues = FRAME_RING_MAX_VALUES;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (unsigned long i = 0; i < nFrames; i++) {
+    frame.device = (uint16_t)(i % 64);
+    frame.deviceMicros = i;
+    frame.hostMicros = i * 20000 / 64;
+    frame.values[0] = (float)(i & 0xFFFF);
+    frame.values[31] = (float)frame.device;
+    ring.publish(frame);
+
+    // Give readers a chance on machines with fewer cores than processes.
+    if (i % 1024 == 0)
+      sched_yield();
+  }
+  double elapsed = seconds(start);
+
+  // End marker, repeated so that even a reader that just fell behind sees one.
+  frame.device = END_DEVICE;
+  for (int k = 0; k < RING_CAPACITY; k++) {
+    frame.deviceMicros = nFrames + k;
+    ring.publish(frame);
+    if (k % 256 == 0)
+      usleep(1000);
+  }
+
+  int failures = 0;
+  for (size_t r = 0; r < children.size(); r++) {
+    int status;
+    waitpid(children[r], &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+      failures++;
+  }
+  printf("writer: %lu frames of %zu bytes, %.1f ns/frame published (%.1f Mframes/s)\n",
+         nFrames, sizeof(RingFrame), elapsed * 1e9 / nFrames, nFrames / elapsed / 1e6);
+  printf("%s\n", failures ? "FAILED" : "all frames read intact");
+  return failures ? 1 : 0;
+}
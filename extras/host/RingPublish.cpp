@@ -0,0 +1,120 @@
+/*
+ * RingPublish.cpp
+ *
+ * Decodes the OSC streams of one or more boards once (Aggregator.h) and
+ * publishes every frame to a shared-memory FrameRing, for any number of
+ * consumer processes (see RingTail).
+ *
+ * Usage: RingPublish [-name /biodata] [-capacity frames] source...
+ *
+ * Sources are as for Aggregate: serial ports, pseudo-TTYs, pipes, FIFOs, or
+ * capture files (replayed at their original pace). Frames carry the host
+ * time of the device timetag, corrected for the drift of each board.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "Aggregator.h"
+#include "FrameRing.h"
+
+struct Publisher {
+  FrameRingWriter ring;
+  const Aggregator* aggregator;
+  int64_t timeShift;  // from capture time to host time
+};
+
+// Set by SIGINT and SIGTERM, so that the ring is removed on exit.
+static volatile sig_atomic_t stopRequested = 0;
+
+static void requestStop(int) {
+  stopRequested = 1;
+}
+
+static void publishFrame(size_t device, const AggregatorFrame& frame, int64_t, void* context) {
+  Publisher* publisher = (Publisher*)context;
+  RingFrame out;
+  out.hostMicros = publisher->aggregator->device(device).clock.toHost(frame.deviceMicros) + publisher->timeShift;
+  out.deviceMicros = frame.deviceMicros;
+  out.device = (uint16_t)device;
+  out.nValues = frame.nValues;
+  out.reserved = 0;
+  memcpy(out.values, frame.values, sizeof(float) * frame.nValues);
+  publisher->ring.publish(out);
+}
+
+int main(int argc, char** argv) {
+  const char* name = FRAME_RING_DEFAULT_NAME;
+  uint32_t capacity = 4096;
+
+  int i = 1;
+  for (; i < argc && argv[i][0] == '-'; i++) {
+    if (strcmp(argv[i], "-name") == 0 && i + 1 < argc)
+      name = argv[++i];
+    else if (strcmp(argv[i], "-capacity") == 0 && i + 1 < argc)
+      capacity = atoi(argv[++i]);
+    else
+      break;
+  }
+  if (i >= argc || capacity == 0) {
+    fprintf(stderr, "usage: %s [-name %s] [-capacity frames] source...\n", argv[0], FRAME_RING_DEFAULT_NAME);
+    return 1;
+  }
+
+  Aggregator aggregator;
+  for (; i < argc; i++) {
+    if (aggregator.openDevice(argv[i]) < 0) {
+      perror(argv[i]);
+      return 1;
+    }
+  }
+
+  Publisher publisher;
+  publisher.aggregator = &aggregator;
+  publisher.timeShift = 0;
+  if (!publisher.ring.create(name, capacity)) {
+    perror(name);
+    return 1;
+  }
+  aggregator.setFrameCallback(publishFrame, &publisher);
+  signal(SIGINT, requestStop);
+  signal(SIGTERM, requestStop);
+  fprintf(stderr, "publishing to %s\n", name);
+
+  // Captures are replayed at their original pace, in host time.
+  int64_t firstArrival = aggregator.nextCaptureArrival();
+  if (firstArrival != INT64_MAX)
+    publisher.timeShift = aggregatorHostMicros() - firstArrival;
+
+  bool live = true;
+  bool replaying = (firstArrival != INT64_MAX);
+  while ((live || replaying) && !stopRequested) {
+    if (live)
+      live = aggregator.poll(replaying ? 1 : 100);
+    else
+      usleep(1000);
+    if (replaying)
+      replaying = aggregator.replayUntil(aggregatorHostMicros() - publisher.timeShift);
+  }
+
+  fprintf(stderr, "%llu frames published\n", (unsigned long long)publisher.ring.nWritten());
+  return 0;
+}
@@ -0,0 +1,72 @@
+/*
+ * RingTail.cpp
+ *
+ * Minimal FrameRing consumer: prints the frames published by RingPublish as
+ * CSV (host time in seconds, device, values) and reports overruns.
+ *
+ * Usage: RingTail [-name /biodata] [-n frames]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FrameRing.h"
+
+int main(int argc, char** argv) {
+  const char* name = FRAME_RING_DEFAULT_NAME;
+  unsigned long long maxFrames = 0;
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-name") == 0 && i + 1 < argc) {
+      name = argv[++i];
+    } else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+      maxFrames = strtoull(argv[++i], NULL, 10);
+    } else {
+      fprintf(stderr, "usage: %s [-name %s] [-n frames]\n", argv[0], FRAME_RING_DEFAULT_NAME);
+      return 1;
+    }
+  }
+
+  FrameRingReader ring;
+  if (!ring.open(name)) {
+    fprintf(stderr, "%s: no frame ring\n", name);
+    return 1;
+  }
+
+  unsigned long long nFrames = 0;
+  uint64_t nLost = 0;
+  RingFrame frame;
+  while (maxFrames == 0 || nFrames < maxFrames) {
+    if (!ring.read(frame)) {
+      fflush(stdout);
+      usleep(1000);
+      continue;
+    }
+    if (ring.nLost() != nLost) {
+      fprintf(stderr, "overrun: %llu frames lost\n", (unsigned long long)(ring.nLost() - nLost));
+      nLost = ring.nLost();
+    }
+    printf("%.6f,%u", frame.hostMicros / 1e6, frame.device);
+    for (uint16_t v = 0; v < frame.nValues && v < FRAME_RING_MAX_VALUES; v++)
+      printf(",%.6g", frame.values[v]);
+    printf("\n");
+    nFrames++;
+  }
+  return 0;
+}
@@ -0,0 +1,261 @@
+/*
+ * SeqlockStress.cpp
+ *
+ * Hammers the feature snapshots published by the sensors (Seqlock.h) with
+ * one writer thread, standing for the timer interrupt that runs update(),
+ * and several reader threads, standing for the main loop.
+ *
+ * First with a wide value whose words must all be equal: readers of the
+ * seqlock must never see a torn value, while readers copying the same words
+ * without it do (on several cores). Then with Heart, SkinConductance and
+ * Respiration processing synthetic signals as fast as possible: every
+ * snapshot read must be, field for field, the features of the sample it
+ * claims to come from (computed beforehand by a sequential pass), and
+ * sample numbers must never go back.
+ *
+ * Usage: SeqlockStress [seconds] [readers]
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Replay.h"
+
+#define WIDE_WORDS 16
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Wide value: all words equal when read as a whole.
+struct Wide {
+  uint32_t words[WIDE_WORDS];
+};
+
+// Totals of the reader threads.
+struct ReadStats {
+  unsigned long long nReads;
+  unsigned long long nTorn;
+  unsigned long long nBackwards;
+
+  ReadStats() : nReads(0), nTorn(0), nBackwards(0) {}
+
+  void add(const ReadStats& s) {
+    nReads += s.nReads;
+    nTorn += s.nTorn;
+    nBackwards += s.nBackwards;
+  }
+};
+
+// Writes wide values for #duration# seconds, with and without the seqlock.
+static bool wideStress(double duration, unsigned int nReaders) {
+  Seqlock<Wide> seqlock;
+  uint32_t plain[WIDE_WORDS] = { 0 };
+  std::atomic<bool> done(false);
+  std::vector<ReadStats> locked(nReaders), unlocked(nReaders);
+
+  std::vector<std::thread> readers;
+  for (unsigned int r = 0; r < nReaders; r++) {
+    readers.push_back(std::thread([&, r]() {
+      uint32_t last = 0;
+      while (!done.load(std::memory_order_relaxed)) {
+        Wide w;
+        uint32_t count = seqlock.read(w);
+        for (int i = 1; i < WIDE_WORDS; i++)
+          if (w.words[i] != w.words[0]) { locked[r].nTorn++; break; }
+        if (w.words[0] != count) locked[r].nTorn++;
+        if (count < last) locked[r].nBackwards++;
+        last = count;
+        locked[r].nReads++;
+
+        // Same words copied without the seqlock.
+        uint32_t first = __atomic_load_n(&plain[0], __ATOMIC_RELAXED);
+        for (int i = 1; i < WIDE_WORDS; i++)
+          if (__atomic_load_n(&plain[i], __ATOMIC_RELAXED) != first) { unlocked[r].nTorn++; break; }
+        unlocked[r].nReads++;
+      }
+    }));
+  }
+
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  unsigned long long nWrites = 0;
+  Wide w;
+  while (seconds(start) < duration) {
+    for (int k = 0; k < 1000; k++) {
+      nWrites++;
+      for (int i = 0; i < WIDE_WORDS; i++)
+        w.words[i] = (uint32_t)nWrites;
+      seqlock.write(w);
+      for (int i = 0; i < WIDE_WORDS; i++)
+        __atomic_store_n(&plain[i], (uint32_t)nWrites, __ATOMIC_RELAXED);
+    }
+  }
+  double elapsed = seconds(start);
+  done = true;
+  for (size_t r = 0; r < readers.size(); r++)
+    readers[r].join();
+
+  ReadStats l, u;
+  for (unsigned int r = 0; r < nReaders; r++) {
+    l.add(locked[r]);
+    u.add(unlocked[r]);
+  }
+  printf("%-16s %12llu writes %14llu reads %10llu torn %6llu backwards  (%.1f ns/write+copy)\n", "wide seqlock",
+         nWrites, l.nReads, l.nTorn, l.nBackwards, elapsed * 1e9 / nWrites);
+  printf("%-16s %12s        %14llu reads %10llu torn\n", "wide unlocked", "", u.nReads, u.nTorn);
+  return l.nTorn == 0 && l.nBackwards == 0;
+}
+
+static bool sameFeatures(const Heart::Features& a, const Heart::Features& b) {
+  return a.raw == b.raw && a.normalized == b.normalized && a.bpm == b.bpm && a.bpmChange == b.bpmChange &&
+         a.amplitudeChange == b.amplitudeChange && a.beats == b.beats && a.beat == b.beat;
+}
+
+static bool sameFeatures(const SkinConductance::Features& a, const SkinConductance::Features& b) {
+  return a.raw == b.raw && a.scr == b.scr && a.scl == b.scl;
+}
+
+static bool sameFeatures(const Respiration::Features& a, const Respiration::Features& b) {
+  return a.temperature == b.temperature && a.normalized == b.normalized && a.scaled == b.scaled &&
+         a.amplitude == b.amplitude && a.amplitudeChange == b.amplitudeChange &&
+         a.amplitudeDelta == b.amplitudeDelta && a.amplitudeVariability == b.amplitudeVariability &&
+         a.interval == b.interval && a.rpm == b.rpm && a.rpmChange == b.rpmChange && a.rpmDelta == b.rpmDelta &&
+         a.rpmVariability == b.rpmVariability && a.exhaling == b.exhaling;
+}
+
+// Synthetic signals.
+static void heartSignal(std::vector<uint16_t>& samples, size_t n, unsigned long rate) {
+  double phase = 0;
+  for (size_t i = 0; i < n; i++) {
+    double t = (double)i / rate;
+    phase = fmod(phase + (1.2 + 0.2 * sin(t / 60.0)) / rate, 1.0);
+    double pulse = exp(-pow((phase - 0.2) / 0.06, 2));
+    samples.push_back((uint16_t)(350 + 250 * pulse));
+  }
+}
+
+static void skinConductanceSignal(std::vector<uint16_t>& samples, size_t n, unsigned long rate) {
+  for (size_t i = 0; i < n; i++) {
+    double t = (double)i / rate;
+    samples.push_back((uint16_t)(500 + 100 * sin(t / 20.0) + 60 * pow(sin(t / 7.0), 8)));
+  }
+}
+
+static void respirationSignal(std::vector<uint16_t>& samples, size_t n, unsigned long rate) {
+  double phase = 0;
+  for (size_t i = 0; i < n; i++) {
+    double t = (double)i / rate;
+    phase += (0.25 + 0.05 * sin(t / 40.0)) / rate;
+    samples.push_back((uint16_t)(13000 + 800 * sin(2 * M_PI * phase)));
+  }
+}
+
+/**
+ * Processes #samples# on a writer thread, as fast as possible and for at
+ * least #duration# seconds, while #nReaders# threads check every snapshot
+ * against the features of a sequential pass.
+ */
+template <class Channel>
+static bool sensorStress(const char* name, const std::vector<uint16_t>& samples, unsigned long rate,
+                         double duration, unsigned int nReaders) {
+  typedef typename Channel::Sensor Sensor;
+  typedef typename Sensor::Features Features;
+
+  // history[k]: features after k + 1 samples (the constructor processes one).
+  std::vector<Features> history(samples.size() + 1);
+  hostSetMicros(0);
+  Sensor* sensor = Channel::create(rate);
+  sensor->getFeatures(history[0]);
+  for (size_t i = 0; i < samples.size(); i++) {
+    Channel::process(*sensor, samples[i], i, rate);
+    sensor->getFeatures(history[i + 1]);
+  }
+  delete sensor;
+
+  ReadStats total;
+  unsigned long long nWrites = 0;
+  double writeSeconds = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  while (seconds(start) < duration) {
+    hostSetMicros(0);
+    sensor = Channel::create(rate);
+    std::atomic<bool> done(false);
+    std::vector<ReadStats> stats(nReaders);
+
+    std::vector<std::thread> readers;
+    for (unsigned int r = 0; r < nReaders; r++) {
+      readers.push_back(std::thread([&, r]() {
+        uint32_t last = 0;
+        while (!done.load(std::memory_order_relaxed)) {
+          Features f;
+          uint32_t count = sensor->getFeatures(f);
+          if (count == 0 || count > history.size() || !sameFeatures(f, history[count - 1]))
+            stats[r].nTorn++;
+          if (count < last)
+            stats[r].nBackwards++;
+          last = count;
+          stats[r].nReads++;
+        }
+      }));
+    }
+
+    std::chrono::steady_clock::time_point writeStart = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < samples.size(); i++)
+      Channel::process(*sensor, samples[i], i, rate);
+    writeSeconds += seconds(writeStart);
+    nWrites += samples.size();
+
+    done = true;
+    for (size_t r = 0; r < readers.size(); r++)
+      readers[r].join();
+    for (unsigned int r = 0; r < nReaders; r++)
+      total.add(stats[r]);
+    delete sensor;
+  }
+
+  printf("%-16s %12llu writes %14llu reads %10llu torn %6llu backwards  (%.1f ns/sample)\n", name, nWrites,
+         total.nReads, total.nTorn, total.nBackwards, writeSeconds * 1e9 / nWrites);
+  return total.nTorn == 0 && total.nBackwards == 0;
+}
+
+int main(int argc, char** argv) {
+  double duration = (argc > 1) ? atof(argv[1]) : 2;
+  unsigned int nReaders = (argc > 2) ? atoi(argv[2]) : 3;
+  if (duration <= 0 || nReaders < 1) {
+    fprintf(stderr, "usage: %s [seconds] [readers]\n", argv[0]);
+    return 1;
+  }
+
+  bool ok = wideStress(duration, nReaders);
+
+  std::vector<uint16_t> heart, sc, respiration;
+  heartSignal(heart, 200 * 300, 200);
+  skinConductanceSignal(sc, 50 * 300, 50);
+  respirationSignal(respiration, 50 * 300, 50);
+  ok &= sensorStress<HeartChannel>("Heart", heart, 200, duration, nReaders);
+  ok &= sensorStress<SkinConductanceChannel>("SkinConductance", sc, 50, duration, nReaders);
+  ok &= sensorStress<RespirationChannel>("Respiration", respiration, 50, duration, nReaders);
+
+  printf("%s\n", ok ? "PASSED" : "FAILED");
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,132 @@
+/*
+ * Session.h (host)
+ *
+ * A recorded session (heart, skin conductance and respiration raw samples)
+ * and its summary, computed by running the host build of the sensors over
+ * it. Every call works on its own sensor instances, so sessions can be
+ * summarized concurrently (see BatchProcess.cpp).
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_SESSION_H_
+#define BIODATA_HOST_SESSION_H_
+
+#include <stdio.h>
+#include <algorithm>
+#include <vector>
+
+#include "Heart.h"
+#include "SkinConductance.h"
+#include "Respiration.h"
+#include "SampleLogger.h"
+
+// SampleLogger channels and sample rates of a session.
+#define SESSION_HEART_CHANNEL        0
+#define SESSION_SC_CHANNEL           1
+#define SESSION_RESPIRATION_CHANNEL  2
+
+#define SESSION_HEART_RATE        200
+#define SESSION_SC_RATE            50
+#define SESSION_RESPIRATION_RATE   50
+
+struct Session {
+  std::vector<uint16_t> heart;
+  std::vector<uint16_t> sc;
+  std::vector<uint16_t> respiration;
+};
+
+struct SessionSummary {
+  float duration;     // seconds
+  size_t nBeats;
+  float meanBpm;      // at detected beats
+  float meanSCL;
+  float meanSCR;
+  size_t nBreaths;
+  float meanRpm;      // at detected exhales
+};
+
+/// Reads a session recorded by SampleLogger. Returns false on error.
+inline bool loadSession(const char* path, Session& session) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  SampleRecord records[512];
+  size_t n;
+  while ((n = fread(records, sizeof(SampleRecord), 512, file)) > 0) {
+    for (size_t i = 0; i < n; i++) {
+      switch (records[i].channel) {
+        case SESSION_HEART_CHANNEL:       session.heart.push_back(records[i].value); break;
+        case SESSION_SC_CHANNEL:          session.sc.push_back(records[i].value); break;
+        case SESSION_RESPIRATION_CHANNEL: session.respiration.push_back(records[i].value); break;
+      }
+    }
+  }
+  bool ok = !ferror(file);
+  fclose(file);
+  return ok;
+}
+
+/// Runs the sensors over #session# and fills #summary#.
+inline void summarizeSession(const Session& session, SessionSummary& summary) {
+  summary = SessionSummary();
+
+  // Sensors start their chronometers at the beginning of the session.
+  hostSetMicros(0);
+  Heart heart(A1, SESSION_HEART_RATE);
+  double bpmSum = 0;
+  for (size_t i = 0; i < session.heart.size(); i++) {
+    heart.process(session.heart[i], (unsigned long)((uint64_t)i * 1000 / SESSION_HEART_RATE));
+    if (heart.beatDetected()) {
+      summary.nBeats++;
+      bpmSum += heart.getBPM();
+    }
+  }
+  summary.meanBpm = summary.nBeats ? bpmSum / summary.nBeats : 0;
+
+  SkinConductance sc(A6, SESSION_SC_RATE);
+  double sclSum = 0, scrSum = 0;
+  for (size_t i = 0; i < session.sc.size(); i++) {
+    sc.process(session.sc[i]);
+    sclSum += sc.getSCL();
+    scrSum += sc.getSCR();
+  }
+  summary.meanSCL = session.sc.empty() ? 0 : sclSum / session.sc.size();
+  summary.meanSCR = session.sc.empty() ? 0 : scrSum / session.sc.size();
+
+  if (!session.respiration.empty()) {
+    hostSetMicros(0);
+    Respiration* respiration = new Respiration(0, SESSION_RESPIRATION_RATE);
+    double rpmSum = 0;
+    bool exhaling = respiration->isExhaling();
+    for (size_t i = 0; i < session.respiration.size(); i++) {
+      respiration->process(session.respiration[i], (unsigned long)((uint64_t)i * 1000 / SESSION_RESPIRATION_RATE));
+      if (respiration->isExhaling() && !exhaling) {
+        summary.nBreaths++;
+        rpmSum += respiration->getRpm();
+      }
+      exhaling = respiration->isExhaling();
+    }
+    summary.meanRpm = summary.nBreaths ? rpmSum / summary.nBreaths : 0;
+    delete respiration;
+  }
+
+  float heartDuration = (float)session.heart.size() / SESSION_HEART_RATE;
+  float scDuration = (float)session.sc.size() / SESSION_SC_RATE;
+  float respirationDuration = (float)session.respiration.size() / SESSION_RESPIRATION_RATE;
+  summary.duration = std::max(heartDuration, std::max(scDuration, respirationDuration));
+}
+
+#endif
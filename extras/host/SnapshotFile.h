@@ -0,0 +1,55 @@
+/*
+ * SnapshotFile.h (host)
+ *
+ * Saves and restores snapshots (see Snapshot.h) to and from files, so that
+ * host tools can warm-start sensors with baselines saved on the device or by
+ * a previous run.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_SNAPSHOT_FILE_H_
+#define BIODATA_HOST_SNAPSHOT_FILE_H_
+
+#include <stdio.h>
+#include <vector>
+
+#include "Snapshot.h"
+
+/// Writes the snapshot of #object# to #path#. Returns false on error.
+template <class T> bool saveSnapshotFile(const T& object, const char* path) {
+  std::vector<uint8_t> buffer(snapshotSize(object));
+  size_t size = saveSnapshot(object, buffer.data(), buffer.size());
+  FILE* file = fopen(path, "wb");
+  if (!file) return false;
+  bool ok = (size > 0 && fwrite(buffer.data(), 1, size, file) == size);
+  return (fclose(file) == 0) && ok;
+}
+
+/// Restores #object# from the snapshot in #path#. Returns false on error.
+template <class T> bool loadSnapshotFile(T& object, const char* path) {
+  FILE* file = fopen(path, "rb");
+  if (!file) return false;
+  std::vector<uint8_t> buffer;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), file)) > 0)
+    buffer.insert(buffer.end(), chunk, chunk + n);
+  fclose(file);
+  return !buffer.empty() && loadSnapshot(object, buffer.data(), buffer.size());
+}
+
+#endif
@@ -0,0 +1,320 @@
+/*
+ * Sweep.h (host)
+ *
+ * Evaluates many sensor configurations in a single pass over a recording:
+ * every sample is decoded once and fanned out to K pipelines.
+ *
+ * HeartSweep runs K copies of Heart's pipeline with the state of every
+ * stage stored as one array per variable (structure of arrays), so the inner
+ * loops run over contiguous lanes. Each lane gives exactly the same results
+ * as a Heart configured with applyHeartConfig().
+ *
+ * RespirationSweep runs K Respiration instances side by side.
+ *
+ * EventScore matches detected events (beats, breaths) against annotations.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_SWEEP_H_
+#define BIODATA_HOST_SWEEP_H_
+
+#include <vector>
+
+#include "Heart.h"
+#include "Respiration.h"
+
+/// Tuning parameters of Heart (defaults as in the Heart constructor).
+struct HeartConfig {
+  float thresholdLower;
+  float thresholdUpper;
+  float minMaxSmoothing;
+  float amplitudeSmoothing;
+  float bpmSmoothing;
+  float amplitudeMinMaxSmoothing;
+  float bpmMinMaxSmoothing;
+
+  HeartConfig() :
+    thresholdLower(0.25), thresholdUpper(0.4), minMaxSmoothing(0.1),
+    amplitudeSmoothing(0.001), bpmSmoothing(0.001),
+    amplitudeMinMaxSmoothing(0.001), bpmMinMaxSmoothing(0.001) {}
+};
+
+/// Configures #heart# (eg. with the best configuration found by a sweep).
+inline void applyHeartConfig(Heart& heart, const HeartConfig& config) {
+  heart.setThreshold(config.thresholdLower, config.thresholdUpper);
+  heart.setMinMaxSmoothing(config.minMaxSmoothing);
+  heart.setAmplitudeSmoothing(config.amplitudeSmoothing);
+  heart.setBpmSmoothing(config.bpmSmoothing);
+  heart.setAmplitudeMinMaxSmoothing(config.amplitudeMinMaxSmoothing);
+  heart.setBpmMinMaxSmoothing(config.bpmMinMaxSmoothing);
+}
+
+/// MinMax (see MinMax.h) over K lanes.
+struct MinMaxLanes {
+  std::vector<float> input, min, max, value, adaptation;
+  bool firstPass; // common to all lanes: they see the same number of samples
+
+  void init(size_t k) {
+    input.assign(k, 0); min.assign(k, 0); max.assign(k, 0); value.assign(k, 0);
+    adaptation.assign(k, 0);
+    firstPass = true;
+  }
+
+  /// Sets the adaptation smoothing of lane #i#, as passed to MinMax::adapt().
+  void setSmoothing(size_t i, float smoothing) {
+    float lop = constrain(smoothing, 0, 1);
+    adaptation[i] = lop * lop;
+  }
+
+  /// Filters lane inputs #f# then adapts min and max, as MinMax::filter()
+  /// followed by MinMax::adapt(). #amplitude#, if not NULL, receives
+  /// max - min in-between, as read by Heart.
+  void filterAdapt(const float* f, float* amplitude, size_t k) {
+    float* in = input.data(); float* lo = min.data(); float* hi = max.data();
+    float* v = value.data(); const float* a = adaptation.data();
+    for (size_t i = 0; i < k; i++) {
+      in[i] = f[i];
+      if (firstPass) {
+        lo[i] = hi[i] = f[i];
+      } else {
+        if (f[i] > hi[i]) hi[i] = f[i];
+        if (f[i] < lo[i]) lo[i] = f[i];
+      }
+      v[i] = (hi[i] == lo[i]) ? 0.5f : (f[i] - lo[i]) / (hi[i] - lo[i]);
+      if (amplitude) amplitude[i] = hi[i] - lo[i];
+      lo[i] += (in[i] - lo[i]) * a[i];
+      hi[i] += (in[i] - hi[i]) * a[i];
+    }
+    firstPass = false;
+  }
+};
+
+/// Lop (see Lop.h) over K lanes.
+struct LopLanes {
+  std::vector<float> alpha, value;
+  std::vector<unsigned int> nCalibration;
+  unsigned int n; // common to all lanes, stops after the longest calibration
+  unsigned int maxCalibration;
+
+  void init(size_t k) {
+    alpha.assign(k, 0); value.assign(k, 0); nCalibration.assign(k, 0);
+    n = maxCalibration = 0;
+  }
+
+  void setSmoothing(size_t i, float smoothing) {
+    alpha[i] = constrain(smoothing, 0, 1);
+    nCalibration[i] = int(2 / alpha[i] - 1);
+    if (nCalibration[i] > maxCalibration) maxCalibration = nCalibration[i];
+  }
+
+  void filter(const float* input, size_t k) {
+    if (n <= maxCalibration) n++;
+    float* v = value.data(); const float* a = alpha.data();
+    for (size_t i = 0; i < k; i++) {
+      if (n <= nCalibration[i])
+        v[i] = (v[i] * (n-1) + input[i]) / n;
+      else
+        v[i] += (input[i] - v[i]) * a[i];
+    }
+  }
+};
+
+/// K Heart pipelines fed with the same samples.
+class HeartSweep {
+  std::vector<HeartConfig> _configs;
+  size_t _k;
+  uint8_t _pin;
+
+  MinMaxLanes _signal, _amplitudeMinMax, _bpmMinMax;
+  LopLanes _amplitudeLop, _bpmLop;
+
+  std::vector<float> _lower, _upper;
+  std::vector<uint8_t> _triggered, _beat;
+  std::vector<float> _bpm;
+  std::vector<unsigned long> _bpmChronoStart;
+
+  // Scratch lanes.
+  std::vector<float> _reading, _amplitude;
+
+public:
+  /// Creates one lane per configuration, reading #pin# on reset() like Heart.
+  HeartSweep(const std::vector<HeartConfig>& configs, uint8_t pin=A1) :
+    _configs(configs), _k(configs.size()), _pin(pin) {
+    reset();
+  }
+
+  /// Resets all lanes, as Heart::reset() (including its first sample).
+  void reset() {
+    _signal.init(_k); _amplitudeMinMax.init(_k); _bpmMinMax.init(_k);
+    _amplitudeLop.init(_k); _bpmLop.init(_k);
+    _lower.resize(_k); _upper.resize(_k);
+    _triggered.assign(_k, 0); _beat.assign(_k, 0);
+    _bpm.assign(_k, 60);
+    _bpmChronoStart.assign(_k, millis());
+    _reading.resize(_k); _amplitude.resize(_k);
+
+    for (size_t i = 0; i < _k; i++) {
+      const HeartConfig& c = _configs[i];
+      _lower[i] = c.thresholdLower;
+      _upper[i] = c.thresholdUpper;
+      _signal.setSmoothing(i, c.minMaxSmoothing);
+      _amplitudeLop.setSmoothing(i, c.amplitudeSmoothing);
+      _bpmLop.setSmoothing(i, c.bpmSmoothing);
+      _amplitudeMinMax.setSmoothing(i, c.amplitudeMinMaxSmoothing);
+      _bpmMinMax.setSmoothing(i, c.bpmMinMaxSmoothing);
+    }
+
+    analogRead(_pin);
+    process(analogRead(_pin), millis());
+  }
+
+  /// Processes one sample in every lane (see Heart::process()).
+  void process(int reading, unsigned long ms) {
+    for (size_t i = 0; i < _k; i++)
+      _reading[i] = reading;
+
+    _signal.filterAdapt(_reading.data(), _amplitude.data(), _k);
+    _amplitudeLop.filter(_amplitude.data(), _k);
+    _bpmLop.filter(_bpm.data(), _k);
+    _amplitudeMinMax.filterAdapt(_amplitudeLop.value.data(), NULL, _k);
+    _bpmMinMax.filterAdapt(_bpmLop.value.data(), NULL, _k);
+
+    const float* normalized = _signal.value.data();
+    for (size_t i = 0; i < _k; i++) {
+      bool beat = false;
+      if (normalized[i] >= _upper[i] && !_triggered[i]) {
+        _triggered[i] = true;
+        beat = true;
+      } else if (normalized[i] <= _lower[i]) {
+        _triggered[i] = false;
+      }
+      _beat[i] = beat;
+
+      if (beat) {
+        float temporaryBpm = 60000. / (ms - _bpmChronoStart[i]);
+        _bpmChronoStart[i] = ms;
+        if (temporaryBpm > 30 && temporaryBpm < 200)
+          _bpm[i] = temporaryBpm;
+      }
+    }
+  }
+
+  /// Number of lanes.
+  size_t size() const { return _k; }
+
+  const HeartConfig& config(size_t i) const { return _configs[i]; }
+
+  // Same as the corresponding Heart accessors, for lane #i#.
+  float getNormalized(size_t i) const { return _signal.value[i]; }
+  bool beatDetected(size_t i) const { return _beat[i]; }
+  float getBPM(size_t i) const { return _bpm[i]; }
+  float amplitudeChange(size_t i) const { return _amplitudeMinMax.value[i]; }
+  float bpmChange(size_t i) const { return _bpmMinMax.value[i]; }
+};
+
+/// K Respiration instances fed with the same samples.
+class RespirationSweep {
+  std::vector<RespirationConfig> _configs;
+  std::vector<Respiration*> _sensors;
+  std::vector<uint8_t> _exhaling, _breath;
+
+public:
+  /**
+   * Creates one instance per configuration (RespirationConfig, see
+   * Respiration.h); the sensors use the sweep's copies of the configurations.
+   */
+  RespirationSweep(const std::vector<RespirationConfig>& configs, uint8_t pin=0) :
+    _configs(configs), _exhaling(configs.size(), 0), _breath(configs.size(), 0) {
+    for (size_t i = 0; i < configs.size(); i++) {
+      _sensors.push_back(new Respiration(pin, 50, &_configs[i]));
+      _exhaling[i] = _sensors[i]->isExhaling();
+    }
+  }
+
+  ~RespirationSweep() {
+    for (size_t i = 0; i < _sensors.size(); i++)
+      delete _sensors[i];
+  }
+
+  /// Processes one sample in every instance (see Respiration::process()).
+  void process(uint16_t adcValue, unsigned long ms) {
+    for (size_t i = 0; i < _sensors.size(); i++) {
+      _sensors[i]->process(adcValue, ms);
+      bool exhaling = _sensors[i]->isExhaling();
+      _breath[i] = exhaling && !_exhaling[i];
+      _exhaling[i] = exhaling;
+    }
+  }
+
+  size_t size() const { return _sensors.size(); }
+
+  const RespirationConfig& config(size_t i) const { return _configs[i]; }
+
+  /// Returns true if instance #i# started exhaling on the last sample.
+  bool breathDetected(size_t i) const { return _breath[i]; }
+
+  const Respiration& sensor(size_t i) const { return *_sensors[i]; }
+};
+
+/**
+ * Counts detections matching annotated event times (sorted, in ms) within
+ * #tolerance# ms, each annotation matching at most one detection. Detections
+ * must be added in increasing time order.
+ */
+class EventScore {
+  const std::vector<unsigned long>* _annotations;
+  unsigned long _tolerance;
+  size_t _next;
+
+public:
+  size_t nTruePositives;
+  size_t nFalsePositives;
+
+  EventScore(const std::vector<unsigned long>& annotations, unsigned long tolerance) :
+    _annotations(&annotations), _tolerance(tolerance), _next(0),
+    nTruePositives(0), nFalsePositives(0) {}
+
+  void add(unsigned long ms) {
+    const std::vector<unsigned long>& a = *_annotations;
+    while (_next < a.size() && a[_next] + _tolerance < ms)
+      _next++;
+    if (_next < a.size() && a[_next] <= ms + _tolerance) {
+      nTruePositives++;
+      _next++;
+    } else {
+      nFalsePositives++;
+    }
+  }
+
+  size_t nFalseNegatives() const { return _annotations->size() - nTruePositives; }
+
+  float sensitivity() const {
+    return _annotations->empty() ? 0 : (float)nTruePositives / _annotations->size();
+  }
+
+  float precision() const {
+    size_t n = nTruePositives + nFalsePositives;
+    return n ? (float)nTruePositives / n : 0;
+  }
+
+  float f1() const {
+    float s = sensitivity(), p = precision();
+    return (s + p > 0) ? 2 * s * p / (s + p) : 0;
+  }
+};
+
+#endif
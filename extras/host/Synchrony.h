@@ -0,0 +1,242 @@
+/*
+ * Synchrony.h (host)
+ *
+ * Live synchrony between the participants of a group installation (eg. the
+ * aligned frames of Aggregator.h), over a sliding window of W frames:
+ *  - pairwise Pearson correlation of BPM;
+ *  - pairwise phase locking value (PLV) of breathing: |mean of e^i(a - b)|
+ *    for breath phases a and b;
+ *  - group coherence: mean over the window of the Kuramoto order parameter
+ *    |mean over participants of e^i(phase)|.
+ *
+ * Recomputing these over the window costs O(N^2 W) per frame. GroupSynchrony
+ * keeps the window sums they are made of (sums and sums of squares of BPM,
+ * and per pair the sums of BPM products and of the cosine and sine of the
+ * phase difference), adding the new frame and removing the one that leaves
+ * the window: O(N^2) per frame. Sums are rebuilt from the window every W
+ * frames so that rounding errors do not accumulate.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_SYNCHRONY_H_
+#define BIODATA_HOST_SYNCHRONY_H_
+
+#include <math.h>
+#include <stddef.h>
+#include <algorithm>
+#include <vector>
+
+/**
+ * Breath phase from Respiration::isExhaling(): 0 at the start of every
+ * exhale, growing linearly to 2 pi over the duration of the previous breath
+ * (and held there if the breath lasts longer). NaN until two exhales were seen.
+ */
+class BreathPhase {
+  double _lastOnset;
+  double _interval;
+  bool _exhaling;
+
+public:
+  BreathPhase() { reset(); }
+
+  void reset() {
+    _lastOnset = NAN;
+    _interval = NAN;
+    _exhaling = false;
+  }
+
+  /// Returns the phase at time #seconds#, given the current exhaling state.
+  float update(bool exhaling, double seconds) {
+    if (exhaling && !_exhaling) {
+      if (!isnan(_lastOnset))
+        _interval = seconds - _lastOnset;
+      _lastOnset = seconds;
+    }
+    _exhaling = exhaling;
+    if (isnan(_interval) || _interval <= 0)
+      return NAN;
+    double progress = (seconds - _lastOnset) / _interval;
+    return (float)(2 * M_PI * (progress < 1 ? progress : 1));
+  }
+};
+
+class GroupSynchrony {
+  size_t _n;
+  size_t _window;
+  size_t _nFrames;   // in the window
+  size_t _next;      // ring position of the next frame
+  size_t _sinceRebuild;
+
+  // Window of inputs, one row of _n per frame.
+  std::vector<double> _bpm;
+  std::vector<double> _cos;
+  std::vector<double> _sin;
+
+  // Last valid inputs, used in place of missing (NaN) ones.
+  std::vector<double> _lastBpm;
+  std::vector<double> _lastPhase;
+
+  // Window sums: per participant, and per pair i < j (upper triangle, row by row).
+  std::vector<double> _sumBpm;
+  std::vector<double> _sumBpm2;
+  std::vector<double> _sumBpmProduct;
+  std::vector<double> _sumCosDiff;
+  std::vector<double> _sumSinDiff;
+  double _sumOrder;  // of the Kuramoto order parameter
+  std::vector<double> _order; // per frame
+
+  static size_t nPairs(size_t n) { return (n > 1) ? n * (n - 1) / 2 : 0; }
+
+  size_t pair(size_t i, size_t j) const { return i * (2 * _n - i - 1) / 2 + (j - i - 1); }
+
+  // Adds (sign 1) or removes (sign -1) frame #f# of the ring to the sums.
+  void accumulate(size_t f, double sign) {
+    const double* bpm = &_bpm[f * _n];
+    const double* c = &_cos[f * _n];
+    const double* s = &_sin[f * _n];
+    size_t p = 0;
+    for (size_t i = 0; i < _n; i++) {
+      _sumBpm[i] += sign * bpm[i];
+      _sumBpm2[i] += sign * bpm[i] * bpm[i];
+      double sb = sign * bpm[i], sc = sign * c[i], ss = sign * s[i];
+      for (size_t j = i + 1; j < _n; j++, p++) {
+        _sumBpmProduct[p] += sb * bpm[j];
+        _sumCosDiff[p] += sc * c[j] + ss * s[j];  // cos(a - b)
+        _sumSinDiff[p] += ss * c[j] - sc * s[j];  // sin(a - b)
+      }
+    }
+    _sumOrder += sign * _order[f];
+  }
+
+  void rebuild() {
+    std::fill(_sumBpm.begin(), _sumBpm.end(), 0);
+    std::fill(_sumBpm2.begin(), _sumBpm2.end(), 0);
+    std::fill(_sumBpmProduct.begin(), _sumBpmProduct.end(), 0);
+    std::fill(_sumCosDiff.begin(), _sumCosDiff.end(), 0);
+    std::fill(_sumSinDiff.begin(), _sumSinDiff.end(), 0);
+    _sumOrder = 0;
+    for (size_t k = 0; k < _nFrames; k++)
+      accumulate((_next + _window - 1 - k) % _window, 1);
+    _sinceRebuild = 0;
+  }
+
+public:
+  /// Synchrony of #nParticipants# over the last #window# frames.
+  GroupSynchrony(size_t nParticipants, size_t window) :
+    _n(nParticipants), _window(window > 0 ? window : 1),
+    _bpm(_n * _window), _cos(_n * _window), _sin(_n * _window),
+    _lastBpm(_n), _lastPhase(_n),
+    _sumBpm(_n), _sumBpm2(_n),
+    _sumBpmProduct(nPairs(_n)), _sumCosDiff(nPairs(_n)), _sumSinDiff(nPairs(_n)),
+    _order(_window)
+  {
+    reset();
+  }
+
+  void reset() {
+    _nFrames = 0;
+    _next = 0;
+    std::fill(_lastBpm.begin(), _lastBpm.end(), 0);
+    std::fill(_lastPhase.begin(), _lastPhase.end(), 0);
+    rebuild();
+  }
+
+  size_t nParticipants() const { return _n; }
+
+  /// Number of frames in the window (up to the window size).
+  size_t nFrames() const { return _nFrames; }
+
+  /**
+   * Adds a frame: BPM and breath phase (radians) of every participant.
+   * Missing values (NaN) repeat the last valid ones.
+   */
+  void add(const float* bpm, const float* phase) {
+    if (_nFrames == _window)
+      accumulate(_next, -1);
+
+    double* b = &_bpm[_next * _n];
+    double* c = &_cos[_next * _n];
+    double* s = &_sin[_next * _n];
+    double sumCos = 0, sumSin = 0;
+    for (size_t i = 0; i < _n; i++) {
+      if (!isnan(bpm[i])) _lastBpm[i] = bpm[i];
+      if (!isnan(phase[i])) _lastPhase[i] = phase[i];
+      b[i] = _lastBpm[i];
+      c[i] = cos(_lastPhase[i]);
+      s[i] = sin(_lastPhase[i]);
+      sumCos += c[i];
+      sumSin += s[i];
+    }
+    _order[_next] = (_n > 0) ? sqrt(sumCos * sumCos + sumSin * sumSin) / _n : 0;
+
+    accumulate(_next, 1);
+    _next = (_next + 1) % _window;
+    if (_nFrames < _window)
+      _nFrames++;
+    if (++_sinceRebuild >= _window)
+      rebuild();
+  }
+
+  /// Pearson correlation of the BPM of participants #i# and #j# (0 if either is constant).
+  float bpmCorrelation(size_t i, size_t j) const {
+    if (i == j) return 1;
+    if (i > j) { size_t t = i; i = j; j = t; }
+    if (_nFrames == 0) return 0;
+    double n = _nFrames;
+    double cov = _sumBpmProduct[pair(i, j)] - _sumBpm[i] * _sumBpm[j] / n;
+    double varI = _sumBpm2[i] - _sumBpm[i] * _sumBpm[i] / n;
+    double varJ = _sumBpm2[j] - _sumBpm[j] * _sumBpm[j] / n;
+    if (varI <= 1e-9 * n || varJ <= 1e-9 * n) return 0;
+    return (float)(cov / sqrt(varI * varJ));
+  }
+
+  /// Phase locking value of the breathing of participants #i# and #j# (0 to 1).
+  float phaseLocking(size_t i, size_t j) const {
+    if (i == j) return 1;
+    if (i > j) { size_t t = i; i = j; j = t; }
+    if (_nFrames == 0) return 0;
+    size_t p = pair(i, j);
+    return (float)(sqrt(_sumCosDiff[p] * _sumCosDiff[p] + _sumSinDiff[p] * _sumSinDiff[p]) / _nFrames);
+  }
+
+  /// Mean of bpmCorrelation() over all pairs.
+  float meanBpmCorrelation() const {
+    if (_n < 2) return 0;
+    double sum = 0;
+    for (size_t i = 0; i < _n; i++)
+      for (size_t j = i + 1; j < _n; j++)
+        sum += bpmCorrelation(i, j);
+    return (float)(sum / nPairs(_n));
+  }
+
+  /// Mean of phaseLocking() over all pairs.
+  float meanPhaseLocking() const {
+    if (_n < 2) return 0;
+    double sum = 0;
+    for (size_t i = 0; i < _n; i++)
+      for (size_t j = i + 1; j < _n; j++)
+        sum += phaseLocking(i, j);
+    return (float)(sum / nPairs(_n));
+  }
+
+  /// Mean Kuramoto order parameter of breath phases over the window (0 to 1).
+  float groupCoherence() const {
+    return _nFrames ? (float)(_sumOrder / _nFrames) : 0;
+  }
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * SynchronyBenchmark.cpp
+ *
+ * Simulates groups of 10 to 60 participants (50 frames per second, partly
+ * coupled BPM and breathing) and computes their synchrony over a 30 s window
+ * with GroupSynchrony (Synchrony.h, O(N^2) per frame) and by recomputing
+ * everything over the window (O(N^2 W) per frame). Reports the cost per
+ * frame of both and the largest difference between their results.
+ *
+ * Usage: SynchronyBenchmark
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "Synchrony.h"
+
+#define FRAME_RATE     50
+#define WINDOW_FRAMES  (30 * FRAME_RATE)
+#define FRAMES         (5 * 60 * FRAME_RATE)
+#define NAIVE_FRAMES   200  // compared at the end of the run
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Small deterministic generator.
+static uint32_t randomState = 12345;
+static double uniform() {
+  randomState = randomState * 1664525UL + 1013904223UL;
+  return (randomState >> 8) / 16777216.0;
+}
+
+struct Participant {
+  double coupling;    // 0 to 1: how much of the shared rhythm is followed
+  double drift;       // individual BPM random walk
+  double breathRate;  // Hz
+  double breathPhase;
+  BreathPhase phase;
+};
+
+struct Results {
+  float bpmCorrelation;
+  float phaseLocking;
+  float coherence;
+};
+
+// Recomputes the mean pairwise synchrony from the last frames of #bpm# and #phase#.
+static Results naive(const std::vector<std::vector<float> >& bpm, const std::vector<std::vector<float> >& phase,
+                     size_t end, size_t n) {
+  size_t first = (end > WINDOW_FRAMES) ? end - WINDOW_FRAMES : 0;
+  double w = end - first;
+  double sumCorrelation = 0, sumLocking = 0, sumOrder = 0;
+  for (size_t i = 0; i < n; i++) {
+    for (size_t j = i + 1; j < n; j++) {
+      double si = 0, sj = 0, sii = 0, sjj = 0, sij = 0, c = 0, s = 0;
+      for (size_t f = first; f < end; f++) {
+        double a = bpm[f][i], b = bpm[f][j];
+        si += a; sj += b; sii += a * a; sjj += b * b; sij += a * b;
+        c += cos(phase[f][i] - phase[f][j]);
+        s += sin(phase[f][i] - phase[f][j]);
+      }
+      double cov = sij - si * sj / w, vi = sii - si * si / w, vj = sjj - sj * sj / w;
+      sumCorrelation += (vi > 1e-9 * w && vj > 1e-9 * w) ? cov / sqrt(vi * vj) : 0;
+      sumLocking += sqrt(c * c + s * s) / w;
+    }
+  }
+  for (size_t f = first; f < end; f++) {
+    double c = 0, s = 0;
+    for (size_t i = 0; i < n; i++) {
+      c += cos(phase[f][i]);
+      s += sin(phase[f][i]);
+    }
+    sumOrder += sqrt(c * c + s * s) / n;
+  }
+  Results r = { (float)(sumCorrelation / (n * (n - 1) / 2)), (float)(sumLocking / (n * (n - 1) / 2)),
+                (float)(sumOrder / w) };
+  return r;
+}
+
+static void run(size_t n) {
+  std::vector<Participant> participants(n);
+  for (size_t i = 0; i < n; i++) {
+    participants[i].coupling = uniform();
+    participants[i].drift = 0;
+    participants[i].breathRate = 0.25 * (1 + 0.2 * (uniform() - 0.5));
+    participants[i].breathPhase = 2 * M_PI * uniform();
+  }
+
+  // Inputs of every frame (phases as given to GroupSynchrony, NaN replaced).
+  std::vector<std::vector<float> > bpm(FRAMES, std::vector<float>(n));
+  std::vector<std::vector<float> > phase(FRAMES, std::vector<float>(n));
+  std::vector<float> lastPhase(n, 0);
+  for (size_t f = 0; f < FRAMES; f++) {
+    double t = (double)f / FRAME_RATE;
+    double shared = sin(2 * M_PI * t / 20);
+    double sharedBreath = 2 * M_PI * 0.25 * t;
+    for (size_t i = 0; i < n; i++) {
+      Participant& p = participants[i];
+      p.drift += 0.05 * (uniform() - 0.5);
+      bpm[f][i] = (float)(70 + 5 * p.coupling * shared + p.drift);
+      p.breathPhase += 2 * M_PI * p.breathRate / FRAME_RATE;
+      double breath = (1 - p.coupling) * p.breathPhase + p.coupling * sharedBreath;
+      float ph = p.phase.update(sin(breath) > 0, t);
+      if (!isnan(ph)) lastPhase[i] = ph;
+      phase[f][i] = lastPhase[i];
+    }
+  }
+
+  GroupSynchrony synchrony(n, WINDOW_FRAMES);
+  Results incremental = { 0, 0, 0 };
+  double maxError = 0;
+  double naiveTime = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for (size_t f = 0; f < FRAMES; f++) {
+    synchrony.add(bpm[f].data(), phase[f].data());
+    incremental.bpmCorrelation = synchrony.meanBpmCorrelation();
+    incremental.phaseLocking = synchrony.meanPhaseLocking();
+    incremental.coherence = synchrony.groupCoherence();
+
+    if (f >= FRAMES - NAIVE_FRAMES) {
+      std::chrono::steady_clock::time_point naiveStart = std::chrono::steady_clock::now();
+      Results r = naive(bpm, phase, f + 1, n);
+      naiveTime += seconds(naiveStart);
+      maxError = fmax(maxError, fabs(r.bpmCorrelation - incremental.bpmCorrelation));
+      maxError = fmax(maxError, fabs(r.phaseLocking - incremental.phaseLocking));
+      maxError = fmax(maxError, fabs(r.coherence - incremental.coherence));
+    }
+  }
+  double incrementalTime = seconds(start) - naiveTime;
+
+  double incrementalFrame = incrementalTime / FRAMES, naiveFrame = naiveTime / NAIVE_FRAMES;
+  printf("%6zu %12.1f %12.1f %9.0fx %10.0f %10.2g   %.3f %.3f %.3f\n", n, incrementalFrame * 1e6, naiveFrame * 1e6,
+         naiveFrame / incrementalFrame, 1 / incrementalFrame, maxError,
+         incremental.bpmCorrelation, incremental.phaseLocking, incremental.coherence);
+}
+
+int main() {
+  printf("%d s window at %d frames/s\n", WINDOW_FRAMES / FRAME_RATE, FRAME_RATE);
+  printf("%6s %12s %12s %10s %10s %10s   %s\n", "people", "incremental", "naive", "speedup", "frames/s",
+         "max diff", "bpm r, PLV, coherence");
+  printf("%6s %12s %12s\n", "", "(us/frame)", "(us/frame)");
+  size_t groups[] = { 10, 30, 60 };
+  for (size_t g = 0; g < sizeof(groups) / sizeof(groups[0]); g++)
+    run(groups[g]);
+  return 0;
+}
@@ -0,0 +1,2 @@
+// Pre-1.0 Arduino core header name, used by Average.h when ARDUINO is undefined.
+#include "Arduino.h"
@@ -0,0 +1,42 @@
+/*
+ * Wire.h (host)
+ *
+ * Stand-in for the Arduino Wire library. Behaves like an I2C bus with no
+ * device attached: every transmission is NACKed and no bytes are returned.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_WIRE_H_
+#define BIODATA_HOST_WIRE_H_
+
+#include "Arduino.h"
+
+class TwoWire {
+public:
+  void begin() {}
+  void setClock(uint32_t) {}
+  void beginTransmission(uint8_t) {}
+  uint8_t endTransmission() { return 2; } // address NACK
+  size_t write(uint8_t) { return 1; }
+  uint8_t requestFrom(int, int) { return 0; }
+  int read() { return -1; }
+  int available() { return 0; }
+};
+
+extern TwoWire Wire;
+
+#endif
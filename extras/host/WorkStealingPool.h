@@ -0,0 +1,152 @@
+/*
+ * WorkStealingPool.h (host)
+ *
+ * Fixed-size thread pool where every worker has its own task queue. Workers
+ * take tasks from the back of their own queue and, when it is empty, steal
+ * from the front of the others', so long tasks (eg. a 10 hour session next to
+ * a 10 minute one) do not leave cores idle.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef BIODATA_HOST_WORK_STEALING_POOL_H_
+#define BIODATA_HOST_WORK_STEALING_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+  typedef std::function<void()> Task;
+
+  /// Starts #nThreads# workers (at least one).
+  explicit WorkStealingPool(unsigned int nThreads) :
+    _nQueued(0), _nPending(0), _stop(false), _next(0), _nSteals(0)
+  {
+    if (nThreads < 1) nThreads = 1;
+    for (unsigned int i = 0; i < nThreads; i++)
+      _queues.push_back(std::unique_ptr<Queue>(new Queue()));
+    for (unsigned int i = 0; i < nThreads; i++)
+      _threads.push_back(std::thread(&WorkStealingPool::run, this, i));
+  }
+
+  /// Waits for all tasks, then stops the workers.
+  ~WorkStealingPool() {
+    wait();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      _stop = true;
+    }
+    _workAvailable.notify_all();
+    for (size_t i = 0; i < _threads.size(); i++)
+      _threads[i].join();
+  }
+
+  /// Queues #task#. Tasks are spread over the workers' queues round-robin.
+  /// Can be called from any thread, including from a task.
+  void submit(const Task& task) {
+    {
+      // Counted before the task is queued: a worker could otherwise run it
+      // and decrement the counters first.
+      std::lock_guard<std::mutex> lock(_mutex);
+      _nQueued++;
+      _nPending++;
+      Queue& queue = *_queues[_next];
+      _next = (_next + 1) % _queues.size();
+      std::lock_guard<std::mutex> queueLock(queue.mutex);
+      queue.tasks.push_back(task);
+    }
+    _workAvailable.notify_one();
+  }
+
+  /// Blocks until every submitted task has completed.
+  void wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _done.wait(lock, [this]() { return _nPending == 0; });
+  }
+
+  /// Number of workers.
+  unsigned int size() const { return _threads.size(); }
+
+  /// Number of tasks taken from another worker's queue.
+  size_t nSteals() const { return _nSteals; }
+
+private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Task> tasks;
+  };
+
+  // Takes a task from queue #index#, or steals one.
+  bool pop(unsigned int index, Task& task) {
+    for (size_t i = 0; i < _queues.size(); i++) {
+      Queue& queue = *_queues[(index + i) % _queues.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.tasks.empty())
+        continue;
+      if (i == 0) {
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+      } else {
+        task = queue.tasks.front();
+        queue.tasks.pop_front();
+        _nSteals++;
+      }
+      _nQueued--;
+      return true;
+    }
+    return false;
+  }
+
+  void run(unsigned int index) {
+    for (;;) {
+      Task task;
+      if (pop(index, task)) {
+        task();
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (--_nPending == 0)
+          _done.notify_all();
+        continue;
+      }
+
+      std::unique_lock<std::mutex> lock(_mutex);
+      _workAvailable.wait(lock, [this]() { return _stop || _nQueued > 0; });
+      if (_stop && _nQueued == 0)
+        return;
+    }
+  }
+
+  std::vector<std::unique_ptr<Queue> > _queues;
+  std::vector<std::thread> _threads;
+
+  std::mutex _mutex;
+  std::condition_variable _workAvailable;
+  std::condition_variable _done;
+  std::atomic<size_t> _nQueued;   // tasks waiting in queues
+  size_t _nPending;               // tasks submitted but not completed
+  bool _stop;
+
+  size_t _next;                   // queue of the next task (under _mutex)
+  std::atomic<size_t> _nSteals;
+};
+
+#endif
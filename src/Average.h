@@ -40,6 +40,8 @@
 
 #include <math.h>
 
+#include "Snapshot.h"
+
 inline static float sqr(float x) {
     return x*x;
 }
@@ -75,6 +77,8 @@ template <class T> class Average {
         T sum();
         void clear();
         Average<T> &operator=(Average<T> &a);
+        void save(SnapshotWriter &out) const;
+        void load(SnapshotReader &in);
 
 };
 
@@ -305,4 +309,34 @@ template <class T> Average<T> &Average<T>::operator=(Average<T> &a) {
     return *this;
 }
 
+// Save the whole circular buffer (see Snapshot.h)
+template <class T> void Average<T>::save(SnapshotWriter &out) const {
+    out.writeUInt8('A');
+    out.writeUInt32(_size);
+    out.writeUInt32(_count);
+    out.writeUInt32(_position);
+    out.write(_sum);
+    for (uint32_t i = 0; i < _size; i++) {
+        out.write(_store[i]);
+    }
+}
+
+// Restore the circular buffer, only if it was saved with the same size
+template <class T> void Average<T>::load(SnapshotReader &in) {
+    in.expect('A');
+    uint32_t size = in.readUInt32();
+    uint32_t count = in.readUInt32();
+    uint32_t position = in.readUInt32();
+    if (!in.ok() || size != _size || count > _size || position >= _size) {
+        in.invalidate();
+        return;
+    }
+    in.read(_sum);
+    for (uint32_t i = 0; i < _size; i++) {
+        in.read(_store[i]);
+    }
+    _count = count;
+    _position = position;
+}
+
 #endif
@@ -32,5 +32,9 @@
 #include "Heart.h"
 #include "SkinConductance.h"
 #include "Respiration.h"
+#include "PulseRespiration.h"
+#include "PulseTransit.h"
+#include "PulseMorphology.h"
+#include "HrvComplexity.h"
 
 #endif
@@ -0,0 +1,170 @@
+/*
+ * Footprint.h
+ *
+ * RAM budgets of the BioData classes and of the example configurations.
+ * Device builds that include this file (every Teensy 3.1 build does, through
+ * src/main.cpp, and examples/Footprint) fail at compile time when a class
+ * grows beyond its budget, and when the static RAM of an example
+ * configuration exceeds FOOTPRINT_RAM_BUDGET. It is not part
+ * of BioData.h: the budgets are for the Teensy 3.1, and the heap measurement
+ * needs newlib's or glibc's mallinfo(). Budgets of the classes holding
+ * buffers follow the size macros of those buffers; any budget can be
+ * overridden with a build flag (eg. -DFOOTPRINT_RESPIRATION_BUDGET=1536).
+ *
+ * sizeof() does not include the heap: Average's buffer is measured at run
+ * time with footprintHeapInUse() (see examples/Footprint and
+ * extras/host/FootprintReport.cpp).
+ *
+ * On the host, sizes differ (64-bit pointers and longs) and the assertions
+ * are skipped unless FOOTPRINT_CHECK_HOST is defined.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include <malloc.h>
+#include <new>
+#include <utility>
+#include "Heart.h"
+#include "SkinConductance.h"
+#include "Respiration.h"
+#include "PulseRespiration.h"
+#include "PulseTransit.h"
+#include "PulseMorphology.h"
+#include "HrvComplexity.h"
+#include "OscEncoder.h"
+#include "SampleLogger.h"
+#include "Pyramid.h"
+#include "RiceCodec.h"
+
+#ifndef FOOTPRINT_H_
+#define FOOTPRINT_H_
+
+// RAM available to a sketch's objects on the Teensy 3.1 (64 KB), keeping
+// 16 KB for the stack, the core and the USB and serial buffers.
+#ifndef FOOTPRINT_RAM_BUDGET
+#define FOOTPRINT_RAM_BUDGET (48 * 1024UL)
+#endif
+
+// Budgets of one instance of each class, in bytes.
+#ifndef FOOTPRINT_HEART_BUDGET
+#define FOOTPRINT_HEART_BUDGET 224
+#endif
+
+#ifndef FOOTPRINT_SKIN_CONDUCTANCE_BUDGET
+#define FOOTPRINT_SKIN_CONDUCTANCE_BUDGET 80
+#endif
+
+#ifndef FOOTPRINT_RESPIRATION_BUDGET
+#define FOOTPRINT_RESPIRATION_BUDGET 832
+#endif
+
+#ifndef FOOTPRINT_PULSE_RESPIRATION_BUDGET
+#define FOOTPRINT_PULSE_RESPIRATION_BUDGET 224
+#endif
+
+#ifndef FOOTPRINT_PULSE_TRANSIT_BUDGET
+#define FOOTPRINT_PULSE_TRANSIT_BUDGET 976
+#endif
+
+#ifndef FOOTPRINT_PULSE_MORPHOLOGY_BUDGET
+#define FOOTPRINT_PULSE_MORPHOLOGY_BUDGET 2400
+#endif
+
+#ifndef FOOTPRINT_HRV_COMPLEXITY_BUDGET
+#define FOOTPRINT_HRV_COMPLEXITY_BUDGET 672
+#endif
+
+#ifndef FOOTPRINT_OSC_ENCODER_BUDGET
+#define FOOTPRINT_OSC_ENCODER_BUDGET (OSC_ENCODER_MAX_SIZE + 48)
+#endif
+
+#ifndef FOOTPRINT_SAMPLE_LOGGER_BUDGET
+#define FOOTPRINT_SAMPLE_LOGGER_BUDGET (2 * SAMPLE_LOGGER_BLOCK_SIZE + 48)
+#endif
+
+#ifndef FOOTPRINT_PYRAMID_BUDGET
+#define FOOTPRINT_PYRAMID_BUDGET ((PYRAMID_MAX_LEVEL + 1) * 16 + 24)
+#endif
+
+#ifndef FOOTPRINT_PYRAMID_LOGGER_BUDGET
+#define FOOTPRINT_PYRAMID_LOGGER_BUDGET (SAMPLE_LOGGER_BLOCK_SIZE + 24)
+#endif
+
+#ifndef FOOTPRINT_RICE_ENCODER_BUDGET
+#define FOOTPRINT_RICE_ENCODER_BUDGET (2 * RICE_CODEC_BLOCK_SAMPLES + RICE_CODEC_MAX_BLOCK_BYTES + 16)
+#endif
+
+/// Static RAM of the sensors of one participant (Heart, SkinConductance, Respiration).
+constexpr size_t FOOTPRINT_TRIO = sizeof(Heart) + sizeof(SkinConductance) + sizeof(Respiration);
+
+/// Static RAM of the BioData objects of the examples.
+constexpr size_t FOOTPRINT_OSC_OUTPUT = FOOTPRINT_TRIO + sizeof(OscEncoder);
+constexpr size_t FOOTPRINT_SAMPLE_LOGGER = FOOTPRINT_TRIO + sizeof(SampleLogger);
+constexpr size_t FOOTPRINT_PYRAMID = FOOTPRINT_TRIO + sizeof(PyramidLogger) + 3 * sizeof(Pyramid);
+constexpr size_t FOOTPRINT_COMPRESSION = sizeof(Heart) + sizeof(SkinConductance) + 2 * sizeof(RiceEncoder);
+
+/// Number of participants (sensor trios) that fit in FOOTPRINT_RAM_BUDGET.
+constexpr size_t FOOTPRINT_MAX_TRIOS = FOOTPRINT_RAM_BUDGET / FOOTPRINT_TRIO;
+
+#if !defined(BIODATA_HOST) || defined(FOOTPRINT_CHECK_HOST)
+static_assert(sizeof(Heart) <= FOOTPRINT_HEART_BUDGET, "Heart exceeds FOOTPRINT_HEART_BUDGET");
+static_assert(sizeof(SkinConductance) <= FOOTPRINT_SKIN_CONDUCTANCE_BUDGET,
+              "SkinConductance exceeds FOOTPRINT_SKIN_CONDUCTANCE_BUDGET");
+static_assert(sizeof(Respiration) <= FOOTPRINT_RESPIRATION_BUDGET, "Respiration exceeds FOOTPRINT_RESPIRATION_BUDGET");
+static_assert(sizeof(PulseRespiration) <= FOOTPRINT_PULSE_RESPIRATION_BUDGET,
+              "PulseRespiration exceeds FOOTPRINT_PULSE_RESPIRATION_BUDGET");
+static_assert(sizeof(PulseTransit) <= FOOTPRINT_PULSE_TRANSIT_BUDGET,
+              "PulseTransit exceeds FOOTPRINT_PULSE_TRANSIT_BUDGET");
+static_assert(sizeof(PulseMorphology) <= FOOTPRINT_PULSE_MORPHOLOGY_BUDGET,
+              "PulseMorphology exceeds FOOTPRINT_PULSE_MORPHOLOGY_BUDGET");
+static_assert(sizeof(HrvComplexity) <= FOOTPRINT_HRV_COMPLEXITY_BUDGET,
+              "HrvComplexity exceeds FOOTPRINT_HRV_COMPLEXITY_BUDGET");
+static_assert(sizeof(OscEncoder) <= FOOTPRINT_OSC_ENCODER_BUDGET, "OscEncoder exceeds FOOTPRINT_OSC_ENCODER_BUDGET");
+static_assert(sizeof(SampleLogger) <= FOOTPRINT_SAMPLE_LOGGER_BUDGET,
+              "SampleLogger exceeds FOOTPRINT_SAMPLE_LOGGER_BUDGET");
+static_assert(sizeof(Pyramid) <= FOOTPRINT_PYRAMID_BUDGET, "Pyramid exceeds FOOTPRINT_PYRAMID_BUDGET");
+static_assert(sizeof(PyramidLogger) <= FOOTPRINT_PYRAMID_LOGGER_BUDGET,
+              "PyramidLogger exceeds FOOTPRINT_PYRAMID_LOGGER_BUDGET");
+static_assert(sizeof(RiceEncoder) <= FOOTPRINT_RICE_ENCODER_BUDGET, "RiceEncoder exceeds FOOTPRINT_RICE_ENCODER_BUDGET");
+
+static_assert(FOOTPRINT_OSC_OUTPUT <= FOOTPRINT_RAM_BUDGET, "OscOutput configuration exceeds FOOTPRINT_RAM_BUDGET");
+static_assert(FOOTPRINT_SAMPLE_LOGGER <= FOOTPRINT_RAM_BUDGET, "SampleLogger configuration exceeds FOOTPRINT_RAM_BUDGET");
+static_assert(FOOTPRINT_PYRAMID <= FOOTPRINT_RAM_BUDGET, "Pyramid configuration exceeds FOOTPRINT_RAM_BUDGET");
+static_assert(FOOTPRINT_COMPRESSION <= FOOTPRINT_RAM_BUDGET, "Compression configuration exceeds FOOTPRINT_RAM_BUDGET");
+#endif
+
+/// Bytes of heap in use (malloc'ed and not freed), for measuring constructors.
+inline size_t footprintHeapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+  return mallinfo2().uordblks;
+#else
+  return mallinfo().uordblks;
+#endif
+}
+
+/**
+ * Constructs a T from #args# in #storage# (sizeof(T) bytes, aligned for T) and
+ * returns the heap allocated by its constructor. The object is left alive.
+ */
+template <class T, class... Args>
+size_t footprintHeap(void* storage, Args&&... args) {
+  size_t before = footprintHeapInUse();
+  new (storage) T(std::forward<Args>(args)...);
+  return footprintHeapInUse() - before;
+}
+
+#endif
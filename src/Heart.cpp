@@ -27,6 +27,10 @@
  */
 #include "Heart.h"
 
+// After a load, a first sample more than this (ms) after the saved one, or
+// before it, comes from another clock.
+#define HEART_RESTORE_MAX_GAP 1000
+
 Heart::Heart(uint8_t pin, unsigned long rate) :
 _pin(pin),
 heartThresh(0.25, 0.4),              // if signal does not fall below (low, high) bounds than signal is ignored
@@ -65,8 +69,14 @@ void Heart::setMinMaxSmoothing(float smoothing)
     heartMinMaxSmoothing = constrain(smoothing, 0, 1);
 }
 
+void Heart::setThreshold(float lower, float upper)
+{
+    heartThresh.setBounds(lower, upper);
+}
+
 void Heart::reset() {
     heartMinMax.reset();
+    heartThresh.reset();
     heartSensorAmplitudeLop.reset();
     heartSensorBpmLop.reset();
     heartSensorAmplitudeLopValueMinMax.reset();
@@ -77,6 +87,9 @@ void Heart::reset() {
 
     bpm = 60;
     beat = false;
+    beats = 0;
+    beatInterval = 0;
+    restored = false;
 
     prevSampleMicros = micros();
 
@@ -89,13 +102,15 @@ void Heart::setSampleRate(unsigned long rate) {
     microsBetweenSamples = 1000000UL / sampleRate;
 }
 
-void Heart::update() {
+bool Heart::update() {
     unsigned long t = micros();
     if (t - prevSampleMicros >= microsBetweenSamples) {
         // Perform updates.
         sample();
         prevSampleMicros = t;
+        return true;
     }
+    return false;
 }
 
 float Heart::getNormalized() const {
@@ -122,10 +137,110 @@ int Heart::getRaw() const {
     return heartSensorReading;
 }
 
+float Heart::getInterval() const {
+    return beatInterval;
+}
+
+float Heart::getAmplitude() const {
+    return heartSensorAmplitude;
+}
+
+void Heart::save(SnapshotWriter& out) const {
+    out.writeUInt8('H');
+    heartMinMax.save(out);
+    heartThresh.save(out);
+    heartSensorAmplitudeLop.save(out);
+    heartSensorBpmLop.save(out);
+    heartSensorAmplitudeLopValueMinMax.save(out);
+    heartSensorBpmLopValueMinMax.save(out);
+    out.writeFloat(heartSensorAmplitudeLopValue);
+    out.writeFloat(heartSensorBpmLopValue);
+    out.writeFloat(heartSensorAmplitudeLopValueMinMaxValue);
+    out.writeFloat(heartSensorBpmLopValueMinMaxValue);
+    out.writeFloat(heartSensorFiltered);
+    out.writeFloat(heartSensorAmplitude);
+    out.writeFloat(heartSensorReading);
+    out.writeFloat(bpm);
+    out.writeBool(beat);
+    out.writeUInt32(beats);
+    out.writeFloat(beatInterval);
+    out.writeUInt32(bpmChronoStart);
+    out.writeUInt32(sampleMillis);
+}
+
+void Heart::load(SnapshotReader& in) {
+    // Read into copies, kept only if the whole record was read.
+    in.expect('H');
+    MinMax minMax = heartMinMax;
+    Threshold thresh = heartThresh;
+    Lop amplitudeLop = heartSensorAmplitudeLop;
+    Lop bpmLop = heartSensorBpmLop;
+    MinMax amplitudeLopValueMinMax = heartSensorAmplitudeLopValueMinMax;
+    MinMax bpmLopValueMinMax = heartSensorBpmLopValueMinMax;
+    minMax.load(in);
+    thresh.load(in);
+    amplitudeLop.load(in);
+    bpmLop.load(in);
+    amplitudeLopValueMinMax.load(in);
+    bpmLopValueMinMax.load(in);
+    float amplitudeLopValue = in.readFloat();
+    float bpmLopValue = in.readFloat();
+    float amplitudeLopValueMinMaxValue = in.readFloat();
+    float bpmLopValueMinMaxValue = in.readFloat();
+    float filtered = in.readFloat();
+    float amplitude = in.readFloat();
+    float reading = in.readFloat();
+    float savedBpm = in.readFloat();
+    bool savedBeat = in.readBool();
+    uint32_t savedBeats = in.readUInt32();
+    float interval = in.readFloat();
+    // Times of the last beat and sample, rebased on the next sample if the
+    // clock is not the same.
+    unsigned long chronoStart = in.readUInt32();
+    unsigned long lastSampleMillis = in.readUInt32();
+    if (!in.ok())
+        return;
+
+    heartMinMax = minMax;
+    heartThresh = thresh;
+    heartSensorAmplitudeLop = amplitudeLop;
+    heartSensorBpmLop = bpmLop;
+    heartSensorAmplitudeLopValueMinMax = amplitudeLopValueMinMax;
+    heartSensorBpmLopValueMinMax = bpmLopValueMinMax;
+    heartSensorAmplitudeLopValue = amplitudeLopValue;
+    heartSensorBpmLopValue = bpmLopValue;
+    heartSensorAmplitudeLopValueMinMaxValue = amplitudeLopValueMinMaxValue;
+    heartSensorBpmLopValueMinMaxValue = bpmLopValueMinMaxValue;
+    heartSensorFiltered = filtered;
+    heartSensorAmplitude = amplitude;
+    heartSensorReading = reading;
+    bpm = savedBpm;
+    beat = savedBeat;
+    beats = savedBeats;
+    beatInterval = interval;
+    bpmChronoStart = chronoStart;
+    sampleMillis = lastSampleMillis;
+    restored = true;
+    publish();
+}
+
 void Heart::sample() {
     // Read analog value if needed.
-    heartSensorReading = analogRead(_pin);  //this is a dummy read to clear the adc.  This is needed at higher sampling frequencies.
-    heartSensorReading = analogRead(_pin);
+    analogRead(_pin);  //this is a dummy read to clear the adc.  This is needed at higher sampling frequencies.
+    process(analogRead(_pin), millis());
+}
+
+void Heart::process(int reading, unsigned long ms) {
+    // Restored in another session (eg. after a reboot): keep the time since
+    // the last beat, as if this sample came one period after the saved one.
+    if (restored) {
+        if (ms - sampleMillis > HEART_RESTORE_MAX_GAP)
+            bpmChronoStart = ms - 1000 / sampleRate - (sampleMillis - bpmChronoStart);
+        restored = false;
+    }
+    sampleMillis = ms;
+
+    heartSensorReading = reading;
 
     heartSensorFiltered = heartMinMax.filter(heartSensorReading);
     heartSensorAmplitude = heartMinMax.getMax() - heartMinMax.getMin();
@@ -142,10 +257,33 @@ void Heart::sample() {
     beat = heartThresh.detect(heartSensorFiltered);
 
     if ( beat ) {
-        unsigned long ms = millis();
-        float temporaryBpm = 60000. / (ms - bpmChronoStart);
+        beatInterval = ms - bpmChronoStart;
+        float temporaryBpm = 60000. / beatInterval;
         bpmChronoStart = ms;
         if ( temporaryBpm > 30 && temporaryBpm < 200 ) // make sure the BPM is within bounds
             bpm = temporaryBpm;
+        beats++;
     }
+
+    publish();
+}
+
+void Heart::publish() {
+    Features f;
+    f.raw = (int)heartSensorReading;
+    f.normalized = heartSensorFiltered;
+    f.bpm = bpm;
+    f.bpmChange = heartSensorBpmLopValueMinMaxValue;
+    f.amplitudeChange = heartSensorAmplitudeLopValueMinMaxValue;
+    f.beats = beats;
+    f.beat = beat;
+    published.write(f);
+}
+
+uint32_t Heart::getFeatures(Features& features) const {
+    return published.read(features);
+}
+
+uint32_t Heart::getSampleCount() const {
+    return published.count();
 }
@@ -30,17 +30,37 @@
 #include "MinMax.h"
 #include "Threshold.h"
 #include "Lop.h"
+#include "Snapshot.h"
+#include "Seqlock.h"
 
 #ifndef HEART_H_
 #define HEART_H_
 
 class Heart {
-    
+public:
+    /// Features of one sample (see getFeatures()).
+    struct Features {
+        int raw;
+        float normalized;
+        float bpm;
+        float bpmChange;
+        float amplitudeChange;
+        uint32_t beats;  // beats detected since reset()
+        bool beat;
+    };
+
+private:
+
     // Analog pin the Heart sensor is connected to.
     uint8_t _pin;
     
     unsigned long bpmChronoStart;
     
+    // Time of the last sample, and whether the state was just loaded (see
+    // process()).
+    unsigned long sampleMillis;
+    bool restored;
+    
     MinMax heartMinMax;
     Threshold heartThresh;
     float heartMinMaxSmoothing;
@@ -68,6 +88,12 @@ class Heart {
     float bpm;  // this value is fed to initialize your BPM before a heartbeat is detected
     
     bool beat;
+    uint32_t beats;
+    float beatInterval;  // ms between the last two beats
+    
+    // Features of the last sample, for readers concurrent with update().
+    Seqlock<Features> published;
+    void publish();
     
     // Sample rate in Hz.
     unsigned long sampleRate;
@@ -86,6 +112,9 @@ public:
     void setBpmMinMaxSmoothing(float smoothing);
     void setMinMaxSmoothing(float smoothing);
     
+    /// Sets beat detection bounds on the normalized signal (default: 0.25, 0.4).
+    void setThreshold(float lower, float upper);
+    
     /// Resets all values.
     void reset();
     
@@ -96,8 +125,9 @@ public:
      * Reads the signal and perform filtering operations. Call this before
      * calling any of the access functions. This function takes into account
      * the sample rate.
+     * Returns true if a new sample was taken.
      */
-    void update();
+    bool update();
     
     /// Get normalized heartrate signal.
     float getNormalized() const;
@@ -111,6 +141,13 @@ public:
     /// Returns raw signal as returned by analogRead().
     int getRaw() const;
     
+    /// Returns the time between the last two beats in milliseconds, including
+    /// intervals rejected by the BPM bounds.
+    float getInterval() const;
+    
+    /// Returns the pulse amplitude (range of the raw signal over the last beats).
+    float getAmplitude() const;
+    
     ///Returns the average amplitude of signal mapped between 0.0 and 1.0.
     /* For example, if amplitude is average, returns 0.5,
      * if amplitude is below average, returns < 0.5
@@ -125,9 +162,35 @@ public:
      */
     float bpmChange() const;
     
+    /**
+     * Copies the features of the last sample into #features#, all from the
+     * same sample even if update() runs in an interrupt meanwhile (see
+     * Seqlock.h). Returns the number of times the features were published
+     * since the sensor was created: once per sample and once per load(), so
+     * a different value means new features.
+     */
+    uint32_t getFeatures(Features& features) const;
+    
+    /// Returns the same count as getFeatures(), without copying the features.
+    /// Classes fed from a Heart use it to process each sample only once.
+    uint32_t getSampleCount() const;
+    
+    /// Saves the state of all filters (see Snapshot.h).
+    void save(SnapshotWriter& out) const;
+    
+    /// Restores the state of all filters (see Snapshot.h).
+    void load(SnapshotReader& in);
+    
     // Performs the actual adjustments of signals and filterings.
-    // Internal use: don't use directly, use update() instead.
+    // Use update() instead, unless samples are timed elsewhere (eg. timer interrupt).
     void sample();
+    
+    /**
+     * Processes a reading acquired elsewhere (eg. replay of a recording) as
+     * returned by getRaw(), taken at time #ms# (in milliseconds). Does not
+     * depend on the board's clock or analog inputs.
+     */
+    void process(int reading, unsigned long ms);
 };
 
 #endif
\ No newline at end of file
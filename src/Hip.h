@@ -23,6 +23,10 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
  #include <Arduino.h>
+ #include "Snapshot.h"
+
+#ifndef HIP_H_
+#define HIP_H_
 
 class Hip {
   float value;
@@ -39,5 +43,24 @@ class Hip {
     previousInput = input;
     return value;
   }
+
+  /// Saves filter state (see Snapshot.h).
+  void save(SnapshotWriter& out) const {
+    out.writeUInt8('P');
+    out.writeFloat(value);
+    out.writeFloat(previousInput);
+  }
+
+  /// Restores filter state (see Snapshot.h).
+  void load(SnapshotReader& in) {
+    in.expect('P');
+    float v = in.readFloat();
+    float p = in.readFloat();
+    if (in.ok()) {
+      value = v;
+      previousInput = p;
+    }
+  }
 };
 
+#endif
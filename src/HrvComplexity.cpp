@@ -0,0 +1,285 @@
+/*
+ * HrvComplexity.cpp
+ *
+ * This class measures the complexity of the heart rate from Heart's beat
+ * intervals: sample entropy and DFA alpha1.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "HrvComplexity.h"
+
+// Beat intervals outside these bounds (ms) are artifacts or missed beats.
+#define HRV_COMPLEXITY_MIN_BEAT  250
+#define HRV_COMPLEXITY_MAX_BEAT  2000
+
+// Relative drift of the standard deviation that retunes the tolerance.
+#define HRV_COMPLEXITY_RETUNE 0.1f
+
+HrvComplexity::HrvComplexity() :
+  toleranceFactor(0.2f)
+{
+  reset();
+}
+
+void HrvComplexity::reset() {
+  memset(intervals, 0, sizeof(intervals));
+  nBeats = 0;
+  count = 0;
+  sum = 0;
+  sumSquares = 0;
+  tolerance = 0;
+  toleranceStdDev = 0;
+  pairsM = pairsM1 = 0;
+  lastHeartSample = 0;
+  for (int s = 0; s < HRV_DFA_N_BOXES; s++) {
+    residuals[s] = 0;
+    nBoxes[s] = 0;
+  }
+  sampleEntropy = alpha1 = NAN;
+}
+
+void HrvComplexity::setTolerance(float stdDevs) {
+  toleranceFactor = (stdDevs > 0) ? stdDevs : 0;
+  tolerance = 0;  // retuned now
+  updateTolerance();
+  updateEntropy();
+}
+
+bool HrvComplexity::process(const Heart& heart) {
+  uint32_t sample = heart.getSampleCount();
+  if (sample == lastHeartSample || !heart.beatDetected())
+    return false;
+  lastHeartSample = sample;
+  return addInterval(heart.getInterval());
+}
+
+bool HrvComplexity::addInterval(float ms) {
+  if (!(ms >= HRV_COMPLEXITY_MIN_BEAT && ms <= HRV_COMPLEXITY_MAX_BEAT))
+    return false;
+
+  // Oldest interval leaves a full window.
+  if (count == HRV_COMPLEXITY_WINDOW) {
+    uint32_t oldest = nBeats - count;
+    for (int s = 0; s < HRV_DFA_N_BOXES; s++) {
+      int n = HRV_DFA_MIN_BOX + s;
+      if (oldest % n == 0) {
+        residuals[s] -= boxResiduals(oldest, n);
+        nBoxes[s]--;
+      }
+    }
+    countPairs(oldest, false, -1);
+    int32_t x = at(oldest);
+    sum -= x;
+    sumSquares -= x * x;
+    count--;
+  }
+
+  int16_t x = (int16_t)(ms * HRV_COMPLEXITY_SCALE + 0.5f);
+  intervals[nBeats % HRV_COMPLEXITY_WINDOW] = x;
+  nBeats++;
+  count++;
+  sum += x;
+  sumSquares += (int32_t)x * x;
+
+  // Pairs of the template that now has its m + 1 intervals.
+  if (count > HRV_COMPLEXITY_M)
+    countPairs(nBeats - 1 - HRV_COMPLEXITY_M, true, 1);
+
+  // Boxes completed by this interval.
+  uint32_t newest = nBeats - 1;
+  for (int s = 0; s < HRV_DFA_N_BOXES; s++) {
+    int n = HRV_DFA_MIN_BOX + s;
+    if (nBeats % n == 0 && n <= (int)count) {
+      residuals[s] += boxResiduals(newest + 1 - n, n);
+      nBoxes[s]++;
+    }
+  }
+
+  // Residual sums are rebuilt every window so that rounding errors do not
+  // accumulate (on the beat count, so that snapshots restore them exactly).
+  if (nBeats % HRV_COMPLEXITY_WINDOW == 0) {
+    uint32_t oldest = nBeats - count;
+    for (int s = 0; s < HRV_DFA_N_BOXES; s++) {
+      int n = HRV_DFA_MIN_BOX + s;
+      residuals[s] = 0;
+      for (uint32_t first = (oldest + n - 1) / n * n; first + n <= nBeats; first += n)
+        residuals[s] += boxResiduals(first, n);
+    }
+  }
+
+  updateTolerance();
+  updateEntropy();
+  updateAlpha1();
+  return true;
+}
+
+void HrvComplexity::countPairs(uint32_t j, bool before, int sign) {
+  if (count <= HRV_COMPLEXITY_M)
+    return;
+  // Templates are counted while their m + 1 intervals are in the window.
+  uint32_t first = nBeats - count;
+  uint32_t last = nBeats - 1 - HRV_COMPLEXITY_M;
+  uint32_t from = before ? first : j + 1;
+  uint32_t to = before ? j : last + 1;
+  for (uint32_t i = from; i < to; i++) {
+    int k = 0;
+    while (k < HRV_COMPLEXITY_M && abs(at(i + k) - at(j + k)) <= tolerance)
+      k++;
+    if (k < HRV_COMPLEXITY_M)
+      continue;
+    pairsM += sign;
+    if (abs(at(i + HRV_COMPLEXITY_M) - at(j + HRV_COMPLEXITY_M)) <= tolerance)
+      pairsM1 += sign;
+  }
+}
+
+void HrvComplexity::recount() {
+  pairsM = pairsM1 = 0;
+  if (count <= HRV_COMPLEXITY_M)
+    return;
+  for (uint32_t j = nBeats - count; j <= nBeats - 1 - HRV_COMPLEXITY_M; j++)
+    countPairs(j, true, 1);
+}
+
+float HrvComplexity::boxResiduals(uint32_t first, int n) const {
+  // Profile (cumulative sum) of the box: any offset of the intervals only
+  // adds a linear trend, which the fit removes.
+  float y[HRV_DFA_MAX_BOX];
+  float cumulative = 0, meanY = 0;
+  int16_t offset = at(first);
+  for (int k = 0; k < n; k++) {
+    cumulative += at(first + k) - offset;
+    y[k] = cumulative;
+    meanY += cumulative;
+  }
+  meanY /= n;
+
+  // Least-squares line: residuals = Syy - Sky^2 / Skk.
+  float meanK = (n - 1) / 2.0f;
+  float skk = n * ((float)n * n - 1) / 12.0f;
+  float sky = 0, syy = 0;
+  for (int k = 0; k < n; k++) {
+    float dy = y[k] - meanY;
+    sky += (k - meanK) * dy;
+    syy += dy * dy;
+  }
+  float residuals = syy - sky * sky / skk;
+  return (residuals > 0) ? residuals : 0;
+}
+
+void HrvComplexity::updateTolerance() {
+  if (count < 2)
+    return;
+  // Exact in 64 bits: both terms are large and close.
+  int64_t spread = (int64_t)count * sumSquares - (int64_t)sum * sum;
+  float variance = (float)spread / ((float)count * (count - 1));
+  float stdDev = (variance > 0) ? sqrt(variance) : 0;
+  if (tolerance > 0 && abs(stdDev - toleranceStdDev) <= HRV_COMPLEXITY_RETUNE * toleranceStdDev)
+    return;
+  int32_t retuned = (int32_t)(toleranceFactor * stdDev + 0.5f);
+  if (retuned < 1)
+    retuned = 1;
+  toleranceStdDev = stdDev;
+  if (retuned != tolerance) {
+    tolerance = retuned;
+    recount();
+  }
+}
+
+void HrvComplexity::updateEntropy() {
+  sampleEntropy = (pairsM > 0 && pairsM1 > 0) ? -log((float)pairsM1 / pairsM) : NAN;
+}
+
+void HrvComplexity::updateAlpha1() {
+  // Slope of log F(n) against log n.
+  float sumX = 0, sumY = 0, sumXX = 0, sumXY = 0;
+  for (int s = 0; s < HRV_DFA_N_BOXES; s++) {
+    int n = HRV_DFA_MIN_BOX + s;
+    if (nBoxes[s] < 2 || residuals[s] <= 0) {
+      alpha1 = NAN;
+      return;
+    }
+    float x = log((float)n);
+    float y = 0.5f * log(residuals[s] / (nBoxes[s] * n));
+    sumX += x; sumY += y; sumXX += x * x; sumXY += x * y;
+  }
+  const float n = HRV_DFA_N_BOXES;
+  alpha1 = (n * sumXY - sumX * sumY) / (n * sumXX - sumX * sumX);
+}
+
+float HrvComplexity::getSampleEntropy() const {
+  return sampleEntropy;
+}
+
+float HrvComplexity::getDfaAlpha1() const {
+  return alpha1;
+}
+
+float HrvComplexity::getTolerance() const {
+  return (float)tolerance / HRV_COMPLEXITY_SCALE;
+}
+
+unsigned int HrvComplexity::getIntervalCount() const {
+  return count;
+}
+
+void HrvComplexity::save(SnapshotWriter& out) const {
+  out.writeUInt8('E');
+  // Intervals in pairs.
+  for (int i = 0; i < HRV_COMPLEXITY_WINDOW; i += 2)
+    out.writeUInt32((uint16_t)intervals[i] | ((uint32_t)(uint16_t)intervals[i + 1] << 16));
+  out.writeUInt32(nBeats);
+  out.writeUInt32(count);
+  out.writeUInt32(sum);
+  out.writeUInt32((uint32_t)sumSquares);
+  out.writeUInt32((uint32_t)(sumSquares >> 32));
+  out.writeUInt32(tolerance);
+  out.writeFloat(toleranceStdDev);
+  out.writeUInt32(pairsM);
+  out.writeUInt32(pairsM1);
+  for (int s = 0; s < HRV_DFA_N_BOXES; s++) {
+    out.writeFloat(residuals[s]);
+    out.writeUInt32(nBoxes[s]);
+  }
+  out.writeFloat(sampleEntropy);
+  out.writeFloat(alpha1);
+}
+
+void HrvComplexity::load(SnapshotReader& in) {
+  in.expect('E');
+  for (int i = 0; i < HRV_COMPLEXITY_WINDOW; i += 2) {
+    uint32_t pair = in.readUInt32();
+    intervals[i] = (int16_t)(pair & 0xFFFF);
+    intervals[i + 1] = (int16_t)(pair >> 16);
+  }
+  nBeats = in.readUInt32();
+  count = in.readUInt32();
+  sum = (int32_t)in.readUInt32();
+  uint32_t low = in.readUInt32();
+  sumSquares = (int64_t)(((uint64_t)in.readUInt32() << 32) | low);
+  tolerance = (int32_t)in.readUInt32();
+  toleranceStdDev = in.readFloat();
+  pairsM = in.readUInt32();
+  pairsM1 = in.readUInt32();
+  for (int s = 0; s < HRV_DFA_N_BOXES; s++) {
+    residuals[s] = in.readFloat();
+    nBoxes[s] = (uint16_t)in.readUInt32();
+  }
+  sampleEntropy = in.readFloat();
+  alpha1 = in.readFloat();
+  lastHeartSample = 0;  // not saved: counts differ between Heart instances
+}
@@ -0,0 +1,166 @@
+/*
+ * HrvComplexity.h
+ *
+ * This class measures the complexity of the heart rate over the last
+ * HRV_COMPLEXITY_WINDOW beat intervals from Heart:
+ *  - sample entropy (m = 2, tolerance r = 0.2 standard deviations): the
+ *    negative log of the probability that intervals similar over two beats
+ *    stay similar over the third;
+ *  - DFA alpha1: the short-term scaling exponent of detrended fluctuation
+ *    analysis, over boxes of 4 to 16 beats (0.5 for uncorrelated intervals,
+ *    1 for 1/f, 1.5 for a random walk).
+ *
+ * Both are updated as intervals enter and leave the window instead of being
+ * recomputed over it:
+ *  - the similar pairs of the sample entropy are counted once: an interval
+ *    entering the window is compared with the others, and the pairs of the
+ *    one leaving are removed, which costs O(window) per beat instead of
+ *    O(window^2). The counts depend on the tolerance, so they are recounted
+ *    (O(window^2)) every time the standard deviation drifts by more than
+ *    HRV_COMPLEXITY_RETUNE from the one the tolerance was last set from;
+ *  - the boxes of the DFA are fixed on the beat count: each box size adds
+ *    the fluctuation of a box when it completes and removes it when it
+ *    leaves the window, which costs O(box) every box, so about one pass
+ *    over the box sizes per beat.
+ * Intervals are stored as integers in 1/HRV_COMPLEXITY_SCALE milliseconds,
+ * and compared in integer arithmetic (Teensy 3.1 has no floating point
+ * unit). The tolerance is rounded to the same unit, so that it stays within
+ * 1% of 0.2 standard deviations even when they are a few milliseconds.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include "Heart.h"
+#include "Snapshot.h"
+
+#ifndef HRV_COMPLEXITY_H_
+#define HRV_COMPLEXITY_H_
+
+// Beat intervals in the window.
+#ifndef HRV_COMPLEXITY_WINDOW
+#define HRV_COMPLEXITY_WINDOW 256
+#endif
+
+// Units of the stored intervals per millisecond (2000 ms must fit in 16 bits).
+#define HRV_COMPLEXITY_SCALE 16
+
+// Template length of the sample entropy.
+#define HRV_COMPLEXITY_M 2
+
+// Box sizes of DFA alpha1, in beats.
+#define HRV_DFA_MIN_BOX 4
+#define HRV_DFA_MAX_BOX 16
+#define HRV_DFA_N_BOXES (HRV_DFA_MAX_BOX - HRV_DFA_MIN_BOX + 1)
+
+class HrvComplexity {
+
+  // Intervals of the window (1/HRV_COMPLEXITY_SCALE ms): beat #b# at
+  // b % HRV_COMPLEXITY_WINDOW.
+  int16_t intervals[HRV_COMPLEXITY_WINDOW];
+
+  // Intervals added since reset(), and in the window.
+  uint32_t nBeats;
+  unsigned int count;
+
+  // Sums of the window, for the standard deviation.
+  int32_t sum;
+  int64_t sumSquares;
+
+  // Sample entropy: tolerance (same unit as the intervals), standard
+  // deviation it was set from, and similar pairs of templates of length m
+  // (B) and m + 1 (A).
+  int32_t tolerance;
+  float toleranceStdDev;
+  uint32_t pairsM;
+  uint32_t pairsM1;
+
+  // DFA: sums of squared residuals of the boxes in the window, and number
+  // of boxes, per box size.
+  float residuals[HRV_DFA_N_BOXES];
+  uint16_t nBoxes[HRV_DFA_N_BOXES];
+
+  float sampleEntropy;
+  float alpha1;
+
+  // Heart sample last processed (see Heart::getSampleCount()).
+  uint32_t lastHeartSample;
+
+  // Tuning.
+  float toleranceFactor;
+
+  int16_t at(uint32_t beat) const { return intervals[beat % HRV_COMPLEXITY_WINDOW]; }
+
+  // Counts the similar pairs between template #j# and the templates of the
+  // window before (#before#) or after it, with #sign#.
+  void countPairs(uint32_t j, bool before, int sign);
+
+  // Recounts all the pairs of the window.
+  void recount();
+
+  // Sum of squared residuals of the box of #n# beats starting at #first#.
+  float boxResiduals(uint32_t first, int n) const;
+
+  void updateTolerance();
+  void updateEntropy();
+  void updateAlpha1();
+
+public:
+  HrvComplexity();
+  virtual ~HrvComplexity() {}
+
+  /// Resets all values.
+  void reset();
+
+  /// Sets the tolerance of the sample entropy in standard deviations of
+  /// the intervals (default: 0.2).
+  void setTolerance(float stdDevs);
+
+  /**
+   * Call after each Heart update(): on the samples where a beat was
+   * detected, adds its interval. Calling it again before the next sample
+   * does nothing. Returns true if an interval was added.
+   */
+  bool process(const Heart& heart);
+
+  /**
+   * Adds a beat interval in milliseconds (eg. from a recording). Intervals
+   * outside 250 to 2000 ms are artifacts or missed beats, and ignored.
+   * Returns true if the interval was added.
+   */
+  bool addInterval(float ms);
+
+  /// Returns the sample entropy of the window, NAN until defined (no
+  /// similar templates yet).
+  float getSampleEntropy() const;
+
+  /// Returns DFA alpha1 of the window, NAN until every box size fits twice.
+  float getDfaAlpha1() const;
+
+  /// Returns the tolerance of the sample entropy in milliseconds.
+  float getTolerance() const;
+
+  /// Returns the number of intervals in the window.
+  unsigned int getIntervalCount() const;
+
+  /// Saves the window and the counts (see Snapshot.h).
+  void save(SnapshotWriter& out) const;
+
+  /// Restores the window and the counts (see Snapshot.h).
+  void load(SnapshotReader& in);
+};
+
+#endif
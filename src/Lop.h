@@ -21,6 +21,7 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include <Arduino.h>
+#include "Snapshot.h"
 
 #ifndef LOP_H_
 #define LOP_H_
@@ -81,6 +82,24 @@ public:
     return value;
   }
 
+  /// Saves filter state (see Snapshot.h).
+  void save(SnapshotWriter& out) const {
+    out.writeUInt8('L');
+    out.writeFloat(value);
+    out.writeUInt32(n);
+  }
+
+  /// Restores filter state (see Snapshot.h).
+  void load(SnapshotReader& in) {
+    in.expect('L');
+    float v = in.readFloat();
+    unsigned int nSamples = in.readUInt32();
+    if (in.ok()) {
+      value = v;
+      n = nSamples;
+    }
+  }
+
 };
 
 #endif
@@ -25,6 +25,7 @@
 
 ******************************************************/
 #include <Arduino.h>
+#include "Snapshot.h"
 
 #ifndef MIN_MAX_H_
 #define MIN_MAX_H_
@@ -84,6 +85,33 @@ class MinMax {
       return min;
     }
 
+    /// Saves normalizer state (see Snapshot.h).
+    void save(SnapshotWriter& out) const {
+      out.writeUInt8('M');
+      out.writeFloat(input);
+      out.writeFloat(min);
+      out.writeFloat(max);
+      out.writeFloat(value);
+      out.writeBool(firstPass);
+    }
+
+    /// Restores normalizer state (see Snapshot.h).
+    void load(SnapshotReader& in) {
+      in.expect('M');
+      float i = in.readFloat();
+      float mn = in.readFloat();
+      float mx = in.readFloat();
+      float v = in.readFloat();
+      bool first = in.readBool();
+      if (in.ok()) {
+        input = i;
+        min = mn;
+        max = mx;
+        value = v;
+        firstPass = first;
+      }
+    }
+
 
 };
 
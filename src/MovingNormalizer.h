@@ -0,0 +1,137 @@
+/* This file is part of the BioData project
+* (c) 2018 Erin Gee   http://www.eringee.net
+*
+* Normalizes a signal to a target mean and standard deviation using a moving
+* average and variance over a time window counted in samples, so that its
+* time constant follows the rate at which it is fed (see Respiration).
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "Snapshot.h"
+
+#ifndef MOVING_NORMALIZER_H_
+#define MOVING_NORMALIZER_H_
+
+class MovingNormalizer {
+
+  // Target mean and standard deviation.
+  float targetMean;
+  float targetStdDev;
+
+  // Smoothing factor of the moving statistics.
+  float alpha;
+
+  // Moving statistics.
+  float mean;
+  float var;
+
+  // Current (normalized) value.
+  float value;
+
+  // N. samples seen thus far.
+  unsigned int n;
+
+  // N. samples in calibration phase.
+  unsigned int nCalibration;
+
+public:
+
+  /// Constructor: time window of #nSamples# samples.
+  MovingNormalizer(float targetMean_=0, float targetStdDev_=1, unsigned int nSamples=100) {
+    setTarget(targetMean_, targetStdDev_);
+    setTimeWindowBySamples(nSamples);
+    reset();
+  }
+
+  /// Resets statistics.
+  void reset() {
+    mean = var = 0;
+    value = targetMean;
+    n = 0;
+  }
+
+  /// Sets the mean and standard deviation of the output.
+  void setTarget(float targetMean_, float targetStdDev_) {
+    targetMean = targetMean_;
+    targetStdDev = targetStdDev_;
+  }
+
+  /// Sets the time window of the statistics, in samples.
+  void setTimeWindowBySamples(unsigned int nSamples) {
+    if (nSamples < 1) nSamples = 1;
+    alpha = 2.0 / (nSamples + 1);
+    nCalibration = nSamples;
+  }
+
+  /// Updates the statistics with #input# and returns it normalized.
+  float filter(float input) {
+    // For the first #nCalibration# samples compute plain statistics;
+    // after that, exponential moving ones.
+    float a = alpha;
+    if (n < nCalibration) {
+      n++;
+      a = 1.0f / n;
+    }
+    float delta = input - mean;
+    mean += delta * a;
+    var = (1 - a) * (var + a * delta * delta);
+
+    float stdDev = getStdDev();
+    value = (stdDev > 0) ? targetMean + (input - mean) / stdDev * targetStdDev : targetMean;
+    return value;
+  }
+
+  /// Returns the last normalized value.
+  float get() const {
+    return value;
+  }
+
+  /// Returns the moving average of the input.
+  float getMean() const {
+    return mean;
+  }
+
+  /// Returns the moving standard deviation of the input.
+  float getStdDev() const {
+    return sqrt(var);
+  }
+
+  /// Saves normalizer state (see Snapshot.h).
+  void save(SnapshotWriter& out) const {
+    out.writeUInt8('N');
+    out.writeFloat(mean);
+    out.writeFloat(var);
+    out.writeFloat(value);
+    out.writeUInt32(n);
+  }
+
+  /// Restores normalizer state (see Snapshot.h).
+  void load(SnapshotReader& in) {
+    in.expect('N');
+    float m = in.readFloat();
+    float v = in.readFloat();
+    float x = in.readFloat();
+    unsigned int nSamples = in.readUInt32();
+    if (in.ok()) {
+      mean = m;
+      var = v;
+      value = x;
+      n = nSamples;
+    }
+  }
+
+};
+
+#endif
@@ -0,0 +1,114 @@
+/* This file is part of the BioData project
+* (c) 2018 Erin Gee   http://www.eringee.net
+*
+* Scales a signal between 0 and 1 according to its minimum and maximum.
+* Like MinMax, but the bounds relax towards the signal over a time window
+* counted in samples, so that its time constant follows the rate at which it
+* is fed (see Respiration).
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "Snapshot.h"
+
+#ifndef MOVING_SCALER_H_
+#define MOVING_SCALER_H_
+
+class MovingScaler {
+
+  // Relaxation factor of the bounds (0 = bounds never relax).
+  float alpha;
+
+  float min;
+  float max;
+  float value;
+  bool firstPass;
+
+public:
+
+  /// Constructor: time window of #nSamples# samples (0 = infinite).
+  MovingScaler(unsigned int nSamples=0) {
+    setTimeWindowBySamples(nSamples);
+    reset();
+  }
+
+  /// Resets bounds.
+  void reset() {
+    min = max = 0;
+    value = 0.5;
+    firstPass = true;
+  }
+
+  /// Sets the time window of the bounds, in samples (0 = infinite).
+  void setTimeWindowBySamples(unsigned int nSamples) {
+    alpha = nSamples ? 2.0 / (nSamples + 1) : 0;
+  }
+
+  /// Updates the bounds with #input# and returns it scaled in [0, 1].
+  float filter(float input) {
+    if (firstPass) {
+      firstPass = false;
+      min = max = input;
+    } else {
+      if (input < min) min = input;
+      else min += (input - min) * alpha;
+
+      if (input > max) max = input;
+      else max += (input - max) * alpha;
+    }
+
+    value = (max == min) ? 0.5 : (input - min) / (max - min);
+    return value;
+  }
+
+  /// Returns the last scaled value.
+  float get() const {
+    return value;
+  }
+
+  float getMin() const {
+    return min;
+  }
+
+  float getMax() const {
+    return max;
+  }
+
+  /// Saves scaler state (see Snapshot.h).
+  void save(SnapshotWriter& out) const {
+    out.writeUInt8('C');
+    out.writeFloat(min);
+    out.writeFloat(max);
+    out.writeFloat(value);
+    out.writeBool(firstPass);
+  }
+
+  /// Restores scaler state (see Snapshot.h).
+  void load(SnapshotReader& in) {
+    in.expect('C');
+    float mn = in.readFloat();
+    float mx = in.readFloat();
+    float v = in.readFloat();
+    bool first = in.readBool();
+    if (in.ok()) {
+      min = mn;
+      max = mx;
+      value = v;
+      firstPass = first;
+    }
+  }
+
+};
+
+#endif
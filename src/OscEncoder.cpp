@@ -0,0 +1,245 @@
+/*
+ * OscEncoder.cpp
+ *
+ * This class serializes BioData features into SLIP-framed OSC bundles, ready
+ * to be sent over a serial link to Max, Pd, TouchDesigner, etc.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "OscEncoder.h"
+#include "Heart.h"
+#include "SkinConductance.h"
+#include "Respiration.h"
+
+// Size of a string once null-terminated and padded to a multiple of 4 bytes.
+static inline uint16_t oscPaddedSize(size_t length) {
+  return (length + 4) & ~3;
+}
+
+// Header: "#bundle\0" followed by the 8 bytes timetag.
+#define OSC_BUNDLE_HEADER_SIZE 16
+
+OscEncoder::OscEncoder() {
+  clear();
+}
+
+void OscEncoder::clear() {
+  memset(_buffer, 0, sizeof(_buffer));
+  memcpy(_buffer, "#bundle", 8);
+  _size = OSC_BUNDLE_HEADER_SIZE;
+  _nMessages = 0;
+  setTimeTag(0, 1); // OSC "immediately"
+}
+
+void OscEncoder::writeInt32(uint16_t offset, uint32_t value) {
+  // OSC is big-endian.
+  _buffer[offset]   = (uint8_t)(value >> 24);
+  _buffer[offset+1] = (uint8_t)(value >> 16);
+  _buffer[offset+2] = (uint8_t)(value >> 8);
+  _buffer[offset+3] = (uint8_t)(value);
+}
+
+int OscEncoder::addMessage(const char* address, const char* typeTags) {
+  if (_nMessages >= OSC_ENCODER_MAX_MESSAGES || address[0] != '/')
+    return -1;
+
+  if (typeTags[0] == ',')
+    typeTags++;
+  size_t nArgs = strlen(typeTags);
+  for (size_t i = 0; i < nArgs; i++) {
+    if (typeTags[i] != 'f' && typeTags[i] != 'i')
+      return -1;
+  }
+
+  uint16_t addressSize = oscPaddedSize(strlen(address));
+  uint16_t typeTagsSize = oscPaddedSize(nArgs + 1); // with leading comma
+  uint16_t messageSize = addressSize + typeTagsSize + 4 * nArgs;
+  if (_size + 4 + messageSize > OSC_ENCODER_MAX_SIZE)
+    return -1;
+
+  // Element size, address and type tags never change after this point.
+  uint16_t offset = _size;
+  writeInt32(offset, messageSize);
+  offset += 4;
+  memcpy(&_buffer[offset], address, strlen(address));
+  offset += addressSize;
+  _buffer[offset] = ',';
+  memcpy(&_buffer[offset+1], typeTags, nArgs);
+  offset += typeTagsSize;
+
+  _argOffset[_nMessages] = offset;
+  _nArgs[_nMessages] = nArgs;
+  _size = offset + 4 * nArgs;
+
+  return _nMessages++;
+}
+
+int OscEncoder::addHeart(const char* address) {
+  return addMessage(address, ",ffffi");
+}
+
+int OscEncoder::addSkinConductance(const char* address) {
+  return addMessage(address, ",ffi");
+}
+
+int OscEncoder::addRespiration(const char* address) {
+  return addMessage(address, ",fiffff");
+}
+
+void OscEncoder::setTimeTag(uint32_t seconds, uint32_t fraction) {
+  writeInt32(8, seconds);
+  writeInt32(12, fraction);
+}
+
+void OscEncoder::setTimeTagMicros(unsigned long us) {
+  uint32_t seconds = us / 1000000UL;
+  uint32_t fraction = (uint32_t)(((uint64_t)(us % 1000000UL) << 32) / 1000000UL);
+  setTimeTag(seconds, fraction);
+}
+
+void OscEncoder::setFloat(int message, uint8_t arg, float value) {
+  if (message < 0 || message >= _nMessages || arg >= _nArgs[message])
+    return;
+  uint32_t bits;
+  memcpy(&bits, &value, 4);
+  writeInt32(_argOffset[message] + 4 * arg, bits);
+}
+
+void OscEncoder::setInt(int message, uint8_t arg, int32_t value) {
+  if (message < 0 || message >= _nMessages || arg >= _nArgs[message])
+    return;
+  writeInt32(_argOffset[message] + 4 * arg, (uint32_t)value);
+}
+
+void OscEncoder::setHeart(int message, const Heart& heart) {
+  setFloat(message, 0, heart.getNormalized());
+  setFloat(message, 1, heart.getBPM());
+  setFloat(message, 2, heart.bpmChange());
+  setFloat(message, 3, heart.amplitudeChange());
+  setInt(message, 4, heart.beatDetected() ? 1 : 0);
+}
+
+void OscEncoder::setSkinConductance(int message, const SkinConductance& sc) {
+  setFloat(message, 0, sc.getSCR());
+  setFloat(message, 1, sc.getSCL());
+  setInt(message, 2, sc.getRaw());
+}
+
+void OscEncoder::setRespiration(int message, const Respiration& resp) {
+  setFloat(message, 0, resp.getNormalized());
+  setInt(message, 1, resp.isExhaling() ? 1 : 0);
+  setFloat(message, 2, resp.getRpm());
+  setFloat(message, 3, resp.getRpmChange());
+  setFloat(message, 4, resp.getTemperatureAmplitude());
+  setFloat(message, 5, resp.getAmplitudeChange());
+}
+
+size_t OscEncoder::encode(uint8_t* out, size_t capacity) const {
+  size_t n = 0;
+  if (capacity < 2) return 0;
+  out[n++] = SLIP_END;
+  for (uint16_t i = 0; i < _size; i++) {
+    uint8_t b = _buffer[i];
+    if (b == SLIP_END || b == SLIP_ESC) {
+      if (n + 3 > capacity) return 0;
+      out[n++] = SLIP_ESC;
+      out[n++] = (b == SLIP_END) ? SLIP_ESC_END : SLIP_ESC_ESC;
+    } else {
+      if (n + 2 > capacity) return 0;
+      out[n++] = b;
+    }
+  }
+  out[n++] = SLIP_END;
+  return n;
+}
+
+size_t OscEncoder::write(Print& out) const {
+  // Encode through a small stack buffer so that the stream sees few large writes.
+  uint8_t chunk[64];
+  size_t n = 0;
+  size_t total = 0;
+  chunk[n++] = SLIP_END;
+  for (uint16_t i = 0; i < _size; i++) {
+    if (n > sizeof(chunk) - 2) {
+      total += out.write(chunk, n);
+      n = 0;
+    }
+    uint8_t b = _buffer[i];
+    if (b == SLIP_END) {
+      chunk[n++] = SLIP_ESC;
+      chunk[n++] = SLIP_ESC_END;
+    } else if (b == SLIP_ESC) {
+      chunk[n++] = SLIP_ESC;
+      chunk[n++] = SLIP_ESC_ESC;
+    } else {
+      chunk[n++] = b;
+    }
+  }
+  if (n == sizeof(chunk)) {
+    total += out.write(chunk, n);
+    n = 0;
+  }
+  chunk[n++] = SLIP_END;
+  total += out.write(chunk, n);
+  return total;
+}
+
+SlipDecoder::SlipDecoder() {
+  reset();
+  _nDropped = 0;
+}
+
+void SlipDecoder::reset() {
+  _size = 0;
+  _escaped = _overflow = _complete = false;
+}
+
+bool SlipDecoder::decode(uint8_t b) {
+  // Previous frame was handed out: start a new one.
+  if (_complete) {
+    _size = 0;
+    _complete = false;
+  }
+
+  if (b == SLIP_END) {
+    _escaped = false;
+    if (_overflow) {
+      _nDropped++;
+      _overflow = false;
+      _size = 0;
+    } else if (_size > 0) {
+      _complete = true;
+    }
+    return _complete;
+  }
+
+  if (_escaped) {
+    _escaped = false;
+    if (b == SLIP_ESC_END) b = SLIP_END;
+    else if (b == SLIP_ESC_ESC) b = SLIP_ESC;
+  } else if (b == SLIP_ESC) {
+    _escaped = true;
+    return false;
+  }
+
+  if (_size < OSC_ENCODER_MAX_SIZE)
+    _buffer[_size++] = b;
+  else
+    _overflow = true;
+
+  return false;
+}
@@ -0,0 +1,157 @@
+/*
+ * OscEncoder.h
+ *
+ * This class serializes BioData features into SLIP-framed OSC bundles, ready
+ * to be sent over a serial link to Max, Pd, TouchDesigner, etc.
+ *
+ * The bundle layout (address patterns, type tags, element sizes) is built once
+ * when messages are added. Afterwards only the timetag and the arguments are
+ * patched in place on every frame: no string formatting and no heap allocation.
+ * Only 32-bit arguments ('f' and 'i') are supported so that the layout stays
+ * fixed from frame to frame.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+
+#ifndef OSC_ENCODER_H_
+#define OSC_ENCODER_H_
+
+// Maximum size of a bundle in bytes (before SLIP framing).
+#ifndef OSC_ENCODER_MAX_SIZE
+#define OSC_ENCODER_MAX_SIZE 256
+#endif
+
+// Maximum number of messages in a bundle.
+#ifndef OSC_ENCODER_MAX_MESSAGES
+#define OSC_ENCODER_MAX_MESSAGES 8
+#endif
+
+// SLIP special characters (RFC 1055).
+#define SLIP_END     0xC0
+#define SLIP_ESC     0xDB
+#define SLIP_ESC_END 0xDC
+#define SLIP_ESC_ESC 0xDD
+
+class Heart;
+class SkinConductance;
+class Respiration;
+
+class OscEncoder {
+
+  // Serialized bundle.
+  uint8_t _buffer[OSC_ENCODER_MAX_SIZE];
+  uint16_t _size;
+
+  // Per message: offset of first argument and number of arguments.
+  uint16_t _argOffset[OSC_ENCODER_MAX_MESSAGES];
+  uint8_t _nArgs[OSC_ENCODER_MAX_MESSAGES];
+  uint8_t _nMessages;
+
+  void writeInt32(uint16_t offset, uint32_t value);
+
+public:
+  OscEncoder();
+
+  /// Removes all messages.
+  void clear();
+
+  /**
+   * Appends a message to the bundle template. The type tag string lists the
+   * arguments, with or without the leading comma (eg. ",ffi" or "ffi").
+   * Returns the message index to use with setFloat()/setInt(), or -1 if the
+   * message does not fit or uses unsupported types.
+   */
+  int addMessage(const char* address, const char* typeTags);
+
+  /// Adds a message for Heart features (normalized, bpm, bpmChange, amplitudeChange, beat).
+  int addHeart(const char* address="/biodata/heart");
+
+  /// Adds a message for SkinConductance features (scr, scl, raw).
+  int addSkinConductance(const char* address="/biodata/sc");
+
+  /// Adds a message for Respiration features (normalized, exhaling, rpm, rpmChange, amplitude, amplitudeChange).
+  int addRespiration(const char* address="/biodata/resp");
+
+  /// Sets the bundle timetag (NTP format: seconds and fraction of second).
+  void setTimeTag(uint32_t seconds, uint32_t fraction);
+
+  /// Sets the timetag from a time in microseconds.
+  void setTimeTagMicros(unsigned long us);
+
+  /// Sets float argument #arg# of message #message#.
+  void setFloat(int message, uint8_t arg, float value);
+
+  /// Sets int argument #arg# of message #message#.
+  void setInt(int message, uint8_t arg, int32_t value);
+
+  /// Copies current features of a sensor into a message created with the matching add*() method.
+  void setHeart(int message, const Heart& heart);
+  void setSkinConductance(int message, const SkinConductance& sc);
+  void setRespiration(int message, const Respiration& resp);
+
+  /// Returns the unframed OSC bundle.
+  const uint8_t* data() const { return _buffer; }
+
+  /// Returns the size of the unframed OSC bundle in bytes.
+  size_t size() const { return _size; }
+
+  /// Returns the number of messages in the bundle.
+  uint8_t nMessages() const { return _nMessages; }
+
+  /**
+   * SLIP-encodes the bundle into #out#. Returns the number of bytes written,
+   * or 0 if #capacity# is too small (2 * size() + 2 always suffices).
+   */
+  size_t encode(uint8_t* out, size_t capacity) const;
+
+  /// SLIP-encodes the bundle and writes it to a stream (eg. Serial).
+  size_t write(Print& out) const;
+};
+
+/**
+ * Decodes a SLIP stream one byte at a time, eg. on the host side or to
+ * read OSC back from a serial port.
+ */
+class SlipDecoder {
+  uint8_t _buffer[OSC_ENCODER_MAX_SIZE];
+  uint16_t _size;
+  bool _escaped;
+  bool _overflow;
+  bool _complete;
+  uint32_t _nDropped;
+
+public:
+  SlipDecoder();
+
+  /// Resets the decoder state.
+  void reset();
+
+  /// Feeds one byte. Returns true when a complete frame is available.
+  bool decode(uint8_t b);
+
+  /// Returns the last complete frame.
+  const uint8_t* data() const { return _buffer; }
+
+  /// Returns the size of the last complete frame.
+  size_t size() const { return _size; }
+
+  /// Returns the number of frames dropped because they did not fit in the buffer.
+  uint32_t nDropped() const { return _nDropped; }
+};
+
+#endif
@@ -0,0 +1,134 @@
+/* This file is part of the BioData project
+* (c) 2018 Erin Gee   http://www.eringee.net
+*
+* Detects the apex of peaks (or troughs) of a signal. Once the signal crosses
+* the trigger threshold, the detector follows it and reports the apex when
+* the signal has fallen back by a fraction of its distance to the reload
+* threshold (the fallback tolerance), or when it crosses the reload
+* threshold. The signal must then cross the reload threshold before another
+* peak can be detected.
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+#include <Arduino.h>
+#include "Snapshot.h"
+
+#ifndef PEAK_H_
+#define PEAK_H_
+
+class Peak {
+public:
+  enum Mode { MAXIMUM, MINIMUM };
+
+private:
+  // Direction of the peaks (troughs are peaks of the inverted signal).
+  float sign;
+
+  float trigger;
+  float reload;
+  float fallback;
+
+  // Signal has crossed the reload threshold since the last peak.
+  bool armed;
+
+  // Signal is above the trigger threshold, apex not reached yet.
+  bool crossing;
+
+  // Highest (inverted) value since crossing.
+  float apex;
+
+  // A peak was detected at the last sample.
+  bool detected;
+
+public:
+
+  /// Constructor. The reload threshold defaults to the trigger threshold.
+  Peak(float trigger_=0.5, Mode mode=MAXIMUM) {
+    sign = (mode == MAXIMUM) ? 1 : -1;
+    setThresholds(trigger_, trigger_, 0.1);
+    reset();
+  }
+
+  /// Rearms the detector.
+  void reset() {
+    armed = true;
+    crossing = detected = false;
+    apex = 0;
+  }
+
+  /// Sets the trigger and reload thresholds and the fallback tolerance (in [0, 1]).
+  void setThresholds(float trigger_, float reload_, float fallback_) {
+    trigger = trigger_;
+    reload = reload_;
+    fallback = constrain(fallback_, 0, 1);
+  }
+
+  /// Returns true when #input# is right after the apex of a peak.
+  bool detect(float input) {
+    float x = sign * input;
+    float r = sign * reload;
+    detected = false;
+
+    if (!crossing) {
+      if (armed && x >= sign * trigger) {
+        crossing = true;
+        armed = false;
+        apex = x;
+      } else if (x <= r) {
+        armed = true;
+      }
+    }
+    if (crossing) {
+      if (x > apex) apex = x;
+      if (x <= r || apex - x >= fallback * (apex - r)) {
+        crossing = false;
+        detected = true;
+        armed = (x <= r);
+      }
+    }
+    return detected;
+  }
+
+  /// Returns true if a peak was detected at the last sample.
+  bool get() const {
+    return detected;
+  }
+
+  /// Saves detector state (see Snapshot.h).
+  void save(SnapshotWriter& out) const {
+    out.writeUInt8('K');
+    out.writeBool(armed);
+    out.writeBool(crossing);
+    out.writeFloat(apex);
+    out.writeBool(detected);
+  }
+
+  /// Restores detector state (see Snapshot.h).
+  void load(SnapshotReader& in) {
+    in.expect('K');
+    bool a = in.readBool();
+    bool c = in.readBool();
+    float x = in.readFloat();
+    bool d = in.readBool();
+    if (in.ok()) {
+      armed = a;
+      crossing = c;
+      apex = x;
+      detected = d;
+    }
+  }
+
+};
+
+#endif
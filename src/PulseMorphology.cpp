@@ -0,0 +1,281 @@
+/*
+ * PulseMorphology.cpp
+ *
+ * This class measures the shape of every pulse captured by Heart.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "PulseMorphology.h"
+
+// Segments start this long (ms) before the beat detection, which happens
+// halfway up the upstroke, so that they include the foot.
+#define PULSE_MORPHOLOGY_LEAD 150
+
+// Shortest beat (ms) measured.
+#define PULSE_MORPHOLOGY_MIN_BEAT 250
+
+// The notch is searched in this fraction of the beat after the peak, and
+// the dicrotic wave after it must rise by this fraction of the amplitude.
+#define PULSE_MORPHOLOGY_NOTCH_SEARCH 0.75f
+#define PULSE_MORPHOLOGY_NOTCH_RISE   0.02f
+
+// Once the template is established, beats less correlated with it are
+// artifacts and not added.
+#define PULSE_MORPHOLOGY_MIN_CORRELATION 0.5f
+
+PulseMorphology::PulseMorphology(unsigned long rate) :
+  nAveragedBeats(16)
+{
+  setSampleRate(rate);
+  reset();
+}
+
+void PulseMorphology::reset() {
+  memset(ring, 0, sizeof(ring));
+  nSamples = 0;
+  lastBeat = 0;
+  hasBeat = false;
+  lastHeartSample = 0;
+  measured = false;
+  segmentLength = 0;
+  memset(&beat, 0, sizeof(beat));
+  for (int k = 0; k < PULSE_MORPHOLOGY_TEMPLATE; k++)
+    beatTemplate[k] = 0;
+  nTemplateBeats = 0;
+}
+
+void PulseMorphology::setSampleRate(unsigned long rate) {
+  sampleRate = rate;
+}
+
+void PulseMorphology::setAveragedBeats(unsigned int nBeats) {
+  nAveragedBeats = (nBeats > 0) ? nBeats : 1;
+}
+
+bool PulseMorphology::process(const Heart& heart) {
+  uint32_t sample = heart.getSampleCount();
+  if (sample == lastHeartSample)
+    return false;
+  lastHeartSample = sample;
+  return process(heart.getRaw(), heart.beatDetected());
+}
+
+bool PulseMorphology::process(int reading, bool beatDetected) {
+  measured = false;
+  uint32_t now = nSamples++;
+  ring[now % PULSE_MORPHOLOGY_RING] = (uint16_t)constrain(reading, 0, 65535);
+  if (!beatDetected)
+    return false;
+
+  uint32_t previous = lastBeat;
+  bool hadBeat = hasBeat;
+  lastBeat = now;
+  hasBeat = true;
+  if (!hadBeat)
+    return false;
+
+  // Copy the previous beat, from #lead# samples before its detection to this one.
+  unsigned int lead = PULSE_MORPHOLOGY_LEAD * sampleRate / 1000;
+  unsigned int nBeat = now - previous;
+  if (nBeat < PULSE_MORPHOLOGY_MIN_BEAT * sampleRate / 1000 || previous < lead ||
+      nBeat + lead + 1 > PULSE_MORPHOLOGY_RING)
+    return false;
+  segmentLength = nBeat + lead + 1;
+  uint32_t start = previous - lead;
+  for (unsigned int i = 0; i < segmentLength; i++)
+    segment[i] = ring[(start + i) % PULSE_MORPHOLOGY_RING];
+
+  measured = measure(nBeat);
+  return measured;
+}
+
+int32_t PulseMorphology::smoothed(int i) const {
+  int last = segmentLength - 1;
+  return (int32_t)segment[(i > 0) ? i - 1 : 0] + segment[i] + segment[(i < last) ? i + 1 : last];
+}
+
+bool PulseMorphology::measure(unsigned int nBeat) {
+  float millisPerSample = 1000.0f / sampleRate;
+  int lead = PULSE_MORPHOLOGY_LEAD * sampleRate / 1000;
+
+  // Systolic peak: highest point of the first half of the beat, and the foot
+  // before it.
+  int peak = 0;
+  for (int i = 1; i < lead + (int)nBeat / 2; i++)
+    if (smoothed(i) > smoothed(peak)) peak = i;
+  int foot = 0;
+  for (int i = 1; i < peak; i++)
+    if (smoothed(i) < smoothed(foot)) foot = i;
+  int32_t base = smoothed(foot);
+  int32_t amplitude = smoothed(peak) - base;
+  if (amplitude <= 0)
+    return false;
+
+  int end = foot + nBeat;
+  if (end > (int)segmentLength - 1)
+    end = segmentLength - 1;
+
+  beat.interval = nBeat * millisPerSample;
+  beat.amplitude = amplitude / 3.0f;
+  beat.riseTime = (peak - foot) * millisPerSample;
+
+  // Width at half the amplitude, interpolated between samples.
+  float half = base + amplitude / 2.0f;
+  int up = peak;
+  while (up > foot && smoothed(up - 1) >= half) up--;
+  int down = peak;
+  while (down < end && smoothed(down + 1) >= half) down++;
+  float rising = up;
+  if (up > foot)
+    rising -= (smoothed(up) - half) / (smoothed(up) - smoothed(up - 1));
+  if (down < end) {
+    float falling = down + (smoothed(down) - half) / (smoothed(down) - smoothed(down + 1));
+    beat.width = (falling - rising) * millisPerSample;
+  } else {
+    beat.width = 0;
+  }
+
+  // Dicrotic notch: the lowest point after the peak followed by a rise.
+  beat.notchTime = beat.notchHeight = 0;
+  int searchEnd = foot + (int)(PULSE_MORPHOLOGY_NOTCH_SEARCH * nBeat);
+  int32_t rise = (int32_t)(PULSE_MORPHOLOGY_NOTCH_RISE * amplitude) + 1;
+  int lowest = peak;
+  for (int i = peak + 1; i < searchEnd && i < end; i++) {
+    int32_t v = smoothed(i);
+    if (v < smoothed(lowest)) {
+      lowest = i;
+    } else if (v - smoothed(lowest) >= rise) {
+      beat.notchTime = (lowest - foot) * millisPerSample;
+      beat.notchHeight = (smoothed(lowest) - base) / (float)amplitude;
+      break;
+    }
+  }
+
+  updateTemplate(foot, nBeat);
+  return true;
+}
+
+void PulseMorphology::updateTemplate(int foot, unsigned int nBeat) {
+  // The beat from foot to foot, resampled and normalized like the template.
+  float points[PULSE_MORPHOLOGY_TEMPLATE];
+  int32_t base = smoothed(foot);
+  float scale = 1.0f / (beat.amplitude * 3);
+  float step = (float)nBeat / (PULSE_MORPHOLOGY_TEMPLATE - 1);
+  int last = segmentLength - 1;
+  for (int k = 0; k < PULSE_MORPHOLOGY_TEMPLATE; k++) {
+    float position = foot + k * step;
+    int i = (int)position;
+    if (i >= last) {
+      points[k] = (smoothed(last) - base) * scale;
+      continue;
+    }
+    float fraction = position - i;
+    points[k] = ((1 - fraction) * smoothed(i) + fraction * smoothed(i + 1) - base) * scale;
+  }
+
+  // Correlation with the template.
+  beat.correlation = 0;
+  if (nTemplateBeats > 0) {
+    float sumX = 0, sumY = 0, sumXX = 0, sumYY = 0, sumXY = 0;
+    for (int k = 0; k < PULSE_MORPHOLOGY_TEMPLATE; k++) {
+      float x = points[k], y = beatTemplate[k];
+      sumX += x; sumY += y; sumXX += x * x; sumYY += y * y; sumXY += x * y;
+    }
+    const float n = PULSE_MORPHOLOGY_TEMPLATE;
+    float variance = (n * sumXX - sumX * sumX) * (n * sumYY - sumY * sumY);
+    if (variance > 0)
+      beat.correlation = (n * sumXY - sumX * sumY) / sqrt(variance);
+  }
+  if (nTemplateBeats >= nAveragedBeats && beat.correlation < PULSE_MORPHOLOGY_MIN_CORRELATION)
+    return;
+
+  // Running average: plain mean until #nAveragedBeats# (see Lop.h).
+  nTemplateBeats++;
+  float alpha = (nTemplateBeats < nAveragedBeats) ? 1.0f / nTemplateBeats : 2.0f / (nAveragedBeats + 1);
+  for (int k = 0; k < PULSE_MORPHOLOGY_TEMPLATE; k++)
+    beatTemplate[k] += (points[k] - beatTemplate[k]) * alpha;
+}
+
+bool PulseMorphology::beatMeasured() const {
+  return measured;
+}
+
+const PulseMorphology::Beat& PulseMorphology::getBeat() const {
+  return beat;
+}
+
+const uint16_t* PulseMorphology::getSegment() const {
+  return segment;
+}
+
+unsigned int PulseMorphology::getSegmentLength() const {
+  return segmentLength;
+}
+
+const float* PulseMorphology::getTemplate() const {
+  return beatTemplate;
+}
+
+unsigned int PulseMorphology::getTemplateBeats() const {
+  return nTemplateBeats;
+}
+
+void PulseMorphology::save(SnapshotWriter& out) const {
+  out.writeUInt8('W');
+  // Readings in pairs.
+  for (int i = 0; i < PULSE_MORPHOLOGY_RING; i += 2)
+    out.writeUInt32(ring[i] | ((uint32_t)ring[i + 1] << 16));
+  out.writeUInt32(nSamples);
+  out.writeUInt32(lastBeat);
+  out.writeBool(hasBeat);
+  out.writeBool(measured);
+  out.writeFloat(beat.interval);
+  out.writeFloat(beat.amplitude);
+  out.writeFloat(beat.riseTime);
+  out.writeFloat(beat.width);
+  out.writeFloat(beat.notchTime);
+  out.writeFloat(beat.notchHeight);
+  out.writeFloat(beat.correlation);
+  for (int k = 0; k < PULSE_MORPHOLOGY_TEMPLATE; k++)
+    out.writeFloat(beatTemplate[k]);
+  out.writeUInt32(nTemplateBeats);
+}
+
+void PulseMorphology::load(SnapshotReader& in) {
+  in.expect('W');
+  // The segment is not saved: it is copied again on the next beat.
+  for (int i = 0; i < PULSE_MORPHOLOGY_RING; i += 2) {
+    uint32_t pair = in.readUInt32();
+    ring[i] = (uint16_t)(pair & 0xFFFF);
+    ring[i + 1] = (uint16_t)(pair >> 16);
+  }
+  nSamples = in.readUInt32();
+  lastBeat = in.readUInt32();
+  hasBeat = in.readBool();
+  lastHeartSample = 0;  // not saved: counts differ between Heart instances
+  measured = in.readBool();
+  beat.interval = in.readFloat();
+  beat.amplitude = in.readFloat();
+  beat.riseTime = in.readFloat();
+  beat.width = in.readFloat();
+  beat.notchTime = in.readFloat();
+  beat.notchHeight = in.readFloat();
+  beat.correlation = in.readFloat();
+  for (int k = 0; k < PULSE_MORPHOLOGY_TEMPLATE; k++)
+    beatTemplate[k] = in.readFloat();
+  nTemplateBeats = in.readUInt32();
+}
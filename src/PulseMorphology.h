@@ -0,0 +1,150 @@
+/*
+ * PulseMorphology.h
+ *
+ * This class measures the shape of every pulse captured by Heart, which
+ * only keeps its timing and amplitude: rise time, width, dicrotic notch,
+ * and a running average of the beats (the template).
+ *
+ * Raw readings are kept in a fixed ring. When Heart detects a beat, the
+ * previous one is complete: its samples, from slightly before its detection
+ * to the new one, are copied into a fixed segment buffer and measured
+ * there. Per sample this only costs a ring write; the measurements and the
+ * template update cost a pass over the segment per beat. Nothing is
+ * allocated.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include "Heart.h"
+#include "Snapshot.h"
+
+#ifndef PULSE_MORPHOLOGY_H_
+#define PULSE_MORPHOLOGY_H_
+
+// Ring of raw readings, and longest beat segment (2.5 s at 200 Hz), in samples.
+#ifndef PULSE_MORPHOLOGY_RING
+#define PULSE_MORPHOLOGY_RING 512
+#endif
+
+// Points of the beat template, from foot to foot.
+#ifndef PULSE_MORPHOLOGY_TEMPLATE
+#define PULSE_MORPHOLOGY_TEMPLATE 64
+#endif
+
+class PulseMorphology {
+public:
+  /// Measurements of one beat (times in milliseconds from its foot).
+  struct Beat {
+    float interval;     // time since the previous beat
+    float amplitude;    // foot to systolic peak, in raw units
+    float riseTime;     // foot to systolic peak
+    float width;        // time above half the amplitude
+    float notchTime;    // dicrotic notch, 0 if none was found
+    float notchHeight;  // height of the notch above the foot, as a fraction of the amplitude
+    float correlation;  // with the template before this beat (-1 to 1)
+  };
+
+private:
+  // Raw readings (unsigned: an ADS1115 gives up to 65535), and samples
+  // written (wraps).
+  uint16_t ring[PULSE_MORPHOLOGY_RING];
+  uint32_t nSamples;
+
+  // Sample of the last beat detection.
+  uint32_t lastBeat;
+  bool hasBeat;
+
+  // Heart sample last processed (see Heart::getSampleCount()).
+  uint32_t lastHeartSample;
+
+  // A beat was measured on the last sample.
+  bool measured;
+
+  // Copy of the last beat's samples.
+  uint16_t segment[PULSE_MORPHOLOGY_RING];
+  unsigned int segmentLength;
+
+  Beat beat;
+
+  // Average beat, normalized from 0 (foot) to 1 (peak).
+  float beatTemplate[PULSE_MORPHOLOGY_TEMPLATE];
+  unsigned int nTemplateBeats;
+
+  // Tuning.
+  unsigned long sampleRate;
+  unsigned int nAveragedBeats;
+
+  // Segment smoothed over 3 samples (sum of the three).
+  int32_t smoothed(int i) const;
+
+  // Measures the segment (#nBeat# samples between the two detections).
+  // Returns false if no pulse could be found.
+  bool measure(unsigned int nBeat);
+
+  // Compares the beat with the template and adds it.
+  void updateTemplate(int foot, unsigned int nBeat);
+
+public:
+  PulseMorphology(unsigned long rate=200);
+  virtual ~PulseMorphology() {}
+
+  /// Resets all values.
+  void reset();
+
+  /// Sets sample rate (the rate of the Heart sensor).
+  void setSampleRate(unsigned long rate);
+
+  /// Sets the number of beats the template is averaged over (default: 16).
+  void setAveragedBeats(unsigned int nBeats);
+
+  /**
+   * Call after each Heart update(). Calling it again before the next sample
+   * does nothing. Returns true when a beat was measured (on the detection of
+   * the next one).
+   */
+  bool process(const Heart& heart);
+
+  /**
+   * Adds one raw reading (eg. from a recording, 0 to 65535), with
+   * #beatDetected# true on the samples where Heart detects a beat.
+   */
+  bool process(int reading, bool beatDetected);
+
+  /// Returns true if a beat was measured during the last call to process().
+  bool beatMeasured() const;
+
+  /// Returns the measurements of the last beat.
+  const Beat& getBeat() const;
+
+  /// Returns the raw readings of the last beat (getSegmentLength() samples).
+  const uint16_t* getSegment() const;
+  unsigned int getSegmentLength() const;
+
+  /// Returns the beat template (PULSE_MORPHOLOGY_TEMPLATE points).
+  const float* getTemplate() const;
+
+  /// Returns the number of beats added to the template.
+  unsigned int getTemplateBeats() const;
+
+  /// Saves the ring, the last measurements and the template (see Snapshot.h).
+  void save(SnapshotWriter& out) const;
+
+  /// Restores the ring, the last measurements and the template (see Snapshot.h).
+  void load(SnapshotReader& in);
+};
+
+#endif
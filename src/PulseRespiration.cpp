@@ -0,0 +1,254 @@
+/*
+ * PulseRespiration.cpp
+ *
+ * This class estimates the respiration rate from the pulse captured by
+ * Heart, for installations without the respiration sensor.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "PulseRespiration.h"
+
+// Beat intervals outside these bounds (ms) are artifacts or missed beats.
+#define PULSE_RESPIRATION_MIN_BEAT  250
+#define PULSE_RESPIRATION_MAX_BEAT  2000
+
+// Breath intervals outside these bounds (ms) are ignored (5 to 30 rpm).
+#define PULSE_RESPIRATION_MIN_BREATH  2000
+#define PULSE_RESPIRATION_MAX_BREATH  12000
+
+// Largest mean relative change between consecutive breath intervals of a
+// reliable estimate.
+#define PULSE_RESPIRATION_MAX_IRREGULARITY  0.2f
+
+// Estimates older than this (ms) are not used.
+#define PULSE_RESPIRATION_TIMEOUT  20000
+
+PulseRespiration::Series::Series() :
+  trend(),
+  magnitude(),
+  rate(),
+  irregularityLop()
+{
+  rate.setSmoothingBySamples(4);
+  irregularityLop.setSmoothingBySamples(4);
+  reset();
+}
+
+void PulseRespiration::Series::reset() {
+  trend.reset();
+  magnitude.reset();
+  rate.reset();
+  rpm = 0;
+  irregularityLop.reset();
+  irregularity = 0;
+  previousInterval = 0;
+  previous = 0;
+  high = false;
+  crossing = lastBreath = 0;
+  hasBreath = false;
+}
+
+bool PulseRespiration::Series::add(float value, unsigned long ms, unsigned long previousMs, float hysteresis) {
+  float deviation = value - trend.filter(value);
+  float bound = hysteresis * magnitude.filter(abs(deviation));
+
+  // Time of the upward zero crossing, interpolated between beats.
+  if (previous <= 0 && deviation > 0)
+    crossing = previousMs + (unsigned long)((ms - previousMs) * (-previous / (deviation - previous)));
+  previous = deviation;
+
+  if (high) {
+    if (deviation < -bound)
+      high = false;
+    return false;
+  }
+  if (deviation <= bound)
+    return false;
+
+  // One breath per oscillation: from crossing to crossing.
+  high = true;
+  unsigned long interval = crossing - lastBreath;
+  if (hasBreath && interval < PULSE_RESPIRATION_MIN_BREATH)
+    return false;
+  if (hasBreath && interval <= PULSE_RESPIRATION_MAX_BREATH) {
+    rpm = rate.filter(60000.0f / interval);
+    if (previousInterval > 0)
+      irregularity = irregularityLop.filter(abs(interval - previousInterval) / previousInterval);
+    previousInterval = interval;
+  }
+  lastBreath = crossing;
+  hasBreath = true;
+  return true;
+}
+
+bool PulseRespiration::Series::isCurrent(unsigned long ms, unsigned long timeout) const {
+  return rpm > 0 && ms - lastBreath <= timeout;
+}
+
+bool PulseRespiration::Series::isRegular() const {
+  return previousInterval > 0 && irregularity <= PULSE_RESPIRATION_MAX_IRREGULARITY;
+}
+
+void PulseRespiration::Series::save(SnapshotWriter& out) const {
+  trend.save(out);
+  magnitude.save(out);
+  rate.save(out);
+  out.writeFloat(rpm);
+  irregularityLop.save(out);
+  out.writeFloat(irregularity);
+  out.writeFloat(previousInterval);
+  out.writeFloat(previous);
+  out.writeBool(high);
+  out.writeUInt32(crossing);
+  out.writeUInt32(lastBreath);
+  out.writeBool(hasBreath);
+}
+
+void PulseRespiration::Series::load(SnapshotReader& in) {
+  trend.load(in);
+  magnitude.load(in);
+  rate.load(in);
+  rpm = in.readFloat();
+  irregularityLop.load(in);
+  irregularity = in.readFloat();
+  previousInterval = in.readFloat();
+  previous = in.readFloat();
+  high = in.readBool();
+  crossing = in.readUInt32();
+  lastBreath = in.readUInt32();
+  hasBreath = in.readBool();
+}
+
+PulseRespiration::PulseRespiration() :
+  hysteresis(0.4),
+  agreement(4)
+{
+  setTrendBeats(16);
+  reset();
+}
+
+void PulseRespiration::reset() {
+  intervalSeries.reset();
+  amplitudeSeries.reset();
+  beatMillis = 0;
+  lastSample = 0;
+  rpm = 0;
+  reliable = false;
+  breath = false;
+}
+
+void PulseRespiration::setTrendBeats(unsigned int nBeats) {
+  intervalSeries.trend.setSmoothingBySamples(nBeats);
+  intervalSeries.magnitude.setSmoothingBySamples(nBeats);
+  amplitudeSeries.trend.setSmoothingBySamples(nBeats);
+  amplitudeSeries.magnitude.setSmoothingBySamples(nBeats);
+}
+
+void PulseRespiration::setHysteresis(float fraction) {
+  hysteresis = constrain(fraction, 0, 1);
+}
+
+void PulseRespiration::setAgreement(float rpm) {
+  agreement = rpm;
+}
+
+bool PulseRespiration::process(const Heart& heart) {
+  uint32_t sample = heart.getSampleCount();
+  if (sample == lastSample || !heart.beatDetected())
+    return false;
+  bool added = addBeat(heart.getInterval(), heart.getAmplitude());
+  lastSample = sample;  // after addBeat(), which can reset()
+  return added;
+}
+
+bool PulseRespiration::addBeat(float interval, float amplitude) {
+  if (!(interval > 0))
+    return false;
+  if (interval > PULSE_RESPIRATION_TIMEOUT) {
+    reset();
+    return false;
+  }
+
+  unsigned long previousMs = beatMillis;
+  beatMillis += (unsigned long)interval;
+
+  breath = amplitudeSeries.add(amplitude, beatMillis, previousMs, hysteresis);
+  if (interval >= PULSE_RESPIRATION_MIN_BEAT && interval <= PULSE_RESPIRATION_MAX_BEAT)
+    breath |= intervalSeries.add(interval, beatMillis, previousMs, hysteresis);
+
+  // Combine the estimates when they agree; otherwise use the one closest to
+  // the previous rate.
+  bool fromIntervals = intervalSeries.isCurrent(beatMillis, PULSE_RESPIRATION_TIMEOUT);
+  bool fromAmplitudes = amplitudeSeries.isCurrent(beatMillis, PULSE_RESPIRATION_TIMEOUT);
+  reliable = false;
+  if (fromIntervals && fromAmplitudes) {
+    float a = intervalSeries.rpm;
+    float b = amplitudeSeries.rpm;
+    if (abs(a - b) <= agreement) {
+      rpm = (a + b) / 2;
+      reliable = intervalSeries.isRegular() && amplitudeSeries.isRegular();
+    } else if (rpm > 0) {
+      rpm = (abs(a - rpm) < abs(b - rpm)) ? a : b;
+    }
+  } else if (fromIntervals) {
+    rpm = intervalSeries.rpm;
+  } else if (fromAmplitudes) {
+    rpm = amplitudeSeries.rpm;
+  }
+  return true;
+}
+
+float PulseRespiration::getRpm() const {
+  return rpm;
+}
+
+bool PulseRespiration::isReliable() const {
+  return reliable;
+}
+
+bool PulseRespiration::breathDetected() const {
+  return breath;
+}
+
+float PulseRespiration::getIntervalRpm() const {
+  return intervalSeries.rpm;
+}
+
+float PulseRespiration::getAmplitudeRpm() const {
+  return amplitudeSeries.rpm;
+}
+
+void PulseRespiration::save(SnapshotWriter& out) const {
+  out.writeUInt8('B');
+  intervalSeries.save(out);
+  amplitudeSeries.save(out);
+  out.writeUInt32(beatMillis);
+  out.writeFloat(rpm);
+  out.writeBool(reliable);
+  out.writeBool(breath);
+}
+
+void PulseRespiration::load(SnapshotReader& in) {
+  in.expect('B');
+  intervalSeries.load(in);
+  amplitudeSeries.load(in);
+  beatMillis = in.readUInt32();
+  lastSample = 0;  // not saved: counts differ between Heart instances
+  rpm = in.readFloat();
+  reliable = in.readBool();
+  breath = in.readBool();
+}
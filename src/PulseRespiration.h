@@ -0,0 +1,155 @@
+/*
+ * PulseRespiration.h
+ *
+ * This class estimates the respiration rate from the pulse captured by
+ * Heart, for installations without the respiration sensor. Breathing
+ * modulates the pulse: heart rate speeds up while inhaling (respiratory
+ * sinus arrhythmia) and the pulse amplitude follows the breath. Both
+ * series are sampled once per beat; each gives a respiration rate from the
+ * time between its oscillations, and the two are combined when they agree.
+ * All the work is done once per beat.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include "Heart.h"
+#include "Lop.h"
+#include "Snapshot.h"
+
+#ifndef PULSE_RESPIRATION_H_
+#define PULSE_RESPIRATION_H_
+
+class PulseRespiration {
+
+  // Breaths detected in one per-beat series (beat intervals or amplitudes).
+  struct Series {
+    // Slow trend of the series, removed to keep the respiratory oscillation.
+    Lop trend;
+
+    // Mean absolute deviation from the trend, for the hysteresis.
+    Lop magnitude;
+
+    // Respiration rate (rpm), averaged over a few breaths.
+    Lop rate;
+    float rpm;
+
+    // Mean relative change between consecutive breath intervals.
+    Lop irregularityLop;
+    float irregularity;
+    float previousInterval;
+
+    // Deviation at the previous beat.
+    float previous;
+
+    // Deviation is above the upper hysteresis bound.
+    bool high;
+
+    // Time of the last upward zero crossing, and of the last breath (ms).
+    unsigned long crossing;
+    unsigned long lastBreath;
+    bool hasBreath;
+
+    Series();
+    void reset();
+
+    // Adds the value of the beat at #ms# (previous beat at #previousMs#).
+    // Returns true when a breath is detected.
+    bool add(float value, unsigned long ms, unsigned long previousMs, float hysteresis);
+
+    // True if a breath was detected in the last #timeout# ms.
+    bool isCurrent(unsigned long ms, unsigned long timeout) const;
+
+    // True if consecutive breath intervals are similar.
+    bool isRegular() const;
+
+    void save(SnapshotWriter& out) const;
+    void load(SnapshotReader& in);
+  };
+
+  Series intervalSeries;
+  Series amplitudeSeries;
+
+  // Time of the last beat (sum of the intervals, ms).
+  unsigned long beatMillis;
+
+  // Heart sample last processed (see Heart::getSampleCount()).
+  uint32_t lastSample;
+
+  // Combined respiration rate.
+  float rpm;
+  bool reliable;
+  bool breath;
+
+  // Tuning.
+  float hysteresis;
+  float agreement;
+
+public:
+  PulseRespiration();
+  virtual ~PulseRespiration() {}
+
+  /// Resets all values.
+  void reset();
+
+  /// Sets the trend window of the beat series in beats (default: 16).
+  void setTrendBeats(unsigned int nBeats);
+
+  /// Sets the hysteresis as a fraction of the mean deviation (default: 0.4).
+  void setHysteresis(float fraction);
+
+  /// Sets the largest difference (rpm) between the two estimates to combine them (default: 4).
+  void setAgreement(float rpm);
+
+  /**
+   * Call after each Heart update(): on the samples where a beat was
+   * detected, adds it. Calling it again before the next sample does
+   * nothing. Returns true if a beat was added.
+   */
+  bool process(const Heart& heart);
+
+  /**
+   * Adds a beat that came #interval# ms after the previous one, with pulse
+   * amplitude #amplitude# (eg. from a recording). Returns false if the
+   * interval is not positive, or if it is so long (over 20 s) that the
+   * estimates are out of date: they are then reset.
+   */
+  bool addBeat(float interval, float amplitude);
+
+  /// Returns the respiration rate (respirations per minute), 0 until known.
+  float getRpm() const;
+
+  /// Returns true if the estimates from beat intervals and amplitudes agree
+  /// and both come from regular breaths.
+  bool isReliable() const;
+
+  /// Returns true if the last beat completed a breath in either series.
+  bool breathDetected() const;
+
+  /// Returns the respiration rate estimated from beat intervals.
+  float getIntervalRpm() const;
+
+  /// Returns the respiration rate estimated from pulse amplitudes.
+  float getAmplitudeRpm() const;
+
+  /// Saves the state of all filters (see Snapshot.h).
+  void save(SnapshotWriter& out) const;
+
+  /// Restores the state of all filters (see Snapshot.h).
+  void load(SnapshotReader& in);
+};
+
+#endif
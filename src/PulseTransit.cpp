@@ -0,0 +1,250 @@
+/*
+ * PulseTransit.cpp
+ *
+ * This class measures the pulse transit time between two Heart sensors.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "PulseTransit.h"
+
+// Slope of the normalized signal (per sample) to ring units.
+#define PULSE_TRANSIT_SCALE 8192
+
+#define PULSE_TRANSIT_MASK (PULSE_TRANSIT_RING - 1)
+
+static int16_t toSlope(float slope) {
+  return (int16_t)constrain(slope * PULSE_TRANSIT_SCALE, -32767, 32767);
+}
+
+PulseTransit::PulseTransit(unsigned long rate) :
+  sampleRate(0),
+  maxLag(0),
+  nAveragedBeats(8)
+{
+  maxLagMillis = 240;
+  setSampleRate(rate);
+  reset();
+}
+
+void PulseTransit::reset() {
+  memset(proximalSlopes, 0, sizeof(proximalSlopes));
+  memset(distalSlopes, 0, sizeof(distalSlopes));
+  previousProximal = previousDistal = 0;
+  head = 0;
+  nFilled = 0;
+  pending = -1;
+  lastProximalSample = lastDistalSample = 0;
+  resetAverage();
+}
+
+void PulseTransit::resetAverage() {
+  for (int k = 0; k < PULSE_TRANSIT_N_LAGS; k++)
+    correlation[k] = 0;
+  nBeats = 0;
+  transitTime = peakCorrelation = 0;
+  beatTransitTime = beatCorrelation = 0;
+}
+
+void PulseTransit::setSampleRate(unsigned long rate) {
+  if (rate != sampleRate) {
+    // The slopes in the rings and the lags of the average are in samples.
+    nFilled = 0;
+    resetAverage();
+  }
+  sampleRate = rate;
+  setMaxLag(maxLagMillis);
+}
+
+void PulseTransit::setMaxLag(float ms) {
+  int lag = constrain((int)(ms * sampleRate / 1000 + 0.5f), 1, PULSE_TRANSIT_MAX_LAG);
+  if (lag != maxLag)
+    resetAverage();
+  maxLagMillis = ms;
+  maxLag = lag;
+  pending = -1;
+}
+
+void PulseTransit::setAveragedBeats(unsigned int nBeats_) {
+  nAveragedBeats = (nBeats_ > 0) ? nBeats_ : 1;
+}
+
+bool PulseTransit::process(const Heart& proximal, const Heart& distal) {
+  uint32_t proximalSample = proximal.getSampleCount();
+  uint32_t distalSample = distal.getSampleCount();
+  if (proximalSample == lastProximalSample && distalSample == lastDistalSample)
+    return false;
+  lastProximalSample = proximalSample;
+  lastDistalSample = distalSample;
+  return process(proximal.getNormalized(), distal.getNormalized(), distal.beatDetected());
+}
+
+bool PulseTransit::process(float proximal, float distal, bool distalBeat) {
+  // Slopes (0 on the first sample).
+  bool first = (nFilled == 0);
+  proximalSlopes[head] = first ? 0 : toSlope(proximal - previousProximal);
+  distalSlopes[head] = first ? 0 : toSlope(distal - previousDistal);
+  previousProximal = proximal;
+  previousDistal = distal;
+  head = (head + 1) & PULSE_TRANSIT_MASK;
+  if (nFilled < PULSE_TRANSIT_RING)
+    nFilled++;
+
+  // The segment is centered on the beat: wait for its second half and for
+  // the largest lag after it.
+  if (distalBeat)
+    pending = PULSE_TRANSIT_SEGMENT / 2 - 1 + maxLag;
+  if (pending < 0)
+    return false;
+  if (pending-- > 0)
+    return false;
+  if ((int)nFilled < PULSE_TRANSIT_SEGMENT + 2 * maxLag)
+    return false;
+  correlate();
+  return true;
+}
+
+void PulseTransit::correlate() {
+  const int n = PULSE_TRANSIT_SEGMENT;
+
+  // Start of the distal segment: the last sample is the largest lag after its end.
+  unsigned int start = (head - 1 - (n - 1) - maxLag) & PULSE_TRANSIT_MASK;
+
+  int64_t sumX = 0, sumXX = 0;
+  for (int j = 0; j < n; j++) {
+    int32_t x = distalSlopes[(start + j) & PULSE_TRANSIT_MASK];
+    sumX += x;
+    sumXX += x * x;
+  }
+  int64_t varX = n * sumXX - sumX * sumX;
+
+  // Proximal window for the first lag (-maxLag), then slid one sample back
+  // per lag, updating its sums.
+  unsigned int window = (start + maxLag) & PULSE_TRANSIT_MASK;
+  int64_t sumY = 0, sumYY = 0;
+  for (int j = 0; j < n; j++) {
+    int32_t y = proximalSlopes[(window + j) & PULSE_TRANSIT_MASK];
+    sumY += y;
+    sumYY += y * y;
+  }
+
+  float beat[PULSE_TRANSIT_N_LAGS];
+  int best = -1;
+  for (int k = -maxLag; k <= maxLag; k++) {
+    if (k > -maxLag) {
+      int32_t leaving = proximalSlopes[(window + n - 1) & PULSE_TRANSIT_MASK];
+      window = (window - 1) & PULSE_TRANSIT_MASK;
+      int32_t entering = proximalSlopes[window];
+      sumY += entering - leaving;
+      sumYY += entering * entering - leaving * leaving;
+    }
+
+    int64_t sumXY = 0;
+    for (int j = 0; j < n; j++)
+      sumXY += (int32_t)distalSlopes[(start + j) & PULSE_TRANSIT_MASK] *
+               proximalSlopes[(window + j) & PULSE_TRANSIT_MASK];
+
+    int64_t varY = n * sumYY - sumY * sumY;
+    int i = k + PULSE_TRANSIT_MAX_LAG;
+    beat[i] = (varX > 0 && varY > 0) ? (float)(n * sumXY - sumX * sumY) / sqrt((float)varX * (float)varY) : 0;
+    if (best < 0 || beat[i] > beat[best])
+      best = i;
+  }
+
+  // Running average over beats: plain mean until #nAveragedBeats# (see Lop.h).
+  nBeats++;
+  float alpha = (nBeats < nAveragedBeats) ? 1.0f / nBeats : 2.0f / (nAveragedBeats + 1);
+  int peak = -1;
+  for (int i = PULSE_TRANSIT_MAX_LAG - maxLag; i <= PULSE_TRANSIT_MAX_LAG + maxLag; i++) {
+    correlation[i] += (beat[i] - correlation[i]) * alpha;
+    if (peak < 0 || correlation[i] > correlation[peak])
+      peak = i;
+  }
+
+  // Only the lags searched are interpolated: beyond them, #beat# is not set.
+  float millisPerSample = 1000.0f / sampleRate;
+  int first = PULSE_TRANSIT_MAX_LAG - maxLag;
+  beatCorrelation = beat[best];
+  beatTransitTime = (interpolatePeak(beat + first, 2 * maxLag + 1, best - first) - maxLag) * millisPerSample;
+  peakCorrelation = correlation[peak];
+  transitTime = (interpolatePeak(correlation + first, 2 * maxLag + 1, peak - first) - maxLag) * millisPerSample;
+}
+
+float PulseTransit::interpolatePeak(const float* values, int n, int index) {
+  if (index <= 0 || index >= n - 1)
+    return index;
+  float a = values[index - 1], b = values[index], c = values[index + 1];
+  float curvature = a - 2 * b + c;
+  if (curvature >= 0)
+    return index;
+  return index + 0.5f * (a - c) / curvature;
+}
+
+float PulseTransit::getTransitTime() const {
+  return transitTime;
+}
+
+float PulseTransit::getCorrelation() const {
+  return peakCorrelation;
+}
+
+float PulseTransit::getBeatTransitTime() const {
+  return beatTransitTime;
+}
+
+float PulseTransit::getBeatCorrelation() const {
+  return beatCorrelation;
+}
+
+void PulseTransit::save(SnapshotWriter& out) const {
+  out.writeUInt8('X');
+  out.writeUInt32(sampleRate);
+  out.writeUInt32(maxLag);
+  out.writeUInt32(nBeats);
+  for (int k = 0; k < PULSE_TRANSIT_N_LAGS; k++)
+    out.writeFloat(correlation[k]);
+  out.writeFloat(transitTime);
+  out.writeFloat(peakCorrelation);
+}
+
+void PulseTransit::load(SnapshotReader& in) {
+  in.expect('X');
+  // The lags of the average are in samples: only valid with the same
+  // sample rate and maximum lag.
+  unsigned long rate = in.readUInt32();
+  int lag = (int)in.readUInt32();
+  if (!in.ok() || rate != sampleRate || lag != maxLag) {
+    in.invalidate();
+    return;
+  }
+  unsigned int beats = in.readUInt32();
+  float averaged[PULSE_TRANSIT_N_LAGS];
+  for (int k = 0; k < PULSE_TRANSIT_N_LAGS; k++)
+    averaged[k] = in.readFloat();
+  float time = in.readFloat();
+  float peak = in.readFloat();
+  if (!in.ok())
+    return;
+  nBeats = beats;
+  memcpy(correlation, averaged, sizeof(correlation));
+  transitTime = time;
+  peakCorrelation = peak;
+  // The rings only hold the last few hundred milliseconds: refilled from
+  // the next samples.
+  nFilled = 0;
+  pending = -1;
+  lastProximalSample = lastDistalSample = 0;
+}
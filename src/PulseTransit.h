@@ -0,0 +1,164 @@
+/*
+ * PulseTransit.h
+ *
+ * This class measures the pulse transit time between two Heart sensors
+ * placed at different distances from the heart (eg. ear and finger): the
+ * delay of the pulse wave at the distal site.
+ *
+ * Both normalized signals are differentiated, which keeps the upstroke of
+ * each pulse, and kept in small fixed rings. On every beat of the distal
+ * sensor, the upstroke segment around the beat is cross-correlated with the
+ * proximal signal over a bounded range of lags; the correlation function is
+ * averaged over beats and its peak, interpolated between samples, gives the
+ * transit time.
+ *
+ * Per sample this only costs two ring writes. Per beat it costs
+ * O(segment x lags): PULSE_TRANSIT_SEGMENT multiply-adds for each of the
+ * 2 * maxLag + 1 lags (2328 at most with the defaults), in integer
+ * arithmetic (Teensy 3.1 has no floating point unit). Running cross sums per
+ * lag would bring the beat down to O(lags), but would cost two multiply-adds
+ * per lag on every sample: about 14 times more work at 200 Hz and 70 beats
+ * per minute.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include "Heart.h"
+#include "Snapshot.h"
+
+#ifndef PULSE_TRANSIT_H_
+#define PULSE_TRANSIT_H_
+
+// Samples of the distal upstroke correlated on each beat (even).
+#ifndef PULSE_TRANSIT_SEGMENT
+#define PULSE_TRANSIT_SEGMENT 24
+#endif
+
+// Largest lag searched, in samples, either way (240 ms at 200 Hz).
+#ifndef PULSE_TRANSIT_MAX_LAG
+#define PULSE_TRANSIT_MAX_LAG 48
+#endif
+
+// Ring size: a power of two holding the segment and the lags on both sides.
+#define PULSE_TRANSIT_RING 128
+
+#define PULSE_TRANSIT_N_LAGS (2 * PULSE_TRANSIT_MAX_LAG + 1)
+
+#if PULSE_TRANSIT_SEGMENT + 2 * PULSE_TRANSIT_MAX_LAG > PULSE_TRANSIT_RING
+#error "PULSE_TRANSIT_SEGMENT and PULSE_TRANSIT_MAX_LAG do not fit in PULSE_TRANSIT_RING"
+#endif
+
+class PulseTransit {
+
+  // Slopes of the normalized signals, scaled to integers.
+  int16_t proximalSlopes[PULSE_TRANSIT_RING];
+  int16_t distalSlopes[PULSE_TRANSIT_RING];
+  float previousProximal;
+  float previousDistal;
+
+  // Next ring position, and samples in the rings (up to PULSE_TRANSIT_RING).
+  unsigned int head;
+  unsigned int nFilled;
+
+  // Samples left until the lags after the last distal beat are available,
+  // negative if no beat is pending.
+  int pending;
+
+  // Heart samples last processed (see Heart::getSampleCount()).
+  uint32_t lastProximalSample;
+  uint32_t lastDistalSample;
+
+  // Correlation per lag, averaged over beats (lag 0 at PULSE_TRANSIT_MAX_LAG).
+  float correlation[PULSE_TRANSIT_N_LAGS];
+  unsigned int nBeats;
+
+  float transitTime;
+  float peakCorrelation;
+  float beatTransitTime;
+  float beatCorrelation;
+
+  // Tuning.
+  unsigned long sampleRate;
+  float maxLagMillis;
+  int maxLag;
+  unsigned int nAveragedBeats;
+
+  // Correlates the segment around the pending beat and updates the average.
+  void correlate();
+
+  // Clears the averaged correlation (when the lags change meaning).
+  void resetAverage();
+
+  // Sub-sample position of the peak of #values# (#n# values) at #index#; at
+  // either end, #index# itself.
+  static float interpolatePeak(const float* values, int n, int index);
+
+public:
+  PulseTransit(unsigned long rate=200);
+  virtual ~PulseTransit() {}
+
+  /// Resets all values.
+  void reset();
+
+  /// Sets sample rate (the rate of both Heart sensors). A new rate clears
+  /// the rings and the averaged correlation.
+  void setSampleRate(unsigned long rate);
+
+  /// Sets the largest transit time searched, either way, in milliseconds
+  /// (default: 240, at most PULSE_TRANSIT_MAX_LAG samples). A new number of
+  /// lags clears the averaged correlation.
+  void setMaxLag(float ms);
+
+  /// Sets the number of beats the correlation is averaged over (default: 8).
+  void setAveragedBeats(unsigned int nBeats);
+
+  /**
+   * Call after each update() of both sensors (proximal: closer to the heart).
+   * Calling it again before either sensor has a new sample does nothing.
+   * Returns true when the transit time was updated, shortly after a distal beat.
+   */
+  bool process(const Heart& proximal, const Heart& distal);
+
+  /**
+   * Adds one sample of both normalized signals (eg. from a recording), with
+   * #distalBeat# true on the samples where the distal sensor detects a beat.
+   */
+  bool process(float proximal, float distal, bool distalBeat);
+
+  /// Returns the transit time in milliseconds (positive if the pulse reaches
+  /// the distal sensor last), averaged over beats. 0 until known.
+  float getTransitTime() const;
+
+  /// Returns the peak of the averaged correlation (-1 to 1): how similar the
+  /// two upstrokes are once aligned. Low values mean getTransitTime() is unreliable.
+  float getCorrelation() const;
+
+  /// Returns the transit time of the last beat alone, in milliseconds.
+  float getBeatTransitTime() const;
+
+  /// Returns the peak correlation of the last beat alone.
+  float getBeatCorrelation() const;
+
+  /// Saves the averaged correlation (see Snapshot.h).
+  void save(SnapshotWriter& out) const;
+
+  /// Restores the averaged correlation (see Snapshot.h). Fails, leaving it
+  /// untouched, if it was saved at another sample rate or maximum lag.
+  void load(SnapshotReader& in);
+};
+
+#endif
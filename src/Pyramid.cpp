@@ -0,0 +1,127 @@
+/*
+ * Pyramid.cpp
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Pyramid.h"
+
+Pyramid::Pyramid(PyramidSink& sink, uint8_t channel, uint8_t minLevel, uint8_t maxLevel) :
+  _sink(sink),
+  _channel(channel)
+{
+  _maxLevel = constrain(maxLevel, 1, PYRAMID_MAX_LEVEL);
+  _minLevel = constrain(minLevel, 1, _maxLevel);
+  reset();
+}
+
+void Pyramid::reset() {
+  for (uint8_t k = 0; k <= PYRAMID_MAX_LEVEL; k++)
+    _pending[k].n = 0;
+  _nSamples = 0;
+}
+
+void Pyramid::merge(Pending& p, float min, float max, float mean, uint32_t n) {
+  if (p.n == 0) {
+    p.min = min;
+    p.max = max;
+    p.mean = mean;
+    p.n = n;
+  } else {
+    if (min < p.min) p.min = min;
+    if (max > p.max) p.max = max;
+    p.mean += (mean - p.mean) * n / (p.n + n);
+    p.n += n;
+  }
+}
+
+void Pyramid::emit(uint8_t level, const Pending& p, uint32_t index) {
+  if (level < _minLevel)
+    return;
+  PyramidBin bin;
+  bin.min = p.min;
+  bin.max = p.max;
+  bin.mean = p.mean;
+  _sink.write(_channel, level, index, bin, p.n);
+}
+
+void Pyramid::put(float value) {
+  _nSamples++;
+
+  // Add the sample to level 1 and carry completed bins upwards: level k
+  // completes every 2^k samples, so this loops twice per sample on average.
+  merge(_pending[1], value, value, value, 1);
+  for (uint8_t k = 1; k <= _maxLevel; k++) {
+    Pending& p = _pending[k];
+    if (p.n < (1UL << k))
+      break;
+    emit(k, p, (_nSamples >> k) - 1);
+    if (k < _maxLevel)
+      merge(_pending[k + 1], p.min, p.max, p.mean, p.n);
+    p.n = 0;
+  }
+}
+
+void Pyramid::flush() {
+  // Partial bin of level k also holds the partial bins of lower levels.
+  Pending partial;
+  partial.n = 0;
+  for (uint8_t k = 1; k <= _maxLevel; k++) {
+    const Pending& p = _pending[k];
+    if (p.n > 0)
+      merge(partial, p.min, p.max, p.mean, p.n);
+    if (partial.n > 0)
+      emit(k, partial, _nSamples >> k);
+    // Higher levels would repeat this bin.
+    if (partial.n == _nSamples)
+      break;
+  }
+}
+
+PyramidLogger::PyramidLogger(LogStorage& storage) :
+  _storage(storage),
+  _nRecords(0),
+  _nWriteErrors(0)
+{}
+
+void PyramidLogger::write(uint8_t channel, uint8_t level, uint32_t index, const PyramidBin& bin, uint32_t nSamples) {
+  PyramidRecord& record = _records[_nRecords++];
+  record.index = index;
+  record.level = level;
+  record.channel = channel;
+  record.reserved = 0;
+  record.nSamples = nSamples;
+  record.min = bin.min;
+  record.max = bin.max;
+  record.mean = bin.mean;
+
+  if (_nRecords >= PYRAMID_LOGGER_RECORDS) {
+    size_t size = _nRecords * sizeof(PyramidRecord);
+    if (_storage.write((const uint8_t*)_records, size) != size)
+      _nWriteErrors++;
+    _nRecords = 0;
+  }
+}
+
+void PyramidLogger::close() {
+  if (_nRecords > 0) {
+    size_t size = _nRecords * sizeof(PyramidRecord);
+    if (_storage.write((const uint8_t*)_records, size) != size)
+      _nWriteErrors++;
+    _nRecords = 0;
+  }
+  _storage.flush();
+}
@@ -0,0 +1,136 @@
+/*
+ * Pyramid.h
+ *
+ * Multi-resolution summaries of a signal for fast plotting of long sessions.
+ * Level k holds one bin (min, max, mean) per 2^k samples; bins are produced
+ * while the signal is recorded or replayed, at an amortized cost of two bin
+ * updates per sample, and sent to a PyramidSink as soon as they are complete.
+ *
+ * On the device, PyramidLogger packs bins into blocks for a LogStorage (see
+ * SampleLogger.h); use a minimum level of 3 or 4 to keep the output small
+ * (about 48 / 2^minLevel bytes per sample). On the host, see
+ * extras/host/PyramidStore.h to store bins and query them at any zoom level.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include "SampleLogger.h"
+
+#ifndef PYRAMID_H_
+#define PYRAMID_H_
+
+// Highest level: bins of 2^PYRAMID_MAX_LEVEL samples (about 1.5 h at 200 Hz).
+#ifndef PYRAMID_MAX_LEVEL
+#define PYRAMID_MAX_LEVEL 20
+#endif
+
+/// Summary of the samples of one bin.
+struct PyramidBin {
+  float min;
+  float max;
+  float mean;
+};
+
+/// Receives the bins of a Pyramid as soon as they are complete.
+class PyramidSink {
+public:
+  virtual ~PyramidSink() {}
+
+  /**
+   * Receives bin #index# of #level# (covering samples index * 2^level to
+   * (index + 1) * 2^level - 1) of #channel#. Bins flushed at the end of a
+   * session cover only #nSamples# samples.
+   */
+  virtual void write(uint8_t channel, uint8_t level, uint32_t index, const PyramidBin& bin, uint32_t nSamples) = 0;
+};
+
+class Pyramid {
+  PyramidSink& _sink;
+  uint8_t _channel;
+  uint8_t _minLevel;
+  uint8_t _maxLevel;
+
+  // Bins being filled, one per level.
+  struct Pending {
+    float min;
+    float max;
+    float mean;
+    uint32_t n;
+  } _pending[PYRAMID_MAX_LEVEL + 1];
+
+  uint32_t _nSamples;
+
+  static void merge(Pending& p, float min, float max, float mean, uint32_t n);
+  void emit(uint8_t level, const Pending& p, uint32_t index);
+
+public:
+  /**
+   * Sends levels #minLevel# to #maxLevel# (1 to PYRAMID_MAX_LEVEL) of the
+   * signal of #channel# to #sink#.
+   */
+  Pyramid(PyramidSink& sink, uint8_t channel=0, uint8_t minLevel=1, uint8_t maxLevel=PYRAMID_MAX_LEVEL);
+
+  /// Starts a new signal.
+  void reset();
+
+  /// Adds a sample.
+  void put(float value);
+
+  /// Sends the partial bins of all levels (end of the signal).
+  void flush();
+
+  /// Number of samples added.
+  uint32_t nSamples() const { return _nSamples; }
+};
+
+/// Bin as stored by PyramidLogger (24 bytes).
+struct PyramidRecord {
+  uint32_t index;
+  uint8_t level;
+  uint8_t channel;
+  uint16_t reserved;
+  uint32_t nSamples;  // 2^level except for partial bins
+  float min;
+  float max;
+  float mean;
+};
+
+#define PYRAMID_LOGGER_RECORDS (SAMPLE_LOGGER_BLOCK_SIZE / sizeof(PyramidRecord))
+
+/**
+ * Sink writing PyramidRecords to a LogStorage, one block of
+ * PYRAMID_LOGGER_RECORDS at a time. Call from loop(), not from an interrupt.
+ */
+class PyramidLogger : public PyramidSink {
+  LogStorage& _storage;
+  PyramidRecord _records[PYRAMID_LOGGER_RECORDS];
+  uint8_t _nRecords;
+  uint32_t _nWriteErrors;
+
+public:
+  PyramidLogger(LogStorage& storage);
+
+  void write(uint8_t channel, uint8_t level, uint32_t index, const PyramidBin& bin, uint32_t nSamples);
+
+  /// Writes buffered records and flushes the storage.
+  void close();
+
+  /// Returns the number of blocks that could not be completely written.
+  uint32_t nWriteErrors() const { return _nWriteErrors; }
+};
+
+#endif
@@ -28,33 +28,16 @@
  */
 #include "Respiration.h"
 
-Respiration::Respiration(uint8_t pin, unsigned long rate) :
+const RespirationConfig respirationDefaultConfig = RespirationConfig();
+
+Respiration::Respiration(uint8_t pin, unsigned long rate, const RespirationConfig* config) :
   _pin(pin),
    ADS(pin),                     // 0x49 is the I2C address we chose (see ADS1115 datasheet for specifications)
   thermistor(),                  // thermistor
-  normalizer(normalizerMean, normalizerStdDev, normalizerTimeWindow), 
-  normalizerAmplitude(normalizerMean, normalizerStdDev, normalizerAmplitudeTimeWindow),
-  normalizerAmplitudeChange(normalizerMean, normalizerStdDev, normalizerAmplitudeChangeTimeWindow),
-  normalizerAmplitudeVariability(normalizerMean, normalizerStdDev, normalizerAmplitudeVariabilityTimeWindow),
-  normalizerRpm(normalizerMean, normalizerStdDev, normalizerRpmTimeWindow),
-  normalizerRpmChange(normalizerMean, normalizerStdDev, normalizerRpmChangeTimeWindow),
-  normalizerRpmVariability(normalizerMean, normalizerStdDev, normalizerRpmVariabilityTimeWindow),
-  normalizerFlowRate(normalizerMean, normalizerStdDev, normalizerFlowRateTimeWindow),
-  peak(peakThreshold, PEAK_MAX),
-  trough(troughThreshold, PEAK_MIN),
-  flowRatePeak(flowRatePeakThreshold, PEAK_MAX),
-  smoother(smootherFactor),
-  smootherAmplitude(smootherAmplitudeFactor),
-  smootherAmplitudeChange(smootherAmplitudeChangeFactor),
-  smootherRpm(smootherRpmFactor),
-  smootherRpmChange(smootherRpmChangeFactor),
-  smootherFlowRate(smootherFlowRateFactor),
-  scaler(), 
-  scalerAmplitudeChange(),
-  scalerAmplitudeVariability(), 
-  scalerRpmChange(),
-  scalerRpmVariability(),
-  flowRateMetro(flowRateMetroTimer),
+  _config(config),
+  peak(config->peakThreshold, Peak::MAXIMUM),
+  trough(config->troughThreshold, Peak::MINIMUM),
+  flowRatePeak(config->flowRatePeakThreshold, Peak::MAXIMUM),
   _temperature(25),
   _adcValue(13000),
   _exhale(0),
@@ -62,11 +45,18 @@ Respiration::Respiration(uint8_t pin, unsigned long rate) :
   _amplitudeChange(0),
   _amplitudeDelta(0),
   _amplitudeCV(0),
+  _amplitudeMin(0),
+  _amplitudeMax(0),
+  _pAmplitude(0),
   _interval(0),
   _rpm(12),
   _rpmChange(0),
   _rpmDelta(0),
-  _rpmCV(0)
+  _rpmCV(0),
+  _intervalMillis(0),
+  _intervalChrono(0),
+  _pRpm(0),
+  _sampleMillis(0)
 {
   setSampleRate(rate);
   reset();
@@ -81,17 +71,11 @@ void Respiration::reset() {
   ADS.readADC(_pin);            // first reading    
 
   prevSampleMicros = micros();
+  _sampleMillis = millis();
+  _intervalChrono = _sampleMillis;
 
-  //set scaler time windows
-  scaler.timeWindow(scalerTimeWindow);
-  scalerAmplitudeChange.timeWindow(scalerAmplitudeChangeTimeWindow);
-  scalerRpmChange.timeWindow(scalerRpmChangeTimeWindow);
-
-  //set peak detector thresholds
-  peak.reloadThreshold(peakReloadThreshold);
-  peak.fallbackTolerance(peakFallbackThreshold);
-  trough.reloadThreshold(troughReloadThreshold);
-  trough.fallbackTolerance(troughFallbackThreshold);
+  // Picks up changes made to the configuration since.
+  applyConfig();
 
   // Perform one update.
   sample();
@@ -100,15 +84,65 @@ void Respiration::reset() {
 void Respiration::setSampleRate(unsigned long rate) {
   sampleRate = rate;
   microsBetweenSamples = 1000000UL / sampleRate;  //
+  applyConfig();
+}
+
+void Respiration::setConfig(const RespirationConfig* config) {
+  _config = config;
+  applyConfig();
+}
+
+unsigned int Respiration::samples(float seconds) const {
+  float n = seconds * sampleRate + 0.5f;
+  return (n < 1) ? 1 : (unsigned int)n;
 }
 
-void Respiration::update() {
+void Respiration::applyConfig() {
+  const RespirationConfig& c = *_config;
+
+  //set normalizer targets and time windows
+  MovingNormalizer* normalizers[] = { &normalizer, &normalizerAmplitude, &normalizerAmplitudeChange,
+                                      &normalizerAmplitudeVariability, &normalizerRpm, &normalizerRpmChange,
+                                      &normalizerRpmVariability, &normalizerFlowRate };
+  for (uint8_t i = 0; i < sizeof(normalizers) / sizeof(normalizers[0]); i++)
+    normalizers[i]->setTarget(c.normalizerMean, c.normalizerStdDev);
+  normalizer.setTimeWindowBySamples(samples(c.normalizerTimeWindow));
+  normalizerAmplitude.setTimeWindowBySamples(samples(c.normalizerAmplitudeTimeWindow));
+  normalizerAmplitudeChange.setTimeWindowBySamples(samples(c.normalizerAmplitudeChangeTimeWindow));
+  normalizerAmplitudeVariability.setTimeWindowBySamples(samples(c.normalizerAmplitudeVariabilityTimeWindow));
+  normalizerRpm.setTimeWindowBySamples(samples(c.normalizerRpmTimeWindow));
+  normalizerRpmChange.setTimeWindowBySamples(samples(c.normalizerRpmChangeTimeWindow));
+  normalizerRpmVariability.setTimeWindowBySamples(samples(c.normalizerRpmVariabilityTimeWindow));
+  normalizerFlowRate.setTimeWindowBySamples(samples(c.normalizerFlowRateTimeWindow));
+
+  //set smoothing factors
+  smoother.setSmoothingBySamples(samples(c.smootherFactor));
+  smootherAmplitude.setSmoothingBySamples(samples(c.smootherAmplitudeFactor));
+  smootherAmplitudeChange.setSmoothingBySamples(samples(c.smootherAmplitudeChangeFactor));
+  smootherRpm.setSmoothingBySamples(samples(c.smootherRpmFactor));
+  smootherRpmChange.setSmoothingBySamples(samples(c.smootherRpmChangeFactor));
+  smootherFlowRate.setSmoothingBySamples(samples(c.smootherFlowRateFactor));
+
+  //set scaler time windows
+  scaler.setTimeWindowBySamples(samples(c.scalerTimeWindow));
+  scalerAmplitudeChange.setTimeWindowBySamples(samples(c.scalerAmplitudeChangeTimeWindow));
+  scalerRpmChange.setTimeWindowBySamples(samples(c.scalerRpmChangeTimeWindow));
+
+  //set peak detector thresholds
+  peak.setThresholds(c.peakThreshold, c.peakReloadThreshold, c.peakFallbackThreshold);
+  trough.setThresholds(c.troughThreshold, c.troughReloadThreshold, c.troughFallbackThreshold);
+  flowRatePeak.setThresholds(c.flowRatePeakThreshold, c.flowRatePeakReloadThreshold, c.flowRatePeakFallbackThreshold);
+}
+
+bool Respiration::update() {
   unsigned long t = micros();
   if (t - prevSampleMicros >= microsBetweenSamples) {
     // Perform updates.
     sample();
     prevSampleMicros = t;
+    return true;
   }
+  return false;
 }
 
 uint16_t Respiration::getRaw()  const {
@@ -120,87 +154,112 @@ return _temperature ;
 }
 
 void Respiration::sample() {
-  _adcValue = ADS.getValue();
-  _temperature = thermistor.readTemp(_adcValue);
+  process(ADS.getValue(), millis());
+}
+
+void Respiration::process(uint16_t adcValue, unsigned long ms) {
+  _sampleMillis = ms;
+  _adcValue = adcValue;
+
+  // Keep the last temperature when the reading cannot be converted (sensor
+  // disconnected or saturated): the filters would never recover from a NaN.
+  float temperature = thermistor.readTemp(_adcValue);
+  if (!isnan(temperature) && !isinf(temperature))
+    _temperature = temperature;
 
   peakOrTrough(_temperature);
   amplitude(_temperature);
   rpm();
+
+  publish();
+}
+
+void Respiration::publish() {
+  Features f;
+  f.temperature = _temperature;
+  f.normalized = normalizer.get();
+  f.scaled = scaler.get();
+  f.amplitude = _amplitude;
+  f.amplitudeChange = _amplitudeChange;
+  f.amplitudeDelta = _amplitudeDelta;
+  f.amplitudeVariability = _amplitudeCV;
+  f.interval = _interval;
+  f.rpm = _rpm;
+  f.rpmChange = _rpmChange;
+  f.rpmDelta = _rpmDelta;
+  f.rpmVariability = _rpmCV;
+  f.exhaling = _exhale;
+  published.write(f);
+}
+
+uint32_t Respiration::getFeatures(Features& features) const {
+  return published.read(features);
 }
 
 void Respiration::peakOrTrough(float value){ // base temperature signal processing and peak detection
-  value >> smoother >> normalizer >> scaler; //smooth, normalize and scale base temperature signal
-  scaler >> peak; // detect max peak (exhale)
-  scaler >> trough; // detect min trough (inhale)
-  _exhale = peak ? 1 : trough ? 0 : _exhale; // store true if exhaling (0 = inhale / 1 = exhale)
+  float scaled = scaler.filter(normalizer.filter(smoother.filter(value))); //smooth, normalize and scale base temperature signal
+  peak.detect(scaled); // detect max peak (exhale)
+  trough.detect(scaled); // detect min trough (inhale)
+  _exhale = peak.get() ? 1 : trough.get() ? 0 : _exhale; // store true if exhaling (0 = inhale / 1 = exhale)
 }
 
 void Respiration::amplitude(float value){ // amplitude data processing
-  // declare and initialize local variables
-  static float min = 0; // base signal value at lowest point in breath cycle
-  static float max = 0; // base signal value at highest point in breath cycle
-  static float pAmplitude = 0; // previous amplitude to determine ampliude difference
-
   //AMPLITUDE + NORMALIZED AMPLITUDE
-  if (peak){  
-    max = value; // base signal value at highest point in breath cycle
-    _amplitude = abs(max - min); // calculate absolute amplitude 
+  if (peak.get()){  
+    _amplitudeMax = value; // base signal value at highest point in breath cycle
+    _amplitude = abs(_amplitudeMax - _amplitudeMin); // calculate absolute amplitude 
   }
-  if (trough) min = value; // base signal value at lowest point in breath cycle
-  _amplitude >> smootherAmplitude >> normalizerAmplitude; // smooth and normalize amplitude
+  if (trough.get()) _amplitudeMin = value; // base signal value at lowest point in breath cycle
+  normalizerAmplitude.filter(smootherAmplitude.filter(_amplitude)); // smooth and normalize amplitude
   
   //AMPLITUDE VARIABILITY
-    _amplitude >> normalizerAmplitudeVariability; // pipe amplitude into a normalizer with 30 second time window to access standard deviation and mean stats
-    _amplitudeCV = (normalizerAmplitudeVariability.stdDev() / normalizerAmplitudeVariability.mean())*100;
+    normalizerAmplitudeVariability.filter(_amplitude); // pipe amplitude into a normalizer with 30 second time window to access standard deviation and mean stats
+    _amplitudeCV = (normalizerAmplitudeVariability.getStdDev() / normalizerAmplitudeVariability.getMean())*100;
     
   //AMPLITUDE CHANGE
-   _amplitudeChange = normalizerAmplitude >> smootherAmplitudeChange >> scalerAmplitudeChange; // smooth and scale normalized amplitude
+   _amplitudeChange = scalerAmplitudeChange.filter(smootherAmplitudeChange.filter(normalizerAmplitude.get())); // smooth and scale normalized amplitude
   
   //AMPLITUDE DELTA (temperature amplitude difference between breath cycles)
-    if (peak) { // on every exhale peak
-        _amplitudeDelta = _amplitude - pAmplitude; // calculate the difference with previous temperature amplitude 
-        pAmplitude = _amplitude; // store amplitude of latest breath cycle
+    if (peak.get()) { // on every exhale peak
+        _amplitudeDelta = _amplitude - _pAmplitude; // calculate the difference with previous temperature amplitude 
+        _pAmplitude = _amplitude; // store amplitude of latest breath cycle
     } 
 }
 
 
 void Respiration::rpm(){ // respiration rate data processing (respirations per minute)
-  static uint16_t interval = 0; // respiration interval (ms)
-    static uint16_t intervalChrono = millis(); // respiration interval chronometer (ms) 
-    static float pRpm = 0; // previous rpm to determine rpm difference
-
   //RPM + NORMALIZED RPM
-  if (peak){ // on every exhale peak
-    interval = millis() - intervalChrono; // calculate interval between current and previous exhale peak
-    intervalChrono = millis(); // restart interval chronometer
-    if (interval >= 30) _rpm = 60000 / interval; // calculate rpm from interval
+  if (peak.get()){ // on every exhale peak
+    _intervalMillis = _sampleMillis - _intervalChrono; // calculate interval between current and previous exhale peak
+    _intervalChrono = _sampleMillis; // restart interval chronometer
+    if (_intervalMillis >= 30) _rpm = 60000 / _intervalMillis; // calculate rpm from interval
     // minimal interval condition to bypass noise errors 
   }
-  _interval = interval;
-  _rpm >> smootherRpm >> normalizerRpm; // smooth and normalize rpm
+  _interval = _intervalMillis;
+  normalizerRpm.filter(smootherRpm.filter(_rpm)); // smooth and normalize rpm
 
   //RPM VARIABILITY
-  _rpm >> normalizerRpmVariability; // pipe rpm into a normalizer with 30 second time window to access standard deviation and mean stats
-   _rpmCV = (normalizerRpmVariability.stdDev() / normalizerRpmVariability.mean())*100;
+  normalizerRpmVariability.filter(_rpm); // pipe rpm into a normalizer with 30 second time window to access standard deviation and mean stats
+   _rpmCV = (normalizerRpmVariability.getStdDev() / normalizerRpmVariability.getMean())*100;
     
   //RPM CHANGE
-  _rpmChange = normalizerRpm >> smootherRpmChange >> scalerRpmChange; // smooth and scale normalized rpm
+  _rpmChange = scalerRpmChange.filter(smootherRpmChange.filter(normalizerRpm.get())); // smooth and scale normalized rpm
 
   //RPM DELTA
-  if(peak){ // on every exhale peak
-      _rpmDelta = _rpm - pRpm; // calculate the difference with previous rpm *RAW OR NORMALIZED RPM?
-      pRpm = _rpm; // store rpm of latest breath cycle
+  if(peak.get()){ // on every exhale peak
+      _rpmDelta = _rpm - _pRpm; // calculate the difference with previous rpm *RAW OR NORMALIZED RPM?
+      _pRpm = _rpm; // store rpm of latest breath cycle
     }
 }
 
 //returns normalized temperature signal (target mean 0, stdDev 1) (example: -2 is abnormally low, +2 is abnormally high)
-float Respiration::getNormalized() {  
-  return normalizer;
+float Respiration::getNormalized() const {  
+  return normalizer.get();
 } 
 
 //returns scaled temperature signal (float between 0 and 1 : 0 is min value, 1 is max value)
-float Respiration::getScaled(){ 
-  return scaler;
+float Respiration::getScaled() const { 
+  return scaler.get();
 } 
 
 //returns true if exhaling 
@@ -214,8 +273,8 @@ float Respiration::getTemperatureAmplitude() const{
 }
 
  //returns normalized breath amplitude (target mean 0, stdDev 1) (example: -2 is abnormally low, +2 is abnormally high)
-float Respiration::getNormalizedAmplitude(){ 
-  return normalizerAmplitude;
+float Respiration::getNormalizedAmplitude() const { 
+  return normalizerAmplitude.get();
 }
 
 //returns breath amplitude change indicator (0 : smaller than baseline, 0.5 : no significant change from baseline, 1 : larger than baseline)
@@ -244,8 +303,8 @@ float Respiration::getRpm() const{
 }
 
 //returns normalized respiration rate (target mean 0, stdDev 1) (example: -2 is abnormally low, +2 is abnormally high)
-float Respiration::getNormalizedRpm(){ 
-  return normalizerRpm;
+float Respiration::getNormalizedRpm() const { 
+  return normalizerRpm.get();
 }
 
 //returns repiration rate change indicator (0 : slower than baseline, 0.5 : no significant change from baseline, 1 : faster than baseline)
@@ -261,4 +320,87 @@ float Respiration::getRpmDelta() const{
 //returns respiration rate coefficient of variation
 float Respiration::getRpmVariability() const{ 
   return _rpmCV;
-}
\ No newline at end of file
+}
+
+void Respiration::save(SnapshotWriter& out) const {
+  out.writeUInt8('R');
+  smoother.save(out);
+  normalizer.save(out);
+  scaler.save(out);
+  peak.save(out);
+  trough.save(out);
+  smootherAmplitude.save(out);
+  normalizerAmplitude.save(out);
+  normalizerAmplitudeVariability.save(out);
+  smootherAmplitudeChange.save(out);
+  scalerAmplitudeChange.save(out);
+  smootherRpm.save(out);
+  normalizerRpm.save(out);
+  normalizerRpmVariability.save(out);
+  smootherRpmChange.save(out);
+  scalerRpmChange.save(out);
+  out.writeFloat(_temperature);
+  out.writeUInt32(_adcValue);
+  out.writeBool(_exhale);
+  out.writeFloat(_amplitude);
+  out.writeFloat(_amplitudeChange);
+  out.writeFloat(_amplitudeDelta);
+  out.writeFloat(_amplitudeCV);
+  out.writeFloat(_amplitudeMin);
+  out.writeFloat(_amplitudeMax);
+  out.writeFloat(_pAmplitude);
+  out.writeUInt32(_intervalMillis);
+  out.writeFloat(_rpm);
+  out.writeFloat(_rpmChange);
+  out.writeFloat(_rpmDelta);
+  out.writeFloat(_rpmCV);
+  out.writeFloat(_pRpm);
+  out.writeUInt32(_intervalChrono);
+}
+
+void Respiration::load(SnapshotReader& in) {
+  // Read into a copy, kept only if the whole record was read.
+  Respiration restored(*this);
+  restored.loadState(in);
+  if (!in.ok())
+    return;
+  *this = restored;
+  publish();
+}
+
+void Respiration::loadState(SnapshotReader& in) {
+  in.expect('R');
+  smoother.load(in);
+  normalizer.load(in);
+  scaler.load(in);
+  peak.load(in);
+  trough.load(in);
+  smootherAmplitude.load(in);
+  normalizerAmplitude.load(in);
+  normalizerAmplitudeVariability.load(in);
+  smootherAmplitudeChange.load(in);
+  scalerAmplitudeChange.load(in);
+  smootherRpm.load(in);
+  normalizerRpm.load(in);
+  normalizerRpmVariability.load(in);
+  smootherRpmChange.load(in);
+  scalerRpmChange.load(in);
+  _temperature = in.readFloat();
+  _adcValue = in.readUInt32();
+  _exhale = in.readBool();
+  _amplitude = in.readFloat();
+  _amplitudeChange = in.readFloat();
+  _amplitudeDelta = in.readFloat();
+  _amplitudeCV = in.readFloat();
+  _amplitudeMin = in.readFloat();
+  _amplitudeMax = in.readFloat();
+  _pAmplitude = in.readFloat();
+  _intervalMillis = in.readUInt32();
+  _interval = _intervalMillis;
+  _rpm = in.readFloat();
+  _rpmChange = in.readFloat();
+  _rpmDelta = in.readFloat();
+  _rpmCV = in.readFloat();
+  _pRpm = in.readFloat();
+  _intervalChrono = in.readUInt32();
+}
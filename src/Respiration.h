@@ -30,34 +30,24 @@
 #include <Arduino.h>
 #include "ExternalADC.h"
 #include "TemperatureSH.h"
+#include "Snapshot.h"
+#include "Seqlock.h"
+#include "Lop.h"
+#include "MovingNormalizer.h"
+#include "MovingScaler.h"
+#include "Peak.h"
 #include <Wire.h>  
 
-#include "PlaquetteLib.h" //https://sofapirate.github.io/Plaquette/index.html
-
-using namespace pq;
-
 #ifndef RESP_H_
 #define RESP_H_
 
-class Respiration {
-  // Analog pin the Respiration sensor is connected to.
-  uint8_t _pin;
-
-  //ADS1115 object if using external ADC
-  ADS1115 ADS;
-
-  //SHthermistor object to calculate temperature from ADC value
-  SHthermistor thermistor;
-
-  // Sample rate in Hz.
-  unsigned long sampleRate;
-
-  // Internal use.
-  unsigned long microsBetweenSamples;
-  unsigned long prevSampleMicros;
-
-public:
-
+/**
+ * Tuning parameters of Respiration. They are only read when a sensor is
+ * created, reset or reconfigured, so a single configuration (in flash when
+ * declared const) can be shared by all sensors. Time windows and smoothing
+ * factors are in seconds, converted to samples at the sensor's sample rate.
+ */
+struct RespirationConfig {
    //-----COMMON PARAMETERS-----//
         // Normalizers have a target mean of 0 and standard deviation of 1
         float normalizerMean = 0; 
@@ -127,48 +117,102 @@ public:
         // Flow rate smoother factors 
         float smootherFlowRateFactor = 0.1;
 
-        // Flow rate delta timer
-        float flowRateMetroTimer = 0.05;
-
         // Thresholds for peak detection
         float flowRatePeakThreshold = 0.5;
         float flowRatePeakReloadThreshold = 0.4;
         float flowRatePeakFallbackThreshold = 0.1;
+};
 
-    //-----PLAQUETTE OBJECTS-----//
+/// Default tuning (in flash).
+extern const RespirationConfig respirationDefaultConfig;
+
+class Respiration {
+public:
+  /// Features of one sample (see getFeatures()).
+  struct Features {
+    float temperature;
+    float normalized;
+    float scaled;
+    float amplitude;
+    float amplitudeChange;
+    float amplitudeDelta;
+    float amplitudeVariability;
+    float interval;
+    float rpm;
+    float rpmChange;
+    float rpmDelta;
+    float rpmVariability;
+    bool exhaling;
+  };
+
+private:
+  // Analog pin the Respiration sensor is connected to.
+  uint8_t _pin;
+
+  //ADS1115 object if using external ADC
+  ADS1115 ADS;
+
+  //SHthermistor object to calculate temperature from ADC value
+  SHthermistor thermistor;
+
+  // Sample rate in Hz.
+  unsigned long sampleRate;
+
+  // Internal use.
+  unsigned long microsBetweenSamples;
+  unsigned long prevSampleMicros;
+
+  // Tuning parameters (not owned).
+  const RespirationConfig* _config;
+
+  // Applies the tuning parameters and the sample rate to the filters.
+  void applyConfig();
+
+  // Reads the record of save() into this object, even if it is truncated.
+  void loadState(SnapshotReader& in);
+
+  // Number of samples in #seconds# at the sample rate.
+  unsigned int samples(float seconds) const;
+
+  // Features of the last sample, for readers concurrent with update().
+  Seqlock<Features> published;
+  void publish();
+
+public:
+
+    //-----FILTERS-----//
+    // Driven by the samples they are fed: their time windows follow the
+    // sample rate, not the clock.
         // Normalizers
-        Normalizer normalizer;
-        Normalizer normalizerAmplitude;
-        Normalizer normalizerAmplitudeChange;
-        Normalizer normalizerAmplitudeVariability;
-        Normalizer normalizerRpm;
-        Normalizer normalizerRpmChange;
-        Normalizer normalizerRpmVariability;
-        Normalizer normalizerFlowRate;
+        MovingNormalizer normalizer;
+        MovingNormalizer normalizerAmplitude;
+        MovingNormalizer normalizerAmplitudeChange;
+        MovingNormalizer normalizerAmplitudeVariability;
+        MovingNormalizer normalizerRpm;
+        MovingNormalizer normalizerRpmChange;
+        MovingNormalizer normalizerRpmVariability;
+        MovingNormalizer normalizerFlowRate;
 
         // Peak detectors
-        PeakDetector peak;
-        PeakDetector trough;
-        PeakDetector flowRatePeak;
+        Peak peak;
+        Peak trough;
+        Peak flowRatePeak;
       
         // Smoothers
-        Smoother smoother;
-        Smoother smootherAmplitude;
-        Smoother smootherAmplitudeChange;
-        Smoother smootherRpm;
-        Smoother smootherRpmChange;
-        Smoother smootherFlowRate;
-        Smoother smootherFlowRateVariability;
+        Lop smoother;
+        Lop smootherAmplitude;
+        Lop smootherAmplitudeChange;
+        Lop smootherRpm;
+        Lop smootherRpmChange;
+        Lop smootherFlowRate;
+        Lop smootherFlowRateVariability;
 
         // Scalers
-        MinMaxScaler scaler;
-        MinMaxScaler scalerAmplitudeChange;
-        MinMaxScaler scalerAmplitudeVariability;
-        MinMaxScaler scalerRpmChange;
-        MinMaxScaler scalerRpmVariability;
-
-        // Metronome
-        Metro flowRateMetro;
+        MovingScaler scaler;
+        MovingScaler scalerAmplitudeChange;
+        MovingScaler scalerAmplitudeVariability;
+        MovingScaler scalerRpmChange;
+        MovingScaler scalerRpmVariability;
     
     //-----VARIABLES-----//
         // Temperature
@@ -183,6 +227,9 @@ public:
         float _amplitudeChange;
         float _amplitudeDelta;
         float _amplitudeCV;
+        float _amplitudeMin; // base signal value at lowest point in breath cycle
+        float _amplitudeMax; // base signal value at highest point in breath cycle
+        float _pAmplitude; // previous amplitude to determine amplitude difference
 
         // Rpm 
         uint8_t _interval;
@@ -190,28 +237,55 @@ public:
         float _rpmChange;
         float _rpmDelta;
         float _rpmCV;
+        uint16_t _intervalMillis; // respiration interval (ms)
+        uint16_t _intervalChrono; // respiration interval chronometer (ms)
+        float _pRpm; // previous rpm to determine rpm difference
+
+        // Time of current sample (ms)
+        unsigned long _sampleMillis;
 
     //-----METHODS-----//
-  Respiration(uint8_t pin, unsigned long rate=50);   // Constructor. Default respiration samplerate is 50Hz
+  Respiration(uint8_t pin, unsigned long rate=50, const RespirationConfig* config=&respirationDefaultConfig);   // Constructor. Default respiration samplerate is 50Hz
   virtual ~Respiration() {}
 
-  /// sets certain Plaquette object parameters
+  /// Restarts the sensor and applies the tuning parameters.
   void reset();
 
-  /// Sets sample rate.
+  /// Sets sample rate (the rate of update() and of the samples given to process()).
   void setSampleRate(unsigned long rate);
 
+  /**
+   * Uses tuning parameters #config#, which must outlive the sensor (eg. a
+   * copy of respirationDefaultConfig modified while experimenting). Takes
+   * effect immediately.
+   */
+  void setConfig(const RespirationConfig* config);
+
+  /// Returns the tuning parameters in use.
+  const RespirationConfig& getConfig() const { return *_config; }
+
   /**
    * Reads the signal and perform filtering operations. Call this before
    * calling any of the access functions. This function takes into account
    * the sample rate.
+   * Returns true if a new sample was taken.
    */
-  void update();
+  bool update();
 
   // Performs the actual adjustments of signals and filterings.
   // Internal use: don't use directly, use update() instead.
   void sample();
 
+  /**
+   * Processes an ADC value acquired elsewhere (eg. replay of a recording) as
+   * returned by getRaw(), taken at time #ms# (in milliseconds). Samples
+   * are expected at the sample rate; nothing depends on the clock, so they
+   * can be processed as fast as they come. A reading that does not convert
+   * to a temperature (sensor disconnected or saturated) is replaced by the
+   * last temperature, so the filters keep running at the sample rate.
+   */
+  void process(uint16_t adcValue, unsigned long ms);
+
   void peakOrTrough(float value); // base temperature signal processing and peak detection
   void amplitude(float value); // amplitude data processing
   void rpm(); // respiration rate data processing
@@ -223,12 +297,12 @@ public:
   float getTemperature() const;
 
   /// Get normalized respiration signal.
-  float getNormalized();
+  float getNormalized() const;
 
-  float getScaled(); //returns scaled base signal
+  float getScaled() const; //returns scaled base signal
   bool isExhaling() const; //returns true if user is exhaling (temperature going up)
   float getTemperatureAmplitude() const; //returns breah amplitude (temperature at peak - temperature at trough)
-  float getNormalizedAmplitude(); //returns normalized breath amplitude 
+  float getNormalizedAmplitude() const; //returns normalized breath amplitude 
 
   ///Returns the average amplitude of signal mapped between 0.0 and 1.0.
   /* For example, if amplitude is average, returns 0.5,
@@ -242,7 +316,7 @@ public:
 
   float getInterval() const; //returns interbreath interval
   float getRpm() const; //returns respiration rate (respirations per minute)
-  float getNormalizedRpm(); //returns normalized respiration rate
+  float getNormalizedRpm() const; //returns normalized respiration rate
 
     /// Returns the average bpm of signal mapped between 0.0 and 1.0.
   /* For example, if bpm is average, returns 0.5,
@@ -252,6 +326,21 @@ public:
   float getRpmChange() const; //returns repiration rate change indicator
   float getRpmDelta() const; //returns respiration rate delta
   float getRpmVariability() const; //returns respiration rate coefficient of variation 
+
+  /**
+   * Copies the features of the last sample into #features#, all from the
+   * same sample even if update() runs in an interrupt meanwhile (see
+   * Seqlock.h). Returns the number of times the features were published
+   * since the sensor was created: once per sample and once per load(), so
+   * a different value means new features.
+   */
+  uint32_t getFeatures(Features& features) const;
+
+  /// Saves filter, breath amplitude and rate state (see Snapshot.h).
+  void save(SnapshotWriter& out) const;
+
+  /// Restores filter, breath amplitude and rate state (see Snapshot.h).
+  void load(SnapshotReader& in);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,224 @@
+/*
+ * RiceCodec.cpp
+ *
+ * Streaming lossless compression of raw ADC samples (one encoder per channel).
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "RiceCodec.h"
+
+// Prediction residual of sample #i# for a given predictor order.
+static inline int32_t riceResidual(const uint16_t* x, uint8_t i, uint8_t order) {
+  switch (order) {
+    case 1:  return (int32_t)x[i] - x[i-1];
+    case 2:  return (int32_t)x[i] - 2 * (int32_t)x[i-1] + x[i-2];
+    default: return x[i];
+  }
+}
+
+// Maps signed residuals to unsigned: 0, -1, 1, -2, 2... -> 0, 1, 2, 3, 4...
+static inline uint32_t riceZigzag(int32_t r) {
+  return ((uint32_t)r << 1) ^ (uint32_t)(r >> 31);
+}
+
+static inline int32_t riceUnzigzag(uint32_t u) {
+  return (int32_t)(u >> 1) ^ -(int32_t)(u & 1);
+}
+
+// MSB-first bit packing into a byte buffer.
+class RiceBitWriter {
+  uint8_t* _out;
+  size_t _pos;
+  uint32_t _acc;
+  uint8_t _nBits;
+
+public:
+  RiceBitWriter(uint8_t* out) : _out(out), _pos(0), _acc(0), _nBits(0) {}
+
+  // Writes the #n# (<= 24) lowest bits of #value#.
+  void write(uint32_t value, uint8_t n) {
+    _acc = (_acc << n) | (value & ((1UL << n) - 1));
+    _nBits += n;
+    while (_nBits >= 8) {
+      _nBits -= 8;
+      _out[_pos++] = (uint8_t)(_acc >> _nBits);
+    }
+  }
+
+  void writeOnes(uint32_t n) {
+    while (n >= 16) {
+      write(0xFFFF, 16);
+      n -= 16;
+    }
+    if (n) write((1UL << n) - 1, n);
+  }
+
+  // Pads to a whole byte and returns the number of bytes written.
+  size_t finish() {
+    if (_nBits) write(0, 8 - _nBits);
+    return _pos;
+  }
+};
+
+class RiceBitReader {
+  const uint8_t* _in;
+  size_t _size;
+  size_t _pos;
+  uint32_t _acc;
+  uint8_t _nBits;
+
+public:
+  bool overflow;
+
+  RiceBitReader(const uint8_t* in, size_t size) : _in(in), _size(size), _pos(0), _acc(0), _nBits(0), overflow(false) {}
+
+  // Reads #n# (<= 24) bits.
+  uint32_t read(uint8_t n) {
+    while (_nBits < n) {
+      if (_pos >= _size) {
+        overflow = true;
+        return 0;
+      }
+      _acc = (_acc << 8) | _in[_pos++];
+      _nBits += 8;
+    }
+    _nBits -= n;
+    return (_acc >> _nBits) & ((1UL << n) - 1);
+  }
+
+  size_t position() const { return _pos; }
+};
+
+RiceEncoder::RiceEncoder() {
+  reset();
+}
+
+void RiceEncoder::reset() {
+  _nSamples = 0;
+  _blockSize = 0;
+}
+
+bool RiceEncoder::put(uint16_t sample) {
+  _samples[_nSamples++] = sample;
+  if (_nSamples < RICE_CODEC_BLOCK_SAMPLES)
+    return false;
+  encodeBlock();
+  return true;
+}
+
+bool RiceEncoder::flush() {
+  if (_nSamples == 0)
+    return false;
+  encodeBlock();
+  return true;
+}
+
+void RiceEncoder::encodeBlock() {
+  const uint8_t n = _nSamples;
+  const uint16_t* x = _samples;
+
+  // Pick the predictor with the smallest absolute residuals.
+  uint32_t cost[3] = { 0, 0, 0 };
+  for (uint8_t i = 2; i < n; i++) {
+    int32_t d1 = (int32_t)x[i] - x[i-1];
+    int32_t d2 = d1 - ((int32_t)x[i-1] - x[i-2]);
+    cost[0] += x[i];
+    cost[1] += (d1 < 0 ? -d1 : d1);
+    cost[2] += (d2 < 0 ? -d2 : d2);
+  }
+  uint8_t order = (cost[1] <= cost[2]) ? 1 : 2;
+  if (cost[0] < cost[order]) order = 0;
+  if (order > n) order = n;
+
+  // Rice parameter: k = floor(log2(mean residual)).
+  uint32_t sum = 0;
+  for (uint8_t i = order; i < n; i++)
+    sum += riceZigzag(riceResidual(x, i, order));
+  uint8_t m = n - order;
+  uint8_t k = 0;
+  while (k < 16 && ((uint32_t)m << (k + 1)) <= sum)
+    k++;
+
+  // Exact size, to fall back on verbatim storage when coding does not pay off.
+  uint32_t bits = 16 + 16 * (uint32_t)order;
+  for (uint8_t i = order; i < n; i++) {
+    uint32_t q = riceZigzag(riceResidual(x, i, order)) >> k;
+    bits += (q < RICE_CODEC_ESCAPE) ? q + 1 + k : RICE_CODEC_ESCAPE + RICE_CODEC_ESCAPE_BITS;
+  }
+
+  RiceBitWriter writer(_block);
+  if (bits >= 16 + 16 * (uint32_t)n) {
+    writer.write(RICE_CODEC_VERBATIM << 6, 8);
+    writer.write(n, 8);
+    for (uint8_t i = 0; i < n; i++)
+      writer.write(x[i], 16);
+  } else {
+    writer.write((order << 6) | (k << 1), 8);
+    writer.write(n, 8);
+    for (uint8_t i = 0; i < order; i++)
+      writer.write(x[i], 16);
+    for (uint8_t i = order; i < n; i++) {
+      uint32_t u = riceZigzag(riceResidual(x, i, order));
+      uint32_t q = u >> k;
+      if (q < RICE_CODEC_ESCAPE) {
+        writer.writeOnes(q);
+        writer.write(0, 1);
+        if (k) writer.write(u, k);
+      } else {
+        writer.writeOnes(RICE_CODEC_ESCAPE);
+        writer.write(u, RICE_CODEC_ESCAPE_BITS);
+      }
+    }
+  }
+  _blockSize = writer.finish();
+  _nSamples = 0;
+}
+
+size_t RiceDecoder::decode(const uint8_t* in, size_t size, uint16_t* out, size_t* consumed) {
+  RiceBitReader reader(in, size);
+  uint8_t header = reader.read(8);
+  uint8_t n = reader.read(8);
+  uint8_t order = header >> 6;
+  uint8_t k = (header >> 1) & 0x1F;
+
+  if (reader.overflow || n == 0 || n > RICE_CODEC_BLOCK_SAMPLES || k > 16)
+    return 0;
+
+  if (order == RICE_CODEC_VERBATIM) {
+    for (uint8_t i = 0; i < n; i++)
+      out[i] = reader.read(16);
+  } else {
+    if (order > n)
+      return 0;
+    for (uint8_t i = 0; i < order; i++)
+      out[i] = reader.read(16);
+    for (uint8_t i = order; i < n && !reader.overflow; i++) {
+      uint32_t q = 0;
+      while (q < RICE_CODEC_ESCAPE && reader.read(1) && !reader.overflow)
+        q++;
+      uint32_t u = (q < RICE_CODEC_ESCAPE) ? ((q << k) | (k ? reader.read(k) : 0)) : reader.read(RICE_CODEC_ESCAPE_BITS);
+      int32_t prediction = (order == 0) ? 0 : (order == 1) ? out[i-1] : 2 * (int32_t)out[i-1] - out[i-2];
+      out[i] = (uint16_t)(prediction + riceUnzigzag(u));
+    }
+  }
+
+  if (reader.overflow)
+    return 0;
+  if (consumed)
+    *consumed = reader.position();
+  return n;
+}
@@ -0,0 +1,100 @@
+/*
+ * RiceCodec.h
+ *
+ * Streaming lossless compression of raw ADC samples (one encoder per channel).
+ *
+ * Samples are grouped in fixed-size blocks. For each block, the encoder picks
+ * the cheapest fixed linear predictor (none, delta or 2nd order), and codes
+ * the prediction residuals with a Rice code whose parameter is chosen from
+ * the block statistics. Blocks that would not compress are stored verbatim.
+ * Each block can be decoded on its own.
+ *
+ * Block format (bits, MSB first, padded to a whole byte):
+ *   2 bits   predictor order (0, 1, 2) or 3 = verbatim
+ *   5 bits   Rice parameter k
+ *   1 bit    unused
+ *   8 bits   number of samples n
+ *   order x 16 bits  warm-up samples
+ *   (n - order) x Rice-coded zigzag residuals, or n x 16 bits if verbatim
+ * A residual whose quotient reaches RICE_CODEC_ESCAPE is written as
+ * RICE_CODEC_ESCAPE ones followed by the zigzag value on 20 bits.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+
+#ifndef RICE_CODEC_H_
+#define RICE_CODEC_H_
+
+// Number of samples per block (at most 255).
+#ifndef RICE_CODEC_BLOCK_SAMPLES
+#define RICE_CODEC_BLOCK_SAMPLES 64
+#endif
+
+// Unary quotient length that triggers an escape.
+#define RICE_CODEC_ESCAPE 24
+
+#define RICE_CODEC_ESCAPE_BITS 20
+
+#define RICE_CODEC_VERBATIM 3
+
+// Largest encoded block: header + verbatim samples.
+#define RICE_CODEC_MAX_BLOCK_BYTES (2 + 2 * RICE_CODEC_BLOCK_SAMPLES)
+
+class RiceEncoder {
+  uint16_t _samples[RICE_CODEC_BLOCK_SAMPLES];
+  uint8_t _nSamples;
+
+  uint8_t _block[RICE_CODEC_MAX_BLOCK_BYTES];
+  uint16_t _blockSize;
+
+  void encodeBlock();
+
+public:
+  RiceEncoder();
+
+  /// Discards buffered samples.
+  void reset();
+
+  /**
+   * Adds a sample. Returns true when a block has been completed, in which case
+   * it is available through data() and size() until the next call.
+   */
+  bool put(uint16_t sample);
+
+  /// Encodes buffered samples as a shorter block. Returns true if a block is available.
+  bool flush();
+
+  /// Returns the last encoded block.
+  const uint8_t* data() const { return _block; }
+
+  /// Returns the size of the last encoded block in bytes.
+  size_t size() const { return _blockSize; }
+};
+
+class RiceDecoder {
+public:
+  /**
+   * Decodes one block from #in# into #out# (room for RICE_CODEC_BLOCK_SAMPLES
+   * samples). Returns the number of samples decoded, or 0 if the block is
+   * malformed or truncated. If #consumed# is not NULL it receives the number
+   * of bytes read from #in#.
+   */
+  static size_t decode(const uint8_t* in, size_t size, uint16_t* out, size_t* consumed=NULL);
+};
+
+#endif
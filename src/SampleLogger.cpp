@@ -0,0 +1,109 @@
+/*
+ * SampleLogger.cpp
+ *
+ * This class logs raw sensor samples to a storage (SD card, file) using two
+ * preallocated blocks.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "SampleLogger.h"
+
+SampleLogger::SampleLogger(LogStorage& storage) :
+  _storage(storage)
+{
+  reset();
+}
+
+void SampleLogger::reset() {
+  _active = 0;
+  _fill = 0;
+  _full[0] = _full[1] = false;
+  _nOverruns = 0;
+  _nBlocksWritten = 0;
+  _nWriteErrors = 0;
+  _maxWriteMicros = 0;
+}
+
+bool SampleLogger::log(uint8_t channel, uint16_t value, uint32_t time) {
+  // Active block is full and could not be swapped: try again now.
+  if (_fill >= SAMPLE_LOGGER_BLOCK_BYTES) {
+    uint8_t next = 1 - _active;
+    if (_full[next]) {
+      _nOverruns++;
+      return false;
+    }
+    _active = next;
+    _fill = 0;
+  }
+
+  SampleRecord record;
+  record.time = time;
+  record.value = value;
+  record.channel = channel;
+  record.reserved = 0;
+  memcpy(&_blocks[_active][_fill], &record, sizeof(SampleRecord));
+  _fill += sizeof(SampleRecord);
+
+  // Hand the block over to flush() and swap as soon as it is full.
+  if (_fill >= SAMPLE_LOGGER_BLOCK_BYTES) {
+    _full[_active] = true;
+    uint8_t next = 1 - _active;
+    if (!_full[next]) {
+      _active = next;
+      _fill = 0;
+    }
+  }
+
+  return true;
+}
+
+bool SampleLogger::writeBlock(uint8_t block, size_t size) {
+  unsigned long start = micros();
+  size_t written = _storage.write(_blocks[block], size);
+  unsigned long elapsed = micros() - start;
+
+  if (elapsed > _maxWriteMicros)
+    _maxWriteMicros = elapsed;
+  if (written != size)
+    _nWriteErrors++;
+  _nBlocksWritten++;
+
+  return (written == size);
+}
+
+bool SampleLogger::flush() {
+  // Only the block that is not being filled is ever written.
+  uint8_t block = 1 - _active;
+  if (!_full[block])
+    return false;
+
+  writeBlock(block, SAMPLE_LOGGER_BLOCK_BYTES);
+  _full[block] = false;
+  return true;
+}
+
+void SampleLogger::close() {
+  flush();
+
+  // Active block, full or partially filled.
+  if (_fill > 0) {
+    writeBlock(_active, _fill);
+    _full[_active] = false;
+    _fill = 0;
+  }
+  _storage.flush();
+}
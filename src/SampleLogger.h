@@ -0,0 +1,133 @@
+/*
+ * SampleLogger.h
+ *
+ * This class logs raw sensor samples to a storage (SD card, file) using two
+ * preallocated blocks: samples are appended to one block while the other one
+ * is written in a single large, aligned write. Logging a sample is a memcpy
+ * and can be done from an interrupt; the slow write happens in flush(), called
+ * from loop(). If both blocks are full when a sample comes in, the sample is
+ * dropped and counted as an overrun.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+
+#ifndef SAMPLE_LOGGER_H_
+#define SAMPLE_LOGGER_H_
+
+// Size of each block in bytes. A multiple of the SD sector size (512).
+#ifndef SAMPLE_LOGGER_BLOCK_SIZE
+#define SAMPLE_LOGGER_BLOCK_SIZE 512
+#endif
+
+/// One logged sample (8 bytes, SAMPLE_LOGGER_BLOCK_SIZE / 8 per block).
+struct SampleRecord {
+  uint32_t time;    // timestamp (eg. micros())
+  uint16_t value;   // raw ADC value
+  uint8_t channel;  // user-defined channel (eg. 0 = heart, 1 = skin conductance, 2 = respiration)
+  uint8_t reserved;
+};
+
+// Bytes used in a full block.
+#define SAMPLE_LOGGER_BLOCK_BYTES ((SAMPLE_LOGGER_BLOCK_SIZE / sizeof(SampleRecord)) * sizeof(SampleRecord))
+
+/// Destination of the logged blocks.
+class LogStorage {
+public:
+  virtual ~LogStorage() {}
+
+  /// Writes #size# bytes. Returns the number of bytes actually written.
+  virtual size_t write(const uint8_t* data, size_t size) = 0;
+
+  /// Commits written data to the medium.
+  virtual bool flush() { return true; }
+};
+
+/// Storage adapter for any file class with write() and flush() (SD, SdFat, LittleFS).
+template <class FileT> class FileStorage : public LogStorage {
+  FileT& _file;
+
+public:
+  FileStorage(FileT& file) : _file(file) {}
+
+  size_t write(const uint8_t* data, size_t size) {
+    return _file.write(data, size);
+  }
+
+  bool flush() {
+    _file.flush();
+    return true;
+  }
+};
+
+class SampleLogger {
+
+  LogStorage& _storage;
+
+  uint8_t _blocks[2][SAMPLE_LOGGER_BLOCK_SIZE];
+
+  // Block currently being filled and number of bytes used in it.
+  volatile uint8_t _active;
+  volatile uint16_t _fill;
+
+  // Blocks waiting to be written.
+  volatile bool _full[2];
+
+  // Statistics.
+  volatile uint32_t _nOverruns;
+  uint32_t _nBlocksWritten;
+  uint32_t _nWriteErrors;
+  unsigned long _maxWriteMicros;
+
+  bool writeBlock(uint8_t block, size_t size);
+
+public:
+  SampleLogger(LogStorage& storage);
+
+  /// Empties the blocks and resets statistics.
+  void reset();
+
+  /**
+   * Appends a sample to the active block. Cheap and safe to call from an
+   * interrupt. Returns false (and counts an overrun) if the sample was dropped
+   * because both blocks are waiting to be written.
+   */
+  bool log(uint8_t channel, uint16_t value, uint32_t time);
+
+  /**
+   * Writes at most one full block to the storage. Call this often from loop().
+   * Returns true if a block was written.
+   */
+  bool flush();
+
+  /// Writes all remaining samples, including the partially filled block, and flushes the storage.
+  void close();
+
+  /// Returns the number of samples dropped because both blocks were full.
+  uint32_t nOverruns() const { return _nOverruns; }
+
+  /// Returns the number of blocks written.
+  uint32_t nBlocksWritten() const { return _nBlocksWritten; }
+
+  /// Returns the number of blocks that could not be completely written.
+  uint32_t nWriteErrors() const { return _nWriteErrors; }
+
+  /// Returns the longest time spent writing a single block, in microseconds.
+  unsigned long maxWriteMicros() const { return _maxWriteMicros; }
+};
+
+#endif
@@ -0,0 +1,89 @@
+/*
+ * Seqlock.h
+ *
+ * Publishes a value written by one writer (eg. a timer interrupt running the
+ * sensors) to any number of readers (eg. the main loop) without locks and
+ * without disabling interrupts. The writer never waits; a reader copies the
+ * value and starts over if it was rewritten meanwhile, so it always gets a
+ * value that was published as a whole.
+ *
+ * The sequence number is odd while a write is in progress. The value is
+ * stored as words accessed atomically, so concurrent reads and writes are
+ * well defined on the host too. T must be trivially copyable (plain structs
+ * of numbers and flags).
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+#include <string.h>
+
+#ifndef SEQLOCK_H_
+#define SEQLOCK_H_
+
+template <class T>
+class Seqlock {
+  static const size_t N_WORDS = (sizeof(T) + sizeof(uint32_t) - 1) / sizeof(uint32_t);
+
+  uint32_t _sequence;
+  uint32_t _words[N_WORDS];
+
+public:
+  Seqlock() : _sequence(0) {
+    memset(_words, 0, sizeof(_words));
+  }
+
+  /// Publishes #value#. Only one writer at a time.
+  void write(const T& value) {
+    uint32_t words[N_WORDS];
+    words[N_WORDS - 1] = 0;
+    memcpy(words, &value, sizeof(T));
+
+    uint32_t sequence = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&_sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < N_WORDS; i++)
+      __atomic_store_n(&_words[i], words[i], __ATOMIC_RELAXED);
+    __atomic_store_n(&_sequence, sequence + 2, __ATOMIC_RELEASE);
+  }
+
+  /**
+   * Copies the last published value into #value# and returns the number of
+   * values published so far (0: #value# is all zeros). Must not be called
+   * from an interrupt that can preempt the writer: it would wait forever.
+   */
+  uint32_t read(T& value) const {
+    uint32_t words[N_WORDS];
+    uint32_t before, after;
+    do {
+      before = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+      for (size_t i = 0; i < N_WORDS; i++)
+        words[i] = __atomic_load_n(&_words[i], __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      after = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+    } while ((before & 1) || before != after);
+
+    memcpy(&value, words, sizeof(T));
+    return before / 2;
+  }
+
+  /// Returns the number of values published so far.
+  uint32_t count() const {
+    return __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE) / 2;
+  }
+};
+
+#endif
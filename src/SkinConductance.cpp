@@ -29,12 +29,10 @@
  */
 #include "SkinConductance.h"
 
-
-float alpha_1 = 0.01;
-float alpha_2 = 0.005;
-
 SkinConductance::SkinConductance(uint8_t pin, unsigned long rate) :
-  _pin(pin)
+  _pin(pin),
+  gsrSensorLopSmoothing(0.01),
+  gsrSensorLopassedSmoothing(0.005)
 {
   setSampleRate(rate);
   reset();
@@ -46,7 +44,9 @@ void SkinConductance::reset() {
   gsrSensorFiltered = 0;
   gsrSensorLopFiltered = 0;
   gsrSensorAmplitude = 0;
+  gsrSensorLop = 0;
   gsrSensorLopassed = 0;
+  gsrSensorChange = 0;
   gsrSensorChangeFiltered = 0;
 
   prevSampleMicros = micros();
@@ -55,18 +55,28 @@ void SkinConductance::reset() {
   sample();
 }
 
+void SkinConductance::setLopSmoothing(float smoothing) {
+  gsrSensorLopSmoothing = constrain(smoothing, 0, 1);
+}
+
+void SkinConductance::setLopassedSmoothing(float smoothing) {
+  gsrSensorLopassedSmoothing = constrain(smoothing, 0, 1);
+}
+
 void SkinConductance::setSampleRate(unsigned long rate) {
   sampleRate = rate;
   microsBetweenSamples = 1000000UL / sampleRate;
 }
 
-void SkinConductance::update() {
+bool SkinConductance::update() {
   unsigned long t = micros();
   if (t - prevSampleMicros >= microsBetweenSamples) {
     // Perform updates.
     sample();
     prevSampleMicros = t;
+    return true;
   }
+  return false;
 }
 
 float SkinConductance::getSCR() const {
@@ -81,14 +91,53 @@ int SkinConductance::getRaw() const {
   return gsrSensorReading;
 }
 
+void SkinConductance::save(SnapshotWriter& out) const {
+  out.writeUInt8('S');
+  out.writeUInt32(gsrSensorReading);
+  out.writeFloat(gsrSensorFiltered);
+  out.writeFloat(gsrSensorLopFiltered);
+  out.writeFloat(gsrSensorChange);
+  out.writeFloat(gsrSensorChangeFiltered);
+  out.writeFloat(gsrSensorAmplitude);
+  out.writeFloat(gsrSensorLop);
+  out.writeFloat(gsrSensorLopassed);
+}
+
+void SkinConductance::load(SnapshotReader& in) {
+  in.expect('S');
+  int32_t reading = (int32_t)in.readUInt32();
+  float filtered = in.readFloat();
+  float lopFiltered = in.readFloat();
+  float change = in.readFloat();
+  float changeFiltered = in.readFloat();
+  float amplitude = in.readFloat();
+  float lop = in.readFloat();
+  float lopassed = in.readFloat();
+  if (!in.ok())
+    return;
+  gsrSensorReading = reading;
+  gsrSensorFiltered = filtered;
+  gsrSensorLopFiltered = lopFiltered;
+  gsrSensorChange = change;
+  gsrSensorChangeFiltered = changeFiltered;
+  gsrSensorAmplitude = amplitude;
+  gsrSensorLop = lop;
+  gsrSensorLopassed = lopassed;
+  publish();
+}
+
 void SkinConductance::sample() {
     // Read sensor value and invert it.
-    gsrSensorReading = 1023 - analogRead(_pin); //this is a dummy read to clear the adc.  This is needed at higher sampling frequencies.
-    gsrSensorReading = 1023 - analogRead(_pin);
+    analogRead(_pin); //this is a dummy read to clear the adc.  This is needed at higher sampling frequencies.
+    process(1023 - analogRead(_pin));
+}
+
+void SkinConductance::process(int reading) {
+    gsrSensorReading = reading;
     // Smooth out the signals that you compare to one another and map between 0 and 1000
 
-    gsrSensorLop = alpha_1*gsrSensorReading + (1 - alpha_1)*gsrSensorLop;
-    gsrSensorLopassed = alpha_2*gsrSensorLop + (1 - alpha_2)*gsrSensorLopassed;
+    gsrSensorLop = gsrSensorLopSmoothing*gsrSensorReading + (1 - gsrSensorLopSmoothing)*gsrSensorLop;
+    gsrSensorLopassed = gsrSensorLopassedSmoothing*gsrSensorLop + (1 - gsrSensorLopassedSmoothing)*gsrSensorLopassed;
 
     gsrSensorChange = ((gsrSensorLop - gsrSensorLopassed)/10)+0.2;
 
@@ -96,4 +145,17 @@ void SkinConductance::sample() {
 
     gsrSensorChange = constrain(gsrSensorChange, 0, 1);
 
+    publish();
+}
+
+void SkinConductance::publish() {
+  Features f;
+  f.raw = gsrSensorReading;
+  f.scr = gsrSensorChange;
+  f.scl = gsrSensorLopFiltered;
+  published.write(f);
+}
+
+uint32_t SkinConductance::getFeatures(Features& features) const {
+  return published.read(features);
 }
@@ -32,6 +32,8 @@
 #include "MinMax.h"
 #include "Lop.h"
 #include "Hip.h"
+#include "Snapshot.h"
+#include "Seqlock.h"
 
 
 #ifndef SKIN_CONDUCTANCE_H_
@@ -39,6 +41,15 @@
 
 
 class SkinConductance {
+public:
+  /// Features of one sample (see getFeatures()).
+  struct Features {
+    int raw;
+    float scr;
+    float scl;
+  };
+
+private:
 
   // Analog pin the SC sensor is connected to.
   uint8_t _pin;
@@ -52,6 +63,10 @@ class SkinConductance {
   float gsrSensorLop;
   float gsrSensorLopassed;
 
+  // Smoothing factors of the two low-pass stages (SCL and its baseline).
+  float gsrSensorLopSmoothing;
+  float gsrSensorLopassedSmoothing;
+
   // Sample rate in Hz.
   unsigned long sampleRate;
 
@@ -59,10 +74,20 @@ class SkinConductance {
   unsigned long microsBetweenSamples;
   unsigned long prevSampleMicros;
 
+  // Features of the last sample, for readers concurrent with update().
+  Seqlock<Features> published;
+  void publish();
+
 public:
   SkinConductance(uint8_t pin, unsigned long rate=50); // default SC samplerate is 50Hz
   virtual ~SkinConductance() {}
 
+  /// Sets smoothing factor of the SCL low-pass filter (default: 0.01).
+  void setLopSmoothing(float smoothing);
+
+  /// Sets smoothing factor of the SCL baseline used by getSCR() (default: 0.005).
+  void setLopassedSmoothing(float smoothing);
+
   /// Resets all values.
   void reset();
 
@@ -72,8 +97,9 @@ public:
   /**
    * Reads the signal and perform filtering operations. Call this before
    * calling any of the access functions.
+   * Returns true if a new sample was taken.
    */
-  void update();
+  bool update();
 
   /// Returns skin conductance response (SRC).
   float getSCR() const;
@@ -84,9 +110,30 @@ public:
   /// Returns raw signal as returned by analogRead() (inverted).
   int getRaw() const;
 
+  /**
+   * Copies the features of the last sample into #features#, all from the
+   * same sample even if update() runs in an interrupt meanwhile (see
+   * Seqlock.h). Returns the number of times the features were published
+   * since the sensor was created: once per sample and once per load(), so
+   * a different value means new features.
+   */
+  uint32_t getFeatures(Features& features) const;
+
+  /// Saves the state of all filters (see Snapshot.h).
+  void save(SnapshotWriter& out) const;
+
+  /// Restores the state of all filters (see Snapshot.h).
+  void load(SnapshotReader& in);
+
   // Performs the actual adjustments of signals and filterings.
-  // Internal use: don't use directly, use update() instead.
+  // Use update() instead, unless samples are timed elsewhere (eg. timer interrupt).
   void sample();
+
+  /**
+   * Processes a reading acquired elsewhere (eg. replay of a recording) as
+   * returned by getRaw() (inverted).
+   */
+  void process(int reading);
 };
 
 #endif
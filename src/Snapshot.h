@@ -0,0 +1,245 @@
+/*
+ * Snapshot.h
+ *
+ * Compact binary snapshots of the state of filters and sensors, used to
+ * warm-start a session with the baselines learned during a previous one.
+ *
+ * Objects that support snapshots implement:
+ *   void save(SnapshotWriter& out) const;
+ *   void load(SnapshotReader& in);
+ * and only store their evolving state, not their tuning parameters.
+ *
+ * saveSnapshot() wraps an object's state with a header and a checksum:
+ *   'B' 'D'  magic
+ *   uint8    SNAPSHOT_VERSION
+ *   uint8    reserved
+ *   uint16   payload size
+ *   ...      payload
+ *   uint16   Fletcher-16 checksum of the payload
+ * Values are stored little-endian with fixed sizes, so a snapshot taken on
+ * the device can be restored on the host and vice versa.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <Arduino.h>
+
+#ifndef SNAPSHOT_H_
+#define SNAPSHOT_H_
+
+// Bump when the layout of any saved state changes.
+#define SNAPSHOT_VERSION 6
+
+// Header (magic, version, reserved, payload size) and checksum.
+#define SNAPSHOT_HEADER_SIZE 6
+#define SNAPSHOT_OVERHEAD (SNAPSHOT_HEADER_SIZE + 2)
+
+/// Writes values into a buffer. With a NULL buffer, only counts bytes.
+class SnapshotWriter {
+  uint8_t* _buffer;
+  size_t _capacity;
+  size_t _size;
+  bool _overflow;
+
+public:
+  SnapshotWriter(uint8_t* buffer, size_t capacity) :
+    _buffer(buffer), _capacity(capacity), _size(0), _overflow(false) {}
+
+  void writeUInt32(uint32_t v) {
+    if (!_buffer) {
+      _size += 4;
+      return;
+    }
+    if (_size + 4 > _capacity) {
+      _overflow = true;
+      return;
+    }
+    _buffer[_size++] = (uint8_t)(v);
+    _buffer[_size++] = (uint8_t)(v >> 8);
+    _buffer[_size++] = (uint8_t)(v >> 16);
+    _buffer[_size++] = (uint8_t)(v >> 24);
+  }
+
+  void writeUInt8(uint8_t v) {
+    if (!_buffer) {
+      _size++;
+      return;
+    }
+    if (_size + 1 > _capacity) {
+      _overflow = true;
+      return;
+    }
+    _buffer[_size++] = v;
+  }
+
+  void writeFloat(float v) {
+    uint32_t bits;
+    memcpy(&bits, &v, 4);
+    writeUInt32(bits);
+  }
+
+  void writeBool(bool v) { writeUInt8(v ? 1 : 0); }
+
+  // Typed overloads, for templates.
+  void write(float v) { writeFloat(v); }
+  void write(int32_t v) { writeUInt32((uint32_t)v); }
+  void write(uint32_t v) { writeUInt32(v); }
+  void write(int16_t v) { writeUInt32((uint32_t)(int32_t)v); }
+  void write(uint16_t v) { writeUInt32(v); }
+  void write(int8_t v) { writeUInt32((uint32_t)(int32_t)v); }
+  void write(uint8_t v) { writeUInt32(v); }
+
+  /// Number of bytes written.
+  size_t size() const { return _size; }
+
+  /// False if the buffer was too small.
+  bool ok() const { return !_overflow; }
+};
+
+class SnapshotReader {
+  const uint8_t* _buffer;
+  size_t _size;
+  size_t _position;
+  bool _underflow;
+
+public:
+  SnapshotReader(const uint8_t* buffer, size_t size) :
+    _buffer(buffer), _size(size), _position(0), _underflow(false) {}
+
+  uint32_t readUInt32() {
+    if (_position + 4 > _size) {
+      _underflow = true;
+      return 0;
+    }
+    uint32_t v = (uint32_t)_buffer[_position] | ((uint32_t)_buffer[_position+1] << 8) |
+                 ((uint32_t)_buffer[_position+2] << 16) | ((uint32_t)_buffer[_position+3] << 24);
+    _position += 4;
+    return v;
+  }
+
+  uint8_t readUInt8() {
+    if (_position + 1 > _size) {
+      _underflow = true;
+      return 0;
+    }
+    return _buffer[_position++];
+  }
+
+  float readFloat() {
+    uint32_t bits = readUInt32();
+    float v;
+    memcpy(&v, &bits, 4);
+    return v;
+  }
+
+  bool readBool() { return readUInt8() != 0; }
+
+  // Typed overloads, for templates.
+  void read(float& v) { v = readFloat(); }
+  void read(int32_t& v) { v = (int32_t)readUInt32(); }
+  void read(uint32_t& v) { v = readUInt32(); }
+  void read(int16_t& v) { v = (int16_t)(int32_t)readUInt32(); }
+  void read(uint16_t& v) { v = (uint16_t)readUInt32(); }
+  void read(int8_t& v) { v = (int8_t)(int32_t)readUInt32(); }
+  void read(uint8_t& v) { v = (uint8_t)readUInt32(); }
+
+  /// Reads a tag and flags the snapshot as invalid if it does not match.
+  void expect(uint8_t tag) {
+    if (readUInt8() != tag)
+      _underflow = true;
+  }
+
+  /// Flags the snapshot as invalid (eg. when saved with different settings).
+  void invalidate() { _underflow = true; }
+
+  /// Number of bytes left.
+  size_t remaining() const { return _size - _position; }
+
+  /// False if data was missing or did not match.
+  bool ok() const { return !_underflow; }
+};
+
+inline uint16_t snapshotChecksum(const uint8_t* data, size_t size) {
+  uint16_t sum1 = 0, sum2 = 0;
+  for (size_t i = 0; i < size; i++) {
+    sum1 = (sum1 + data[i]) % 255;
+    sum2 = (sum2 + sum1) % 255;
+  }
+  return (sum2 << 8) | sum1;
+}
+
+/**
+ * Saves the state of #object# into #buffer#. Returns the number of bytes
+ * written, or 0 if #capacity# is too small.
+ */
+template <class T> size_t saveSnapshot(const T& object, uint8_t* buffer, size_t capacity) {
+  if (capacity < SNAPSHOT_OVERHEAD)
+    return 0;
+
+  SnapshotWriter payload(buffer + SNAPSHOT_HEADER_SIZE, capacity - SNAPSHOT_OVERHEAD);
+  object.save(payload);
+  if (!payload.ok() || payload.size() > 0xFFFF)
+    return 0;
+
+  uint16_t size = payload.size();
+  uint16_t checksum = snapshotChecksum(buffer + SNAPSHOT_HEADER_SIZE, size);
+  buffer[0] = 'B';
+  buffer[1] = 'D';
+  buffer[2] = SNAPSHOT_VERSION;
+  buffer[3] = 0;
+  buffer[4] = (uint8_t)(size);
+  buffer[5] = (uint8_t)(size >> 8);
+  buffer[SNAPSHOT_HEADER_SIZE + size] = (uint8_t)(checksum);
+  buffer[SNAPSHOT_HEADER_SIZE + size + 1] = (uint8_t)(checksum >> 8);
+  return size + SNAPSHOT_OVERHEAD;
+}
+
+/// Returns the size of the snapshot of #object#, header and checksum included.
+template <class T> size_t snapshotSize(const T& object) {
+  SnapshotWriter counter(NULL, 0);
+  object.save(counter);
+  return counter.size() + SNAPSHOT_OVERHEAD;
+}
+
+/**
+ * Restores the state of #object# from a snapshot. Returns false, leaving
+ * #object# untouched, if the snapshot is missing, corrupted, from another
+ * version or does not have the size of #object#'s state. Returns false too
+ * if the snapshot is of another kind of object of the same size, in which
+ * case #object# should be reset().
+ */
+template <class T> bool loadSnapshot(T& object, const uint8_t* buffer, size_t size) {
+  if (size < SNAPSHOT_OVERHEAD || buffer[0] != 'B' || buffer[1] != 'D' || buffer[2] != SNAPSHOT_VERSION)
+    return false;
+
+  uint16_t payloadSize = buffer[4] | (buffer[5] << 8);
+  if ((size_t)payloadSize + SNAPSHOT_OVERHEAD > size)
+    return false;
+
+  const uint8_t* payload = buffer + SNAPSHOT_HEADER_SIZE;
+  uint16_t checksum = payload[payloadSize] | (payload[payloadSize + 1] << 8);
+  if (checksum != snapshotChecksum(payload, payloadSize))
+    return false;
+
+  if ((size_t)payloadSize + SNAPSHOT_OVERHEAD != snapshotSize(object))
+    return false;
+
+  SnapshotReader in(payload, payloadSize);
+  object.load(in);
+  return in.ok();
+}
+
+#endif
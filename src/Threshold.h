@@ -24,6 +24,7 @@
 
 ******************************************************/
 #include <Arduino.h>
+#include "Snapshot.h"
 
 #ifndef THRESHOLD_H_
 #define THRESHOLD_H_
@@ -40,6 +41,17 @@ public:
   this->upper = upper;
  }
 
+ /// Rearms the detector.
+ void reset() {
+  triggered = false;
+ }
+
+ /// Sets the bounds: triggers above #upper#, rearms below #lower#.
+ void setBounds(float lower, float upper) {
+  this->lower = lower;
+  this->upper = upper;
+ }
+
  bool detect(float value) {
 
     if ( value >= upper && triggered == false ) {
@@ -52,6 +64,20 @@ public:
 
  }
 
+ /// Saves detector state (see Snapshot.h).
+ void save(SnapshotWriter& out) const {
+    out.writeUInt8('T');
+    out.writeBool(triggered);
+ }
+
+ /// Restores detector state (see Snapshot.h).
+ void load(SnapshotReader& in) {
+    in.expect('T');
+    bool t = in.readBool();
+    if (in.ok())
+      triggered = t;
+ }
+
 
 
 };
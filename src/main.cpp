@@ -1,9 +1,15 @@
 #include <Arduino.h>             // Arduino core
 
+// Checks the RAM budgets of Footprint.h in every Teensy 3.1 build (the
+// budgets are for that board), not only in examples/Footprint.
+#if defined(__MK20DX256__) || defined(FOOTPRINT_CHECK_HOST)
+#include "Footprint.h"
+#endif
+
 void setup()
 {
 }
 
 void loop()
 {
-}
\ No newline at end of file
+}
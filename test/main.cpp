@@ -1,9 +1,529 @@
+/*
+ * main.cpp (regression suite)
+ *
+ * Golden-output regression tests for the Heart, SkinConductance and
+ * Respiration pipelines, built on the host (see test/README). Every case
+ * replays a recording through one sensor and compares every feature of every
+ * sample with a golden file (test/golden/<case>.bdfa, a FeatureArchive):
+ *
+ *  - values must be within an absolute or relative tolerance of the golden
+ *    value at the same sample, or at a neighbouring sample within the
+ *    alignment window of the sensor (so that a detection moved by a sample
+ *    counts as a time error, not as a large value error);
+ *  - events (beats, exhale and inhale onsets, SCR onsets) are matched one to
+ *    one with golden events within the same window: missed and extra events
+ *    fail the case, and the mean shift is reported.
+ *
+ * Each case also reports the processing cost in ns/sample (best of several
+ * runs), so that speed and accuracy changes show up in the same report.
+ *
+ * Cases are synthetic recordings generated here, and the channels of any
+ * SampleLogger session given with -session (reference recordings). A case
+ * without a readable golden file fails; -update writes the golden files from
+ * the current outputs.
+ *
+ * Usage: regression [-golden dir] [-update] [-session file]...
+ *
+ * On the device, this file is an empty sketch.
+ *
+ * This file is part of the BioData project
+ * (c) 2018 Erin Gee
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
 #include <Arduino.h>             // Arduino core
 
+#ifdef BIODATA_HOST
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "Replay.h"
+#include "Session.h"
+#include "EventIndex.h"
+#include "FeatureArchive.h"
+
+// Minimum total duration of the timing runs of a case, in seconds.
+#define REGRESSION_TIMING_SECONDS 0.3
+
+/**
+ * An output series: a feature compared with a tolerance, or an event flag
+ * (1 at the samples where an event starts) matched in time.
+ */
+struct Column {
+  const char* name;
+  bool event;
+  float absTolerance;
+  float relTolerance;
+};
+
+/// Outputs of a case, one vector per column.
+typedef std::vector<std::vector<float> > Table;
+
+/**
+ * Column layout of each channel, and conversion of its features into a row.
+ * #alignment# is the time window (seconds) for values and events.
+ */
+template <class Channel> struct Columns;
+
+template <> struct Columns<HeartChannel> {
+  static const size_t n = 7;
+  static const Column columns[n];
+  static constexpr double alignment = 0.02;
+
+  void row(const HeartFeatures& f, float* out) {
+    out[0] = f.normalized;
+    out[1] = f.bpm;
+    out[2] = f.bpmChange;
+    out[3] = f.amplitudeChange;
+    out[4] = f.interval;
+    out[5] = f.amplitude;
+    out[6] = f.beat ? 1 : 0;
+  }
+};
+
+const Column Columns<HeartChannel>::columns[] = {
+  { "normalized",      false, 0.01f, 0 },
+  { "bpm",             false, 0.5f,  0 },
+  { "bpmChange",       false, 0.02f, 0 },
+  { "amplitudeChange", false, 0.02f, 0 },
+  { "interval",        false, 2,     0 },
+  { "amplitude",       false, 0.5f,  0.01f },
+  { "beat",            true,  0,     0 },
+};
+
+template <> struct Columns<SkinConductanceChannel> {
+  static const size_t n = 3;
+  static const Column columns[n];
+  static constexpr double alignment = 0.1;
+
+  bool response;  // between an SCR onset and its offset (as in EventIndex)
+  Columns() : response(false) {}
+
+  void row(const SkinConductanceFeatures& f, float* out) {
+    out[0] = f.scr;
+    out[1] = f.scl;
+    out[2] = 0;
+    if (!response && f.scr > EVENT_SCR_ONSET) {
+      out[2] = 1;
+      response = true;
+    } else if (response && f.scr < EVENT_SCR_OFFSET) {
+      response = false;
+    }
+  }
+};
+
+const Column Columns<SkinConductanceChannel>::columns[] = {
+  { "scr",      false, 0.001f, 0.01f },
+  { "scl",      false, 0.002f, 0 },
+  { "scrOnset", true,  0,      0 },
+};
+
+template <> struct Columns<RespirationChannel> {
+  static const size_t n = 16;
+  static const Column columns[n];
+  static constexpr double alignment = 0.1;
+
+  bool exhaling;
+  Columns() : exhaling(false) {}
+
+  void row(const RespirationFeatures& f, float* out) {
+    out[0] = f.rpm;
+    out[1] = f.rpmChange;
+    out[2] = f.amplitude;
+    out[3] = f.amplitudeChange;
+    out[4] = f.temperature;
+    out[5] = f.normalized;
+    out[6] = f.scaled;
+    out[7] = f.normalizedAmplitude;
+    out[8] = f.amplitudeDelta;
+    out[9] = f.amplitudeVariability;
+    out[10] = f.interval;
+    out[11] = f.normalizedRpm;
+    out[12] = f.rpmDelta;
+    out[13] = f.rpmVariability;
+    out[14] = (f.exhaling && !exhaling) ? 1 : 0;
+    out[15] = (!f.exhaling && exhaling) ? 1 : 0;
+    exhaling = f.exhaling;
+  }
+};
+
+const Column Columns<RespirationChannel>::columns[] = {
+  { "rpm",                  false, 0.5f,   0 },
+  { "rpmChange",            false, 0.02f,  0 },
+  { "amplitude",            false, 0.001f, 0.01f },
+  { "amplitudeChange",      false, 0.02f,  0 },
+  { "temperature",          false, 0.005f, 0 },
+  { "normalized",           false, 0.02f,  0 },
+  { "scaled",               false, 0.01f,  0 },
+  { "normalizedAmplitude",  false, 0.02f,  0 },
+  { "amplitudeDelta",       false, 0.05f,  0.01f },
+  { "amplitudeVariability", false, 0.1f,   0.01f },
+  { "interval",             false, 1,      0 },
+  { "normalizedRpm",        false, 0.02f,  0 },
+  { "rpmDelta",             false, 0.5f,   0 },
+  { "rpmVariability",       false, 0.5f,   0.01f },
+  { "exhale",               true,  0,      0 },
+  { "inhale",               true,  0,      0 },
+};
+
+constexpr double Columns<HeartChannel>::alignment;
+constexpr double Columns<SkinConductanceChannel>::alignment;
+constexpr double Columns<RespirationChannel>::alignment;
+
+// Synthetic recordings ////////////////////////////////////////////////////
+
+// Small deterministic noise generator (one per recording).
+struct Noise {
+  uint32_t state;
+  Noise(uint32_t seed) : state(seed) {}
+  double uniform() {
+    state = state * 1664525UL + 1013904223UL;
+    return (state >> 8) / 16777216.0;
+  }
+  int integer(int amplitude) { return (int)(uniform() * (2 * amplitude + 1)) - amplitude; }
+};
+
+/// 10-bit analogRead() reading.
+static uint16_t clampSample(double v) {
+  return (uint16_t)(v < 0 ? 0 : (v > 1023 ? 1023 : v));
+}
+
+/// Single-ended ADS1115 reading (15 bits).
+static uint16_t clampAdsSample(double v) {
+  return (uint16_t)(v < 0 ? 0 : (v > 32767 ? 32767 : v));
+}
+
+/// PPG with a slowly varying heart rate; #jitter# randomizes every interval.
+static std::vector<uint16_t> syntheticPpg(double seconds, unsigned long rate, double jitter, int noise,
+                                          uint32_t seed) {
+  Noise r(seed);
+  std::vector<uint16_t> samples;
+  double phase = 0, frequency = 1.2;
+  for (size_t i = 0; i < (size_t)(seconds * rate); i++) {
+    double t = (double)i / rate;
+    phase += frequency / rate;
+    if (phase >= 1) {
+      phase -= 1;
+      frequency = (1.2 + 0.3 * sin(t / 40.0)) * (1 + jitter * (r.uniform() - 0.5));
+    }
+    double pulse = exp(-pow((phase - 0.2) / 0.06, 2)) + 0.3 * exp(-pow((phase - 0.45) / 0.08, 2));
+    double wander = 30 * sin(t / 7.0);
+    samples.push_back(clampSample(350 + wander + (250 + 50 * sin(t / 90.0)) * pulse + r.integer(noise)));
+  }
+  return samples;
+}
+
+/// Skin conductance: drifting level with responses every 15 to 45 seconds.
+static std::vector<uint16_t> syntheticSc(double seconds, unsigned long rate, uint32_t seed) {
+  Noise r(seed);
+  std::vector<uint16_t> samples;
+  double nextOnset = 10, onset = -1000, amplitude = 0;
+  for (size_t i = 0; i < (size_t)(seconds * rate); i++) {
+    double t = (double)i / rate;
+    if (t >= nextOnset) {
+      onset = t;
+      amplitude = 20 + 40 * r.uniform();
+      nextOnset = t + 15 + 30 * r.uniform();
+    }
+    double dt = t - onset;
+    double response = amplitude * (1 - exp(-dt / 0.7)) * exp(-dt / 6.0);
+    samples.push_back(clampSample(400 + 80 * sin(t / 200.0) + response + r.integer(1)));
+  }
+  return samples;
+}
+
+/// Thermistor respiration signal on the ADS1115, 10 to 20 breaths per
+/// minute: around 13000 counts (24 C, about 310 counts per degree), breaths
+/// of 0.5 to 1 degree.
+static std::vector<uint16_t> syntheticRespiration(double seconds, unsigned long rate, uint32_t seed) {
+  Noise r(seed);
+  std::vector<uint16_t> samples;
+  double phase = 0, frequency = 0.25, amplitude = 230;
+  for (size_t i = 0; i < (size_t)(seconds * rate); i++) {
+    double t = (double)i / rate;
+    phase += frequency / rate;
+    if (phase >= 1) {
+      phase -= 1;
+      frequency = (10 + 10 * r.uniform()) / 60;
+      amplitude = 150 + 150 * r.uniform();
+    }
+    samples.push_back(
+        clampAdsSample(13000 + amplitude * sin(2 * M_PI * phase) + 40 * sin(t / 30.0) + r.integer(8)));
+  }
+  return samples;
+}
+
+// Cases ///////////////////////////////////////////////////////////////////
+
+struct Case {
+  std::string name;
+  int channel;  // SESSION_*_CHANNEL
+  unsigned long rate;
+  std::vector<uint16_t> samples;
+};
+
+struct Result {
+  bool failed;
+  double nsPerSample;
+};
+
+static double elapsed(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/// Best time per sample of replaying #c#, in ns.
+template <class Channel>
+static double timeReplay(const Case& c, std::vector<typename Channel::Features>& features) {
+  double best = INFINITY, total = 0;
+  for (int run = 0; run < 3 || total < REGRESSION_TIMING_SECONDS; run++) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    replay<Channel>(c.samples.data(), c.samples.size(), c.rate, features.data());
+    double t = elapsed(start);
+    total += t;
+    if (t < best) best = t;
+  }
+  return best * 1e9 / c.samples.size();
+}
+
+static bool readGolden(const std::string& path, const Column* columns, size_t nColumns, unsigned long rate,
+                       size_t nRows, Table& golden) {
+  FeatureArchiveReader reader;
+  if (!reader.open(path.c_str()))
+    return false;
+  if (reader.rate() != rate || reader.nRows() != nRows) {
+    fprintf(stderr, "%s: %llu rows at %u Hz, expected %zu at %lu Hz\n", path.c_str(),
+            (unsigned long long)reader.nRows(), reader.rate(), nRows, rate);
+    return false;
+  }
+  golden.assign(nColumns, std::vector<float>(nRows));
+  for (size_t c = 0; c < nColumns; c++) {
+    int column = reader.findColumn(columns[c].name);
+    if (column < 0 || reader.read(column, 0, nRows, golden[c].data()) != nRows) {
+      fprintf(stderr, "%s: no column %s\n", path.c_str(), columns[c].name);
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool writeGolden(const std::string& path, const Column* columns, size_t nColumns, unsigned long rate,
+                        const Table& table) {
+  std::vector<std::string> names;
+  for (size_t c = 0; c < nColumns; c++)
+    names.push_back(columns[c].name);
+  FeatureArchiveWriter writer;
+  if (!writer.open(path.c_str(), names, rate))
+    return false;
+  std::vector<float> row(nColumns);
+  for (size_t i = 0; i < table[0].size(); i++) {
+    for (size_t c = 0; c < nColumns; c++)
+      row[c] = table[c][i];
+    writer.append(row.data());
+  }
+  return writer.close();
+}
+
+/**
+ * Compares a feature with its golden series. Prints the largest error (after
+ * alignment) and returns false if any sample is out of tolerance.
+ */
+static bool compareValues(const char* caseName, const Column& column, const std::vector<float>& values,
+                          const std::vector<float>& golden, size_t window) {
+  size_t n = values.size(), nBad = 0;
+  double maxError = 0;
+  for (size_t i = 0; i < n; i++) {
+    float v = values[i];
+    double error = fabs(v - golden[i]);
+    size_t first = (i > window) ? i - window : 0, end = (i + window + 1 < n) ? i + window + 1 : n;
+    for (size_t j = first; j < end && error > 0; j++) {
+      if (isnan(v) && isnan(golden[j])) error = 0;
+      else if (fabs(v - golden[j]) < error) error = fabs(v - golden[j]);
+    }
+    if (isnan(error) || error > column.absTolerance + column.relTolerance * fabs(golden[i])) {
+      nBad++;
+      error = isnan(error) ? INFINITY : error;
+    }
+    if (error > maxError) maxError = error;
+  }
+  printf("%-24s %-16s max error %-10.4g tolerance %-6g", caseName, column.name, maxError, column.absTolerance);
+  if (column.relTolerance > 0)
+    printf(" + %g x", column.relTolerance);
+  printf("  %s\n", nBad ? "FAIL" : "ok");
+  if (nBad)
+    printf("%-24s %-16s %zu of %zu samples out of tolerance\n", "", "", nBad, n);
+  return nBad == 0;
+}
+
+/**
+ * Matches events one to one (in time order) within #window# samples. Prints
+ * the counts and the mean shift, and returns false if any event is missed or
+ * extra.
+ */
+static bool compareEvents(const char* caseName, const Column& column, const std::vector<float>& values,
+                          const std::vector<float>& golden, size_t window, unsigned long rate) {
+  std::vector<size_t> a, g;
+  for (size_t i = 0; i < values.size(); i++) {
+    if (values[i] != 0) a.push_back(i);
+    if (golden[i] != 0) g.push_back(i);
+  }
+  size_t nMatched = 0, nMissed = 0, nExtra = 0;
+  double shift = 0;
+  size_t i = 0, j = 0;
+  while (i < a.size() || j < g.size()) {
+    if (i < a.size() && j < g.size() && (a[i] > g[j] ? a[i] - g[j] : g[j] - a[i]) <= window) {
+      shift += (double)a[i] - (double)g[j];
+      nMatched++;
+      i++;
+      j++;
+    } else if (j >= g.size() || (i < a.size() && a[i] < g[j])) {
+      nExtra++;
+      i++;
+    } else {
+      nMissed++;
+      j++;
+    }
+  }
+  bool ok = (nMissed == 0 && nExtra == 0);
+  printf("%-24s %-16s %zu/%zu matched, %zu missed, %zu extra, mean shift %.1f ms  %s\n", caseName, column.name,
+         nMatched, g.size(), nMissed, nExtra, nMatched ? shift / nMatched * 1000 / rate : 0.0, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+template <class Channel>
+static Result runCase(const Case& c, const std::string& goldenDirectory, bool update) {
+  typedef Columns<Channel> Layout;
+  Result result = { false, 0 };
+  size_t n = c.samples.size();
+
+  std::vector<typename Channel::Features> features(n);
+  result.nsPerSample = timeReplay<Channel>(c, features);
+
+  Layout layout;
+  Table table(Layout::n, std::vector<float>(n));
+  float row[Layout::n];
+  for (size_t i = 0; i < n; i++) {
+    layout.row(features[i], row);
+    for (size_t k = 0; k < Layout::n; k++)
+      table[k][i] = row[k];
+  }
+
+  std::string path = goldenDirectory + "/" + c.name + ".bdfa";
+  if (update) {
+    if (!writeGolden(path, Layout::columns, Layout::n, c.rate, table)) {
+      perror(path.c_str());
+      result.failed = true;
+    }
+    printf("%-24s updated %s (%zu samples, %.1f ns/sample)\n", c.name.c_str(), path.c_str(), n,
+           result.nsPerSample);
+    return result;
+  }
+
+  Table golden;
+  if (!readGolden(path, Layout::columns, Layout::n, c.rate, n, golden)) {
+    printf("%-24s cannot read golden file %s (run with -update to write it)\n", c.name.c_str(), path.c_str());
+    result.failed = true;
+    return result;
+  }
+
+  size_t window = (size_t)(Layout::alignment * c.rate + 0.5);
+  for (size_t k = 0; k < Layout::n; k++) {
+    const Column& column = Layout::columns[k];
+    bool ok = column.event ? compareEvents(c.name.c_str(), column, table[k], golden[k], window, c.rate)
+                           : compareValues(c.name.c_str(), column, table[k], golden[k], window);
+    if (!ok) result.failed = true;
+  }
+  printf("%-24s %-16s %.1f ns/sample  %s\n", c.name.c_str(), "cost", result.nsPerSample,
+         result.failed ? "FAILED" : "PASSED");
+  return result;
+}
+
+static Result run(const Case& c, const std::string& goldenDirectory, bool update) {
+  switch (c.channel) {
+    case SESSION_HEART_CHANNEL: return runCase<HeartChannel>(c, goldenDirectory, update);
+    case SESSION_SC_CHANNEL:    return runCase<SkinConductanceChannel>(c, goldenDirectory, update);
+    default:                    return runCase<RespirationChannel>(c, goldenDirectory, update);
+  }
+}
+
+static void addCase(std::vector<Case>& cases, const std::string& name, int channel, unsigned long rate,
+                    const std::vector<uint16_t>& samples) {
+  if (samples.empty()) return;
+  Case c = { name, channel, rate, samples };
+  cases.push_back(c);
+}
+
+int main(int argc, char** argv) {
+  std::string goldenDirectory = "test/golden";
+  bool update = false;
+  std::vector<Case> cases;
+
+  addCase(cases, "heart-steady", SESSION_HEART_CHANNEL, SESSION_HEART_RATE,
+          syntheticPpg(120, SESSION_HEART_RATE, 0.02, 3, 1));
+  addCase(cases, "heart-irregular", SESSION_HEART_CHANNEL, SESSION_HEART_RATE,
+          syntheticPpg(120, SESSION_HEART_RATE, 0.4, 12, 2));
+  addCase(cases, "sc-responses", SESSION_SC_CHANNEL, SESSION_SC_RATE,
+          syntheticSc(300, SESSION_SC_RATE, 3));
+  addCase(cases, "respiration-variable", SESSION_RESPIRATION_CHANNEL, SESSION_RESPIRATION_RATE,
+          syntheticRespiration(300, SESSION_RESPIRATION_RATE, 4));
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "-golden") == 0 && i + 1 < argc) {
+      goldenDirectory = argv[++i];
+    } else if (strcmp(argv[i], "-update") == 0) {
+      update = true;
+    } else if (strcmp(argv[i], "-session") == 0 && i + 1 < argc) {
+      const char* path = argv[++i];
+      Session session;
+      if (!loadSession(path, session)) {
+        perror(path);
+        return 1;
+      }
+      std::string name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+      name = name.substr(0, name.rfind('.'));
+      addCase(cases, name + "-heart", SESSION_HEART_CHANNEL, SESSION_HEART_RATE, session.heart);
+      addCase(cases, name + "-sc", SESSION_SC_CHANNEL, SESSION_SC_RATE, session.sc);
+      addCase(cases, name + "-respiration", SESSION_RESPIRATION_CHANNEL, SESSION_RESPIRATION_RATE,
+              session.respiration);
+    } else {
+      fprintf(stderr, "usage: %s [-golden dir] [-update] [-session file]...\n", argv[0]);
+      return 1;
+    }
+  }
+
+  size_t nFailed = 0;
+  for (size_t i = 0; i < cases.size(); i++) {
+    Result result = run(cases[i], goldenDirectory, update);
+    if (result.failed) nFailed++;
+  }
+  printf("%zu cases: %zu passed, %zu failed\n", cases.size(), cases.size() - nFailed, nFailed);
+  return nFailed ? 1 : 0;
+}
+
+#else
+
 void setup()
 {
 }
 
 void loop()
 {
-}
\ No newline at end of file
+}
+
+#endif